@@ -0,0 +1,390 @@
+#include "AssetCooker.h"
+#include "Hash.h"
+#include "TextureCooker.h"
+#include "../JobSystem.h"
+#include "../MeshLoader.h"
+#include "../PVSBuilder.h"
+#include "../SceneFile.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <thread>
+#include <unordered_set>
+
+namespace fs = std::filesystem;
+
+AssetCooker::AssetCooker(const CookerSettings& settings)
+{
+	this->settings = settings;
+	if (this->settings.threadCount == 0)
+		this->settings.threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+AssetCooker::~AssetCooker()
+{
+}
+
+// --------------------------------------------------------
+// Cooks everything that's out of date and reports the results
+// --------------------------------------------------------
+int AssetCooker::Run()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	std::error_code error;
+	fs::create_directories(settings.outputDirectory, error);
+
+	if (!settings.force)
+		LoadManifest();
+
+	std::vector<Job> jobs;
+	GatherJobs(jobs);
+
+	// Simple shared work queue - each thread grabs the next
+	// unclaimed job until there are none left
+	//  - Scenes are left for after, below
+	std::atomic<size_t> nextJob(0);
+	auto worker = [&]()
+	{
+		TextureCooker textureCooker;
+		for (size_t i = nextJob++; i < jobs.size(); i = nextJob++)
+			if (jobs[i].type != AssetType::Scene)
+				RunJob(jobs[i], textureCooker);
+	};
+
+	unsigned int threadCount = (unsigned int)std::min((size_t)settings.threadCount, std::max(jobs.size(), (size_t)1));
+	std::vector<std::thread> threads;
+	for (unsigned int t = 1; t < threadCount; t++)
+		threads.push_back(std::thread(worker));
+	worker();
+	for (auto& t : threads)
+		t.join();
+
+	for (auto& job : jobs)
+	{
+		if (job.type != AssetType::Scene)
+			sourceHashes[job.key] = job.entry.sourceHash;
+	}
+
+	// Scenes take far longer than anything else, so they go one
+	// at a time once those threads are done, each spreading its
+	// cells over every thread
+	JobSystem* jobSystem = settings.threadCount > 1 ? new JobSystem(settings.threadCount - 1) : 0;
+	for (auto& job : jobs)
+	{
+		if (job.type == AssetType::Scene)
+			RunSceneJob(job, jobSystem);
+	}
+	delete jobSystem;
+
+	SaveManifest(jobs);
+
+	// Report
+	int cooked = 0, skipped = 0, failed = 0;
+	for (auto& job : jobs)
+	{
+		switch (job.result)
+		{
+		case JobResult::Cooked: cooked++; break;
+		case JobResult::Skipped: skipped++; break;
+		case JobResult::Failed:
+			failed++;
+			printf("FAILED: %s\n", job.key.c_str());
+			break;
+		}
+	}
+
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	printf("%d cooked, %d up to date, %d failed in %.1fms (%u threads)\n", cooked, skipped, failed, ms, threadCount);
+	return failed;
+}
+
+fs::path AssetCooker::GetManifestPath()
+{
+	return settings.outputDirectory / "CookManifest.txt";
+}
+
+// --------------------------------------------------------
+// Reads the manifest from the last run, if there is one
+//  - Format is one asset per line:
+//    settingsHash sourceHash sourceSize sourceTime relativePath
+// --------------------------------------------------------
+void AssetCooker::LoadManifest()
+{
+	std::ifstream file(GetManifestPath());
+	if (!file.is_open())
+		return;
+
+	ManifestEntry entry;
+	std::string key;
+	while (file >> std::hex >> entry.settingsHash >> entry.sourceHash >> std::dec >> entry.sourceSize >> entry.sourceTime)
+	{
+		file.get(); // Skip the space before the path, which may itself contain spaces
+		if (!std::getline(file, key))
+			break;
+		manifest[key] = entry;
+	}
+}
+
+// --------------------------------------------------------
+// Writes out the manifest for the next run
+//  - Failed assets are left out so they're retried
+// --------------------------------------------------------
+void AssetCooker::SaveManifest(const std::vector<Job>& jobs)
+{
+	std::ofstream file(GetManifestPath(), std::ios::trunc);
+	for (auto& job : jobs)
+	{
+		if (job.result == JobResult::Failed)
+			continue;
+
+		file << std::hex << job.entry.settingsHash << " " << job.entry.sourceHash << " "
+			<< std::dec << job.entry.sourceSize << " " << job.entry.sourceTime << " "
+			<< job.key << "\n";
+	}
+}
+
+// --------------------------------------------------------
+// Finds every asset we know how to cook
+//  - The output directory is skipped in case it lives
+//    inside the source directory (which is the default)
+// --------------------------------------------------------
+void AssetCooker::GatherJobs(std::vector<Job>& jobs)
+{
+	std::error_code error;
+	fs::path outputDirectory = fs::weakly_canonical(settings.outputDirectory, error);
+
+	fs::recursive_directory_iterator it(settings.sourceDirectory, error), end;
+	for (; it != end; it.increment(error))
+	{
+		if (it->is_directory())
+		{
+			if (fs::weakly_canonical(it->path(), error) == outputDirectory)
+				it.disable_recursion_pending();
+			continue;
+		}
+
+		std::string extension = it->path().extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+		Job job;
+		if (extension == ".obj")
+			job.type = AssetType::Mesh;
+		else if (extension == ".png" || extension == ".jpg" || extension == ".bmp" || extension == ".tif")
+			job.type = AssetType::Texture;
+		else if (extension == ".scene")
+			job.type = AssetType::Scene;
+		else
+			continue;
+
+		fs::path relative = fs::relative(it->path(), settings.sourceDirectory, error);
+		job.source = it->path();
+		job.output = settings.outputDirectory / relative;
+		job.output.replace_extension(job.type == AssetType::Mesh ? ".cmesh" : job.type == AssetType::Texture ? ".dds" : ".cscene");
+		job.key = relative.generic_string();
+		jobs.push_back(job);
+	}
+}
+
+// --------------------------------------------------------
+// Hashes everything that changes the output of a cook
+// besides the source file itself
+// --------------------------------------------------------
+unsigned long long AssetCooker::GetSettingsHash(AssetType type)
+{
+	unsigned long long hash = Hash::Value(type);
+	switch (type)
+	{
+	case AssetType::Mesh:
+		hash = Hash::Value(MeshLoader::CookedMeshVersion, hash);
+		hash = Hash::Value(sizeof(Vertex), hash);
+		break;
+
+	case AssetType::Texture:
+		hash = Hash::Value(TextureCooker::Version, hash);
+		hash = Hash::Value(settings.generateMips, hash);
+		break;
+
+	case AssetType::Scene:
+		hash = Hash::Value(SceneFile::CookedSceneVersion, hash);
+		break;
+	}
+	return hash;
+}
+
+// --------------------------------------------------------
+// Fills in the job's manifest entry and checks it against
+// the last run
+//  - Cheap check first: if the size and timestamp match the
+//    manifest, the file isn't even opened
+//  - Otherwise the contents are hashed, so touching a file
+//    without changing it doesn't cause a re-cook
+//  - A scene's hash takes in the meshes it places as well,
+//    which its own size and timestamp know nothing about, so
+//    scenes are always hashed
+// --------------------------------------------------------
+bool AssetCooker::IsUpToDate(Job& job)
+{
+	std::error_code error;
+	job.entry.settingsHash = GetSettingsHash(job.type);
+	job.entry.sourceSize = fs::file_size(job.source, error);
+	job.entry.sourceTime = fs::last_write_time(job.source, error).time_since_epoch().count();
+
+	auto previous = manifest.find(job.key);
+	bool havePrevious =
+		previous != manifest.end() &&
+		previous->second.settingsHash == job.entry.settingsHash &&
+		fs::exists(job.output, error);
+
+	if (havePrevious &&
+		job.type != AssetType::Scene &&
+		previous->second.sourceSize == job.entry.sourceSize &&
+		previous->second.sourceTime == job.entry.sourceTime)
+	{
+		job.entry.sourceHash = previous->second.sourceHash;
+		return true;
+	}
+
+	job.entry.sourceHash = HashFile(job.source);
+	if (job.type == AssetType::Scene)
+		job.entry.sourceHash = HashSceneMeshes(job, job.entry.sourceHash);
+
+	return havePrevious && previous->second.sourceHash == job.entry.sourceHash;
+}
+
+unsigned long long AssetCooker::HashFile(const fs::path& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	return Hash::Bytes(bytes.data(), bytes.size());
+}
+
+// --------------------------------------------------------
+// Folds the contents of every mesh a scene places into hash
+//  - Meshes cooked this run already have theirs, so only
+//    ones from outside the source directory get read here
+//  - A scene that doesn't load is left to fail in the cook
+// --------------------------------------------------------
+unsigned long long AssetCooker::HashSceneMeshes(const Job& job, unsigned long long hash)
+{
+	SceneData scene;
+	if (!SceneFile::LoadScene(job.source.string().c_str(), scene))
+		return hash;
+
+	std::unordered_set<std::string> hashed;
+	for (const SceneObject& object : scene.objects)
+	{
+		if (!hashed.insert(object.mesh).second)
+			continue;
+
+		std::error_code error;
+		fs::path meshPath = job.source.parent_path() / object.mesh;
+		auto known = sourceHashes.find(fs::relative(meshPath, settings.sourceDirectory, error).generic_string());
+		hash = Hash::String(object.mesh, hash);
+		hash = Hash::Value(known != sourceHashes.end() ? known->second : HashFile(meshPath), hash);
+	}
+	return hash;
+}
+
+// --------------------------------------------------------
+// Cooks a single mesh or texture if it's out of date
+// --------------------------------------------------------
+void AssetCooker::RunJob(Job& job, TextureCooker& textureCooker)
+{
+	if (IsUpToDate(job))
+	{
+		job.result = JobResult::Skipped;
+		return;
+	}
+
+	std::error_code error;
+	fs::create_directories(job.output.parent_path(), error);
+
+	bool success = false;
+	switch (job.type)
+	{
+	case AssetType::Mesh:
+	{
+		std::vector<Vertex> verts;
+		std::vector<unsigned int> indices;
+		std::vector<MeshLOD> lods;
+		MeshBVH bvh;
+		success = MeshLoader::LoadOBJ(job.source.string().c_str(), verts, indices);
+		if (success)
+		{
+			// Built here so the game never has to
+			MeshLoader::BuildBVH(verts, indices, bvh);
+			MeshLoader::BuildLODs(verts, indices, lods);
+			success = MeshLoader::WriteCookedMesh(job.output.string().c_str(), verts, indices, &bvh, &lods);
+		}
+	}
+		break;
+
+	case AssetType::Texture:
+		success = textureCooker.Cook(job.source.wstring(), job.output.wstring(), settings.generateMips);
+		break;
+
+	case AssetType::Scene:
+		break;	// RunSceneJob() instead
+	}
+
+	job.result = success ? JobResult::Cooked : JobResult::Failed;
+}
+
+// --------------------------------------------------------
+// Cooks a single scene if it's out of date
+// --------------------------------------------------------
+void AssetCooker::RunSceneJob(Job& job, JobSystem* jobSystem)
+{
+	if (IsUpToDate(job))
+	{
+		job.result = JobResult::Skipped;
+		return;
+	}
+
+	std::error_code error;
+	fs::create_directories(job.output.parent_path(), error);
+	job.result = CookScene(job, jobSystem) ? JobResult::Cooked : JobResult::Failed;
+}
+
+// --------------------------------------------------------
+// Works out a scene's potentially visible sets, from the
+// meshes it places, and writes it out with them
+//  - Fails if there's nothing in the scene to see
+// --------------------------------------------------------
+bool AssetCooker::CookScene(const Job& job, JobSystem* jobSystem)
+{
+	SceneData scene;
+	if (!SceneFile::LoadScene(job.source.string().c_str(), scene))
+		return false;
+
+	// Each mesh is loaded once, however many times it's placed
+	std::unordered_map<std::string, MeshData> meshes;
+	PVSBuilder builder;
+	for (const SceneObject& object : scene.objects)
+	{
+		MeshData& mesh = meshes[object.mesh];
+		if (!mesh.success)
+		{
+			fs::path meshPath = job.source.parent_path() / object.mesh;
+			mesh.success = MeshLoader::LoadOBJ(meshPath.string().c_str(), mesh.vertices, mesh.indices) && !mesh.vertices.empty();
+			if (!mesh.success)
+			{
+				printf("%s: can't load %s\n", job.key.c_str(), object.mesh.c_str());
+				return false;
+			}
+		}
+		builder.AddObject(&mesh.vertices[0].Position, (unsigned int)mesh.vertices.size(), sizeof(Vertex), mesh.indices.data(), (unsigned int)mesh.indices.size(), object.world);
+	}
+
+	builder.SetCellSize(scene.cellSize);
+	builder.SetRaysPerObject(scene.raysPerObject);
+	if (!builder.Build(scene.pvs, jobSystem))
+	{
+		printf("%s: nothing to build visibility from\n", job.key.c_str());
+		return false;
+	}
+
+	return SceneFile::WriteCookedScene(job.output.string().c_str(), scene);
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class JobSystem;
+class TextureCooker;
+
+// --------------------------------------------------------
+// Options that affect the cooked output
+//  - Anything in here must also feed into the settings hash,
+//    otherwise changing it won't trigger a rebuild
+// --------------------------------------------------------
+struct CookerSettings
+{
+	std::filesystem::path sourceDirectory;
+	std::filesystem::path outputDirectory;
+	unsigned int threadCount = 0;	// 0 = one per hardware thread
+	bool force = false;				// Ignore the manifest and rebuild everything
+	bool generateMips = true;
+};
+
+// --------------------------------------------------------
+// Offline asset cooker
+//  - Finds every cookable asset under the source directory
+//    and writes a runtime-ready version of it to the same
+//    relative path under the output directory
+//  - Incremental: a manifest remembers each asset's source
+//    hash and settings hash, and unchanged assets are skipped
+//  - Jobs run in parallel across all cores
+// --------------------------------------------------------
+class AssetCooker
+{
+public:
+	AssetCooker(const CookerSettings& settings);
+	~AssetCooker();
+
+	// Returns the number of assets that failed to cook
+	int Run();
+
+private:
+	enum class AssetType { Mesh, Texture, Scene };
+
+	// One line of the manifest
+	struct ManifestEntry
+	{
+		unsigned long long settingsHash = 0;
+		unsigned long long sourceHash = 0;
+		unsigned long long sourceSize = 0;
+		long long sourceTime = 0;
+	};
+
+	enum class JobResult { Skipped, Cooked, Failed };
+
+	struct Job
+	{
+		AssetType type;
+		std::filesystem::path source;
+		std::filesystem::path output;
+		std::string key;		// Source path relative to the source directory
+		ManifestEntry entry;	// Filled in as the job runs
+		JobResult result = JobResult::Skipped;
+	};
+
+	CookerSettings settings;
+	std::unordered_map<std::string, ManifestEntry> manifest;
+
+	// Source hashes of everything but scenes, once it's been
+	// through RunJob(), for scenes to fold in
+	std::unordered_map<std::string, unsigned long long> sourceHashes;
+
+	std::filesystem::path GetManifestPath();
+	void LoadManifest();
+	void SaveManifest(const std::vector<Job>& jobs);
+
+	void GatherJobs(std::vector<Job>& jobs);
+	unsigned long long GetSettingsHash(AssetType type);
+	bool IsUpToDate(Job& job);
+	static unsigned long long HashFile(const std::filesystem::path& path);
+	unsigned long long HashSceneMeshes(const Job& job, unsigned long long hash);
+	void RunJob(Job& job, TextureCooker& textureCooker);
+	void RunSceneJob(Job& job, JobSystem* jobSystem);
+	bool CookScene(const Job& job, JobSystem* jobSystem);
+};
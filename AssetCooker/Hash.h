@@ -0,0 +1,35 @@
+#pragma once
+#include <string>
+
+// --------------------------------------------------------
+// 64-bit FNV-1a hashing
+//  - Not cryptographic, just fast and stable across runs,
+//    which is all the cooker needs to detect changes
+// --------------------------------------------------------
+class Hash
+{
+public:
+	static const unsigned long long Seed = 14695981039346656037ULL;
+
+	static unsigned long long Bytes(const void* data, size_t size, unsigned long long hash = Seed)
+	{
+		const unsigned char* bytes = (const unsigned char*)data;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ULL;
+		}
+		return hash;
+	}
+
+	static unsigned long long String(const std::string& str, unsigned long long hash = Seed)
+	{
+		return Bytes(str.data(), str.size(), hash);
+	}
+
+	template<typename T>
+	static unsigned long long Value(const T& value, unsigned long long hash = Seed)
+	{
+		return Bytes(&value, sizeof(T), hash);
+	}
+};
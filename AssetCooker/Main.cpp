@@ -0,0 +1,48 @@
+#include <Windows.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "AssetCooker.h"
+
+// --------------------------------------------------------
+// Entry point for the asset cooker
+//
+// Usage: AssetCooker [sourceDir] [outputDir] [-j threads] [-force] [-nomips]
+//  - Defaults to cooking ../../Assets into ../../Assets/Cooked,
+//    which is where the game looks for cooked assets
+// --------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	CookerSettings settings;
+	settings.sourceDirectory = "../../Assets";
+	settings.outputDirectory = "../../Assets/Cooked";
+
+	int positional = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+			settings.threadCount = (unsigned int)atoi(argv[++i]);
+		else if (strcmp(argv[i], "-force") == 0)
+			settings.force = true;
+		else if (strcmp(argv[i], "-nomips") == 0)
+			settings.generateMips = false;
+		else if (argv[i][0] == '-')
+		{
+			printf("Usage: AssetCooker [sourceDir] [outputDir] [-j threads] [-force] [-nomips]\n");
+			return 1;
+		}
+		else if (positional == 0)
+		{
+			settings.sourceDirectory = argv[i];
+			positional++;
+		}
+		else if (positional == 1)
+		{
+			settings.outputDirectory = argv[i];
+			positional++;
+		}
+	}
+
+	AssetCooker cooker(settings);
+	return cooker.Run() == 0 ? 0 : 1;
+}
@@ -0,0 +1,173 @@
+#include "TextureCooker.h"
+#include <Windows.h>
+#include <wincodec.h>
+#include <wrl/client.h>
+#include <fstream>
+#include <vector>
+
+#pragma comment(lib, "windowscodecs.lib")
+
+using Microsoft::WRL::ComPtr;
+
+// --------------------------------------------------------
+// Minimal DDS file structures
+//  - Only what's needed to describe an uncompressed
+//    RGBA8 texture with mips (see the DDS docs on MSDN)
+// --------------------------------------------------------
+struct DDSPixelFormat
+{
+	unsigned int size;
+	unsigned int flags;
+	unsigned int fourCC;
+	unsigned int rgbBitCount;
+	unsigned int rBitMask;
+	unsigned int gBitMask;
+	unsigned int bBitMask;
+	unsigned int aBitMask;
+};
+
+struct DDSHeader
+{
+	unsigned int size;
+	unsigned int flags;
+	unsigned int height;
+	unsigned int width;
+	unsigned int pitchOrLinearSize;
+	unsigned int depth;
+	unsigned int mipMapCount;
+	unsigned int reserved1[11];
+	DDSPixelFormat pixelFormat;
+	unsigned int caps;
+	unsigned int caps2;
+	unsigned int caps3;
+	unsigned int caps4;
+	unsigned int reserved2;
+};
+
+static const unsigned int DDSMagic = 0x20534444; // "DDS "
+
+
+TextureCooker::TextureCooker()
+{
+	factory = 0;
+
+	// WIC is COM based, so each cooking thread needs COM
+	comInitialized = SUCCEEDED(CoInitializeEx(nullptr, COINIT_MULTITHREADED));
+
+	CoCreateInstance(
+		CLSID_WICImagingFactory,
+		nullptr,
+		CLSCTX_INPROC_SERVER,
+		IID_PPV_ARGS(&factory));
+}
+
+TextureCooker::~TextureCooker()
+{
+	if (factory)
+		factory->Release();
+
+	if (comInitialized)
+		CoUninitialize();
+}
+
+// --------------------------------------------------------
+// Decodes the source image, builds a box-filtered mip chain
+// and writes the whole thing out as a .dds file
+// --------------------------------------------------------
+bool TextureCooker::Cook(const std::wstring& sourceFile, const std::wstring& outputFile, bool generateMips)
+{
+	if (!factory)
+		return false;
+
+	// Decode the first frame and convert it to RGBA8
+	ComPtr<IWICBitmapDecoder> decoder;
+	ComPtr<IWICBitmapFrameDecode> frame;
+	ComPtr<IWICFormatConverter> converter;
+	if (FAILED(factory->CreateDecoderFromFilename(sourceFile.c_str(), nullptr, GENERIC_READ, WICDecodeMetadataCacheOnDemand, decoder.GetAddressOf())) ||
+		FAILED(decoder->GetFrame(0, frame.GetAddressOf())) ||
+		FAILED(factory->CreateFormatConverter(converter.GetAddressOf())) ||
+		FAILED(converter->Initialize(frame.Get(), GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom)))
+		return false;
+
+	UINT width = 0;
+	UINT height = 0;
+	converter->GetSize(&width, &height);
+	if (width == 0 || height == 0)
+		return false;
+
+	std::vector<unsigned char> pixels(width * height * 4);
+	if (FAILED(converter->CopyPixels(nullptr, width * 4, (UINT)pixels.size(), &pixels[0])))
+		return false;
+
+	// Count the mips down to 1x1
+	unsigned int mipCount = 1;
+	if (generateMips)
+	{
+		for (UINT w = width, h = height; w > 1 || h > 1; w = max(w / 2, 1u), h = max(h / 2, 1u))
+			mipCount++;
+	}
+
+	// Write the header
+	std::ofstream file(outputFile, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return false;
+
+	DDSHeader header = {};
+	header.size = sizeof(DDSHeader);
+	header.flags = 0x1 | 0x2 | 0x4 | 0x8 | 0x1000 | 0x20000; // CAPS | HEIGHT | WIDTH | PITCH | PIXELFORMAT | MIPMAPCOUNT
+	header.height = height;
+	header.width = width;
+	header.pitchOrLinearSize = width * 4;
+	header.mipMapCount = mipCount;
+	header.pixelFormat.size = sizeof(DDSPixelFormat);
+	header.pixelFormat.flags = 0x40 | 0x1; // RGB | ALPHAPIXELS
+	header.pixelFormat.rgbBitCount = 32;
+	header.pixelFormat.rBitMask = 0x000000ff;
+	header.pixelFormat.gBitMask = 0x0000ff00;
+	header.pixelFormat.bBitMask = 0x00ff0000;
+	header.pixelFormat.aBitMask = 0xff000000;
+	header.caps = 0x1000 | (mipCount > 1 ? 0x400000 | 0x8 : 0); // TEXTURE | MIPMAP | COMPLEX
+
+	file.write((const char*)&DDSMagic, sizeof(DDSMagic));
+	file.write((const char*)&header, sizeof(DDSHeader));
+	file.write((const char*)&pixels[0], pixels.size());
+
+	// Each mip is a 2x2 box filter of the previous one
+	//  - Odd dimensions clamp at the edge
+	std::vector<unsigned char> next;
+	UINT w = width;
+	UINT h = height;
+	for (unsigned int mip = 1; mip < mipCount; mip++)
+	{
+		UINT nw = max(w / 2, 1u);
+		UINT nh = max(h / 2, 1u);
+		next.resize(nw * nh * 4);
+
+		for (UINT y = 0; y < nh; y++)
+		{
+			UINT y0 = min(y * 2, h - 1);
+			UINT y1 = min(y * 2 + 1, h - 1);
+			for (UINT x = 0; x < nw; x++)
+			{
+				UINT x0 = min(x * 2, w - 1);
+				UINT x1 = min(x * 2 + 1, w - 1);
+				for (UINT c = 0; c < 4; c++)
+				{
+					unsigned int sum =
+						pixels[(y0 * w + x0) * 4 + c] +
+						pixels[(y0 * w + x1) * 4 + c] +
+						pixels[(y1 * w + x0) * 4 + c] +
+						pixels[(y1 * w + x1) * 4 + c];
+					next[(y * nw + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+				}
+			}
+		}
+
+		file.write((const char*)&next[0], next.size());
+		pixels.swap(next);
+		w = nw;
+		h = nh;
+	}
+
+	return file.good();
+}
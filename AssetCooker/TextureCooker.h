@@ -0,0 +1,27 @@
+#pragma once
+#include <string>
+
+// --------------------------------------------------------
+// Converts source images (anything WIC can decode, so PNG,
+// JPG, BMP, etc.) into uncompressed RGBA8 .dds files with
+// a pre-built mip chain
+//  - The runtime can then load them with CreateDDSTextureFromFile
+//    and skip both image decoding and GenerateMips()
+//  - Each thread needs its own TextureCooker, since the WIC
+//    factory is created per instance
+// --------------------------------------------------------
+class TextureCooker
+{
+public:
+	// Bump this whenever the output changes in any way
+	static const unsigned int Version = 1;
+
+	TextureCooker();
+	~TextureCooker();
+
+	bool Cook(const std::wstring& sourceFile, const std::wstring& outputFile, bool generateMips);
+
+private:
+	struct IWICImagingFactory* factory;
+	bool comInitialized;
+};
@@ -0,0 +1,277 @@
+#include "AssetLoader.h"
+#include "MeshLoader.h"
+#include "WICTextureLoader.h"
+#include "DDSTextureLoader.h"
+#include <chrono>
+
+using namespace DirectX;
+
+// Case-insensitive check of a path's extension
+static bool HasExtension(const std::wstring& path, const wchar_t* extension)
+{
+	size_t length = path.size();
+	size_t extensionLength = wcslen(extension);
+	return length > extensionLength && _wcsicmp(path.c_str() + length - extensionLength, extension) == 0;
+}
+
+AssetLoader::AssetLoader(
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	StateCache* stateCache,
+	ThreadPool* threadPool,
+	AsyncFileLoader* fileLoader)
+{
+	this->device = device;
+	this->context = context;
+	this->stateCache = stateCache;
+	this->threadPool = threadPool;
+	this->fileLoader = fileLoader;
+	this->pendingCount = 0;
+	this->shuttingDown = false;
+}
+
+// --------------------------------------------------------
+// Cancels everything in flight and waits for it to wind down
+//  - Requests still on the pool or reading files will end up
+//    on the main thread queue, where we resume them so they
+//    can see they've been stopped and clean up
+// --------------------------------------------------------
+AssetLoader::~AssetLoader()
+{
+	shuttingDown = true;
+
+	std::unique_lock<std::mutex> lock(mainThreadMutex);
+	while (true)
+	{
+		mainThreadQueued.wait(lock, [this]() { return pendingCount == 0 || !mainThreadQueue.empty(); });
+		if (mainThreadQueue.empty())
+			break;
+
+		std::coroutine_handle<> handle = mainThreadQueue.front();
+		mainThreadQueue.pop_front();
+
+		lock.unlock();
+		handle.resume();
+		lock.lock();
+	}
+}
+
+// --------------------------------------------------------
+// Requests - each starts a detached coroutine that calls
+// back on the main thread unless it's been cancelled
+// --------------------------------------------------------
+void AssetLoader::LoadMesh(const std::wstring& path, std::function<void(Mesh*)> onLoaded, TaskPriority priority, CancellationToken cancel)
+{
+	pendingCount++;
+	MeshRequest(path, onLoaded, priority, cancel).Detach();
+}
+
+void AssetLoader::LoadTexture(const std::wstring& path, std::function<void(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>)> onLoaded, TaskPriority priority, CancellationToken cancel)
+{
+	pendingCount++;
+	TextureRequest(path, onLoaded, priority, cancel).Detach();
+}
+
+void AssetLoader::LoadVertexShader(const std::wstring& path, std::function<void(SimpleVertexShader*)> onLoaded, TaskPriority priority)
+{
+	pendingCount++;
+	VertexShaderRequest(path, onLoaded, priority).Detach();
+}
+
+void AssetLoader::LoadPixelShader(const std::wstring& path, std::function<void(SimplePixelShader*)> onLoaded, TaskPriority priority)
+{
+	pendingCount++;
+	PixelShaderRequest(path, onLoaded, priority).Detach();
+}
+
+// --------------------------------------------------------
+// Reads and parses the mesh on the thread pool, then makes
+// its buffers on the main thread
+//  - ".cmesh" files come from the asset cooker, anything
+//    else is treated as an OBJ
+// --------------------------------------------------------
+Task<Mesh*> AssetLoader::LoadMeshAsync(std::wstring path, TaskPriority priority, CancellationToken cancel)
+{
+	FileData file = co_await fileLoader->ReadFileAsync(path);
+	co_await threadPool->Schedule(priority);
+	if (Stopped(cancel) || !file.success)
+	{
+		// Callers always finish on the main thread, even empty-handed
+		co_await ResumeOnMainThread();
+		co_return 0;
+	}
+
+	MeshData mesh;
+	mesh.success = HasExtension(file.path, L".cmesh") ?
+		MeshLoader::ParseCookedMesh(file.bytes.data(), file.bytes.size(), mesh.vertices, mesh.indices, &mesh.bvh, &mesh.lods) :
+		MeshLoader::ParseOBJ(file.bytes.data(), file.bytes.size(), mesh.vertices, mesh.indices);
+
+	// Cooked meshes normally come with their BVH and levels of
+	// detail; anything else gets them built here, off the main
+	// thread (the BVH first, while there's only the one level)
+	if (mesh.success && mesh.bvh.IsEmpty())
+		MeshLoader::BuildBVH(mesh.vertices, mesh.indices, mesh.bvh, &mesh.lods);
+	if (mesh.success && mesh.lods.empty())
+		MeshLoader::BuildLODs(mesh.vertices, mesh.indices, mesh.lods);
+
+	co_await ResumeOnMainThread();
+	if (Stopped(cancel) || !mesh.success)
+		co_return 0;
+
+	co_return new Mesh(mesh, device);
+}
+
+// --------------------------------------------------------
+// Reads the texture, then creates it
+//  - Cooked .dds files are ready to go, so they're created
+//    right on the pool (the device is free-threaded)
+//  - Anything else is decoded by WIC on the main thread,
+//    since it uses the context to make mips
+// --------------------------------------------------------
+Task<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> AssetLoader::LoadTextureAsync(std::wstring path, TaskPriority priority, CancellationToken cancel)
+{
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+
+	FileData file = co_await fileLoader->ReadFileAsync(path);
+	co_await threadPool->Schedule(priority);
+	if (Stopped(cancel) || !file.success)
+	{
+		co_await ResumeOnMainThread();
+		co_return srv;
+	}
+
+	if (HasExtension(file.path, L".dds"))
+	{
+		CreateDDSTextureFromMemory(
+			device.Get(),
+			(const uint8_t*)file.bytes.data(),
+			file.bytes.size(),
+			nullptr,
+			srv.GetAddressOf());
+
+		co_await ResumeOnMainThread();
+	}
+	else
+	{
+		co_await ResumeOnMainThread();
+		if (Stopped(cancel))
+			co_return srv;
+
+		CreateWICTextureFromMemory(
+			device.Get(),
+			context.Get(),	// Passing in the context auto-generates mipmaps!!
+			(const uint8_t*)file.bytes.data(),
+			file.bytes.size(),
+			nullptr,
+			srv.GetAddressOf());
+	}
+
+	co_return srv;
+}
+
+Task<void> AssetLoader::MeshRequest(std::wstring path, std::function<void(Mesh*)> onLoaded, TaskPriority priority, CancellationToken cancel)
+{
+	Mesh* mesh = co_await LoadMeshAsync(path, priority, cancel);
+	if (Stopped(cancel))
+		delete mesh;
+	else
+		onLoaded(mesh);
+
+	FinishRequest();
+}
+
+Task<void> AssetLoader::TextureRequest(std::wstring path, std::function<void(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>)> onLoaded, TaskPriority priority, CancellationToken cancel)
+{
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv = co_await LoadTextureAsync(path, priority, cancel);
+	if (!Stopped(cancel))
+		onLoaded(srv);
+
+	FinishRequest();
+}
+
+// --------------------------------------------------------
+// Shaders only touch the device while they're created and
+// reflected, so all of that happens on the pool too
+// --------------------------------------------------------
+Task<void> AssetLoader::VertexShaderRequest(std::wstring path, std::function<void(SimpleVertexShader*)> onLoaded, TaskPriority priority)
+{
+	FileData file = co_await fileLoader->ReadFileAsync(path);
+	co_await threadPool->Schedule(priority);
+
+	SimpleVertexShader* shader = 0;
+	if (file.success && !shuttingDown)
+	{
+		shader = new SimpleVertexShader(device.Get(), context.Get(), file.bytes.data(), file.bytes.size());
+		shader->SetStateCache(stateCache);
+	}
+
+	co_await ResumeOnMainThread();
+	if (shuttingDown)
+		delete shader;
+	else
+		onLoaded(shader);
+
+	FinishRequest();
+}
+
+Task<void> AssetLoader::PixelShaderRequest(std::wstring path, std::function<void(SimplePixelShader*)> onLoaded, TaskPriority priority)
+{
+	FileData file = co_await fileLoader->ReadFileAsync(path);
+	co_await threadPool->Schedule(priority);
+
+	SimplePixelShader* shader = 0;
+	if (file.success && !shuttingDown)
+	{
+		shader = new SimplePixelShader(device.Get(), context.Get(), file.bytes.data(), file.bytes.size());
+		shader->SetStateCache(stateCache);
+	}
+
+	co_await ResumeOnMainThread();
+	if (shuttingDown)
+		delete shader;
+	else
+		onLoaded(shader);
+
+	FinishRequest();
+}
+
+// --------------------------------------------------------
+// Resumes waiting coroutines until the budget is used up
+// --------------------------------------------------------
+void AssetLoader::Update(float budgetMilliseconds)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	while (true)
+	{
+		std::coroutine_handle<> handle;
+		{
+			std::lock_guard<std::mutex> lock(mainThreadMutex);
+			if (mainThreadQueue.empty())
+				return;
+
+			handle = mainThreadQueue.front();
+			mainThreadQueue.pop_front();
+		}
+
+		handle.resume();
+
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		if (elapsed.count() >= budgetMilliseconds)
+			return;
+	}
+}
+
+void AssetLoader::QueueMainThread(std::coroutine_handle<> handle)
+{
+	std::lock_guard<std::mutex> lock(mainThreadMutex);
+	mainThreadQueue.push_back(handle);
+	mainThreadQueued.notify_all();
+}
+
+void AssetLoader::FinishRequest()
+{
+	std::lock_guard<std::mutex> lock(mainThreadMutex);
+	pendingCount--;
+	mainThreadQueued.notify_all();
+}
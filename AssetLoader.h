@@ -0,0 +1,109 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include "AsyncFileLoader.h"
+#include "Mesh.h"
+#include "SimpleShader.h"
+#include "StateCache.h"
+#include "Task.h"
+#include "ThreadPool.h"
+
+// --------------------------------------------------------
+// Loads assets in the background
+//  - Each load is a coroutine: it reads the file, hops to the
+//    thread pool for CPU work (parsing, etc.) at its priority,
+//    and then hops to the main thread to create GPU objects
+//  - Main-thread steps are run by Update(), which stops once its
+//    time budget is used up so loading never causes a long hitch
+//  - Callbacks always run on the main thread, and get null if
+//    the asset failed to load
+//  - Cancelled loads stop at their next step and never call back,
+//    and everything still in flight is cancelled on shutdown
+// --------------------------------------------------------
+class AssetLoader
+{
+public:
+	AssetLoader(
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		StateCache* stateCache,
+		ThreadPool* threadPool,
+		AsyncFileLoader* fileLoader);
+	~AssetLoader();
+
+	// Requests - the callback owns whatever it's given
+	void LoadMesh(
+		const std::wstring& path,
+		std::function<void(Mesh*)> onLoaded,
+		TaskPriority priority = TaskPriority::Normal,
+		CancellationToken cancel = CancellationToken());
+	void LoadTexture(
+		const std::wstring& path,
+		std::function<void(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>)> onLoaded,
+		TaskPriority priority = TaskPriority::Normal,
+		CancellationToken cancel = CancellationToken());
+	void LoadVertexShader(
+		const std::wstring& path,
+		std::function<void(SimpleVertexShader*)> onLoaded,
+		TaskPriority priority = TaskPriority::High);
+	void LoadPixelShader(
+		const std::wstring& path,
+		std::function<void(SimplePixelShader*)> onLoaded,
+		TaskPriority priority = TaskPriority::High);
+
+	// Coroutine versions, for loaders that want to chain steps
+	//  - These resume the caller on the main thread
+	Task<Mesh*> LoadMeshAsync(std::wstring path, TaskPriority priority, CancellationToken cancel);
+	Task<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> LoadTextureAsync(std::wstring path, TaskPriority priority, CancellationToken cancel);
+
+	// Runs main-thread steps until the budget runs out
+	//  - Always runs at least one, so loading can't stall
+	void Update(float budgetMilliseconds);
+
+	// Number of requests that haven't finished yet
+	int GetPendingCount() { return pendingCount; }
+
+	// co_await ResumeOnMainThread() to continue inside Update()
+	struct MainThreadAwaitable
+	{
+		AssetLoader* loader;
+
+		bool await_ready() { return false; }
+		void await_suspend(std::coroutine_handle<> handle) { loader->QueueMainThread(handle); }
+		void await_resume() { }
+	};
+	MainThreadAwaitable ResumeOnMainThread() { return MainThreadAwaitable{ this }; }
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	StateCache* stateCache;	// Given to the shaders we load
+	ThreadPool* threadPool;
+	AsyncFileLoader* fileLoader;
+
+	// Requests that haven't finished
+	std::atomic<int> pendingCount;
+	std::atomic<bool> shuttingDown;
+
+	// Coroutines waiting for the main thread
+	std::mutex mainThreadMutex;
+	std::condition_variable mainThreadQueued;
+	std::deque<std::coroutine_handle<>> mainThreadQueue;
+
+	void QueueMainThread(std::coroutine_handle<> handle);
+	void FinishRequest();
+	bool Stopped(const CancellationToken& cancel) { return shuttingDown || cancel.IsCancelled(); }
+
+	// Top-level request coroutines
+	Task<void> MeshRequest(std::wstring path, std::function<void(Mesh*)> onLoaded, TaskPriority priority, CancellationToken cancel);
+	Task<void> TextureRequest(std::wstring path, std::function<void(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>)> onLoaded, TaskPriority priority, CancellationToken cancel);
+	Task<void> VertexShaderRequest(std::wstring path, std::function<void(SimpleVertexShader*)> onLoaded, TaskPriority priority);
+	Task<void> PixelShaderRequest(std::wstring path, std::function<void(SimplePixelShader*)> onLoaded, TaskPriority priority);
+};
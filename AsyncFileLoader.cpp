@@ -0,0 +1,205 @@
+#include "AsyncFileLoader.h"
+#include <memory>
+
+AsyncFileLoader::AsyncFileLoader(ThreadPool* threadPool, bool useCompletionPort)
+{
+	this->threadPool = threadPool;
+	this->pendingReads = 0;
+	this->completionPort = 0;
+
+	// Set up the completion port and a thread to service it
+	//  - A single thread is plenty, since all it does is hand
+	//    finished reads off to the thread pool
+	if (useCompletionPort)
+		completionPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, 0, 0, 1);
+
+	if (completionPort)
+		completionThread = std::thread(&AsyncFileLoader::CompletionLoop, this);
+}
+
+AsyncFileLoader::~AsyncFileLoader()
+{
+	// Nothing can still be in flight when the port goes away
+	WaitForAll();
+
+	if (completionPort)
+	{
+		// A null OVERLAPPED tells the completion thread to stop
+		PostQueuedCompletionStatus(completionPort, 0, 0, 0);
+		completionThread.join();
+		CloseHandle(completionPort);
+	}
+}
+
+// --------------------------------------------------------
+// Starts reading the given file and calls onComplete with
+// the results (successful or not) on a thread pool thread
+// --------------------------------------------------------
+void AsyncFileLoader::ReadFile(const std::wstring& path, std::function<void(FileData&)> onComplete)
+{
+	ReadRequest* request = new ReadRequest();
+	request->file = INVALID_HANDLE_VALUE;
+	request->data.path = path;
+	request->onComplete = onComplete;
+	pendingReads++;
+
+	// Try the overlapped path first, and fall back to a
+	// blocking read on the pool if it isn't available
+	if (!completionPort || !BeginOverlappedRead(request))
+		threadPool->Enqueue([this, request]() { ReadBlocking(request); });
+}
+
+// --------------------------------------------------------
+// Starts reading the given file and returns a future that
+// will hold its contents
+// --------------------------------------------------------
+std::future<FileData> AsyncFileLoader::ReadFile(const std::wstring& path)
+{
+	std::shared_ptr<std::promise<FileData>> promise = std::make_shared<std::promise<FileData>>();
+	std::future<FileData> future = promise->get_future();
+
+	ReadFile(path, [promise](FileData& data) { promise->set_value(std::move(data)); });
+	return future;
+}
+
+// --------------------------------------------------------
+// Starts reading a whole batch of files at once
+//  - All reads are issued before any are waited on, so the
+//    OS is free to service them in whatever order is fastest
+// --------------------------------------------------------
+std::vector<std::future<FileData>> AsyncFileLoader::ReadFiles(const std::vector<std::wstring>& paths)
+{
+	std::vector<std::future<FileData>> futures;
+	for (auto& path : paths)
+		futures.push_back(ReadFile(path));
+	return futures;
+}
+
+void AsyncFileLoader::WaitForAll()
+{
+	std::unique_lock<std::mutex> lock(pendingMutex);
+	pendingDone.wait(lock, [this]() { return pendingReads == 0; });
+}
+
+// --------------------------------------------------------
+// Opens the file for overlapped I/O and issues one read
+// for the whole thing
+//  - Returns false (and cleans up) if anything goes wrong
+//    before the read is in flight, so the caller can fall back
+// --------------------------------------------------------
+bool AsyncFileLoader::BeginOverlappedRead(ReadRequest* request)
+{
+	request->file = CreateFileW(
+		request->data.path.c_str(),
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		0,
+		OPEN_EXISTING,
+		FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN,
+		0);
+	if (request->file == INVALID_HANDLE_VALUE)
+		return false;
+
+	// Whole-file reads only, so anything over 4GB isn't supported here
+	LARGE_INTEGER size = {};
+	if (!GetFileSizeEx(request->file, &size) || size.QuadPart == 0 || size.HighPart != 0 ||
+		!CreateIoCompletionPort(request->file, completionPort, 0, 0))
+	{
+		CloseHandle(request->file);
+		request->file = INVALID_HANDLE_VALUE;
+		return false;
+	}
+
+	request->data.bytes.resize((size_t)size.QuadPart);
+	ZeroMemory(&request->overlapped, sizeof(OVERLAPPED));
+
+	// Even if this completes immediately, a completion
+	// packet is still queued, so it's handled the same way
+	if (!::ReadFile(request->file, &request->data.bytes[0], size.LowPart, 0, &request->overlapped) &&
+		GetLastError() != ERROR_IO_PENDING)
+	{
+		CloseHandle(request->file);
+		request->file = INVALID_HANDLE_VALUE;
+		request->data.bytes.clear();
+		return false;
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Fallback path - a plain blocking read on a pool thread
+// --------------------------------------------------------
+void AsyncFileLoader::ReadBlocking(ReadRequest* request)
+{
+	HANDLE file = CreateFileW(
+		request->data.path.c_str(),
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		0,
+		OPEN_EXISTING,
+		FILE_FLAG_SEQUENTIAL_SCAN,
+		0);
+
+	LARGE_INTEGER size = {};
+	if (file != INVALID_HANDLE_VALUE && GetFileSizeEx(file, &size) && size.HighPart == 0)
+	{
+		request->data.bytes.resize((size_t)size.QuadPart);
+
+		DWORD bytesRead = 0;
+		request->data.success =
+			size.QuadPart > 0 &&
+			::ReadFile(file, &request->data.bytes[0], size.LowPart, &bytesRead, 0) &&
+			bytesRead == size.LowPart;
+	}
+
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+
+	Complete(request);
+}
+
+// --------------------------------------------------------
+// Hands the results to the callback and retires the request
+// --------------------------------------------------------
+void AsyncFileLoader::Complete(ReadRequest* request)
+{
+	if (!request->data.success)
+		request->data.bytes.clear();
+
+	if (request->onComplete)
+		request->onComplete(request->data);
+	delete request;
+
+	if (--pendingReads == 0)
+	{
+		std::lock_guard<std::mutex> lock(pendingMutex);
+		pendingDone.notify_all();
+	}
+}
+
+// --------------------------------------------------------
+// Waits on the completion port and passes finished reads
+// along to the thread pool for their callbacks
+// --------------------------------------------------------
+void AsyncFileLoader::CompletionLoop()
+{
+	while (true)
+	{
+		DWORD bytesRead = 0;
+		ULONG_PTR key = 0;
+		OVERLAPPED* overlapped = 0;
+		BOOL result = GetQueuedCompletionStatus(completionPort, &bytesRead, &key, &overlapped, INFINITE);
+
+		// Null OVERLAPPED means we're shutting down
+		if (!overlapped)
+			return;
+
+		ReadRequest* request = CONTAINING_RECORD(overlapped, ReadRequest, overlapped);
+		request->data.success = result && bytesRead == request->data.bytes.size();
+		CloseHandle(request->file);
+		request->file = INVALID_HANDLE_VALUE;
+
+		threadPool->Enqueue([this, request]() { Complete(request); });
+	}
+}
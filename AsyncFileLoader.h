@@ -0,0 +1,95 @@
+#pragma once
+#include <Windows.h>
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ThreadPool.h"
+
+// --------------------------------------------------------
+// The result of reading a whole file
+// --------------------------------------------------------
+struct FileData
+{
+	std::wstring path;
+	std::vector<char> bytes;
+	bool success = false;
+};
+
+// --------------------------------------------------------
+// Reads whole files without blocking the calling thread
+//  - Uses overlapped I/O and a completion port, so any number
+//    of reads can be in flight at once and the OS can batch them
+//  - Completion callbacks run on the thread pool, which means
+//    parsing one file overlaps with reading the others
+//  - Falls back to plain blocking reads on the thread pool if
+//    the completion port can't be used
+// --------------------------------------------------------
+class AsyncFileLoader
+{
+public:
+	AsyncFileLoader(ThreadPool* threadPool, bool useCompletionPort = true);
+	~AsyncFileLoader();
+
+	// Callback version - onComplete runs on a thread pool thread
+	void ReadFile(const std::wstring& path, std::function<void(FileData&)> onComplete);
+
+	// Future versions - the caller can wait whenever it needs the data
+	std::future<FileData> ReadFile(const std::wstring& path);
+	std::vector<std::future<FileData>> ReadFiles(const std::vector<std::wstring>& paths);
+
+	// Coroutine version - co_await loader->ReadFileAsync(path) suspends
+	// until the data is in, then resumes on a thread pool thread
+	struct ReadAwaitable
+	{
+		AsyncFileLoader* loader;
+		std::wstring path;
+		FileData result;
+
+		bool await_ready() { return false; }
+		void await_suspend(std::coroutine_handle<> handle)
+		{
+			loader->ReadFile(path, [this, handle](FileData& data)
+			{
+				result = std::move(data);
+				handle.resume();
+			});
+		}
+		FileData await_resume() { return std::move(result); }
+	};
+	ReadAwaitable ReadFileAsync(const std::wstring& path) { return ReadAwaitable{ this, path }; }
+
+	// Blocks until every outstanding read (and its callback) is done
+	void WaitForAll();
+
+private:
+	// One outstanding overlapped read
+	//  - OVERLAPPED must be first so we can get back to the
+	//    request from the pointer the completion port gives us
+	struct ReadRequest
+	{
+		OVERLAPPED overlapped;
+		HANDLE file;
+		FileData data;
+		std::function<void(FileData&)> onComplete;
+	};
+
+	ThreadPool* threadPool;
+	HANDLE completionPort;
+	std::thread completionThread;
+
+	// Outstanding read tracking for WaitForAll()
+	std::atomic<int> pendingReads;
+	std::mutex pendingMutex;
+	std::condition_variable pendingDone;
+
+	bool BeginOverlappedRead(ReadRequest* request);
+	void ReadBlocking(ReadRequest* request);
+	void Complete(ReadRequest* request);
+	void CompletionLoop();
+};
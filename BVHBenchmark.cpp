@@ -0,0 +1,144 @@
+#include "BVHBenchmark.h"
+#include "BenchmarkTiming.h"
+#include "EntityBVH.h"
+#include <chrono>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+using namespace DirectX;
+
+static const unsigned int FrustumQueries = 100;
+static const unsigned int OverlapQueries = 10000;
+static const unsigned int RayQueries = 100000;
+
+static void RunAtCount(unsigned int count, unsigned int iterations)
+{
+	printf("-- %u entities --\n", count);
+
+	// Spheres spread through a cube that grows with the count,
+	// so the density stays the same
+	std::mt19937 random(1234);
+	float side = cbrtf((float)count) * 4.0f;
+	std::uniform_real_distribution<float> position(0.0f, side);
+	std::uniform_real_distribution<float> size(0.25f, 1.5f);
+	std::uniform_real_distribution<float> speed(-6.0f, 6.0f);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	std::vector<XMFLOAT3> centers(count);
+	std::vector<XMFLOAT3> velocities(count);
+	std::vector<float> radii(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		centers[i] = XMFLOAT3(position(random), position(random), position(random));
+		velocities[i] = XMFLOAT3(speed(random), speed(random), speed(random));
+		radii[i] = size(random);
+	}
+
+	// Building
+	EntityBVH bvh;
+	std::vector<SpatialProxy> proxies(count);
+	auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		EntityId entity;
+		entity.index = i;
+		entity.generation = 1;
+		proxies[i] = bvh.Insert(entity, centers[i], radii[i]);
+	}
+	float insertTime = GetElapsed(start);
+	printf("Insert one by one: %8.3fms  %9.1fM entities/s  cost %6.1f\n", insertTime, count / (insertTime * 1000.0f), bvh.GetCost());
+
+	float buildTime = TimeAverage(iterations, [&]() { bvh.Build(); });
+	float buildCost = bvh.GetCost();
+	printf("SAH build:         %8.3fms  %9.1fM entities/s  cost %6.1f\n", buildTime, count / (buildTime * 1000.0f), buildCost);
+
+	// Refitting, after everything's moved a frame's worth
+	//  - The same motion twice, from the same built tree, so the
+	//    costs at the end show what the rotations saved
+	std::vector<XMFLOAT3> startCenters = centers;
+	float timeStep = 1.0f / 60.0f;
+	auto moveAll = [&](unsigned int frame)
+	{
+		for (unsigned int i = 0; i < count; i++)
+		{
+			centers[i].x += velocities[i].x * timeStep;
+			centers[i].y += velocities[i].y * timeStep;
+			centers[i].z += velocities[i].z * timeStep;
+			bvh.Move(proxies[i], centers[i], radii[i]);
+		}
+	};
+	unsigned int refitFrames = iterations * 6;
+	float plainRefitTime = TimeAverage(refitFrames, moveAll, [&]() { bvh.Refit(false); });
+	printf("Refit:             %8.3fms  %9.1fM entities/s  cost %6.1f after %u frames\n", plainRefitTime, count / (plainRefitTime * 1000.0f), bvh.GetCost(), refitFrames);
+
+	centers = startCenters;
+	for (unsigned int i = 0; i < count; i++)
+		bvh.Move(proxies[i], centers[i], radii[i]);
+	bvh.Build();
+	float rotateRefitTime = TimeAverage(refitFrames, moveAll, [&]() { bvh.Refit(); });
+	printf("Refit + rotate:    %8.3fms  %9.1fM entities/s  cost %6.1f after %u frames\n", rotateRefitTime, count / (rotateRefitTime * 1000.0f), bvh.GetCost(), refitFrames);
+
+	// Queries, against the refitted tree
+	std::vector<EntityId> results;
+	results.reserve(count);
+
+	std::vector<Frustum> frustums(FrustumQueries);
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, side * 0.25f);
+	for (Frustum& frustum : frustums)
+	{
+		XMVECTOR eye = XMVectorSet(position(random), position(random), position(random), 0.0f);
+		XMVECTOR direction = XMVectorSet(unit(random), unit(random), unit(random) + 0.01f, 0.0f);
+		XMFLOAT4X4 viewProjection;
+		XMStoreFloat4x4(&viewProjection, XMMatrixLookToLH(eye, direction, XMVectorSet(0, 1, 0, 0)) * projection);
+		frustum = MakeFrustum(viewProjection);
+	}
+	start = std::chrono::high_resolution_clock::now();
+	for (const Frustum& frustum : frustums)
+		bvh.QueryFrustum(frustum, results);
+	PrintQueries("Frustum:", FrustumQueries, GetElapsed(start), results.size());
+
+	results.clear();
+	std::vector<XMFLOAT3> points(OverlapQueries);
+	for (XMFLOAT3& point : points)
+		point = XMFLOAT3(position(random), position(random), position(random));
+	start = std::chrono::high_resolution_clock::now();
+	for (const XMFLOAT3& point : points)
+		bvh.QuerySphere(point, 5.0f, results);
+	PrintQueries("Sphere (r = 5):", OverlapQueries, GetElapsed(start), results.size());
+
+	results.clear();
+	start = std::chrono::high_resolution_clock::now();
+	for (const XMFLOAT3& point : points)
+	{
+		AABB box = MakeAABB(point, 5.0f);
+		bvh.QueryBox(box, results);
+	}
+	PrintQueries("Box (5 x 2):", OverlapQueries, GetElapsed(start), results.size());
+
+	std::vector<Ray> rays(RayQueries);
+	for (Ray& ray : rays)
+	{
+		ray.origin = XMFLOAT3(position(random), position(random), position(random));
+		XMStoreFloat3(&ray.direction, XMVector3Normalize(XMVectorSet(unit(random), unit(random), unit(random) + 0.01f, 0.0f)));
+	}
+	size_t hits = 0;
+	start = std::chrono::high_resolution_clock::now();
+	for (const Ray& ray : rays)
+	{
+		RayHit hit;
+		if (bvh.RayCast(ray, side, hit))
+			hits++;
+	}
+	PrintQueries("Ray (nearest):", RayQueries, GetElapsed(start), hits);
+}
+
+void RunBVHBenchmark(unsigned int iterations)
+{
+	printf("---- Entity BVH benchmark: %u iterations ----\n", iterations);
+
+	RunAtCount(10000, iterations);
+	RunAtCount(100000, iterations);
+	RunAtCount(1000000, iterations);
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+// --------------------------------------------------------
+// Times the entity BVH at 10k, 100k and 1M randomly placed
+// moving spheres, and prints the results
+//  - Building (one at a time and all at once), refitting with
+//    and without rotations, and each kind of query
+//  - Tree quality is shown as its SAH cost, so the refits can
+//    be compared with a fresh build
+// --------------------------------------------------------
+void RunBVHBenchmark(unsigned int iterations = 10);
@@ -0,0 +1,67 @@
+#pragma once
+#include <chrono>
+#include <stdio.h>
+
+// --------------------------------------------------------
+// Timing and printing the benchmarks have in common
+// --------------------------------------------------------
+
+// Milliseconds since start
+inline float GetElapsed(std::chrono::high_resolution_clock::time_point start)
+{
+	std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	return elapsed.count();
+}
+
+// Milliseconds taken by work()
+template<typename Work>
+float Time(Work work)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	work();
+	return GetElapsed(start);
+}
+
+// Average milliseconds per call of work()
+template<typename Work>
+float TimeAverage(unsigned int iterations, Work work)
+{
+	float total = 0.0f;
+	for (unsigned int i = 0; i < iterations; i++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		work();
+		total += GetElapsed(start);
+	}
+	return total / iterations;
+}
+
+// Average milliseconds per call of work(), with move(i) run
+// untimed before each
+template<typename Move, typename Work>
+float TimeAverage(unsigned int iterations, Move move, Work work)
+{
+	float total = 0.0f;
+	for (unsigned int i = 0; i < iterations; i++)
+	{
+		move(i);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		work();
+		total += GetElapsed(start);
+	}
+	return total / iterations;
+}
+
+// Thousands of queries per second is queries per millisecond
+inline void PrintQueries(const char* name, unsigned int queries, float milliseconds, size_t results)
+{
+	printf("%-18s %8.3fms  %9.1fk queries/s  %9.1f results each\n",
+		name, milliseconds, queries / milliseconds, (double)results / queries);
+}
+
+// Millions of rays per second is thousands of rays per millisecond
+inline void PrintRays(const char* name, unsigned int rays, float milliseconds, unsigned int hits)
+{
+	printf("%-22s %8.3fms  %8.2fM rays/s  %8u hits\n", name, milliseconds, rays / (milliseconds * 1000.0f), hits);
+}
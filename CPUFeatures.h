@@ -0,0 +1,9 @@
+#pragma once
+
+// --------------------------------------------------------
+// What the CPU we're running on supports, for the code that
+// picks between SIMD paths at runtime
+// --------------------------------------------------------
+
+// AVX2, and that the OS saves the YMM registers
+bool HasAVX2();
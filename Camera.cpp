@@ -1,5 +1,6 @@
 #include "Camera.h"
 #include <Windows.h>
+#include <string.h>
 
 using namespace DirectX;
 
@@ -9,6 +10,8 @@ Camera::Camera(float x, float y, float z, float aspectRatio, float mouseLookSpee
 	// Save speed and pos
 	this->mouseLookSpeed = mouseLookSpeed;
 	transform.SetPosition(x, y, z);
+	XMStoreFloat4x4(&viewMatrix, XMMatrixIdentity());
+	frustumDirty = true;
 
 	// Update our view & proj
 	UpdateViewMatrix();
@@ -62,10 +65,10 @@ void Camera::Update(float dt, HWND windowHandle)
 // Creates a new view matrix based on current position and orientation
 void Camera::UpdateViewMatrix()
 {
-	// Figure out our "forward"  vector and
-	// create a quaternion using OUR rotation
-	XMFLOAT3 rotation = transform.GetRotation();
-	XMVECTOR rotQuat = XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&rotation));
+	// Figure out our "forward"  vector using
+	// OUR rotation, which the transform caches as a quaternion
+	XMFLOAT4 rotation = transform.GetRotationQuaternion();
+	XMVECTOR rotQuat = XMLoadFloat4(&rotation);
 
 	// Define the "standard" forward vector w/o rotation (0,0,1)
 	XMVECTOR basicForward = XMVectorSet(0, 0, 1, 0);
@@ -78,7 +81,15 @@ void Camera::UpdateViewMatrix()
 		XMLoadFloat3(&transform.GetPosition()),
 		ourForward,
 		XMVectorSet(0, 1, 0, 0));
-	XMStoreFloat4x4(&viewMatrix, view);
+
+	// Update() calls this every frame, moving or not
+	XMFLOAT4X4 newView;
+	XMStoreFloat4x4(&newView, view);
+	if (memcmp(&newView, &viewMatrix, sizeof(XMFLOAT4X4)) != 0)
+	{
+		viewMatrix = newView;
+		frustumDirty = true;
+	}
 }
 
 // Updates the projection matrix
@@ -90,6 +101,19 @@ void Camera::UpdateProjectionMatrix(float aspectRatio)
 		0.01f,
 		100.0f);
 	XMStoreFloat4x4(&projMatrix, proj);
+	frustumDirty = true;
+}
+
+const Frustum& Camera::GetFrustum()
+{
+	if (frustumDirty)
+	{
+		XMFLOAT4X4 viewProjection;
+		XMStoreFloat4x4(&viewProjection, XMLoadFloat4x4(&viewMatrix) * XMLoadFloat4x4(&projMatrix));
+		frustum = MakeFrustum(viewProjection);
+		frustumDirty = false;
+	}
+	return frustum;
 }
 
 Transform* Camera::GetTransform()
@@ -2,6 +2,7 @@
 #include <DirectXMath.h>
 #include <Windows.h>
 #include "Transform.h"
+#include "Collision.h"
 
 class Camera
 {
@@ -18,12 +19,19 @@ public:
 	DirectX::XMFLOAT4X4 GetView() { return viewMatrix; }
 	DirectX::XMFLOAT4X4 GetProjection() { return projMatrix; }
 
+	// World space frustum of view * projection
+	//  - Cached, and only worked out again after one of the
+	//    matrices has actually changed
+	const Frustum& GetFrustum();
+
 	Transform* GetTransform();
 
 private:
 	// Camera matrices
 	DirectX::XMFLOAT4X4 viewMatrix;
 	DirectX::XMFLOAT4X4 projMatrix;
+	Frustum frustum;
+	bool frustumDirty;
 
 	// Room to add FOV, near/far clip distances, movement speed, etc.
 	float mouseLookSpeed;
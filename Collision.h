@@ -0,0 +1,247 @@
+#pragma once
+#include <DirectXMath.h>
+#include <math.h>
+
+// --------------------------------------------------------
+// Shapes and overlap tests shared by the spatial structures
+//  - Scalar and header-only; the structures that need more
+//    speed batch these up themselves
+// --------------------------------------------------------
+
+// Axis-aligned bounding box
+struct AABB
+{
+	DirectX::XMFLOAT3 lower;
+	DirectX::XMFLOAT3 upper;
+};
+
+// Six planes facing inwards: left, right, bottom, top, near, far
+//  - A point is inside a plane when dot(xyz, point) + w >= 0
+struct Frustum
+{
+	DirectX::XMFLOAT4 planes[6];
+};
+
+// Direction needn't be normalized; distances along the ray
+// are then in multiples of its length
+struct Ray
+{
+	DirectX::XMFLOAT3 origin;
+	DirectX::XMFLOAT3 direction;
+};
+
+enum class Containment
+{
+	Outside,
+	Intersects,
+	Inside
+};
+
+inline AABB MakeAABB(const DirectX::XMFLOAT3& center, float radius)
+{
+	return AABB{
+		DirectX::XMFLOAT3(center.x - radius, center.y - radius, center.z - radius),
+		DirectX::XMFLOAT3(center.x + radius, center.y + radius, center.z + radius) };
+}
+
+inline AABB Union(const AABB& a, const AABB& b)
+{
+	return AABB{
+		DirectX::XMFLOAT3(a.lower.x < b.lower.x ? a.lower.x : b.lower.x, a.lower.y < b.lower.y ? a.lower.y : b.lower.y, a.lower.z < b.lower.z ? a.lower.z : b.lower.z),
+		DirectX::XMFLOAT3(a.upper.x > b.upper.x ? a.upper.x : b.upper.x, a.upper.y > b.upper.y ? a.upper.y : b.upper.y, a.upper.z > b.upper.z ? a.upper.z : b.upper.z) };
+}
+
+// Half the surface area, which is all SAH comparisons need
+inline float HalfArea(const AABB& box)
+{
+	float x = box.upper.x - box.lower.x;
+	float y = box.upper.y - box.lower.y;
+	float z = box.upper.z - box.lower.z;
+	return x * y + y * z + z * x;
+}
+
+inline DirectX::XMFLOAT3 GetCenter(const AABB& box)
+{
+	return DirectX::XMFLOAT3(
+		(box.lower.x + box.upper.x) * 0.5f,
+		(box.lower.y + box.upper.y) * 0.5f,
+		(box.lower.z + box.upper.z) * 0.5f);
+}
+
+inline bool Overlaps(const AABB& a, const AABB& b)
+{
+	return
+		a.lower.x <= b.upper.x && a.upper.x >= b.lower.x &&
+		a.lower.y <= b.upper.y && a.upper.y >= b.lower.y &&
+		a.lower.z <= b.upper.z && a.upper.z >= b.lower.z;
+}
+
+inline bool SphereOverlapsAABB(const DirectX::XMFLOAT3& center, float radius, const AABB& box)
+{
+	float dx = center.x < box.lower.x ? box.lower.x - center.x : (center.x > box.upper.x ? center.x - box.upper.x : 0.0f);
+	float dy = center.y < box.lower.y ? box.lower.y - center.y : (center.y > box.upper.y ? center.y - box.upper.y : 0.0f);
+	float dz = center.z < box.lower.z ? box.lower.z - center.z : (center.z > box.upper.z ? center.z - box.upper.z : 0.0f);
+	return dx * dx + dy * dy + dz * dz <= radius * radius;
+}
+
+inline bool SpheresOverlap(const DirectX::XMFLOAT3& centerA, float radiusA, const DirectX::XMFLOAT3& centerB, float radiusB)
+{
+	float dx = centerA.x - centerB.x;
+	float dy = centerA.y - centerB.y;
+	float dz = centerA.z - centerB.z;
+	float r = radiusA + radiusB;
+	return dx * dx + dy * dy + dz * dz <= r * r;
+}
+
+// --------------------------------------------------------
+// Pulls the planes out of a view * projection matrix
+//  - Row-vector matrices, as DirectXMath makes them, with
+//    clip space z from 0 to 1
+//  - Planes are normalized, so plane tests give distances
+// --------------------------------------------------------
+inline Frustum MakeFrustum(const DirectX::XMFLOAT4X4& viewProjection)
+{
+	const DirectX::XMFLOAT4X4& m = viewProjection;
+	DirectX::XMFLOAT4 column0(m._11, m._21, m._31, m._41);
+	DirectX::XMFLOAT4 column1(m._12, m._22, m._32, m._42);
+	DirectX::XMFLOAT4 column2(m._13, m._23, m._33, m._43);
+	DirectX::XMFLOAT4 column3(m._14, m._24, m._34, m._44);
+
+	Frustum frustum;
+	frustum.planes[0] = DirectX::XMFLOAT4(column3.x + column0.x, column3.y + column0.y, column3.z + column0.z, column3.w + column0.w);
+	frustum.planes[1] = DirectX::XMFLOAT4(column3.x - column0.x, column3.y - column0.y, column3.z - column0.z, column3.w - column0.w);
+	frustum.planes[2] = DirectX::XMFLOAT4(column3.x + column1.x, column3.y + column1.y, column3.z + column1.z, column3.w + column1.w);
+	frustum.planes[3] = DirectX::XMFLOAT4(column3.x - column1.x, column3.y - column1.y, column3.z - column1.z, column3.w - column1.w);
+	frustum.planes[4] = column2;
+	frustum.planes[5] = DirectX::XMFLOAT4(column3.x - column2.x, column3.y - column2.y, column3.z - column2.z, column3.w - column2.w);
+
+	for (int i = 0; i < 6; i++)
+	{
+		DirectX::XMFLOAT4& p = frustum.planes[i];
+		float length = sqrtf(p.x * p.x + p.y * p.y + p.z * p.z);
+		if (length > 0.0f)
+		{
+			p.x /= length;
+			p.y /= length;
+			p.z /= length;
+			p.w /= length;
+		}
+	}
+	return frustum;
+}
+
+inline Containment TestSphere(const Frustum& frustum, const DirectX::XMFLOAT3& center, float radius)
+{
+	Containment result = Containment::Inside;
+	for (int i = 0; i < 6; i++)
+	{
+		const DirectX::XMFLOAT4& p = frustum.planes[i];
+		float distance = p.x * center.x + p.y * center.y + p.z * center.z + p.w;
+		if (distance < -radius)
+			return Containment::Outside;
+		if (distance < radius)
+			result = Containment::Intersects;
+	}
+	return result;
+}
+
+// --------------------------------------------------------
+// Box against frustum, using the corner furthest along each
+// plane's normal (and the one furthest back) per plane
+//  - Conservative: a box near a frustum corner can be called
+//    intersecting when it's just outside
+// --------------------------------------------------------
+inline Containment TestAABB(const Frustum& frustum, const AABB& box)
+{
+	Containment result = Containment::Inside;
+	for (int i = 0; i < 6; i++)
+	{
+		const DirectX::XMFLOAT4& p = frustum.planes[i];
+		float front =
+			p.x * (p.x >= 0.0f ? box.upper.x : box.lower.x) +
+			p.y * (p.y >= 0.0f ? box.upper.y : box.lower.y) +
+			p.z * (p.z >= 0.0f ? box.upper.z : box.lower.z) + p.w;
+		if (front < 0.0f)
+			return Containment::Outside;
+
+		float back =
+			p.x * (p.x >= 0.0f ? box.lower.x : box.upper.x) +
+			p.y * (p.y >= 0.0f ? box.lower.y : box.upper.y) +
+			p.z * (p.z >= 0.0f ? box.lower.z : box.upper.z) + p.w;
+		if (back < 0.0f)
+			result = Containment::Intersects;
+	}
+	return result;
+}
+
+// --------------------------------------------------------
+// Slab test, given the reciprocal of the ray's direction
+//  - On a hit, entry is where the ray enters the box (0 if
+//    it starts inside)
+// --------------------------------------------------------
+inline bool RayIntersectsAABB(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& inverseDirection, const AABB& box, float maxDistance, float& entry)
+{
+	float tx1 = (box.lower.x - origin.x) * inverseDirection.x;
+	float tx2 = (box.upper.x - origin.x) * inverseDirection.x;
+	float ty1 = (box.lower.y - origin.y) * inverseDirection.y;
+	float ty2 = (box.upper.y - origin.y) * inverseDirection.y;
+	float tz1 = (box.lower.z - origin.z) * inverseDirection.z;
+	float tz2 = (box.upper.z - origin.z) * inverseDirection.z;
+
+	float tNear = tx1 < tx2 ? tx1 : tx2;
+	float tFar = tx1 < tx2 ? tx2 : tx1;
+	float yNear = ty1 < ty2 ? ty1 : ty2;
+	float yFar = ty1 < ty2 ? ty2 : ty1;
+	float zNear = tz1 < tz2 ? tz1 : tz2;
+	float zFar = tz1 < tz2 ? tz2 : tz1;
+	tNear = tNear > yNear ? tNear : yNear;
+	tNear = tNear > zNear ? tNear : zNear;
+	tFar = tFar < yFar ? tFar : yFar;
+	tFar = tFar < zFar ? tFar : zFar;
+
+	if (tNear < 0.0f)
+		tNear = 0.0f;
+	if (tNear > tFar || tNear > maxDistance)
+		return false;
+
+	entry = tNear;
+	return true;
+}
+
+// Distance along the ray to the sphere's surface, or 0 if it
+// starts inside
+inline bool RayIntersectsSphere(const Ray& ray, const DirectX::XMFLOAT3& center, float radius, float maxDistance, float& distance)
+{
+	float ox = ray.origin.x - center.x;
+	float oy = ray.origin.y - center.y;
+	float oz = ray.origin.z - center.z;
+	float a = ray.direction.x * ray.direction.x + ray.direction.y * ray.direction.y + ray.direction.z * ray.direction.z;
+	float b = ox * ray.direction.x + oy * ray.direction.y + oz * ray.direction.z;
+	float c = ox * ox + oy * oy + oz * oz - radius * radius;
+	if (c <= 0.0f)
+	{
+		distance = 0.0f;
+		return true;
+	}
+
+	float discriminant = b * b - a * c;
+	if (b > 0.0f || discriminant < 0.0f || a == 0.0f)
+		return false;
+
+	float t = (-b - sqrtf(discriminant)) / a;
+	if (t > maxDistance)
+		return false;
+
+	distance = t;
+	return true;
+}
+
+// Reciprocal direction for slab tests, with zeros turned
+// into huge values rather than infinities
+inline DirectX::XMFLOAT3 GetInverseDirection(const DirectX::XMFLOAT3& direction)
+{
+	return DirectX::XMFLOAT3(
+		1.0f / (direction.x != 0.0f ? direction.x : 1e-30f),
+		1.0f / (direction.y != 0.0f ? direction.y : 1e-30f),
+		1.0f / (direction.z != 0.0f ? direction.z : 1e-30f));
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <DirectXMath.h>
+#include "TransformSystem.h"
+#include "Mesh.h"
+#include "Material.h"
+#include "HandlePool.h"
+#include "SpatialIndex.h"
+#include "VisibilityCache.h"
+#include "LODSelector.h"
+
+typedef Handle<Mesh> MeshHandle;
+typedef Handle<Material> MaterialHandle;
+
+// --------------------------------------------------------
+// The components the game's entities are built from
+//  - Plain data only; the World moves them with memcpy
+//  - Meshes and materials live in pools and are referred to
+//    by handle, so several entities can share one
+// --------------------------------------------------------
+
+// The entity's transform, which lives in the TransformSystem
+struct TransformComponent
+{
+	TransformHandle handle;
+};
+
+struct MeshComponent
+{
+	MeshHandle mesh;
+};
+
+struct MaterialComponent
+{
+	MaterialHandle material;
+};
+
+// The mesh's own bounding sphere, copied off it when it's
+// assigned, so the simulation never has to look at the mesh
+struct LocalBounds
+{
+	DirectX::XMFLOAT3 center;
+	float radius;
+};
+
+// World space bounding sphere, refreshed from LocalBounds
+// and the world matrix each update
+struct Bounds
+{
+	DirectX::XMFLOAT3 center;
+	float radius;
+};
+
+// Which of the game's spatial indices an entity is kept in
+//  - Static is an EntityBVH, for things that rarely move;
+//    Dynamic is a SpatialGrid, for things that move all the time
+enum class SpatialLayer
+{
+	Static,
+	Dynamic,
+	Count
+};
+
+// The entity's entry in its layer's spatial index, which is
+// kept in step with Bounds
+struct SpatialComponent
+{
+	SpatialProxy proxy;
+	SpatialLayer layer;
+};
+
+// Marks an entity as solid enough to hide what's behind it
+//  - mesh is one of the OcclusionCuller's meshes, in a space
+//    from -1 to 1 that's fitted inside the entity's LocalBounds
+//    (the largest box inside the sphere), so it should only go
+//    on entities that are solid out to there
+struct Occluder
+{
+	unsigned int mesh;
+};
+
+// Per second - angular is pitch/yaw/roll in radians
+struct Velocity
+{
+	DirectX::XMFLOAT3 linear;
+	DirectX::XMFLOAT3 angular;
+};
+
+// The world matrix the entity was last drawn with, and the
+// update that was, for blending from on the next update
+struct RenderHistory
+{
+	DirectX::XMFLOAT4X4 world;
+	unsigned long long update;
+};
+
+// CullHistory (see VisibilityCache.h) is also a component,
+// on everything that goes through frustum culling, as is
+// LODState (see LODSelector.h), on everything that's drawn
+
+// Tags the entity the user has picked with Tab, which is
+// the only one drawn and moved
+struct Selected
+{
+};
@@ -0,0 +1,191 @@
+#include "CullingBenchmark.h"
+#include "BenchmarkTiming.h"
+#include "CPUFeatures.h"
+#include "EntityBVH.h"
+#include "FrustumCuller.h"
+#include "VisibilityCache.h"
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+using namespace DirectX;
+
+// Average milliseconds per call of work(), with a different
+// frustum each time
+template<typename Work>
+static float TimeAverage(const std::vector<Frustum>& frustums, Work work)
+{
+	float total = 0.0f;
+	for (const Frustum& frustum : frustums)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		work(frustum);
+		total += GetElapsed(start);
+	}
+	return total / frustums.size();
+}
+
+static void PrintTime(const char* name, unsigned int count, float milliseconds, size_t visible)
+{
+	printf("%-22s %8.3fms  %8.1fM spheres/s  %8zu visible\n", name, milliseconds, count / (milliseconds * 1000.0f), visible);
+}
+
+// --------------------------------------------------------
+// A camera walking and turning slowly through the spheres, as
+// it would in play, culled in full each frame and then through
+// a VisibilityCache, which should give the same spheres
+// --------------------------------------------------------
+static void RunWalk(JobSystem* jobSystem, const std::vector<XMFLOAT3>& centers, const std::vector<float>& radii, float side, unsigned int frames)
+{
+	unsigned int count = (unsigned int)centers.size();
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, side * 0.5f);
+
+	FrustumCuller culler;
+	VisibilityCache cache;
+	std::vector<CullHistory> histories(count, CullHistory{});
+	std::vector<unsigned int> fullVisible, visible, tested, reused;
+	std::vector<float> margins;
+	float fullTime = 0.0f;
+	float cachedTime = 0.0f;
+	size_t totalVisible = 0;
+	unsigned int mismatches = 0;
+	for (unsigned int frame = 0; frame < frames; frame++)
+	{
+		float yaw = frame * 0.01f;
+		XMFLOAT3 eye(side * (0.2f + frame * 0.002f), side * 0.5f, side * (0.2f + frame * 0.001f));
+		XMFLOAT4X4 viewProjection;
+		XMStoreFloat4x4(&viewProjection,
+			XMMatrixLookToLH(XMLoadFloat3(&eye), XMVectorSet(sinf(yaw), -0.1f, cosf(yaw), 0.0f), XMVectorSet(0, 1, 0, 0)) * projection);
+		Frustum frustum = MakeFrustum(viewProjection);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		culler.Clear();
+		for (unsigned int i = 0; i < count; i++)
+			culler.Add(centers[i], radii[i], i);
+		culler.Cull(frustum, fullVisible, jobSystem);
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		fullTime += elapsed.count();
+
+		// As Game::BuildSnapshot() does it
+		start = std::chrono::high_resolution_clock::now();
+		cache.BeginFrame(frustum, eye);
+		culler.Clear();
+		tested.clear();
+		reused.clear();
+		for (unsigned int i = 0; i < count; i++)
+		{
+			bool sphereVisible;
+			if (cache.Check(histories[i], centers[i], radii[i], sphereVisible))
+			{
+				if (sphereVisible)
+					reused.push_back(i);
+			}
+			else
+			{
+				culler.Add(centers[i], radii[i], i);
+				tested.push_back(i);
+			}
+		}
+		culler.Cull(frustum, visible, margins, jobSystem);
+		for (unsigned int t = 0; t < tested.size(); t++)
+			cache.Record(histories[tested[t]], centers[tested[t]], radii[tested[t]], margins[t]);
+		size_t testedVisible = visible.size();
+		visible.insert(visible.end(), reused.begin(), reused.end());
+		std::inplace_merge(visible.begin(), visible.begin() + testedVisible, visible.end());
+		elapsed = std::chrono::high_resolution_clock::now() - start;
+		cachedTime += elapsed.count();
+
+		totalVisible += visible.size();
+		mismatches += visible == fullVisible ? 0 : 1;
+	}
+
+	PrintTime("Walk, full:", count, fullTime / frames, totalVisible / frames);
+	PrintTime("Walk, cached:", count, cachedTime / frames, totalVisible / frames);
+	cache.PrintStats();
+	if (mismatches > 0)
+		printf("Cached results differed on %u of %u frames!\n", mismatches, frames);
+}
+
+static void RunAtCount(JobSystem* jobSystem, unsigned int count, unsigned int iterations)
+{
+	printf("-- %u spheres --\n", count);
+
+	// Spheres spread through a cube that grows with the count,
+	// seen from cameras inside it
+	std::mt19937 random(1234);
+	float side = cbrtf((float)count) * 4.0f;
+	std::uniform_real_distribution<float> position(0.0f, side);
+	std::uniform_real_distribution<float> size(0.25f, 1.5f);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	FrustumCuller culler;
+	EntityBVH bvh;
+	std::vector<XMFLOAT3> centers(count);
+	std::vector<float> radii(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		XMFLOAT3 center(position(random), position(random), position(random));
+		float radius = size(random);
+		culler.Add(center, radius, i);
+		centers[i] = center;
+		radii[i] = radius;
+
+		EntityId entity;
+		entity.index = i;
+		entity.generation = 1;
+		bvh.Insert(entity, center, radius);
+	}
+	bvh.Build();
+
+	std::vector<Frustum> frustums(iterations);
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, side * 0.5f);
+	for (Frustum& frustum : frustums)
+	{
+		XMVECTOR eye = XMVectorSet(position(random), position(random), position(random), 0.0f);
+		XMVECTOR direction = XMVectorSet(unit(random), unit(random), unit(random) + 0.01f, 0.0f);
+		XMFLOAT4X4 viewProjection;
+		XMStoreFloat4x4(&viewProjection, XMMatrixLookToLH(eye, direction, XMVectorSet(0, 1, 0, 0)) * projection);
+		frustum = MakeFrustum(viewProjection);
+	}
+
+	std::vector<unsigned int> visible;
+	size_t totalVisible = 0;
+	culler.SetUseSIMD(false);
+	float scalarTime = TimeAverage(frustums, [&](const Frustum& frustum) { culler.Cull(frustum, visible); totalVisible += visible.size(); });
+	PrintTime("Scalar:", count, scalarTime, totalVisible / iterations);
+
+	if (HasAVX2())
+	{
+		culler.SetUseSIMD(true);
+		totalVisible = 0;
+		float simdTime = TimeAverage(frustums, [&](const Frustum& frustum) { culler.Cull(frustum, visible); totalVisible += visible.size(); });
+		PrintTime("AVX2:", count, simdTime, totalVisible / iterations);
+	}
+	else
+		printf("AVX2:                  (not supported)\n");
+
+	totalVisible = 0;
+	float threadedTime = TimeAverage(frustums, [&](const Frustum& frustum) { culler.Cull(frustum, visible, jobSystem); totalVisible += visible.size(); });
+	PrintTime("Threaded:", count, threadedTime, totalVisible / iterations);
+
+	// The BVH skips whole subtrees, so how it compares depends
+	// on how much of the scene is in view
+	std::vector<EntityId> results;
+	totalVisible = 0;
+	float bvhTime = TimeAverage(frustums, [&](const Frustum& frustum) { results.clear(); bvh.QueryFrustum(frustum, results); totalVisible += results.size(); });
+	PrintTime("Entity BVH:", count, bvhTime, totalVisible / iterations);
+
+	RunWalk(jobSystem, centers, radii, side, iterations * 5);
+}
+
+void RunCullingBenchmark(JobSystem* jobSystem, unsigned int iterations)
+{
+	printf("---- Culling benchmark: %u threads, %u iterations ----\n", jobSystem->GetThreadCount(), iterations);
+
+	RunAtCount(jobSystem, 10000, iterations);
+	RunAtCount(jobSystem, 100000, iterations);
+	RunAtCount(jobSystem, 1000000, iterations);
+}
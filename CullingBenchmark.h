@@ -0,0 +1,11 @@
+#pragma once
+#include "JobSystem.h"
+
+// --------------------------------------------------------
+// Times frustum culling at 10k, 100k and 1M bounding spheres
+// with FrustumCuller's scalar, SIMD and threaded SIMD paths,
+// and with the entity BVH's frustum query, then along a
+// smooth camera path with and without a VisibilityCache, and
+// prints the results
+// --------------------------------------------------------
+void RunCullingBenchmark(JobSystem* jobSystem, unsigned int iterations = 20);
@@ -1,6 +1,7 @@
 #include "DXCore.h"
 
 #include <WindowsX.h>
+#include <cmath>
 #include <sstream>
 
 // Define the static instance variable so our OS-level 
@@ -56,6 +57,12 @@ DXCore::DXCore(
 	this->deltaTime = 0;
 	this->startTime = 0;
 	this->totalTime = 0;
+	this->fixedTimeStep = 1.0f / 60.0f;
+	this->maxStepsPerFrame = 5;
+	this->accumulator = 0.0;
+	this->threadedSimulation = false;
+	this->frameScheduler = new FrameScheduler();
+	this->stopSimulation = false;
 
 	// Query performance counter for accurate timing information
 	__int64 perfFreq;
@@ -72,6 +79,8 @@ DXCore::~DXCore()
 	// we don't need to explicitly clean up those DirectX objects
 	// - If we weren't using smart pointers, we'd need
 	//   to call Release() on each DirectX object
+
+	delete frameScheduler;
 }
 
 // --------------------------------------------------------
@@ -396,17 +405,113 @@ HRESULT DXCore::Run()
 			if(titleBarStats)
 				UpdateTitleBarStats();
 
+			// Move the simulation if we've been asked to
+			if (threadedSimulation && !IsSimulationThreaded())
+				StartSimulationThread();
+			else if (!threadedSimulation && IsSimulationThreaded())
+				StopSimulationThread();
+
 			// The game loop
-			Update(deltaTime, totalTime);
+			UpdateMainThread(deltaTime, totalTime);
+			if (!IsSimulationThreaded())
+				StepSimulation(accumulator, deltaTime, totalTime);
 			Draw(deltaTime, totalTime);
+
+			// Spend what's left of the frame on deferrable work
+			__int64 frameEnd;
+			QueryPerformanceCounter((LARGE_INTEGER*)&frameEnd);
+			frameScheduler->RunFrame((float)((frameEnd - currentTime) * perfCounterSeconds * 1000.0));
 		}
 	}
 
 	// We'll end up here once we get a WM_QUIT message,
 	// which usually comes from the user closing the window
+	StopSimulationThread();
 	return (HRESULT)msg.wParam;
 }
 
+// --------------------------------------------------------
+// Starts calling Update() on its own thread
+// --------------------------------------------------------
+void DXCore::StartSimulationThread()
+{
+	stopSimulation = false;
+	simulationThread = std::thread(&DXCore::SimulationLoop, this);
+}
+
+// --------------------------------------------------------
+// Waits for the simulation thread's current Update() to
+// finish, and hands Update() back to this thread
+// --------------------------------------------------------
+void DXCore::StopSimulationThread()
+{
+	if (!simulationThread.joinable())
+		return;
+
+	stopSimulation = true;
+	simulationThread.join();
+	accumulator = 0.0;
+	OnSimulationThreadChanged();
+}
+
+// --------------------------------------------------------
+// Runs Update() once for each fixed time step that has
+// passed, carrying what's left over to next time in owed
+//  - Gives up after maxStepsPerFrame and drops the time still
+//    owed, so the simulation falls behind real time rather
+//    than spending ever longer catching up
+// --------------------------------------------------------
+void DXCore::StepSimulation(double& owed, float deltaTime, float totalTime)
+{
+	owed += deltaTime;
+
+	unsigned int steps = 0;
+	while (owed >= fixedTimeStep && steps < maxStepsPerFrame)
+	{
+		owed -= fixedTimeStep;
+		Update(fixedTimeStep, (float)(totalTime - owed));
+		steps++;
+	}
+
+	if (owed >= fixedTimeStep)
+		owed = fmod(owed, (double)fixedTimeStep);
+}
+
+// --------------------------------------------------------
+// The simulation thread's loop, with its own clock (but the
+// same start time, so total times match the window's thread)
+//  - Sleeps between steps rather than spinning, with the
+//    system timer turned up so a sleep is about a millisecond
+// --------------------------------------------------------
+void DXCore::SimulationLoop()
+{
+	OnSimulationThreadChanged();
+	timeBeginPeriod(1);
+
+	double simulationAccumulator = 0.0;
+	__int64 previous;
+	QueryPerformanceCounter((LARGE_INTEGER*)&previous);
+	while (!stopSimulation)
+	{
+		__int64 now;
+		QueryPerformanceCounter((LARGE_INTEGER*)&now);
+		float dt = max((float)((now - previous) * perfCounterSeconds), 0.0f);
+		float total = (float)((now - startTime) * perfCounterSeconds);
+		previous = now;
+
+		StepSimulation(simulationAccumulator, dt, total);
+
+		// Wait for the next step, finishing with a yield so we
+		// don't oversleep it
+		if (fixedTimeStep - simulationAccumulator > 0.002)
+			Sleep(1);
+		else
+			std::this_thread::yield();
+	}
+
+	timeEndPeriod(1);
+}
+
 
 // --------------------------------------------------------
 // Sends an OS-level window close message to our process, which
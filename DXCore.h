@@ -2,12 +2,16 @@
 
 #include <Windows.h>
 #include <d3d11.h>
+#include <atomic>
 #include <string>
+#include <thread>
 #include <wrl/client.h> // Used for ComPtr - a smart pointer for COM objects
+#include "FrameScheduler.h"
 
 // We can include the correct library files here
 // instead of in Visual Studio settings if we want
 #pragma comment(lib, "d3d11.lib")
+#pragma comment(lib, "winmm.lib") // timeBeginPeriod(), for the simulation thread's sleeps
 
 class DXCore
 {
@@ -40,10 +44,37 @@ public:
 	virtual void OnResize();
 
 	// Pure virtual methods for setup and game functionality
+	//  - Update() runs at a fixed rate, as many times per frame as
+	//    it takes to keep up with real time, each with the fixed
+	//    time step as its delta time and the time its result is
+	//    for as its total time
+	//  - Draw() runs once per frame with the real frame time, so
+	//    it can interpolate between the last two updates
 	virtual void Init() = 0;
 	virtual void Update(float deltaTime, float totalTime) = 0;
 	virtual void Draw(float deltaTime, float totalTime) = 0;
 
+	// Optional per-frame work that must stay on the window's
+	// thread even when Update() doesn't, run just before Draw()
+	virtual void UpdateMainThread(float deltaTime, float totalTime) { }
+
+	// Called on the thread that's about to start calling Update()
+	virtual void OnSimulationThreadChanged() { }
+
+	// Moves Update() onto a thread of its own, where it keeps to
+	// its fixed rate independent of Draw(), or brings it back
+	//  - Call from the window's thread; takes effect between frames
+	void SetThreadedSimulation(bool threaded) { threadedSimulation = threaded; }
+	bool IsSimulationThreaded() { return simulationThread.joinable(); }
+
+	// The rate Update() runs at, and how many updates one frame
+	// may run before the rest of the time owed is dropped, so a
+	// slow frame can't snowball into ever slower ones
+	//  - Set these in Init(), before the simulation can be threaded
+	void SetFixedTimeStep(float seconds) { fixedTimeStep = seconds; }
+	float GetFixedTimeStep() { return fixedTimeStep; }
+	void SetMaxStepsPerFrame(unsigned int steps) { maxStepsPerFrame = steps; }
+
 protected:
 	HINSTANCE	hInstance;		// The handle to the application
 	HWND		hWnd;			// The handle to the window itself
@@ -67,6 +98,10 @@ protected:
 	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> backBufferRTV;
 	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> depthStencilView;
 
+	// Deferrable work, run on this thread after each frame's
+	// Draw() in whatever time the frame has to spare
+	FrameScheduler* frameScheduler;
+
 	// Helper function for allocating a console window
 	void CreateConsoleWindow(int bufferLines, int bufferColumns, int windowLines, int windowColumns);
 
@@ -93,5 +128,21 @@ private:
 
 	void UpdateTimer();			// Updates the timer for this frame
 	void UpdateTitleBarStats();	// Puts debug info in the title bar
+
+	// Fixed time step
+	float fixedTimeStep;
+	unsigned int maxStepsPerFrame;
+	double accumulator; // Time owed to Update() on the window's thread
+
+	void StepSimulation(double& owed, float deltaTime, float totalTime);
+
+	// Simulation thread
+	bool threadedSimulation;
+	std::thread simulationThread;
+	std::atomic<bool> stopSimulation;
+
+	void StartSimulationThread();
+	void StopSimulationThread();
+	void SimulationLoop();
 };
 
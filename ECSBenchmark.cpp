@@ -0,0 +1,115 @@
+#include "ECSBenchmark.h"
+#include "BenchmarkTiming.h"
+#include "World.h"
+#include "Components.h"
+#include <stdio.h>
+#include <vector>
+
+using namespace DirectX;
+
+// What an entity looked like before the World, with all of
+// its data in one heap object
+struct HeapEntity
+{
+	XMFLOAT3 position;
+	XMFLOAT3 rotation;
+	XMFLOAT3 scale;
+	XMFLOAT4X4 world;
+	Mesh* mesh;
+	Material* material;
+	Bounds bounds;
+	Velocity velocity;
+};
+
+static const float TimeStep = 1.0f / 60.0f;
+
+static void MoveBounds(unsigned int count, Bounds* bounds, Velocity* velocities)
+{
+	for (unsigned int i = 0; i < count; i++)
+	{
+		bounds[i].center.x += velocities[i].linear.x * TimeStep;
+		bounds[i].center.y += velocities[i].linear.y * TimeStep;
+		bounds[i].center.z += velocities[i].linear.z * TimeStep;
+	}
+}
+
+// Millions of entities per second is entities per microsecond
+static void PrintResult(float milliseconds, unsigned int entityCount)
+{
+	printf(" %8.3fms  %8.1fM entities/s\n", milliseconds, entityCount / (milliseconds * 1000.0f));
+}
+
+static void RunAtCount(JobSystem* jobSystem, unsigned int entityCount, unsigned int iterations)
+{
+	printf("-- %u entities --\n", entityCount);
+
+	// Old layout
+	//  - Each entity also allocated its own mesh and material,
+	//    which sat between the entities on the heap
+	std::vector<HeapEntity*> heapEntities(entityCount);
+	std::vector<unsigned char*> heapNeighbours(entityCount * 2);
+	for (unsigned int i = 0; i < entityCount; i++)
+	{
+		heapEntities[i] = new HeapEntity();
+		heapNeighbours[i * 2] = new unsigned char[sizeof(Mesh)];
+		heapNeighbours[i * 2 + 1] = new unsigned char[sizeof(Material)];
+		heapEntities[i]->velocity.linear = XMFLOAT3((float)(i % 7), 1.0f, (float)(i % 3));
+	}
+	float heapTime = TimeAverage(iterations, [&]()
+	{
+		for (HeapEntity* entity : heapEntities)
+			MoveBounds(1, &entity->bounds, &entity->velocity);
+	});
+	printf("Heap objects:      ");
+	PrintResult(heapTime, entityCount);
+	for (unsigned int i = 0; i < entityCount; i++)
+	{
+		delete heapEntities[i];
+		delete[] heapNeighbours[i * 2];
+		delete[] heapNeighbours[i * 2 + 1];
+	}
+
+	// The same entities in a World
+	//  - The query only reads the bounds and velocity arrays,
+	//    skipping the rest of each chunk
+	World world;
+	for (unsigned int i = 0; i < entityCount; i++)
+	{
+		Velocity velocity = { XMFLOAT3((float)(i % 7), 1.0f, (float)(i % 3)), XMFLOAT3(0, 0, 0) };
+		world.Create(
+			TransformComponent{ InvalidTransformHandle },
+			MeshComponent{ MeshHandle() },
+			MaterialComponent{ MaterialHandle() },
+			Bounds{ XMFLOAT3(0, 0, 0), 1.0f },
+			velocity);
+	}
+
+	float chunkTime = TimeAverage(iterations, [&]()
+	{
+		world.ForEachChunk<Bounds, Velocity>([](unsigned int count, EntityId* entities, Bounds* bounds, Velocity* velocities)
+		{
+			MoveBounds(count, bounds, velocities);
+		});
+	});
+	printf("World, 1 thread:   ");
+	PrintResult(chunkTime, entityCount);
+
+	float parallelTime = TimeAverage(iterations, [&]()
+	{
+		world.ParallelForEachChunk<Bounds, Velocity>(jobSystem, [](unsigned int count, EntityId* entities, Bounds* bounds, Velocity* velocities)
+		{
+			MoveBounds(count, bounds, velocities);
+		});
+	});
+	printf("World, %2u threads: ", jobSystem->GetThreadCount());
+	PrintResult(parallelTime, entityCount);
+}
+
+void RunECSBenchmark(JobSystem* jobSystem, unsigned int iterations)
+{
+	printf("---- ECS iteration benchmark: %u iterations ----\n", iterations);
+
+	RunAtCount(jobSystem, 10000, iterations);
+	RunAtCount(jobSystem, 100000, iterations);
+	RunAtCount(jobSystem, 1000000, iterations);
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include "JobSystem.h"
+
+// --------------------------------------------------------
+// Times a simple system (bounds moved by velocity) over
+// 10k, 100k and 1M entities, and prints the results
+//  - Compares the old layout, one heap object per entity,
+//    against the World's chunks, on one thread and across
+//    the job system
+// --------------------------------------------------------
+void RunECSBenchmark(JobSystem* jobSystem, unsigned int iterations = 20);
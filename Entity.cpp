@@ -1,33 +0,0 @@
-#include "Entity.h"
-
-Entity::Entity(Mesh* mesh, Material* material)
-{
-	this->mesh = mesh;
-	this->material = material;
-}
-
-Entity::~Entity()
-{
-	delete mesh;
-	delete material;
-}
-
-void Entity::Draw()
-{
-
-}
-
-Mesh* Entity::GetMesh()
-{
-	return mesh;
-}
-
-Transform* Entity::GetTransform()
-{
-	return &transform;
-}
-
-Material* Entity::GetMaterial()
-{
-	return material;
-}
@@ -0,0 +1,804 @@
+#include "EntityBVH.h"
+#include "CPUFeatures.h"
+#include "RayPacket.h"
+#include <algorithm>
+#include <float.h>
+
+using namespace DirectX;
+
+// Buckets per axis when looking for the best split
+static const int SplitBins = 16;
+
+// --------------------------------------------------------
+// Stack of node indices for walking the tree, which stays
+// in a fixed array unless the tree is unusually deep
+// --------------------------------------------------------
+class NodeStack
+{
+public:
+	NodeStack() : count(0) { }
+
+	void Push(int index)
+	{
+		if (count < LocalSize)
+			local[count] = index;
+		else
+			overflow.push_back(index);
+		count++;
+	}
+
+	int Pop()
+	{
+		count--;
+		if (count < LocalSize)
+			return local[count];
+
+		int index = overflow.back();
+		overflow.pop_back();
+		return index;
+	}
+
+	bool IsEmpty() { return count == 0; }
+
+private:
+	static const unsigned int LocalSize = 64;
+	int local[LocalSize];
+	std::vector<int> overflow;
+	unsigned int count;
+};
+
+// A leaf's sphere, which its box was made from
+static void GetLeafSphere(const AABB& box, XMFLOAT3& center, float& radius)
+{
+	center = GetCenter(box);
+	radius = (box.upper.x - box.lower.x) * 0.5f;
+}
+
+EntityBVH::EntityBVH()
+{
+	root = -1;
+	leafCount = 0;
+	useAVX2 = HasAVX2();
+}
+
+SpatialProxy EntityBVH::Insert(EntityId entity, const XMFLOAT3& center, float radius)
+{
+	int leaf = AllocateNode();
+	nodes[leaf].box = MakeAABB(center, radius);
+	nodes[leaf].entity = entity;
+	InsertLeaf(leaf);
+	leafCount++;
+	return (SpatialProxy)leaf;
+}
+
+void EntityBVH::Remove(SpatialProxy proxy)
+{
+	RemoveLeaf((int)proxy);
+	FreeNode((int)proxy);
+	leafCount--;
+}
+
+void EntityBVH::Move(SpatialProxy proxy, const XMFLOAT3& center, float radius)
+{
+	nodes[proxy].box = MakeAABB(center, radius);
+}
+
+int EntityBVH::AllocateNode()
+{
+	int index;
+	if (!freeNodes.empty())
+	{
+		index = freeNodes.back();
+		freeNodes.pop_back();
+	}
+	else
+	{
+		index = (int)nodes.size();
+		nodes.push_back(Node());
+	}
+
+	Node& node = nodes[index];
+	node.parent = -1;
+	node.children[0] = -1;
+	node.children[1] = -1;
+	node.entity = InvalidEntity;
+	return index;
+}
+
+void EntityBVH::FreeNode(int index)
+{
+	freeNodes.push_back(index);
+}
+
+// --------------------------------------------------------
+// Pairs the leaf with whichever node it adds the least area
+// to the tree next to, walking down from the root
+// --------------------------------------------------------
+void EntityBVH::InsertLeaf(int leaf)
+{
+	if (root < 0)
+	{
+		root = leaf;
+		nodes[leaf].parent = -1;
+		return;
+	}
+
+	AABB leafBox = nodes[leaf].box;
+	int sibling = root;
+	while (!IsLeaf(sibling))
+	{
+		const Node& node = nodes[sibling];
+		float area = HalfArea(node.box);
+		float combinedArea = HalfArea(Union(node.box, leafBox));
+
+		// Pairing here makes one new node; going further down
+		// grows this one (and everything above) regardless
+		float cost = 2.0f * combinedArea;
+		float inheritedCost = 2.0f * (combinedArea - area);
+
+		float childCosts[2];
+		for (int c = 0; c < 2; c++)
+		{
+			const Node& child = nodes[node.children[c]];
+			float grown = HalfArea(Union(child.box, leafBox));
+			childCosts[c] = (IsLeaf(node.children[c]) ? grown : grown - HalfArea(child.box)) + inheritedCost;
+		}
+
+		if (cost < childCosts[0] && cost < childCosts[1])
+			break;
+		sibling = childCosts[0] < childCosts[1] ? node.children[0] : node.children[1];
+	}
+
+	int oldParent = nodes[sibling].parent;
+	int newParent = AllocateNode();
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].box = Union(leafBox, nodes[sibling].box);
+	nodes[newParent].children[0] = sibling;
+	nodes[newParent].children[1] = leaf;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+
+	if (oldParent >= 0)
+		ReplaceChild(oldParent, sibling, newParent);
+	else
+		root = newParent;
+
+	RefitAncestors(oldParent);
+}
+
+// Takes the leaf out of the tree, and its parent with it
+void EntityBVH::RemoveLeaf(int leaf)
+{
+	if (leaf == root)
+	{
+		root = -1;
+		return;
+	}
+
+	int parent = nodes[leaf].parent;
+	int grandparent = nodes[parent].parent;
+	int sibling = nodes[parent].children[0] == leaf ? nodes[parent].children[1] : nodes[parent].children[0];
+
+	nodes[sibling].parent = grandparent;
+	if (grandparent >= 0)
+		ReplaceChild(grandparent, parent, sibling);
+	else
+		root = sibling;
+
+	FreeNode(parent);
+	RefitAncestors(grandparent);
+}
+
+void EntityBVH::RefitAncestors(int index)
+{
+	while (index >= 0)
+	{
+		Node& node = nodes[index];
+		node.box = Union(nodes[node.children[0]].box, nodes[node.children[1]].box);
+		index = node.parent;
+	}
+}
+
+void EntityBVH::ReplaceChild(int parent, int oldChild, int newChild)
+{
+	Node& node = nodes[parent];
+	if (node.children[0] == oldChild)
+		node.children[0] = newChild;
+	else
+		node.children[1] = newChild;
+}
+
+// --------------------------------------------------------
+// Refits every internal node's box, children before parents,
+// and rotates each one once its children are done
+//  - Internal nodes are gathered parent-first, so going
+//    through them backwards always reaches children first
+// --------------------------------------------------------
+void EntityBVH::Refit(bool rotate)
+{
+	if (root < 0 || IsLeaf(root))
+		return;
+
+	std::vector<int> internalNodes;
+	internalNodes.reserve(leafCount);
+	NodeStack stack;
+	stack.Push(root);
+	while (!stack.IsEmpty())
+	{
+		int index = stack.Pop();
+		if (IsLeaf(index))
+			continue;
+
+		internalNodes.push_back(index);
+		stack.Push(nodes[index].children[0]);
+		stack.Push(nodes[index].children[1]);
+	}
+
+	for (size_t i = internalNodes.size(); i-- > 0;)
+	{
+		Node& node = nodes[internalNodes[i]];
+		node.box = Union(nodes[node.children[0]].box, nodes[node.children[1]].box);
+		if (rotate)
+			Rotate(internalNodes[i]);
+	}
+}
+
+// --------------------------------------------------------
+// Tries swapping each child with each of the other child's
+// children, and keeps the swap that shrinks that other child
+// the most, if any do
+//  - The node's own box doesn't change, since it still holds
+//    the same leaves
+// --------------------------------------------------------
+void EntityBVH::Rotate(int index)
+{
+	int best = -1;
+	float bestSaving = 0.0f;
+	int moveUp = -1;
+	int moveDown = -1;
+	AABB bestBox = {};
+
+	for (int c = 0; c < 2; c++)
+	{
+		int child = nodes[index].children[c];
+		int other = nodes[index].children[1 - c];
+		if (IsLeaf(other))
+			continue;
+
+		float otherArea = HalfArea(nodes[other].box);
+		for (int g = 0; g < 2; g++)
+		{
+			// child trades places with grandchild g, so other
+			// ends up holding child and the remaining grandchild
+			int grandchild = nodes[other].children[g];
+			int remaining = nodes[other].children[1 - g];
+			AABB box = Union(nodes[child].box, nodes[remaining].box);
+			float saving = otherArea - HalfArea(box);
+			if (saving > bestSaving)
+			{
+				bestSaving = saving;
+				best = other;
+				moveDown = child;
+				moveUp = grandchild;
+				bestBox = box;
+			}
+		}
+	}
+
+	if (best < 0)
+		return;
+
+	ReplaceChild(index, moveDown, moveUp);
+	ReplaceChild(best, moveUp, moveDown);
+	nodes[moveUp].parent = index;
+	nodes[moveDown].parent = best;
+	nodes[best].box = bestBox;
+}
+
+// --------------------------------------------------------
+// Throws away the internal nodes and builds new ones from
+// the leaves, top down with a binned SAH split
+// --------------------------------------------------------
+void EntityBVH::Build()
+{
+	buildItems.clear();
+	if (root < 0)
+		return;
+
+	// Gather the leaves and free everything else
+	NodeStack stack;
+	stack.Push(root);
+	while (!stack.IsEmpty())
+	{
+		int index = stack.Pop();
+		if (IsLeaf(index))
+		{
+			BuildItem item;
+			item.box = nodes[index].box;
+			XMFLOAT3 center = GetCenter(item.box);
+			item.center[0] = center.x;
+			item.center[1] = center.y;
+			item.center[2] = center.z;
+			item.leaf = index;
+			buildItems.push_back(item);
+			continue;
+		}
+
+		stack.Push(nodes[index].children[0]);
+		stack.Push(nodes[index].children[1]);
+		FreeNode(index);
+	}
+
+	root = BuildRange(0, (int)buildItems.size());
+	nodes[root].parent = -1;
+}
+
+// --------------------------------------------------------
+// Builds the subtree over buildItems[first, last) and
+// returns its root
+//  - Works from its own stack of ranges rather than recursing,
+//    since a lopsided scene can make a deep tree
+//  - Each range's items are binned along all three axes in
+//    one pass, and split at the cheapest bin boundary
+// --------------------------------------------------------
+int EntityBVH::BuildRange(int first, int last)
+{
+	struct Range
+	{
+		int first;
+		int last;
+		int parent;
+		int slot;
+	};
+
+	const AABB empty = {
+		XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX),
+		XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX) };
+
+	int subtreeRoot = -1;
+	std::vector<Range> ranges;
+	ranges.push_back(Range{ first, last, -1, 0 });
+	while (!ranges.empty())
+	{
+		Range range = ranges.back();
+		ranges.pop_back();
+		int count = range.last - range.first;
+
+		int node;
+		if (count == 1)
+			node = buildItems[range.first].leaf;
+		else
+		{
+			// Bounds of the boxes, and of their centers, which
+			// are what get binned
+			AABB box = empty;
+			float centerLower[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+			float centerUpper[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+			for (int i = range.first; i < range.last; i++)
+			{
+				const BuildItem& item = buildItems[i];
+				box = Union(box, item.box);
+				for (int axis = 0; axis < 3; axis++)
+				{
+					centerLower[axis] = std::min(centerLower[axis], item.center[axis]);
+					centerUpper[axis] = std::max(centerUpper[axis], item.center[axis]);
+				}
+			}
+
+			float scales[3];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				float extent = centerUpper[axis] - centerLower[axis];
+				scales[axis] = extent > 0.0f ? SplitBins * 0.9999f / extent : 0.0f;
+			}
+
+			AABB binBoxes[3][SplitBins];
+			int binCounts[3][SplitBins] = {};
+			for (int axis = 0; axis < 3; axis++)
+			{
+				for (int b = 0; b < SplitBins; b++)
+					binBoxes[axis][b] = empty;
+			}
+			for (int i = range.first; i < range.last; i++)
+			{
+				const BuildItem& item = buildItems[i];
+				for (int axis = 0; axis < 3; axis++)
+				{
+					int bin = (int)((item.center[axis] - centerLower[axis]) * scales[axis]);
+					binBoxes[axis][bin] = Union(binBoxes[axis][bin], item.box);
+					binCounts[axis][bin]++;
+				}
+			}
+
+			// Cheapest split over every axis: area * count on each side
+			int bestAxis = -1;
+			int bestSplit = 0;
+			float bestCost = FLT_MAX;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				if (scales[axis] == 0.0f)
+					continue;
+
+				// Sweep from the right for the costs of the right sides
+				float rightCosts[SplitBins];
+				AABB rightBox = empty;
+				int rightCount = 0;
+				for (int b = SplitBins - 1; b > 0; b--)
+				{
+					rightBox = Union(rightBox, binBoxes[axis][b]);
+					rightCount += binCounts[axis][b];
+					rightCosts[b] = rightCount > 0 ? HalfArea(rightBox) * rightCount : 0.0f;
+				}
+
+				// Then from the left, splitting before bin b
+				AABB leftBox = empty;
+				int leftCount = 0;
+				for (int b = 1; b < SplitBins; b++)
+				{
+					leftBox = Union(leftBox, binBoxes[axis][b - 1]);
+					leftCount += binCounts[axis][b - 1];
+					if (leftCount == 0 || leftCount == count)
+						continue;
+
+					float cost = HalfArea(leftBox) * leftCount + rightCosts[b];
+					if (cost < bestCost)
+					{
+						bestCost = cost;
+						bestAxis = axis;
+						bestSplit = b;
+					}
+				}
+			}
+
+			int middle;
+			if (bestAxis >= 0)
+			{
+				float scale = scales[bestAxis];
+				float lower = centerLower[bestAxis];
+				middle = (int)(std::partition(buildItems.begin() + range.first, buildItems.begin() + range.last, [=](const BuildItem& item)
+				{
+					return (int)((item.center[bestAxis] - lower) * scale) < bestSplit;
+				}) - buildItems.begin());
+			}
+			else
+			{
+				// Every center's in the same place, so any split is as good
+				middle = (range.first + range.last) / 2;
+			}
+
+			node = AllocateNode();
+			nodes[node].box = box;
+			ranges.push_back(Range{ range.first, middle, node, 0 });
+			ranges.push_back(Range{ middle, range.last, node, 1 });
+		}
+
+		nodes[node].parent = range.parent;
+		if (range.parent >= 0)
+			nodes[range.parent].children[range.slot] = node;
+		else
+			subtreeRoot = node;
+	}
+
+	return subtreeRoot;
+}
+
+float EntityBVH::GetCost()
+{
+	if (root < 0 || IsLeaf(root))
+		return 0.0f;
+
+	float rootArea = HalfArea(nodes[root].box);
+	float total = 0.0f;
+	NodeStack stack;
+	stack.Push(root);
+	while (!stack.IsEmpty())
+	{
+		int index = stack.Pop();
+		if (IsLeaf(index))
+			continue;
+
+		total += HalfArea(nodes[index].box);
+		stack.Push(nodes[index].children[0]);
+		stack.Push(nodes[index].children[1]);
+	}
+	return rootArea > 0.0f ? total / rootArea : 0.0f;
+}
+
+// Every leaf under index, without testing any of them
+void EntityBVH::AddSubtree(int index, std::vector<EntityId>& results)
+{
+	NodeStack stack;
+	stack.Push(index);
+	while (!stack.IsEmpty())
+	{
+		index = stack.Pop();
+		if (IsLeaf(index))
+		{
+			results.push_back(nodes[index].entity);
+			continue;
+		}
+		stack.Push(nodes[index].children[0]);
+		stack.Push(nodes[index].children[1]);
+	}
+}
+
+// --------------------------------------------------------
+// Everything touching the frustum
+//  - Subtrees entirely inside are taken whole
+// --------------------------------------------------------
+void EntityBVH::QueryFrustum(const Frustum& frustum, std::vector<EntityId>& results)
+{
+	if (root < 0)
+		return;
+
+	NodeStack stack;
+	stack.Push(root);
+	while (!stack.IsEmpty())
+	{
+		int index = stack.Pop();
+		const Node& node = nodes[index];
+
+		if (IsLeaf(index))
+		{
+			XMFLOAT3 center;
+			float radius;
+			GetLeafSphere(node.box, center, radius);
+			if (TestSphere(frustum, center, radius) != Containment::Outside)
+				results.push_back(node.entity);
+			continue;
+		}
+
+		Containment containment = TestAABB(frustum, node.box);
+		if (containment == Containment::Inside)
+			AddSubtree(index, results);
+		else if (containment == Containment::Intersects)
+		{
+			stack.Push(node.children[0]);
+			stack.Push(node.children[1]);
+		}
+	}
+}
+
+void EntityBVH::QuerySphere(const XMFLOAT3& center, float radius, std::vector<EntityId>& results)
+{
+	if (root < 0)
+		return;
+
+	NodeStack stack;
+	stack.Push(root);
+	while (!stack.IsEmpty())
+	{
+		int index = stack.Pop();
+		const Node& node = nodes[index];
+
+		if (IsLeaf(index))
+		{
+			XMFLOAT3 leafCenter;
+			float leafRadius;
+			GetLeafSphere(node.box, leafCenter, leafRadius);
+			if (SpheresOverlap(center, radius, leafCenter, leafRadius))
+				results.push_back(node.entity);
+		}
+		else if (SphereOverlapsAABB(center, radius, node.box))
+		{
+			stack.Push(node.children[0]);
+			stack.Push(node.children[1]);
+		}
+	}
+}
+
+void EntityBVH::QueryBox(const AABB& box, std::vector<EntityId>& results)
+{
+	if (root < 0)
+		return;
+
+	NodeStack stack;
+	stack.Push(root);
+	while (!stack.IsEmpty())
+	{
+		int index = stack.Pop();
+		const Node& node = nodes[index];
+
+		if (IsLeaf(index))
+		{
+			XMFLOAT3 leafCenter;
+			float leafRadius;
+			GetLeafSphere(node.box, leafCenter, leafRadius);
+			if (SphereOverlapsAABB(leafCenter, leafRadius, box))
+				results.push_back(node.entity);
+		}
+		else if (Overlaps(box, node.box))
+		{
+			stack.Push(node.children[0]);
+			stack.Push(node.children[1]);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Best first: nodes wait in a heap ordered by how far their
+// box is from the point, and the search stops once the
+// nearest box left is further than the worst entity kept
+// --------------------------------------------------------
+void EntityBVH::QueryNearest(const XMFLOAT3& point, unsigned int count, std::vector<EntityId>& results)
+{
+	if (root < 0 || count == 0)
+		return;
+
+	struct Pending
+	{
+		float distance;
+		int index;
+		bool operator<(const Pending& other) const { return distance > other.distance; }
+	};
+
+	NearestCollector nearest(count);
+	std::vector<Pending> pending;
+	pending.push_back(Pending{ DistanceToAABB(point, nodes[root].box), root });
+	while (!pending.empty())
+	{
+		std::pop_heap(pending.begin(), pending.end());
+		Pending next = pending.back();
+		pending.pop_back();
+		if (next.distance > nearest.GetWorstDistance())
+			break;
+
+		const Node& node = nodes[next.index];
+		if (IsLeaf(next.index))
+		{
+			XMFLOAT3 center;
+			float radius;
+			GetLeafSphere(node.box, center, radius);
+			nearest.Offer(node.entity, DistanceToSphere(point, center, radius));
+			continue;
+		}
+
+		for (int c = 0; c < 2; c++)
+		{
+			int child = node.children[c];
+			float distance = DistanceToAABB(point, nodes[child].box);
+			if (distance <= nearest.GetWorstDistance())
+			{
+				pending.push_back(Pending{ distance, child });
+				std::push_heap(pending.begin(), pending.end());
+			}
+		}
+	}
+
+	nearest.AppendSorted(results);
+}
+
+// --------------------------------------------------------
+// Nearest leaf sphere along the ray
+//  - Nearer children are visited first, and the search
+//    distance shrinks with every hit, so most of the tree
+//    behind the first hit is never looked at
+// --------------------------------------------------------
+bool EntityBVH::RayCast(const Ray& ray, float maxDistance, RayHit& hit)
+{
+	if (root < 0)
+		return false;
+
+	XMFLOAT3 inverseDirection = GetInverseDirection(ray.direction);
+	float nearest = maxDistance;
+	bool found = false;
+
+	NodeStack stack;
+	stack.Push(root);
+	while (!stack.IsEmpty())
+	{
+		int index = stack.Pop();
+		const Node& node = nodes[index];
+
+		float entry;
+		if (!RayIntersectsAABB(ray.origin, inverseDirection, node.box, nearest, entry))
+			continue;
+
+		if (IsLeaf(index))
+		{
+			XMFLOAT3 center;
+			float radius;
+			float distance;
+			GetLeafSphere(node.box, center, radius);
+			if (RayIntersectsSphere(ray, center, radius, nearest, distance))
+			{
+				nearest = distance;
+				hit.entity = node.entity;
+				hit.distance = distance;
+				found = true;
+			}
+			continue;
+		}
+
+		// Push the further child first, so the nearer one's next
+		float entries[2];
+		bool hits[2];
+		for (int c = 0; c < 2; c++)
+			hits[c] = RayIntersectsAABB(ray.origin, inverseDirection, nodes[node.children[c]].box, nearest, entries[c]);
+
+		int nearChild = hits[0] && (!hits[1] || entries[0] <= entries[1]) ? 0 : 1;
+		if (hits[1 - nearChild])
+			stack.Push(node.children[1 - nearChild]);
+		if (hits[nearChild])
+			stack.Push(node.children[nearChild]);
+	}
+
+	return found;
+}
+
+void EntityBVH::RayCastPacket(const Ray* rays, unsigned int count, float* maxDistances, const RayVisitor& visit)
+{
+	if (count > 4 && useAVX2)
+		RayCastPacket<Lanes8>(rays, std::min(count, 8u), maxDistances, visit);
+	else
+	{
+		for (unsigned int first = 0; first < count && first < 8; first += 4)
+		{
+			// Lanes here are numbered from the packet of 4, so move
+			// the visitor's bits up for the second one
+			unsigned int shift = first;
+			RayCastPacket<Lanes4>(&rays[first], std::min(count - first, 4u), &maxDistances[first], shift == 0 ? visit :
+				RayVisitor([&](EntityId entity, const XMFLOAT3& center, float radius, unsigned int lanes) { visit(entity, center, radius, lanes << shift); }));
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Same walk as RayCast(), with each node's box tested against
+// every ray in the packet at once
+// --------------------------------------------------------
+template<typename Lanes>
+void EntityBVH::RayCastPacket(const Ray* rays, unsigned int count, float* maxDistances, const RayVisitor& visit)
+{
+	if (root < 0 || count == 0)
+		return;
+
+	RayPacket<Lanes> packet(rays, count, maxDistances);
+	float entry;
+	if (!packet.TestBox(&nodes[root].box.lower.x, &nodes[root].box.upper.x, entry))
+		return;
+
+	TraversalStack stack;
+	stack.Push((unsigned int)root, entry);
+	float furthest = packet.GetFurthest();
+	while (!stack.IsEmpty())
+	{
+		unsigned int index;
+		stack.Pop(index, entry);
+		if (entry > furthest)
+			continue;
+
+		const Node& node = nodes[index];
+		if (IsLeaf(index))
+		{
+			// Retested, since the rays may have been brought in
+			// since it was pushed
+			int lanes = packet.TestBox(&node.box.lower.x, &node.box.upper.x, entry);
+			if (lanes == 0)
+				continue;
+
+			XMFLOAT3 center;
+			float radius;
+			GetLeafSphere(node.box, center, radius);
+			visit(node.entity, center, radius, (unsigned int)lanes);
+			packet.SetNearest(maxDistances);
+			furthest = packet.GetFurthest();
+			continue;
+		}
+
+		// Push the further child first, so the nearer one's next
+		float entries[2];
+		bool hits[2];
+		for (int c = 0; c < 2; c++)
+		{
+			const AABB& box = nodes[node.children[c]].box;
+			hits[c] = packet.TestBox(&box.lower.x, &box.upper.x, entries[c]) != 0;
+		}
+
+		int nearChild = hits[0] && (!hits[1] || entries[0] <= entries[1]) ? 0 : 1;
+		if (hits[1 - nearChild])
+			stack.Push((unsigned int)node.children[1 - nearChild], entries[1 - nearChild]);
+		if (hits[nearChild])
+			stack.Push((unsigned int)node.children[nearChild], entries[nearChild]);
+	}
+}
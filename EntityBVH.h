@@ -0,0 +1,103 @@
+#pragma once
+#include <DirectXMath.h>
+#include <functional>
+#include <vector>
+#include "SpatialIndex.h"
+
+// --------------------------------------------------------
+// Dynamic bounding volume hierarchy over entities' world
+// space bounding spheres
+//  - One entity per leaf; internal nodes always have two
+//    children
+//  - Build() makes the tree from scratch with a binned SAH
+//    split, for the best tree at a price
+//  - Things that move just have their leaf updated with Move();
+//    Refit() then fixes up every box bottom-up, rotating
+//    subtrees wherever that shrinks a child, so the tree stays
+//    good for far longer than a plain refit would keep it
+//  - Insert() and Remove() patch the tree in place, so Build()
+//    is only needed to start over
+//  - Leaves are spheres, and queries test them as spheres
+//  - Proxies (leaf indices) never change while the entity's in
+//    the tree, Build() included
+// --------------------------------------------------------
+class EntityBVH : public SpatialIndex
+{
+public:
+	EntityBVH();
+
+	SpatialProxy Insert(EntityId entity, const DirectX::XMFLOAT3& center, float radius);
+	void Remove(SpatialProxy proxy);
+
+	// Changes a leaf's bounds; the tree above it is out of date
+	// until the next Refit()
+	void Move(SpatialProxy proxy, const DirectX::XMFLOAT3& center, float radius);
+	void Update() { Refit(); }
+
+	void Build();
+	void Refit(bool rotate = true); // Rotations can be turned off, for comparison
+
+	unsigned int GetCount() { return leafCount; }
+
+	// Sum of internal nodes' areas, relative to the root's - the
+	// expected number of nodes a random ray visits, near enough
+	float GetCost();
+
+	// Queries append what they find to results
+	void QueryFrustum(const Frustum& frustum, std::vector<EntityId>& results);
+	void QuerySphere(const DirectX::XMFLOAT3& center, float radius, std::vector<EntityId>& results);
+	void QueryBox(const AABB& box, std::vector<EntityId>& results);
+	void QueryNearest(const DirectX::XMFLOAT3& point, unsigned int count, std::vector<EntityId>& results);
+
+	// Nearest hit within maxDistance, if any
+	bool RayCast(const Ray& ray, float maxDistance, RayHit& hit);
+
+	// Walks the tree once for up to 8 rays together, with SIMD,
+	// calling visit(entity, center, radius, lanes) for each leaf
+	// whose box any of them hits within its maxDistances[i]
+	//  - lanes has bit i set for each ray i that hit the box
+	//  - Leaves come nearest first, and visit can bring the rays'
+	//    maxDistances in (to where it found they hit something),
+	//    which the walk takes up straight away
+	typedef std::function<void(EntityId, const DirectX::XMFLOAT3&, float, unsigned int)> RayVisitor;
+	void RayCastPacket(const Ray* rays, unsigned int count, float* maxDistances, const RayVisitor& visit);
+
+private:
+	struct Node
+	{
+		AABB box;
+		int parent;
+		int children[2];	// Both -1 for leaves
+		EntityId entity;	// Leaves only
+	};
+
+	std::vector<Node> nodes;
+	std::vector<int> freeNodes;
+	int root;
+	unsigned int leafCount;
+	bool useAVX2;
+
+	// Scratch for Build() - the leaves, with copies of what the
+	// build needs, so it never has to go back to the nodes
+	struct BuildItem
+	{
+		AABB box;
+		float center[3];
+		int leaf;
+	};
+	std::vector<BuildItem> buildItems;
+
+	int AllocateNode();
+	void FreeNode(int index);
+	bool IsLeaf(int index) { return nodes[index].children[0] < 0; }
+
+	void InsertLeaf(int leaf);
+	void RemoveLeaf(int leaf);
+	void RefitAncestors(int index);
+	void Rotate(int index);
+	void ReplaceChild(int parent, int oldChild, int newChild);
+
+	int BuildRange(int first, int last);
+	template<typename Lanes> void RayCastPacket(const Ray* rays, unsigned int count, float* maxDistances, const RayVisitor& visit);
+	void AddSubtree(int index, std::vector<EntityId>& results);
+};
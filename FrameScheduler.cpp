@@ -0,0 +1,225 @@
+#include "FrameScheduler.h"
+#include <chrono>
+#include <stdio.h>
+
+FrameScheduler::FrameScheduler()
+{
+	nextId = 0;
+	budget = 2.0f;
+	frameTimeTarget = 1000.0f / 60.0f;
+	starvationFrames = 30;
+	ResetStats();
+}
+
+FrameScheduler::~FrameScheduler()
+{
+	for (Task* task : tasks)
+		delete task;
+}
+
+FrameScheduler::TaskId FrameScheduler::Add(const std::string& name, Step step, TaskPriority priority)
+{
+	Task* task = new Task();
+	task->name = name;
+	task->step = step;
+	task->priority = priority;
+	task->progress = 0.0f;
+	task->cancelled = false;
+	task->ranThisFrame = false;
+	task->framesWaiting = 0;
+	task->steps = 0;
+	task->milliseconds = 0.0;
+
+	std::lock_guard<std::mutex> lock(taskMutex);
+	task->id = nextId++;
+	tasks.push_back(task);
+	return task->id;
+}
+
+// --------------------------------------------------------
+// Stops the task from being stepped again
+//  - A step that's already running finishes first
+// --------------------------------------------------------
+void FrameScheduler::Cancel(TaskId id)
+{
+	std::lock_guard<std::mutex> lock(taskMutex);
+	for (Task* task : tasks)
+	{
+		if (task->id == id)
+			task->cancelled = true;
+	}
+}
+
+float FrameScheduler::GetProgress(TaskId id)
+{
+	std::lock_guard<std::mutex> lock(taskMutex);
+	for (Task* task : tasks)
+	{
+		if (task->id == id)
+			return task->cancelled ? 1.0f : task->progress;
+	}
+	return 1.0f;
+}
+
+unsigned int FrameScheduler::GetTaskCount()
+{
+	std::lock_guard<std::mutex> lock(taskMutex);
+	return (unsigned int)tasks.size();
+}
+
+// --------------------------------------------------------
+// Steps starved tasks once each, then the highest priority
+// task there is until the budget runs out, then clears out
+// whatever's finished
+//  - Tasks that didn't get a step this frame wait one frame
+//    longer; those that did start counting again
+// --------------------------------------------------------
+void FrameScheduler::RunFrame(float frameMilliseconds)
+{
+	float available = frameTimeTarget - frameMilliseconds;
+	if (available > budget)
+		available = budget;
+	if (available < 0.0f)
+		available = 0.0f;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	Task* task;
+	unsigned int stepsRun = 0;
+	while ((task = PickTask(true)) != 0)
+	{
+		RunStep(task);
+		starvedSteps++;
+		stepsRun++;
+	}
+
+	while (true)
+	{
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		if (elapsed.count() >= available)
+			break;
+
+		task = PickTask(false);
+		if (!task)
+			break;
+		RunStep(task);
+		stepsRun++;
+	}
+
+	// Only frames with work to do count towards the stats
+	std::chrono::duration<float, std::milli> used = std::chrono::high_resolution_clock::now() - start;
+	lastBudget = available;
+	lastUsed = stepsRun > 0 ? used.count() : 0.0f;
+	if (stepsRun > 0)
+	{
+		frames++;
+		if (lastUsed > available)
+			framesOverBudget++;
+		totalBudget += lastBudget;
+		totalUsed += lastUsed;
+	}
+
+	std::lock_guard<std::mutex> lock(taskMutex);
+	for (unsigned int i = 0; i < tasks.size();)
+	{
+		task = tasks[i];
+		task->framesWaiting = task->ranThisFrame ? 0 : task->framesWaiting + 1;
+		task->ranThisFrame = false;
+
+		if (task->cancelled || task->progress >= 1.0f)
+		{
+			if (!task->cancelled)
+				tasksFinished++;
+			delete task;
+			tasks.erase(tasks.begin() + i);
+			continue;
+		}
+		i++;
+	}
+}
+
+// --------------------------------------------------------
+// The next task to step: the highest priority, and of those,
+// the one that's waited longest
+//  - starvedOnly limits it to tasks that have waited too long
+//    and haven't had a step yet this frame
+// --------------------------------------------------------
+FrameScheduler::Task* FrameScheduler::PickTask(bool starvedOnly)
+{
+	std::lock_guard<std::mutex> lock(taskMutex);
+
+	Task* best = 0;
+	for (Task* task : tasks)
+	{
+		if (task->cancelled || task->progress >= 1.0f)
+			continue;
+		if (starvedOnly && (task->ranThisFrame || task->framesWaiting < starvationFrames))
+			continue;
+
+		if (!best ||
+			task->priority < best->priority ||
+			(task->priority == best->priority && task->framesWaiting > best->framesWaiting))
+			best = task;
+	}
+	return best;
+}
+
+// --------------------------------------------------------
+// Runs one step of the task, outside the lock so the step
+// can add tasks of its own
+//  - Tasks are only ever deleted by RunFrame(), so it's safe
+//    to use without the lock held
+// --------------------------------------------------------
+void FrameScheduler::RunStep(Task* task)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	float progress = task->step();
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+	std::lock_guard<std::mutex> lock(taskMutex);
+	task->progress = progress > 1.0f ? 1.0f : progress;
+	task->ranThisFrame = true;
+	task->steps++;
+	task->milliseconds += elapsed.count();
+}
+
+void FrameScheduler::PrintStats()
+{
+	std::lock_guard<std::mutex> lock(taskMutex);
+
+	static const char* priorityNames[] = { "High", "Normal", "Low" };
+	printf("---- Frame scheduler: %u tasks, %llu finished ----\n", (unsigned int)tasks.size(), tasksFinished);
+	for (Task* task : tasks)
+	{
+		printf("%-24s %-6s %5.1f%%  %6llu steps  %8.2fms  waiting %u frames\n",
+			task->name.c_str(),
+			priorityNames[(int)task->priority],
+			task->progress * 100.0f,
+			task->steps,
+			task->milliseconds,
+			task->framesWaiting);
+	}
+
+	if (frames > 0)
+	{
+		printf("Budget: %.2fms average, %.2fms used (%.1f%%), over on %llu of %llu frames, %llu starved steps\n",
+			totalBudget / frames,
+			totalUsed / frames,
+			totalBudget > 0.0 ? totalUsed * 100.0 / totalBudget : 0.0,
+			framesOverBudget,
+			frames,
+			starvedSteps);
+	}
+}
+
+void FrameScheduler::ResetStats()
+{
+	lastBudget = 0.0f;
+	lastUsed = 0.0f;
+	frames = 0;
+	framesOverBudget = 0;
+	starvedSteps = 0;
+	tasksFinished = 0;
+	totalBudget = 0.0;
+	totalUsed = 0.0;
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ThreadPool.h"
+
+// --------------------------------------------------------
+// Runs deferrable work on the window's thread a slice at a
+// time, in whatever each frame has to spare
+//  - For work that's too slow for one frame but has to happen
+//    on the window's thread, or just doesn't need to be done
+//    right away: rebuilds, generation, cache writes
+//  - A task is a step function that does a little of the work
+//    and returns how far along it is, from 0 to 1; it's called
+//    over and over, across as many frames as it takes, until
+//    it returns 1
+//  - Each frame's budget is the most it's allowed, or what's
+//    left before the frame time target, whichever is less
+//  - Higher priorities go first, but a task that's been passed
+//    over for too many frames gets a step before anything
+//    else, budget or no budget, so nothing waits forever
+//  - Tasks can be added and cancelled from any thread
+//  - Nothing in the game gives it work yet: the deferrable
+//    work there is (like rebuilding the entity BVH once it's
+//    degraded) belongs to the simulation, which can be on
+//    another thread, so for now DXCore runs it on an empty
+//    list and F reports on it
+// --------------------------------------------------------
+class FrameScheduler
+{
+public:
+	typedef unsigned int TaskId;
+	typedef std::function<float()> Step; // Keep each call well under a millisecond
+
+	FrameScheduler();
+	~FrameScheduler();
+
+	TaskId Add(const std::string& name, Step step, TaskPriority priority = TaskPriority::Normal);
+	void Cancel(TaskId id);
+
+	// From 0 to 1, where finished and cancelled tasks count as 1
+	float GetProgress(TaskId id);
+	bool IsFinished(TaskId id) { return GetProgress(id) >= 1.0f; }
+	unsigned int GetTaskCount();
+
+	// Most milliseconds per frame, and the frame time the budget
+	// is cut back to stay within
+	void SetBudget(float milliseconds) { budget = milliseconds; }
+	void SetFrameTimeTarget(float milliseconds) { frameTimeTarget = milliseconds; }
+	void SetStarvationFrames(unsigned int frames) { starvationFrames = frames; }
+
+	// Runs steps until this frame's budget is spent, given how
+	// long the frame has taken so far
+	void RunFrame(float frameMilliseconds);
+
+	// The last frame's budget, and how much of it was used
+	float GetLastBudget() { return lastBudget; }
+	float GetLastUsed() { return lastUsed; }
+
+	// Each task's progress, and budget use since the last reset
+	void PrintStats();
+	void ResetStats();
+
+private:
+	struct Task
+	{
+		TaskId id;
+		std::string name;
+		Step step;
+		TaskPriority priority;
+		float progress;
+		bool cancelled;
+		bool ranThisFrame;
+		unsigned int framesWaiting;
+
+		unsigned long long steps;
+		double milliseconds;
+	};
+
+	std::vector<Task*> tasks;
+	std::mutex taskMutex;
+	TaskId nextId;
+
+	float budget;
+	float frameTimeTarget;
+	unsigned int starvationFrames;
+
+	// Stats
+	float lastBudget;
+	float lastUsed;
+	unsigned long long frames;
+	unsigned long long framesOverBudget;
+	unsigned long long starvedSteps;
+	unsigned long long tasksFinished;
+	double totalBudget;
+	double totalUsed;
+
+	Task* PickTask(bool starvedOnly);
+	void RunStep(Task* task);
+};
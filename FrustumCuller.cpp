@@ -0,0 +1,206 @@
+#include "FrustumCuller.h"
+#include "CPUFeatures.h"
+#include <algorithm>
+#include <float.h>
+#include <immintrin.h>
+#include <string.h>
+
+using namespace DirectX;
+
+// Spheres per block when culling across threads
+//  - A multiple of 8, and big enough that each block is worth
+//    a job of its own
+static const unsigned int BlockSize = 4096;
+
+FrustumCuller::FrustumCuller()
+{
+	count = 0;
+	useSIMD = HasAVX2();
+}
+
+void FrustumCuller::SetUseSIMD(bool useSIMD)
+{
+	this->useSIMD = useSIMD && HasAVX2();
+}
+
+void FrustumCuller::Clear()
+{
+	centerX.clear();
+	centerY.clear();
+	centerZ.clear();
+	radius.clear();
+	ids.clear();
+	count = 0;
+}
+
+// --------------------------------------------------------
+// Adds a sphere, growing by a whole batch at a time
+//  - Padding has a radius of -FLT_MAX, which puts it behind
+//    every plane no matter where it is
+// --------------------------------------------------------
+void FrustumCuller::Add(const XMFLOAT3& center, float radius, unsigned int id)
+{
+	if (count == ids.size())
+	{
+		unsigned int paddedCount = count + 8;
+		centerX.resize(paddedCount, 0.0f);
+		centerY.resize(paddedCount, 0.0f);
+		centerZ.resize(paddedCount, 0.0f);
+		this->radius.resize(paddedCount, -FLT_MAX);
+		ids.resize(paddedCount, 0);
+	}
+
+	centerX[count] = center.x;
+	centerY[count] = center.y;
+	centerZ[count] = center.z;
+	this->radius[count] = radius;
+	ids[count] = id;
+	count++;
+}
+
+// --------------------------------------------------------
+// Small sets are culled right into visible; big ones are split
+// into blocks that each write to their own part of
+// blockVisible, which are then packed together in order
+// --------------------------------------------------------
+void FrustumCuller::Cull(const Frustum& frustum, std::vector<unsigned int>& visible, JobSystem* jobSystem)
+{
+	CullSpheres(frustum, visible, 0, jobSystem);
+}
+
+// Padding gets margins too, and is cut off afterwards
+void FrustumCuller::Cull(const Frustum& frustum, std::vector<unsigned int>& visible, std::vector<float>& margins, JobSystem* jobSystem)
+{
+	margins.resize(ids.size());
+	CullSpheres(frustum, visible, margins.data(), jobSystem);
+	margins.resize(count);
+}
+
+void FrustumCuller::CullSpheres(const Frustum& frustum, std::vector<unsigned int>& visible, float* margins, JobSystem* jobSystem)
+{
+	unsigned int batchCount = (unsigned int)ids.size() / 8;
+	unsigned int blockCount = (count + BlockSize - 1) / BlockSize;
+	if (!jobSystem || blockCount <= 1)
+	{
+		visible.resize(ids.size());
+		unsigned int visibleCount = CullBatches(frustum, 0, batchCount, visible.data(), margins);
+		visible.resize(visibleCount);
+		return;
+	}
+
+	blockVisible.resize(blockCount * BlockSize);
+	blockCounts.resize(blockCount);
+	const unsigned int batchesPerBlock = BlockSize / 8;
+	jobSystem->ParallelFor(blockCount, 1, [this, &frustum, margins, batchCount, batchesPerBlock](unsigned int firstBlock, unsigned int lastBlock)
+	{
+		for (unsigned int b = firstBlock; b < lastBlock; b++)
+		{
+			unsigned int firstBatch = b * batchesPerBlock;
+			unsigned int lastBatch = std::min(firstBatch + batchesPerBlock, batchCount);
+			blockCounts[b] = CullBatches(frustum, firstBatch, lastBatch, &blockVisible[b * BlockSize], margins);
+		}
+	});
+
+	unsigned int visibleCount = 0;
+	for (unsigned int b = 0; b < blockCount; b++)
+		visibleCount += blockCounts[b];
+	visible.resize(visibleCount);
+
+	unsigned int offset = 0;
+	for (unsigned int b = 0; b < blockCount; b++)
+	{
+		if (blockCounts[b] > 0)
+			memcpy(&visible[offset], &blockVisible[b * BlockSize], blockCounts[b] * sizeof(unsigned int));
+		offset += blockCounts[b];
+	}
+}
+
+// --------------------------------------------------------
+// A sphere is visible unless it's entirely behind a plane
+//  - Margins need every plane, so only then does it carry on
+//    past the first one the sphere is behind
+// --------------------------------------------------------
+unsigned int FrustumCuller::CullBatches(const Frustum& frustum, unsigned int firstBatch, unsigned int lastBatch, unsigned int* output, float* margins)
+{
+	if (useSIMD)
+		return CullBatchesSIMD(frustum, firstBatch, lastBatch, output, margins);
+
+	unsigned int visibleCount = 0;
+	for (unsigned int i = firstBatch * 8; i < lastBatch * 8; i++)
+	{
+		bool inside = true;
+		float margin = FLT_MAX;
+		for (int p = 0; p < 6 && (inside || margins); p++)
+		{
+			const XMFLOAT4& plane = frustum.planes[p];
+			float distance = (plane.x * centerX[i] + plane.y * centerY[i]) + (plane.z * centerZ[i] + plane.w);
+			inside = inside && distance >= -radius[i];
+			margin = std::min(margin, distance + radius[i]);
+		}
+		if (margins)
+			margins[i] = margin;
+
+		// Always written, only kept when it's visible
+		output[visibleCount] = ids[i];
+		visibleCount += inside ? 1 : 0;
+	}
+	return visibleCount;
+}
+
+// --------------------------------------------------------
+// Tests 8 spheres against each plane at once, with each
+// __m256 holding one component for all 8
+//  - Planes are splatted once up front, so the loop is just
+//    loads, multiplies, adds and compares
+//  - Batches with nothing visible are skipped outright; the
+//    rest are compacted without branching on each sphere
+//  - Margins are a running minimum alongside the mask
+// --------------------------------------------------------
+unsigned int FrustumCuller::CullBatchesSIMD(const Frustum& frustum, unsigned int firstBatch, unsigned int lastBatch, unsigned int* output, float* margins)
+{
+	__m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++)
+	{
+		planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+		planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+		planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+		planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+	}
+	const __m256 signBit = _mm256_set1_ps(-0.0f);
+
+	unsigned int visibleCount = 0;
+	for (unsigned int b = firstBatch; b < lastBatch; b++)
+	{
+		unsigned int i = b * 8;
+		__m256 x = _mm256_loadu_ps(&centerX[i]);
+		__m256 y = _mm256_loadu_ps(&centerY[i]);
+		__m256 z = _mm256_loadu_ps(&centerZ[i]);
+		__m256 sphereRadius = _mm256_loadu_ps(&radius[i]);
+		__m256 negativeRadius = _mm256_xor_ps(sphereRadius, signBit);
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		__m256 margin = _mm256_set1_ps(FLT_MAX);
+		for (int p = 0; p < 6; p++)
+		{
+			__m256 distance = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(planeX[p], x), _mm256_mul_ps(planeY[p], y)),
+				_mm256_add_ps(_mm256_mul_ps(planeZ[p], z), planeW[p]));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+			if (margins)
+				margin = _mm256_min_ps(margin, _mm256_add_ps(distance, sphereRadius));
+		}
+		if (margins)
+			_mm256_storeu_ps(&margins[i], margin);
+
+		int mask = _mm256_movemask_ps(inside);
+		if (mask == 0)
+			continue;
+
+		for (unsigned int j = 0; j < 8; j++)
+		{
+			output[visibleCount] = ids[i + j];
+			visibleCount += (mask >> j) & 1;
+		}
+	}
+	return visibleCount;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+#include "Collision.h"
+#include "JobSystem.h"
+
+// --------------------------------------------------------
+// Culls bounding spheres against a frustum, 8 at a time
+//  - Spheres are stored structure-of-arrays, so a batch of 8
+//    is one 256-bit load per component, tested against all six
+//    planes with AVX (when the CPU has AVX2, like TransformSystem)
+//  - Each sphere carries an id of the caller's choosing, and
+//    Cull() writes out the ids of the visible ones, in the order
+//    they were added
+//  - Big sets are split into blocks across the job system; each
+//    block compacts its own results, and they're joined at the end
+// --------------------------------------------------------
+class FrustumCuller
+{
+public:
+	FrustumCuller();
+
+	// Empties the set, keeping the memory for next time
+	void Clear();
+	void Add(const DirectX::XMFLOAT3& center, float radius, unsigned int id);
+	unsigned int GetCount() { return count; }
+
+	// Replaces visible with the ids of spheres that are at
+	// least partly inside the frustum
+	//  - Pass a job system to spread big sets across it
+	void Cull(const Frustum& frustum, std::vector<unsigned int>& visible, JobSystem* jobSystem = 0);
+
+	// The same, also writing each sphere's margin to margins, in
+	// the order they were added
+	//  - That's the smallest distance + radius over the planes,
+	//    so it's negative for those outside (see VisibilityCache)
+	void Cull(const Frustum& frustum, std::vector<unsigned int>& visible, std::vector<float>& margins, JobSystem* jobSystem = 0);
+
+	// Turns the SIMD path off, for comparing against it
+	void SetUseSIMD(bool useSIMD);
+
+private:
+	// Padded out to a multiple of 8 with spheres that can never
+	// be visible, so batches never need a tail case
+	std::vector<float> centerX, centerY, centerZ, radius;
+	std::vector<unsigned int> ids;
+	unsigned int count;
+	bool useSIMD;
+
+	// Per-block results when culling across threads
+	std::vector<unsigned int> blockVisible;
+	std::vector<unsigned int> blockCounts;
+
+	// Both Cull()s; margins may be null
+	void CullSpheres(const Frustum& frustum, std::vector<unsigned int>& visible, float* margins, JobSystem* jobSystem);
+
+	// Culls batches [firstBatch, lastBatch), writing visible ids
+	// to output, and margins too if they're wanted, and returns
+	// how many were visible
+	unsigned int CullBatches(const Frustum& frustum, unsigned int firstBatch, unsigned int lastBatch, unsigned int* output, float* margins);
+	unsigned int CullBatchesSIMD(const Frustum& frustum, unsigned int firstBatch, unsigned int lastBatch, unsigned int* output, float* margins);
+};
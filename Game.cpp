@@ -1,7 +1,18 @@
 #include "Game.h"
 #include "Vertex.h"
+#include "TransformBenchmark.h"
+#include "ECSBenchmark.h"
+#include "BVHBenchmark.h"
+#include "SpatialIndexBenchmark.h"
+#include "CullingBenchmark.h"
+#include "OcclusionBenchmark.h"
+#include "RayCastBenchmark.h"
+#include "RayQueryBenchmark.h"
+#include "PVSBenchmark.h"
+#include <algorithm>
 #include <fstream>
 #include "WICTextureLoader.h"
+#include "DDSTextureLoader.h"
 
 // Needed for a helper function to read compiled shader files from the hard drive
 #pragma comment(lib, "d3dcompiler.lib")
@@ -28,14 +39,41 @@ Game::Game(HINSTANCE hInstance)
 {
 
 	camera = 0;
+	jobSystem = 0;
+	threadPool = 0;
+	fileLoader = 0;
+	assetLoader = 0;
+	startupGraph = 0;
+	assetLoadBudget = 2.0f;
+	firstFrameReported = false;
+	fullyLoadedReported = false;
 	currentEntity = 0;
-	prevTab = false;
+	pendingAspectRatio = 0.0f;
+	screenHeight = 0.0f;
+	lastFrameMs = 0.0f;
+	simulationUpdates = 0;
+	modeStartUpdates = 0;
+	modeFrames = 0;
+	modeLatencyMs = 0.0;
+	modeLatencySamples = 0;
+	world = 0;
+	transformSystem = 0;
+	for (SpatialIndex*& layer : spatialLayers)
+		layer = 0;
+	entityCuller = 0;
+	visibilityCache = 0;
+	occlusionCuller = 0;
+	occluderBoxMesh = 0;
+	lodSelector = 0;
+	renderQueue = 0;
+	stateCache = 0;
 	pixelShader = 0;
 	vertexShader = 0;
 	pixelShaderNormalMap = 0;
 	vertexShaderNormalMap = 0;
 	currentPS = 0;
 	currentVS = 0;
+	CreateKeyActions();
 
 #if defined(DEBUG) || defined(_DEBUG)
 	// Do we want a console window?  Probably only in debug mode
@@ -55,10 +93,19 @@ Game::~Game()
 	// we don't need to explicitly clean up those DirectX objects
 	// - If we weren't using smart pointers, we'd need
 	//   to call Release() on each DirectX object
-	for (int i = 0; i < entities.size(); i++)
-	{
-		delete entities[i];
-	}
+
+	// Startup tasks still running on the pool use what's below
+	delete startupGraph;
+
+	delete world;
+	delete transformSystem;
+	for (SpatialIndex* layer : spatialLayers)
+		delete layer;
+	delete entityCuller;
+	delete visibilityCache;
+	delete occlusionCuller;
+	delete lodSelector;
+	delete renderQueue;
 
 	delete vertexShader;
 	delete pixelShader;
@@ -67,6 +114,13 @@ Game::~Game()
 	/*delete currentPS;
 	delete currentVS;*/
 	delete camera;
+
+	// The loaders wait on the pool, so they go first
+	delete assetLoader;
+	delete fileLoader;
+	delete threadPool;
+	delete jobSystem;
+	delete stateCache;
 }
 
 // --------------------------------------------------------
@@ -75,28 +129,68 @@ Game::~Game()
 // --------------------------------------------------------
 void Game::Init()
 {
-	// Helper methods for loading shaders, creating some basic
-	// geometry to draw and some simple camera matrices.
-	//  - You'll be expanding and/or replacing these later
-	LoadShaders();
-	CreateBasicGeometry();
+	// Startup runs as a graph of tasks spread across every core
+	//  - LoadShaders() and CreateBasicGeometry() add tasks to the
+	//    graph instead of doing the work right away
+	//  - Init() only waits on what the first frame needs, and the
+	//    real assets keep loading behind placeholders in UpdateMainThread()
+	loadStartTime = std::chrono::high_resolution_clock::now();
+	jobSystem = new JobSystem();
+	threadPool = new ThreadPool();
+	fileLoader = new AsyncFileLoader(threadPool);
+	stateCache = new StateCache(context.Get());
+	assetLoader = new AssetLoader(device, context, stateCache, threadPool, fileLoader);
+	startupGraph = new TaskGraph(threadPool);
+	world = new World();
+	transformSystem = new TransformSystem();
+	spatialLayers[(int)SpatialLayer::Static] = new EntityBVH();
+	spatialLayers[(int)SpatialLayer::Dynamic] = new SpatialGrid();
+	entityCuller = new FrustumCuller();
+	visibilityCache = new VisibilityCache();
+	lodSelector = new LODSelector();
+	renderQueue = new RenderQueue();
+	screenHeight = (float)this->height;
+	CreateOccluderMeshes();
+
+	TaskGraph::TaskId entitiesReady = CreateBasicGeometry();
+	LoadShaders(entitiesReady);
+	TaskGraph::TaskId cameraReady = startupGraph->Add("Camera and lights", [this]() { CreateCameraAndLights(); });
+	startupGraph->Start();
 
 	// Tell the input assembler stage of the pipeline what kind of
 	// geometric primitives (points, lines or triangles) we want to draw.  
 	// Essentially: "What kind of shape should the GPU draw with our data?"
-	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	stateCache->SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-	// Get the size as the next multiple of 16
-	unsigned int size = vertexShader->GetBufferSize(0);
-	size = (size + 15) / 16 * 16;
+	startupGraph->Wait(entitiesReady);
+	startupGraph->Wait(cameraReady);
+	previousView = camera->GetView();
+	previousCameraPosition = camera->GetTransform()->GetPosition();
+	modeStartTime = std::chrono::high_resolution_clock::now();
+}
 
-	// Describe the constant buffer
-	CD3D11_BUFFER_DESC cbDesc = {}; // Sets to all zeros
-	cbDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	cbDesc.ByteWidth = size;
-	cbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	cbDesc.Usage = D3D11_USAGE_DYNAMIC;
+// --------------------------------------------------------
+// Sets up occlusion culling, with the one occluder mesh the
+// scene needs: a box from -1 to 1
+// --------------------------------------------------------
+void Game::CreateOccluderMeshes()
+{
+	occlusionCuller = new OcclusionCuller();
+
+	XMFLOAT3 positions[8];
+	for (int i = 0; i < 8; i++)
+		positions[i] = XMFLOAT3((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f);
+	unsigned int indices[36] = {
+		0, 2, 3, 0, 3, 1,	4, 5, 7, 4, 7, 6,	0, 1, 5, 0, 5, 4,
+		2, 6, 7, 2, 7, 3,	0, 4, 6, 0, 6, 2,	1, 3, 7, 1, 7, 5 };
+	occluderBoxMesh = occlusionCuller->AddMesh(positions, 8, indices, 36);
+}
 
+// --------------------------------------------------------
+// Creates the camera and the scene's lights
+// --------------------------------------------------------
+void Game::CreateCameraAndLights()
+{
 	// Create the camera
 	//camera = new Camera(x, y, z, aspectRatio, mouseLookSpeed);
 	camera = new Camera(0.0f, 0.0f, -5.0f, (float)(this->width / this->height), 2.0f);
@@ -133,62 +227,205 @@ void Game::Init()
 //    be verified against vertex shader byte code
 // - We'll have that byte code already loaded below
 // --------------------------------------------------------
-void Game::LoadShaders()
+void Game::LoadShaders(TaskGraph::TaskId entitiesReady)
 {
-	vertexShader = new SimpleVertexShader(device.Get(), context.Get(),
-		GetFullPathTo_Wide(L"VertexShader.cso").c_str());
-	pixelShader = new SimplePixelShader(device.Get(), context.Get(),
-		GetFullPathTo_Wide(L"PixelShader.cso").c_str());
+	// Shaders are loaded by the startup graph and show up a few frames later
+	//  - Until then, materials have no shaders and aren't drawn
+	//  - Each pair is handed out as soon as both halves are in
+	TaskGraph::TaskId vs = startupGraph->AddAsync("Load VertexShader", [this](std::function<void()> done)
+	{
+		assetLoader->LoadVertexShader(GetFullPathTo_Wide(L"VertexShader.cso"), [this, done](SimpleVertexShader* vs)
+		{
+			vertexShader = vs;
+			done();
+		});
+	});
+	TaskGraph::TaskId ps = startupGraph->AddAsync("Load PixelShader", [this](std::function<void()> done)
+	{
+		assetLoader->LoadPixelShader(GetFullPathTo_Wide(L"PixelShader.cso"), [this, done](SimplePixelShader* ps)
+		{
+			pixelShader = ps;
+			done();
+		});
+	});
+	TaskGraph::TaskId normalMapVS = startupGraph->AddAsync("Load NormalMapVS", [this](std::function<void()> done)
+	{
+		assetLoader->LoadVertexShader(GetFullPathTo_Wide(L"NormalMapVS.cso"), [this, done](SimpleVertexShader* vs)
+		{
+			vertexShaderNormalMap = vs;
+			done();
+		});
+	});
+	TaskGraph::TaskId normalMapPS = startupGraph->AddAsync("Load NormalMapPS", [this](std::function<void()> done)
+	{
+		assetLoader->LoadPixelShader(GetFullPathTo_Wide(L"NormalMapPS.cso"), [this, done](SimplePixelShader* ps)
+		{
+			pixelShaderNormalMap = ps;
+			done();
+		});
+	});
 
-	vertexShaderNormalMap = new SimpleVertexShader(device.Get(), context.Get(),
-		GetFullPathTo_Wide(L"NormalMapVS.cso").c_str());
-	pixelShaderNormalMap = new SimplePixelShader(device.Get(), context.Get(),
-		GetFullPathTo_Wide(L"NormalMapPS.cso").c_str());
+	startupGraph->Add("Assign shaders", [this]() { AssignLoadedShaders(); },
+		{ vs, ps, entitiesReady }, TaskThread::Main);
+	startupGraph->Add("Assign normal map shaders", [this]() { AssignLoadedShaders(); },
+		{ normalMapVS, normalMapPS, entitiesReady }, TaskThread::Main);
 }
 
+// --------------------------------------------------------
+// Gives any material that's still missing shaders the ones
+// it should use, if they've loaded
+//  - Materials with a normal map use the normal map shaders
+// --------------------------------------------------------
+void Game::AssignLoadedShaders()
+{
+	for (Material& material : materials)
+	{
+		bool normalMapped = material.GetNormalMap().Get() != nullptr;
 
+		if (!material.GetVertexShader())
+			material.SetVertexShader(normalMapped ? vertexShaderNormalMap : vertexShader);
+		if (!material.GetPixelShader())
+			material.SetPixelShader(normalMapped ? pixelShaderNormalMap : pixelShader);
+	}
+}
 
 // --------------------------------------------------------
-// Creates the geometry we're going to draw - a single triangle for now
+// The material of one of the entities Tab cycles through
 // --------------------------------------------------------
-void Game::CreateBasicGeometry()
+Material* Game::GetSceneMaterial(int sceneIndex)
 {
-	// Create some temporary variables to represent colors
-	// - Not necessary, just makes things more readable
-	XMFLOAT4 red = XMFLOAT4(1.0f, 0.0f, 0.0f, 1.0f);
-	XMFLOAT4 green = XMFLOAT4(0.0f, 1.0f, 0.0f, 1.0f);
-	XMFLOAT4 blue = XMFLOAT4(0.0f, 0.0f, 1.0f, 1.0f);
-
-	XMFLOAT3 normal = XMFLOAT3(0, 0, -1);
-	XMFLOAT2 uv = XMFLOAT2(0, 0);
-
-	// Texture releated init
-	CreateWICTextureFromFile(
-		device.Get(),
-		context.Get(),	// Passing in the context auto-generates mipmaps!!
-		GetFullPathTo_Wide(L"../../Assets/Textures/rock.png").c_str(),
-		nullptr,		// We don't need the texture ref ourselves
-		diffuseTexture1.GetAddressOf()); // We do need an SRV
-	CreateWICTextureFromFile(
-		device.Get(),
-		context.Get(),	// Passing in the context auto-generates mipmaps!!
-		GetFullPathTo_Wide(L"../../Assets/Textures/rock_normals.png").c_str(),
-		nullptr,		// We don't need the texture ref ourselves
-		normalMap1.GetAddressOf()); // We do need an SRV
-
-	CreateWICTextureFromFile(
-		device.Get(),
-		context.Get(),	// Passing in the context auto-generates mipmaps!!
-		GetFullPathTo_Wide(L"../../Assets/Textures/cushion.png").c_str(),
-		nullptr,		// We don't need the texture ref ourselves
-		diffuseTexture2.GetAddressOf()); // We do need an SRV
-	CreateWICTextureFromFile(
-		device.Get(),
-		context.Get(),	// Passing in the context auto-generates mipmaps!!
-		GetFullPathTo_Wide(L"../../Assets/Textures/cushion_normals.png").c_str(),
-		nullptr,		// We don't need the texture ref ourselves
-		normalMap2.GetAddressOf()); // We do need an SRV
+	return materials.Get(sceneMaterials[sceneIndex]);
+}
+
+// --------------------------------------------------------
+// Creates the stand-ins that entities use while their real
+// assets are loading
+//  - A unit cube, a plain white texture and a flat normal map
+// --------------------------------------------------------
+void Game::CreatePlaceholders()
+{
+	// One quad per face so each face gets its own normal
+	XMFLOAT3 faceNormals[6] = {
+		XMFLOAT3(0, 0, -1), XMFLOAT3(0, 0, 1),
+		XMFLOAT3(-1, 0, 0), XMFLOAT3(1, 0, 0),
+		XMFLOAT3(0, 1, 0), XMFLOAT3(0, -1, 0) };
+
+	Vertex verts[24];
+	unsigned int indices[36];
+	for (int f = 0; f < 6; f++)
+	{
+		// Build the face's "right" and "up" axes as seen from outside
+		XMVECTOR normal = XMLoadFloat3(&faceNormals[f]);
+		XMVECTOR up = faceNormals[f].y != 0 ? XMVectorSet(0, 0, 1, 0) : XMVectorSet(0, 1, 0, 0);
+		XMVECTOR right = XMVector3Cross(normal, up);
+		XMVECTOR center = normal * 0.5f;
+
+		XMFLOAT2 uvs[4] = { XMFLOAT2(0, 1), XMFLOAT2(0, 0), XMFLOAT2(1, 0), XMFLOAT2(1, 1) };
+		for (int c = 0; c < 4; c++)
+		{
+			XMVECTOR corner = center +
+				right * (uvs[c].x - 0.5f) +
+				up * (0.5f - uvs[c].y);
+
+			Vertex& v = verts[f * 4 + c];
+			XMStoreFloat3(&v.Position, corner);
+			v.Normal = faceNormals[f];
+			v.UV = uvs[c];
+		}
+
+		// Clockwise when viewed from outside
+		unsigned int base = f * 4;
+		unsigned int faceIndices[6] = { base, base + 1, base + 2, base, base + 2, base + 3 };
+		memcpy(&indices[f * 6], faceIndices, sizeof(faceIndices));
+	}
+	placeholderMesh = meshes.Create(verts, 24, indices, 36, device);
+
+	// 1x1 textures
+	CreateSolidColorTexture(0xFFFFFFFF, placeholderTexture);   // White
+	CreateSolidColorTexture(0xFFFF8080, placeholderNormalMap); // (0.5, 0.5, 1) - straight out
+}
+
+// --------------------------------------------------------
+// Makes a 1x1 RGBA8 texture of the given color
+//  - color is packed as 0xAABBGGRR
+// --------------------------------------------------------
+void Game::CreateSolidColorTexture(unsigned int color, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv)
+{
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = 1;
+	desc.Height = 1;
+	desc.MipLevels = 1;
+	desc.ArraySize = 1;
+	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_IMMUTABLE;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	D3D11_SUBRESOURCE_DATA data = {};
+	data.pSysMem = &color;
+	data.SysMemPitch = sizeof(unsigned int);
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	device->CreateTexture2D(&desc, &data, texture.GetAddressOf());
+	device->CreateShaderResourceView(texture.Get(), 0, srv.GetAddressOf());
+}
+
+
+
+// --------------------------------------------------------
+// Adds the startup tasks for the geometry we're going to draw
+//  - Returns the task that creates the entities, which
+//    the first frame needs
+// --------------------------------------------------------
+TaskGraph::TaskId Game::CreateBasicGeometry()
+{
+	// Device-only work can happen on any thread
+	TaskGraph::TaskId placeholders = startupGraph->Add("Placeholders", [this]() { CreatePlaceholders(); });
+	TaskGraph::TaskId sampler = startupGraph->Add("Sampler state", [this]() { CreateSamplerState(); });
+	TaskGraph::TaskId transparency = startupGraph->Add("Transparency states", [this]() { CreateTransparencyStates(); });
+	TaskGraph::TaskId entitiesReady = startupGraph->Add("Entities", [this]() { CreateEntities(); }, { placeholders, sampler, transparency });
+
+	// Request the real assets, which replace the placeholders as they arrive
+	//  - Cooked versions are used when the asset cooker has been run
+	//  - Shapes matter most, and normal maps least, for how
+	//    the scene looks while it's still loading
+	TaskGraph::TaskId rock = AddTextureLoad("Load rock", GetAssetPath(L"../../Assets/Textures/rock.png", L".dds"), diffuseTexture1, TaskPriority::Normal);
+	TaskGraph::TaskId rockNormals = AddTextureLoad("Load rock_normals", GetAssetPath(L"../../Assets/Textures/rock_normals.png", L".dds"), normalMap1, TaskPriority::Low);
+	TaskGraph::TaskId cushion = AddTextureLoad("Load cushion", GetAssetPath(L"../../Assets/Textures/cushion.png", L".dds"), diffuseTexture2, TaskPriority::Normal);
+	TaskGraph::TaskId cushionNormals = AddTextureLoad("Load cushion_normals", GetAssetPath(L"../../Assets/Textures/cushion_normals.png", L".dds"), normalMap2, TaskPriority::Low);
+
+	// Materials pick up their textures on the main thread, since
+	// they're in use for drawing by then
+	startupGraph->Add("Rock materials", [this]()
+	{
+		if (diffuseTexture1)
+		{
+			GetSceneMaterial(0)->SetSRV(diffuseTexture1.Get());
+			GetSceneMaterial(1)->SetSRV(diffuseTexture1.Get());
+		}
+		if (normalMap1)
+			GetSceneMaterial(0)->SetNormalMap(normalMap1.Get());
+	}, { rock, rockNormals, entitiesReady }, TaskThread::Main);
+	startupGraph->Add("Cushion material", [this]()
+	{
+		if (diffuseTexture2)
+			GetSceneMaterial(2)->SetSRV(diffuseTexture2.Get());
+		if (normalMap2)
+			GetSceneMaterial(2)->SetNormalMap(normalMap2.Get());
+	}, { cushion, cushionNormals, entitiesReady }, TaskThread::Main);
+
+	AddMeshLoad("Load sphere", GetAssetPath(L"../../Assets/Models/sphere.obj", L".cmesh"), 0);
+	AddMeshLoad("Load cube", GetAssetPath(L"../../Assets/Models/cube.obj", L".cmesh"), 1);
+	AddMeshLoad("Load helix", GetAssetPath(L"../../Assets/Models/helix.obj", L".cmesh"), 2);
+
+	return entitiesReady;
+}
 
+// --------------------------------------------------------
+// Creates the sampler state every material uses
+// --------------------------------------------------------
+void Game::CreateSamplerState()
+{
 	// Describe the sampler state that I want
 	D3D11_SAMPLER_DESC sampDesc = {};
 	sampDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
@@ -198,22 +435,170 @@ void Game::CreateBasicGeometry()
 	sampDesc.MaxAnisotropy = 16;
 	sampDesc.MaxLOD = D3D11_FLOAT32_MAX;
 	device->CreateSamplerState(&sampDesc, samplerOptions.GetAddressOf());
+}
+
+// --------------------------------------------------------
+// Transparent draws blend by their alpha over what's behind
+// them, and are depth tested against it without hiding each
+// other
+// --------------------------------------------------------
+void Game::CreateTransparencyStates()
+{
+	D3D11_BLEND_DESC blendDesc = {};
+	blendDesc.RenderTarget[0].BlendEnable = true;
+	blendDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;
+	blendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+	blendDesc.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
+	blendDesc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+	blendDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
+	blendDesc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+	blendDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+	device->CreateBlendState(&blendDesc, transparentBlendState.GetAddressOf());
+
+	D3D11_DEPTH_STENCIL_DESC depthDesc = {};
+	depthDesc.DepthEnable = true;
+	depthDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+	depthDesc.DepthFunc = D3D11_COMPARISON_LESS;
+	device->CreateDepthStencilState(&depthDesc, transparentDepthState.GetAddressOf());
+}
+
+// --------------------------------------------------------
+// Creates the entities, in the order sphere, cube, helix
+// --------------------------------------------------------
+void Game::CreateEntities()
+{
+	// Create some temporary variables to represent colors
+	// - Not necessary, just makes things more readable
+	XMFLOAT4 white = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 
+	// Every entity starts out as a placeholder
+	//  - They all share the placeholder mesh until their own loads
+	//  - Shaders are filled in by AssignLoadedShaders()
 	// mesh 1 - sphere
-	entities.push_back(new Entity(
-		new Mesh(GetFullPathTo("../../Assets/Models/sphere.obj").c_str(), device),
-		new Material(pixelShaderNormalMap, vertexShaderNormalMap, XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), 1.0f, diffuseTexture1.Get(), normalMap1.Get(), samplerOptions.Get())
-	));
+	sceneMaterials.push_back(materials.Create(nullptr, nullptr, white, 1.0f, placeholderTexture.Get(), placeholderNormalMap.Get(), samplerOptions.Get()));
 	// mesh 2 - cube
-	entities.push_back(new Entity(
-		new Mesh(GetFullPathTo("../../Assets/Models/cube.obj").c_str(), device),
-		new Material(pixelShader, vertexShader, XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), 1.0f, diffuseTexture1.Get(), samplerOptions.Get())
-	));
+	sceneMaterials.push_back(materials.Create(nullptr, nullptr, white, 1.0f, placeholderTexture.Get(), samplerOptions.Get()));
 	// mesh 3 - helix
-	entities.push_back(new Entity(
-		new Mesh(GetFullPathTo("../../Assets/Models/helix.obj").c_str(), device),
-		new Material(pixelShaderNormalMap, vertexShaderNormalMap, XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), 1.0f, diffuseTexture2.Get(), normalMap2.Get(), samplerOptions.Get())
-	));
+	sceneMaterials.push_back(materials.Create(nullptr, nullptr, white, 1.0f, placeholderTexture.Get(), placeholderNormalMap.Get(), samplerOptions.Get()));
+
+	// Each spins about its Y axis while it's selected
+	Mesh* placeholder = meshes.Get(placeholderMesh);
+	Velocity spin = { XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0.5f, 0) };
+	for (int i = 0; i < 3; i++)
+	{
+		EntityId entity = world->Create(
+			TransformComponent{ transformSystem->Create() },
+			MeshComponent{ placeholderMesh },
+			MaterialComponent{ sceneMaterials[i] },
+			LocalBounds{ placeholder->GetBoundsCenter(), placeholder->GetBoundsRadius() },
+			Bounds{ placeholder->GetBoundsCenter(), placeholder->GetBoundsRadius() },
+			RenderHistory{},
+			CullHistory{},
+			LODSelector::MakeState(&placeholder->GetLOD(0), placeholder->GetLODCount(), placeholder->GetBoundsRadius()),
+			spin);
+		sceneEntities.push_back(entity);
+
+		// They all move, so they go in the grid
+		SpatialLayer layer = SpatialLayer::Dynamic;
+		SpatialProxy proxy = spatialLayers[(int)layer]->Insert(entity, placeholder->GetBoundsCenter(), placeholder->GetBoundsRadius());
+		world->Add(entity, SpatialComponent{ proxy, layer });
+	}
+	world->Add(sceneEntities[currentEntity], Selected());
+
+	// The largest box inside a cube's bounding sphere is the cube
+	// itself, so it can hide things
+	world->Add(sceneEntities[1], Occluder{ occluderBoxMesh });
+}
+
+// --------------------------------------------------------
+// Adds a startup task that loads a texture into srv
+// --------------------------------------------------------
+TaskGraph::TaskId Game::AddTextureLoad(const std::string& name, std::wstring path, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv, TaskPriority priority)
+{
+	return startupGraph->AddAsync(name, [this, path, &srv, priority](std::function<void()> done)
+	{
+		assetLoader->LoadTexture(path, [&srv, done](Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> loaded)
+		{
+			srv = loaded;
+			done();
+		}, priority);
+	});
+}
+
+// --------------------------------------------------------
+// Adds a startup task that loads a mesh for one entity
+//  - Doesn't need to wait on the entities, since load
+//    callbacks only run in UpdateMainThread(), after Init()
+//    has made them
+//  - The mesh goes into the pool here, on the window's thread,
+//    and the entity is pointed at it by the simulation
+// --------------------------------------------------------
+TaskGraph::TaskId Game::AddMeshLoad(const std::string& name, std::wstring path, int entityIndex)
+{
+	return startupGraph->AddAsync(name, [this, path, entityIndex](std::function<void()> done)
+	{
+		assetLoader->LoadMesh(path, [this, entityIndex, done](Mesh* mesh)
+		{
+			if (mesh)
+			{
+				// The pool keeps its own copy, which shares the GPU buffers
+				MeshHandle handle = meshes.Create(std::move(*mesh));
+				Mesh* pooled = meshes.Get(handle);
+				LocalBounds local = { pooled->GetBoundsCenter(), pooled->GetBoundsRadius() };
+				LODState lods = LODSelector::MakeState(&pooled->GetLOD(0), pooled->GetLODCount(), pooled->GetBoundsRadius());
+
+				RunOnSimulation([this, entityIndex, handle, local, lods]()
+				{
+					EntityId entity = sceneEntities[entityIndex];
+					MeshComponent* meshRef = world->Get<MeshComponent>(entity);
+					LocalBounds* localBounds = world->Get<LocalBounds>(entity);
+					LODState* lodState = world->Get<LODState>(entity);
+					if (meshRef && localBounds && lodState)
+					{
+						meshRef->mesh = handle;
+						*localBounds = local;
+						*lodState = lods;
+					}
+				});
+			}
+			delete mesh;
+			done();
+		}, TaskPriority::High);
+	});
+}
+
+// --------------------------------------------------------
+// Maps a source asset path to the asset cooker's output
+//  - "Assets/Textures/rock.png" -> "Assets/Cooked/Textures/rock.dds"
+//  - Returns an empty string if the path isn't under Assets/
+// --------------------------------------------------------
+static std::wstring GetCookedAssetPath(std::wstring relativePath, std::wstring cookedExtension)
+{
+	size_t assets = relativePath.find(L"Assets/");
+	size_t dot = relativePath.find_last_of(L'.');
+	if (assets == std::wstring::npos || dot == std::wstring::npos || dot < assets)
+		return std::wstring();
+
+	return
+		relativePath.substr(0, assets + 7) + L"Cooked/" +
+		relativePath.substr(assets + 7, dot - assets - 7) + cookedExtension;
+}
+
+// --------------------------------------------------------
+// Picks the cooked version of an asset if the asset cooker
+// has made one, otherwise the source file
+// --------------------------------------------------------
+std::wstring Game::GetAssetPath(std::wstring relativePath, std::wstring cookedExtension)
+{
+	std::wstring cookedPath = GetCookedAssetPath(relativePath, cookedExtension);
+	if (!cookedPath.empty())
+	{
+		std::wstring fullCookedPath = GetFullPathTo_Wide(cookedPath);
+		if (GetFileAttributesW(fullCookedPath.c_str()) != INVALID_FILE_ATTRIBUTES)
+			return fullCookedPath;
+	}
+
+	return GetFullPathTo_Wide(relativePath);
 }
 
 
@@ -226,36 +611,434 @@ void Game::OnResize()
 	// Handle base-level DX resize stuff
 	DXCore::OnResize();
 
-	// update the camera
-	if(camera != 0)
-		camera->UpdateProjectionMatrix((float)(this->width / this->height));
+	// The camera belongs to the simulation, which picks this up
+	pendingAspectRatio = (float)(this->width / this->height);
+	screenHeight = (float)this->height;
 }
 
 // --------------------------------------------------------
-// Update your game here - user input, move objects, AI, etc.
+// Per-frame work that has to happen on the window's thread,
+// wherever Update() is running
 // --------------------------------------------------------
-void Game::Update(float deltaTime, float totalTime)
+void Game::UpdateMainThread(float deltaTime, float totalTime)
 {
 	// Quit if the escape key is pressed
 	if (GetAsyncKeyState(VK_ESCAPE))
 		Quit();
 
-	bool currentTab = (GetAsyncKeyState(VK_TAB) & 0x8000) != 0;
-	if (currentTab && !prevTab)
+	// Finish off any loaded assets, within our time budget, and
+	// whatever startup tasks were waiting on them
+	assetLoader->Update(assetLoadBudget);
+	startupGraph->RunMainThreadTasks();
+	if (!fullyLoadedReported && startupGraph->IsFinished())
 	{
-		currentEntity++;
-		currentEntity %= entities.size();
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - loadStartTime;
+		startupGraph->PrintReport();
+		printf("Time to fully loaded: %.2fms\n", elapsed.count());
+		fullyLoadedReported = true;
 	}
 
-	// Save state for next frame
-	prevTab = currentTab;
+	PollKeys(mainThreadKeys);
+}
+
+// --------------------------------------------------------
+// The simulation is the job system's main thread, so it
+// can wait on jobs, wherever it's running
+// --------------------------------------------------------
+void Game::OnSimulationThreadChanged()
+{
+	jobSystem->SetMainThread();
+}
 
-	// Rotate
-	entities[currentEntity]->GetTransform()->Rotate(0, 0.5f * deltaTime, 0);
-	entities[currentEntity]->GetTransform()->CreateWorldMatrix();
+void Game::RunOnSimulation(std::function<void()> command)
+{
+	std::lock_guard<std::mutex> lock(simulationCommandMutex);
+	simulationCommands.push_back(command);
+}
+
+// --------------------------------------------------------
+// What each key does when it's pressed
+//  - Whatever touches the simulation's state goes in
+//    simulationKeys; the threading toggle and the stats for
+//    what the window's thread owns go in mainThreadKeys
+// --------------------------------------------------------
+void Game::CreateKeyActions()
+{
+	simulationKeys = {
+		// Benchmarks
+		{ 'B', [this]() { RunTransformBenchmark(jobSystem); } },
+		{ 'E', [this]() { RunECSBenchmark(jobSystem); } },
+		{ 'V', [this]() { RunBVHBenchmark(); } },
+		{ 'G', [this]() { RunSpatialIndexBenchmark(); } },
+		{ 'C', [this]() { RunCullingBenchmark(jobSystem); } },
+		{ 'P', [this]() { RunOcclusionBenchmark(jobSystem); } },
+		{ 'R', [this]() { RunRayCastBenchmark(jobSystem); } },
+		{ 'Y', [this]() { RunRayQueryBenchmark(jobSystem); } },
+		{ 'K', [this]() { RunPVSBenchmark(jobSystem); } },
+
+		// Show how culling has been doing since the last time
+		{ 'O', [this]()
+		{
+			visibilityCache->PrintStats();
+			visibilityCache->ResetStats();
+			occlusionCuller->PrintStats();
+			occlusionCuller->ResetStats();
+		} },
+
+		// Show what level of detail selection has been saving
+		{ 'L', [this]() { lodSelector->PrintStats(); lodSelector->ResetStats(); } },
+
+		// Show how the job system has been doing since the last time
+		{ 'J', [this]() { jobSystem->PrintStats(); jobSystem->ResetStats(); } },
+
+		// Tab moves the selection on to the next entity
+		{ VK_TAB, [this]()
+		{
+			world->Remove<Selected>(sceneEntities[currentEntity]);
+			currentEntity++;
+			currentEntity %= sceneEntities.size();
+			world->Add(sceneEntities[currentEntity], Selected());
+		} },
+	};
+
+	mainThreadKeys = {
+		// T moves the simulation onto its own thread and back,
+		// reporting on the mode being left
+		{ 'T', [this]() { PrintThreadingStats(); SetThreadedSimulation(!IsSimulationThreaded()); } },
+
+		// Show what the frame scheduler's working on, and how much
+		// of its budget it's been using
+		{ 'F', [this]() { frameScheduler->PrintStats(); frameScheduler->ResetStats(); } },
+
+		// Show how much sorting the draws saves in state changes
+		{ 'Q', [this]() { renderQueue->PrintStats(); renderQueue->ResetStats(); } },
+
+		// Show how many binds the state cache has been skipping
+		{ 'N', [this]() { stateCache->PrintStats(); stateCache->ResetStats(); } },
+	};
+}
+
+// --------------------------------------------------------
+// Runs the action of each key that's gone down since the
+// last poll, so holding a key only does it once
+// --------------------------------------------------------
+void Game::PollKeys(std::vector<KeyAction>& keys)
+{
+	for (KeyAction& key : keys)
+	{
+		bool down = (GetAsyncKeyState(key.key) & 0x8000) != 0;
+		if (down && !key.wasDown)
+			key.action();
+		key.wasDown = down;
+	}
+}
+
+// --------------------------------------------------------
+// Prints frames and updates per second, and the average time
+// from an update reading input to its results being presented,
+// since the threading mode last changed
+// --------------------------------------------------------
+void Game::PrintThreadingStats()
+{
+	std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
+	std::chrono::duration<double> elapsed = now - modeStartTime;
+	unsigned long long updates = simulationUpdates.load() - modeStartUpdates;
+	double seconds = elapsed.count() > 0.0 ? elapsed.count() : 1.0;
+
+	printf("---- %s simulation, last %.1fs ----\n", IsSimulationThreaded() ? "Threaded" : "Single-threaded", elapsed.count());
+	printf("Frames:  %9.1f/s\n", modeFrames / seconds);
+	printf("Updates: %9.1f/s\n", updates / seconds);
+	printf("Input to present: %.2fms average\n", modeLatencySamples > 0 ? modeLatencyMs / modeLatencySamples : 0.0);
+
+	modeStartTime = now;
+	modeStartUpdates = simulationUpdates.load();
+	modeFrames = 0;
+	modeLatencyMs = 0.0;
+	modeLatencySamples = 0;
+}
+
+// --------------------------------------------------------
+// Update your game here - user input, move objects, AI, etc.
+//  - May be on its own thread (see SetThreadedSimulation()),
+//    so it only touches what the simulation owns, and
+//    finishes by publishing a snapshot for Draw()
+// --------------------------------------------------------
+void Game::Update(float deltaTime, float totalTime)
+{
+	// When this update read its input, for measuring latency
+	std::chrono::high_resolution_clock::time_point inputTime = std::chrono::high_resolution_clock::now();
+
+	// Catch up on what the window's thread has sent over
+	std::vector<std::function<void()>> commands;
+	{
+		std::lock_guard<std::mutex> lock(simulationCommandMutex);
+		commands.swap(simulationCommands);
+	}
+	for (std::function<void()>& command : commands)
+		command();
+
+	float aspectRatio = pendingAspectRatio.exchange(0.0f);
+	if (aspectRatio > 0.0f)
+		camera->UpdateProjectionMatrix(aspectRatio);
+
+	PollKeys(simulationKeys);
+
+	// Move, then rebuild the world matrices of everything that
+	// moved, then the bounds that depend on them, and the BVH
+	// that depends on those
+	MoveEntities(deltaTime);
+	transformSystem->Update(jobSystem);
+	UpdateBounds();
+	UpdateSpatialIndex();
 
 	// Update the camera
 	camera->Update(deltaTime, this->hWnd);
+
+	// Hand what Draw() needs over to the window's thread
+	RenderSnapshot& snapshot = snapshots.GetBack();
+	snapshot.update = ++simulationUpdates;
+	snapshot.time = totalTime;
+	snapshot.timeStep = deltaTime;
+	snapshot.inputTime = inputTime;
+	BuildSnapshot(snapshot);
+	snapshots.Publish();
+}
+
+// --------------------------------------------------------
+// Applies each selected entity's velocity to its transform
+//  - Each chunk only touches its own transforms, so the
+//    chunks can go to different threads
+// --------------------------------------------------------
+void Game::MoveEntities(float deltaTime)
+{
+	world->ParallelForEachChunk<TransformComponent, Velocity, Selected>(jobSystem,
+		[this, deltaTime](unsigned int count, EntityId* entities, TransformComponent* transforms, Velocity* velocities, Selected* selected)
+	{
+		for (unsigned int i = 0; i < count; i++)
+		{
+			XMFLOAT3 linear = velocities[i].linear;
+			XMFLOAT3 angular = velocities[i].angular;
+			transformSystem->MoveAbsolute(transforms[i].handle, linear.x * deltaTime, linear.y * deltaTime, linear.z * deltaTime);
+			transformSystem->Rotate(transforms[i].handle, angular.x * deltaTime, angular.y * deltaTime, angular.z * deltaTime);
+		}
+	});
+}
+
+// --------------------------------------------------------
+// Moves each mesh's bounding sphere into world space
+//  - The radius grows by the largest scale on any axis, so
+//    the sphere still holds the mesh under non-uniform scale
+// --------------------------------------------------------
+void Game::UpdateBounds()
+{
+	world->ParallelForEachChunk<TransformComponent, LocalBounds, Bounds>(jobSystem,
+		[this](unsigned int count, EntityId* entities, TransformComponent* transforms, LocalBounds* localBounds, Bounds* bounds)
+	{
+		for (unsigned int i = 0; i < count; i++)
+		{
+			XMFLOAT4X4 m4World = transformSystem->GetWorldMatrix(transforms[i].handle);
+			XMMATRIX entityWorld = XMLoadFloat4x4(&m4World);
+			XMStoreFloat3(&bounds[i].center, XMVector3TransformCoord(XMLoadFloat3(&localBounds[i].center), entityWorld));
+
+			float scaleSq = XMVectorGetX(XMVectorMax(XMVector3LengthSq(entityWorld.r[0]),
+				XMVectorMax(XMVector3LengthSq(entityWorld.r[1]), XMVector3LengthSq(entityWorld.r[2]))));
+			bounds[i].radius = localBounds[i].radius * sqrtf(scaleSq);
+		}
+	});
+}
+
+// --------------------------------------------------------
+// Moves each entity's entry in its layer's index to its new
+// bounds, then lets each index catch up (the BVH refits)
+//  - Single threaded, since Move() writes into each index's
+//    shared arrays
+// --------------------------------------------------------
+void Game::UpdateSpatialIndex()
+{
+	world->ForEachChunk<Bounds, SpatialComponent>(
+		[this](unsigned int count, EntityId* entities, Bounds* bounds, SpatialComponent* spatial)
+	{
+		for (unsigned int i = 0; i < count; i++)
+			spatialLayers[(int)spatial[i].layer]->Move(spatial[i].proxy, bounds[i].center, bounds[i].radius);
+	});
+	for (SpatialIndex* layer : spatialLayers)
+		layer->Update();
+}
+
+// --------------------------------------------------------
+// Copies out everything Draw() needs: each selected entity
+// that has something to draw with and is in view and not
+// hidden behind an occluder, the camera and the lights
+//  - Along with where each was in the last snapshot, which
+//    Draw() blends from
+//  - Culling numbers the candidates in the order the chunks
+//    are visited, and the second pass visits the same chunks
+//    in the same order, picking out the visible ones
+//  - Reuses the snapshot's vectors, so nothing is allocated
+//    once they've grown to size
+// --------------------------------------------------------
+void Game::BuildSnapshot(RenderSnapshot& snapshot)
+{
+	// Only what the visibility cache can't answer goes to the
+	// frustum culler; either way, each candidate's index is its
+	// place in the order ForEachChunk visits them, so both
+	// passes have to ask for the same components
+	const Frustum& frustum = camera->GetFrustum();
+	visibilityCache->BeginFrame(frustum, camera->GetTransform()->GetPosition());
+	entityCuller->Clear();
+	testedEntities.clear();
+	reusedVisible.clear();
+	occludeeBoxes.clear();
+	world->ForEachChunk<TransformComponent, MeshComponent, MaterialComponent, RenderHistory, CullHistory, LODState, Bounds, Selected>(
+		[this](unsigned int count, EntityId* entities, TransformComponent* transforms, MeshComponent* meshRefs, MaterialComponent* materialRefs, RenderHistory* history, CullHistory* cullHistory, LODState* lodStates, Bounds* bounds, Selected* selected)
+	{
+		for (unsigned int i = 0; i < count; i++)
+		{
+			unsigned int candidate = (unsigned int)occludeeBoxes.size();
+			bool visible;
+			if (visibilityCache->Check(cullHistory[i], bounds[i].center, bounds[i].radius, visible))
+			{
+				if (visible)
+					reusedVisible.push_back(candidate);
+			}
+			else
+			{
+				entityCuller->Add(bounds[i].center, bounds[i].radius, candidate);
+				testedEntities.push_back(candidate);
+			}
+			occludeeBoxes.push_back(MakeAABB(bounds[i].center, bounds[i].radius));
+		}
+	});
+	entityCuller->Cull(frustum, visibleEntities, cullMargins, jobSystem);
+
+	// Both are in candidate order, so they merge into one that is
+	if (!reusedVisible.empty())
+	{
+		size_t testedVisible = visibleEntities.size();
+		visibleEntities.insert(visibleEntities.end(), reusedVisible.begin(), reusedVisible.end());
+		std::inplace_merge(visibleEntities.begin(), visibleEntities.begin() + testedVisible, visibleEntities.end());
+	}
+	CullOccluded();
+
+	lodSelector->SetScreenHeight(screenHeight);
+	lodSelector->BeginFrame(camera->GetProjection(), camera->GetTransform()->GetPosition(), lastFrameMs);
+
+	snapshot.items.clear();
+	unsigned int candidate = 0;
+	unsigned int nextTested = 0;
+	unsigned int nextVisible = 0;
+	world->ForEachChunk<TransformComponent, MeshComponent, MaterialComponent, RenderHistory, CullHistory, LODState, Bounds, Selected>(
+		[this, &snapshot, &candidate, &nextTested, &nextVisible](unsigned int count, EntityId* entities, TransformComponent* transforms, MeshComponent* meshRefs, MaterialComponent* materialRefs, RenderHistory* history, CullHistory* cullHistory, LODState* lodStates, Bounds* bounds, Selected* selected)
+	{
+		for (unsigned int i = 0; i < count; i++, candidate++)
+		{
+			// Keep what the frustum said for next time
+			if (nextTested < testedEntities.size() && testedEntities[nextTested] == candidate)
+			{
+				visibilityCache->Record(cullHistory[i], bounds[i].center, bounds[i].radius, cullMargins[nextTested]);
+				nextTested++;
+			}
+
+			if (nextVisible == visibleEntities.size() || visibleEntities[nextVisible] != candidate)
+				continue;
+			nextVisible++;
+
+			RenderItem item;
+			item.mesh = meshRefs[i].mesh;
+			item.material = materialRefs[i].material;
+			item.lod = lodSelector->Select(lodStates[i], bounds[i].center, bounds[i].radius);
+			item.world = transformSystem->GetWorldMatrix(transforms[i].handle);
+
+			// Nothing to blend from if it wasn't in the last snapshot
+			bool drawnLastUpdate = history[i].update != 0 && history[i].update + 1 == snapshot.update;
+			item.previousWorld = drawnLastUpdate ? history[i].world : item.world;
+			history[i].world = item.world;
+			history[i].update = snapshot.update;
+
+			snapshot.items.push_back(item);
+		}
+	});
+
+	snapshot.previousView = previousView;
+	snapshot.view = camera->GetView();
+	snapshot.projection = camera->GetProjection();
+	snapshot.previousCameraPosition = previousCameraPosition;
+	snapshot.cameraPosition = camera->GetTransform()->GetPosition();
+	previousView = snapshot.view;
+	previousCameraPosition = snapshot.cameraPosition;
+
+	snapshot.directionalLights = dLights;
+	snapshot.pointLights = pLights;
+}
+
+// --------------------------------------------------------
+// Rasterizes the occluders that are being drawn, then drops
+// whatever they hide from visibleEntities
+//  - Only drawn (selected) entities can occlude; anything else
+//    would hide things behind nothing
+//  - An occluder sits inside its own bounds, so it can't hide
+//    itself; with fewer than two entities left there's nothing
+//    to gain, and nothing is rasterized. That's every frame in
+//    this scene, which only draws the selected entity, so the
+//    occlusion benchmark (P) is what exercises the culler
+// --------------------------------------------------------
+void Game::CullOccluded()
+{
+	if (visibleEntities.size() < 2)
+		return;
+
+	XMFLOAT4X4 view = camera->GetView();
+	XMFLOAT4X4 projection = camera->GetProjection();
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, XMLoadFloat4x4(&view) * XMLoadFloat4x4(&projection));
+	occlusionCuller->BeginFrame(viewProjection);
+
+	world->ForEachChunk<TransformComponent, LocalBounds, Occluder, Selected>(
+		[this](unsigned int count, EntityId* entities, TransformComponent* transforms, LocalBounds* localBounds, Occluder* occluders, Selected* selected)
+	{
+		for (unsigned int i = 0; i < count; i++)
+		{
+			// From -1..1 to the box inside the local bounding sphere
+			float halfSize = localBounds[i].radius / sqrtf(3.0f);
+			XMFLOAT3 center = localBounds[i].center;
+			XMFLOAT4X4 entityWorld = transformSystem->GetWorldMatrix(transforms[i].handle);
+			XMFLOAT4X4 occluderWorld;
+			XMStoreFloat4x4(&occluderWorld,
+				XMMatrixScaling(halfSize, halfSize, halfSize) *
+				XMMatrixTranslation(center.x, center.y, center.z) *
+				XMLoadFloat4x4(&entityWorld));
+			occlusionCuller->AddOccluder(occluders[i].mesh, occluderWorld);
+		}
+	});
+
+	occlusionCuller->Rasterize(jobSystem);
+	occlusionCuller->Cull(occludeeBoxes.data(), visibleEntities, jobSystem);
+}
+
+// --------------------------------------------------------
+// Blends between two matrices made of a scale, a rotation and
+// a translation - scales and translations linearly, and
+// rotations along the shortest arc
+//  - Just returns b if there's nothing to blend, or if either
+//    won't decompose (a zero scale, say)
+// --------------------------------------------------------
+static XMMATRIX InterpolateMatrix(const XMFLOAT4X4& a, const XMFLOAT4X4& b, float t)
+{
+	XMMATRIX matrixB = XMLoadFloat4x4(&b);
+	if (t >= 1.0f || memcmp(&a, &b, sizeof(XMFLOAT4X4)) == 0)
+		return matrixB;
+
+	XMVECTOR scaleA, rotationA, translationA;
+	XMVECTOR scaleB, rotationB, translationB;
+	if (!XMMatrixDecompose(&scaleA, &rotationA, &translationA, XMLoadFloat4x4(&a)) ||
+		!XMMatrixDecompose(&scaleB, &rotationB, &translationB, matrixB))
+		return matrixB;
+
+	return XMMatrixAffineTransformation(
+		XMVectorLerp(scaleA, scaleB, t),
+		XMVectorZero(),
+		XMQuaternionSlerp(rotationA, rotationB, t),
+		XMVectorLerp(translationA, translationB, t));
 }
 
 // --------------------------------------------------------
@@ -289,57 +1072,149 @@ void Game::Draw(float deltaTime, float totalTime)
 	// - However, this isn't always the case (but might be for this course)
 	//context->IASetInputLayout(inputLayout.Get()); // Removed due to SimpleShader implementation
 
-	currentPS = entities[currentEntity]->GetMaterial()->GetPixelShader();
-	currentVS = entities[currentEntity]->GetMaterial()->GetVertexShader();
+	// The simulation biases levels of detail by how long frames take
+	lastFrameMs = deltaTime * 1000.0f;
+
+	// Draw the newest snapshot the simulation has published, or
+	// the last one again if it hasn't finished another since
+	bool newSnapshot = snapshots.Consume();
+	RenderSnapshot& snapshot = snapshots.GetFront();
 
-	// Activate the current material's shaders
-	currentVS->SetShader();
-	currentPS->SetShader();
+	// Draw things as they were one time step ago: between the
+	// snapshot's two updates, as far along as we are past the
+	// newer one
+	float alpha = snapshot.timeStep > 0.0f ? (totalTime - snapshot.time) / snapshot.timeStep : 1.0f;
+	alpha = max(0.0f, min(alpha, 1.0f));
 
-	currentPS->SetData("dLight1", &dLights[0], sizeof(DirectionalLight));
-	currentPS->SetData("pLight1", &pLights[0], sizeof(PointLight));
-	currentPS->SetFloat3("cameraPosition", camera->GetTransform()->GetPosition());
-	currentPS->SetFloat("specInt", entities[currentEntity]->GetMaterial()->GetSpecularIntensity());
-	currentPS->CopyAllBufferData();
+	// The camera blends in world space, where it actually moves
+	XMFLOAT4X4 previousCameraWorld, cameraWorld;
+	XMStoreFloat4x4(&previousCameraWorld, XMMatrixInverse(0, XMLoadFloat4x4(&snapshot.previousView)));
+	XMStoreFloat4x4(&cameraWorld, XMMatrixInverse(0, XMLoadFloat4x4(&snapshot.view)));
+	XMFLOAT4X4 view;
+	XMStoreFloat4x4(&view, XMMatrixInverse(0, InterpolateMatrix(previousCameraWorld, cameraWorld, alpha)));
+	XMFLOAT3 cameraPosition;
+	XMStoreFloat3(&cameraPosition, XMVectorLerp(XMLoadFloat3(&snapshot.previousCameraPosition), XMLoadFloat3(&snapshot.cameraPosition), alpha));
 
-	currentPS->SetShaderResourceView("diffuseTexture", entities[currentEntity]->GetMaterial()->GetSRV().Get());
-	// check for normal map
-	if (entities[currentEntity]->GetMaterial()->GetNormalMap().Get() != nullptr)
+	// Queue everything that can be drawn, then sort it by state
+	//  - Depth is view-space z, measured between the projection's
+	//    near and far planes
+	const XMFLOAT4X4& projection = snapshot.projection;
+	float nearZ = -projection._43 / projection._33;
+	float farZ = projection._43 / (1.0f - projection._33);
+	renderQueue->Begin(nearZ, farZ);
+	for (unsigned int i = 0; i < snapshot.items.size(); i++)
 	{
-		currentPS->SetShaderResourceView("normalMap", entities[currentEntity]->GetMaterial()->GetNormalMap().Get());
+		RenderItem& item = snapshot.items[i];
+		Material* material = materials.Get(item.material);
+		Mesh* mesh = meshes.Get(item.mesh);
+		if (!material || !mesh || mesh->GetLODCount() == 0)
+			continue;
+
+		// Nothing can be drawn until the material's shaders have loaded
+		if (!material->GetVertexShader() || !material->GetPixelShader())
+			continue;
+
+		float depth =
+			item.world._41 * view._13 +
+			item.world._42 * view._23 +
+			item.world._43 * view._33 +
+			view._43;
+		renderQueue->Add(
+			material->IsTransparent() ? RenderPass::Transparent : RenderPass::Opaque,
+			renderQueue->GetShaderId(material->GetVertexShader(), material->GetPixelShader()),
+			item.material.index,
+			item.mesh.index,
+			depth,
+			i);
+	}
+	renderQueue->Sort();
+
+	// Then draw in that order, only setting what's changed since
+	// the draw before
+	//  - Per-frame values go in when the shaders change, and the
+	//    material's whenever the shaders or the material do
+	const QueuedDraw* last = 0;
+	for (unsigned int i = 0; i < renderQueue->GetCount(); i++)
+	{
+		const QueuedDraw& draw = renderQueue->Get(i);
+		RenderItem& item = snapshot.items[draw.item];
+		Material* material = materials.Get(item.material);
+		Mesh* mesh = meshes.Get(item.mesh);
+
+		// Transparent draws come after every opaque one
+		if (draw.pass == RenderPass::Transparent && (!last || last->pass != RenderPass::Transparent))
+		{
+			context->OMSetBlendState(transparentBlendState.Get(), 0, 0xFFFFFFFF);
+			context->OMSetDepthStencilState(transparentDepthState.Get(), 0);
+		}
+
+		bool shaderChanged = !last || draw.shader != last->shader;
+		if (shaderChanged)
+		{
+			currentPS = material->GetPixelShader();
+			currentVS = material->GetVertexShader();
+
+			// Activate the current material's shaders
+			currentVS->SetShader();
+			currentPS->SetShader();
+
+			currentVS->SetMatrix4x4("view", view);
+			currentVS->SetMatrix4x4("projection", snapshot.projection);
+			currentPS->SetData("dLight1", &snapshot.directionalLights[0], sizeof(DirectionalLight));
+			currentPS->SetData("pLight1", &snapshot.pointLights[0], sizeof(PointLight));
+			currentPS->SetFloat3("cameraPosition", cameraPosition);
+		}
+
+		if (shaderChanged || draw.material != last->material)
+		{
+			currentPS->SetFloat("specInt", material->GetSpecularIntensity());
+			currentPS->CopyAllBufferData();
+
+			currentPS->SetShaderResourceView("diffuseTexture", material->GetSRV().Get());
+			// check for normal map
+			if (material->GetNormalMap().Get() != nullptr)
+			{
+				currentPS->SetShaderResourceView("normalMap", material->GetNormalMap().Get());
+			}
+			currentPS->SetSamplerState("samplerOptions", material->GetSamplerState().Get());
+
+			currentVS->SetFloat4("colorTint", material->GetColorTint());
+		}
+
+		XMMATRIX itemWorld = InterpolateMatrix(item.previousWorld, item.world, alpha);
+		XMFLOAT4X4 m4World, m4WorldInverseTranspose;
+		XMStoreFloat4x4(&m4World, itemWorld);
+		XMStoreFloat4x4(&m4WorldInverseTranspose, XMMatrixTranspose(XMMatrixInverse(0, itemWorld)));
+		currentVS->SetMatrix4x4("world", m4World);
+		currentVS->SetMatrix4x4("worldInverseTranspose", m4WorldInverseTranspose);
+		currentVS->CopyAllBufferData();
+
+		// Set buffers in the input assembler
+		//  - The state cache skips them unless the mesh changed,
+		//    which sorting keeps rare
+		stateCache->SetVertexBuffer(0, mesh->GetVertexBuffer().Get(), sizeof(Vertex), 0);
+		stateCache->SetIndexBuffer(mesh->GetIndexBuffer().Get(), DXGI_FORMAT_R32_UINT, 0);
+
+		//  - Do this ONCE PER OBJECT you intend to draw
+		//  - This will use all of the currently set DirectX "stuff" (shaders, buffers, etc)
+		//  - DrawIndexed() uses the currently set INDEX BUFFER to look up corresponding
+		//     vertices in the currently set VERTEX BUFFER
+		//  - Each level of detail is its own range of the index buffer
+		const MeshLOD& lod = mesh->GetLOD(min(item.lod, mesh->GetLODCount() - 1));
+		context->DrawIndexed(
+			lod.indexCount,     // The number of indices to use (we could draw a subset if we wanted)
+			lod.firstIndex,     // Offset to the first index we want to use
+			0);    // Offset to add to each index when looking up vertices
+
+		last = &draw;
+	}
+
+	// Back to the default states for the next frame's opaque draws
+	if (last && last->pass == RenderPass::Transparent)
+	{
+		context->OMSetBlendState(0, 0, 0xFFFFFFFF);
+		context->OMSetDepthStencilState(0, 0);
 	}
-	currentPS->SetSamplerState("samplerOptions", entities[currentEntity]->GetMaterial()->GetSamplerState().Get());
-
-
-	// Collecting data locally
-	SimpleVertexShader* vsData = currentVS;
-	vsData->SetFloat4("colorTint", entities[currentEntity]->GetMaterial()->GetColorTint());
-	vsData->SetMatrix4x4("world", entities[currentEntity]->GetTransform()->GetWorldMatrix());
-	vsData->SetMatrix4x4("view", camera->GetView());
-	vsData->SetMatrix4x4("projection", camera->GetProjection());
-
-	vsData->CopyAllBufferData();
-
-	// Set buffers in the input assembler
-	//  - Do this ONCE PER OBJECT you're drawing, since each object might
-	//    have different geometry.
-	//  - for this demo, this step *could* simply be done once during Init(),
-	//    but I'm doing it here because it's often done multiple times per frame
-	//    in a larger application/game
-	UINT stride = sizeof(Vertex);
-	UINT offset = 0;
-
-	
-	context->IASetVertexBuffers(0, 1, entities[currentEntity]->GetMesh()->GetVertexBuffer().GetAddressOf(), &stride, &offset);
-	context->IASetIndexBuffer(entities[currentEntity]->GetMesh()->GetIndexBuffer().Get(), DXGI_FORMAT_R32_UINT, 0);
-	//  - Do this ONCE PER OBJECT you intend to draw
-	//  - This will use all of the currently set DirectX "stuff" (shaders, buffers, etc)
-	//  - DrawIndexed() uses the currently set INDEX BUFFER to look up corresponding
-	//     vertices in the currently set VERTEX BUFFER
-	context->DrawIndexed(
-		entities[currentEntity]->GetMesh()->GetIndexCount(),     // The number of indices to use (we could draw a subset if we wanted)
-		0,     // Offset to the first index we want to use
-		0);    // Offset to add to each index when looking up vertices
 
 
 	// Present the back buffer to the user
@@ -347,6 +1222,23 @@ void Game::Draw(float deltaTime, float totalTime)
 	//  - Do this exactly ONCE PER FRAME (always at the very end of the frame)
 	swapChain->Present(0, 0);
 
+	// Count how long the snapshot's input took to get on screen,
+	// the first time it's shown
+	modeFrames++;
+	if (newSnapshot)
+	{
+		std::chrono::duration<double, std::milli> latency = std::chrono::high_resolution_clock::now() - snapshot.inputTime;
+		modeLatencyMs += latency.count();
+		modeLatencySamples++;
+	}
+
+	if (!firstFrameReported)
+	{
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - loadStartTime;
+		printf("Time to first frame: %.2fms\n", elapsed.count());
+		firstFrameReported = true;
+	}
+
 	// Due to the usage of a more sophisticated swap chain,
 	// the render target must be re-bound after every call to Present()
 	context->OMSetRenderTargets(1, backBufferRTV.GetAddressOf(), depthStencilView.Get());
@@ -4,10 +4,31 @@
 #include <DirectXMath.h>
 #include <wrl/client.h> // Used for ComPtr - a smart pointer for COM objects
 #include "Mesh.h"
-#include "Entity.h"
+#include "World.h"
+#include "Components.h"
 #include "Camera.h"
 #include "Material.h"
 #include "Lights.h"
+#include "ThreadPool.h"
+#include "JobSystem.h"
+#include "AsyncFileLoader.h"
+#include "AssetLoader.h"
+#include "TaskGraph.h"
+#include "TransformSystem.h"
+#include "EntityBVH.h"
+#include "SpatialGrid.h"
+#include "FrustumCuller.h"
+#include "VisibilityCache.h"
+#include "OcclusionCuller.h"
+#include "LODSelector.h"
+#include "RenderQueue.h"
+#include "StateCache.h"
+#include "RenderSnapshot.h"
+#include "TripleBuffer.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
 #include <vector>
 
 class Game 
@@ -23,23 +44,163 @@ public:
 	void Init();
 	void OnResize();
 	void Update(float deltaTime, float totalTime);
+	void UpdateMainThread(float deltaTime, float totalTime);
 	void Draw(float deltaTime, float totalTime);
+	void OnSimulationThreadChanged();
 
 private:
 
 	// Initialization helper methods - feel free to customize, combine, etc.
-	void LoadShaders(); 
-	void CreateBasicGeometry();
+	void LoadShaders(TaskGraph::TaskId entitiesReady);
+	TaskGraph::TaskId CreateBasicGeometry();
+	void CreateSamplerState();
+	void CreateTransparencyStates();
+	void CreateEntities();
+	void CreateCameraAndLights();
+	void CreateOccluderMeshes();
+
+	// Per-frame systems, run over the world's entities
+	void MoveEntities(float deltaTime);
+	void UpdateBounds();
+	void UpdateSpatialIndex();
+	void BuildSnapshot(RenderSnapshot& snapshot);
+	void CullOccluded();
+
+	// Has Update() run a command next time, on whichever thread it's on
+	void RunOnSimulation(std::function<void()> command);
+	void PrintThreadingStats();
+
+	void CreatePlaceholders();
+	void CreateSolidColorTexture(unsigned int color, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv);
+	void AssignLoadedShaders();
+	Material* GetSceneMaterial(int sceneIndex);
+
+	// Startup tasks that load an asset through the asset loader
+	TaskGraph::TaskId AddTextureLoad(const std::string& name, std::wstring path, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv, TaskPriority priority);
+	TaskGraph::TaskId AddMeshLoad(const std::string& name, std::wstring path, int entityIndex);
+
+	// Prefers the asset cooker's output when it exists
+	std::wstring GetAssetPath(std::wstring relativePath, std::wstring cookedExtension);
+
+	// Background work and asset loading
+	//  - The job system is for per-frame work, and the thread
+	//    pool for loading, which can take as long as it likes
+	JobSystem* jobSystem;
+	ThreadPool* threadPool;
+	AsyncFileLoader* fileLoader;
+	AssetLoader* assetLoader;
+	TaskGraph* startupGraph;
+	float assetLoadBudget; // Milliseconds per frame for finishing loaded assets
+
+	// Stand-ins used until the real assets arrive
+	MeshHandle placeholderMesh;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> placeholderTexture;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> placeholderNormalMap;
+
+	// Load time reporting
+	std::chrono::high_resolution_clock::time_point loadStartTime;
+	bool firstFrameReported;
+	bool fullyLoadedReported;
 
 	// Matrices
 	DirectX::XMFLOAT4X4 worldMatrix;
 
-	// Entities
-	std::vector<Entity*> entities = std::vector<Entity*>();
+	// Entities, and the transforms they use
+	//  - sceneEntities is the order Tab cycles through them
+	World* world;
+	std::vector<EntityId> sceneEntities;
+	TransformSystem* transformSystem;
+
+	// Every entity's bounds, for finding things by where they are,
+	// in one index per SpatialLayer
+	//  - Owned by the simulation, like the world
+	SpatialIndex* spatialLayers[(int)SpatialLayer::Count];
+
+	// Culls what's about to go in a snapshot against the camera
+	//  - visibleEntities is its output, kept to save reallocating
+	FrustumCuller* entityCuller;
+	std::vector<unsigned int> visibleEntities;
+
+	// Skips testing what can't have changed since the last snapshot
+	//  - The culler only gets the rest (their candidate indices
+	//    are in testedEntities, with their margins in cullMargins);
+	//    those still visible are in reusedVisible
+	VisibilityCache* visibilityCache;
+	std::vector<unsigned int> testedEntities;
+	std::vector<float> cullMargins;
+	std::vector<unsigned int> reusedVisible;
+
+	// Then against what's in front of them
+	//  - occludeeBoxes is indexed the same way as the frustum
+	//    culler's ids
+	OcclusionCuller* occlusionCuller;
+	unsigned int occluderBoxMesh;
+	std::vector<AABB> occludeeBoxes;
+
+	// Picks what's left's levels of detail
+	//  - Told the screen height and how long frames take by the
+	//    window's thread, through screenHeight and lastFrameMs
+	LODSelector* lodSelector;
+	std::atomic<float> screenHeight;
+	std::atomic<float> lastFrameMs;
+
+	// Meshes and materials, which entities refer to by handle
+	//  - sceneMaterials is in the same order as sceneEntities
+	HandlePool<Mesh> meshes;
+	HandlePool<Material> materials;
+	std::vector<MaterialHandle> sceneMaterials;
+
+	// Orders each frame's draws to change state as little as it
+	//  can, then draws the transparent ones blended over the rest
+	//  - Owned by the window's thread, like the pools
+	RenderQueue* renderQueue;
+	Microsoft::WRL::ComPtr<ID3D11BlendState> transparentBlendState;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilState> transparentDepthState;
+
+	// Everything Draw() and the shaders bind goes through this,
+	// which skips what's already bound
+	StateCache* stateCache;
+
+	// Hand-off between Update(), which may be on a thread of its
+	// own, and the window's thread, which draws
+	//  - The simulation owns the world, the transforms and the
+	//    camera; the window's thread owns the mesh and material
+	//    pools and everything that uses the device context
+	//  - Draw() only sees the simulation through snapshots, and
+	//    the simulation only hears from the window's thread
+	//    through commands
+	TripleBuffer<RenderSnapshot> snapshots;
+	std::vector<std::function<void()>> simulationCommands;
+	std::mutex simulationCommandMutex;
+	std::atomic<float> pendingAspectRatio; // 0 when there's no change
+
+	// The camera as of the last snapshot, for the next to blend from
+	DirectX::XMFLOAT4X4 previousView;
+	DirectX::XMFLOAT3 previousCameraPosition;
+
+	// Throughput and input latency since the threading mode last changed
+	std::atomic<unsigned long long> simulationUpdates;
+	std::chrono::high_resolution_clock::time_point modeStartTime;
+	unsigned long long modeStartUpdates;
+	unsigned long long modeFrames;
+	double modeLatencyMs;
+	unsigned long long modeLatencySamples;
 
 	// User input and entity swapping
+	//  - Keys act once per press, on the thread whose table
+	//    they're in: simulationKeys are polled by Update(), and
+	//    mainThreadKeys by UpdateMainThread()
+	struct KeyAction
+	{
+		int key;
+		std::function<void()> action;
+		bool wasDown = false;
+	};
 	int currentEntity;
-	bool prevTab;
+	std::vector<KeyAction> simulationKeys;
+	std::vector<KeyAction> mainThreadKeys;
+	void CreateKeyActions();
+	static void PollKeys(std::vector<KeyAction>& keys);
 
 	Camera* camera;
 	
@@ -58,9 +219,6 @@ private:
 	SimplePixelShader* currentPS;
 	SimpleVertexShader* currentVS;
 
-	// Materials for Assignment 5
-	std::vector<Material*> materials;
-
 	// Lights
 	std::vector<DirectionalLight> dLights = std::vector<DirectionalLight>();
 	std::vector<PointLight> pLights = std::vector<PointLight>();
@@ -0,0 +1,123 @@
+#pragma once
+#include <utility>
+#include <vector>
+
+// --------------------------------------------------------
+// Refers to an object in a HandlePool<T> (or, for entities,
+// in a World)
+//  - The generation goes up every time a slot is freed, so a
+//    handle to something that's been destroyed is caught
+//    instead of quietly pointing at whatever replaced it
+//  - A default-constructed handle is never valid
+// --------------------------------------------------------
+template<typename T>
+struct Handle
+{
+	unsigned int index = 0xFFFFFFFF;
+	unsigned int generation = 0;
+
+	bool operator==(const Handle& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const Handle& other) const { return !(*this == other); }
+};
+
+// --------------------------------------------------------
+// Owns objects of one type, handed out by generational handle
+//  - Objects are stored back to back, so going over every
+//    live one is a linear walk through memory
+//  - Create and Destroy are O(1): slots come from a free list,
+//    and destroying moves the last object into the gap
+//  - Since objects move, pointers from Get() are only good
+//    until the next Create/Destroy - hold on to the handle
+//  - Not thread safe
+// --------------------------------------------------------
+template<typename T>
+class HandlePool
+{
+public:
+	template<typename... Args>
+	Handle<T> Create(Args&&... args);
+	void Destroy(Handle<T> handle);
+
+	bool IsValid(Handle<T> handle);
+	T* Get(Handle<T> handle); // Null for stale or invalid handles
+	unsigned int GetCount() { return (unsigned int)objects.size(); }
+
+	// Every live object, in storage order
+	typename std::vector<T>::iterator begin() { return objects.begin(); }
+	typename std::vector<T>::iterator end() { return objects.end(); }
+
+private:
+	struct Slot
+	{
+		unsigned int objectIndex;
+		unsigned int generation;
+	};
+
+	std::vector<Slot> slots;
+	std::vector<T> objects;
+	std::vector<unsigned int> objectToSlot;
+	std::vector<unsigned int> freeSlots;
+};
+
+template<typename T>
+template<typename... Args>
+Handle<T> HandlePool<T>::Create(Args&&... args)
+{
+	unsigned int slot;
+	if (!freeSlots.empty())
+	{
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else
+	{
+		// Generations start at 1, so default handles never match
+		slot = (unsigned int)slots.size();
+		slots.push_back(Slot{ 0, 1 });
+	}
+
+	slots[slot].objectIndex = (unsigned int)objects.size();
+	objects.emplace_back(std::forward<Args>(args)...);
+	objectToSlot.push_back(slot);
+
+	Handle<T> handle;
+	handle.index = slot;
+	handle.generation = slots[slot].generation;
+	return handle;
+}
+
+template<typename T>
+void HandlePool<T>::Destroy(Handle<T> handle)
+{
+	if (!IsValid(handle))
+		return;
+
+	// Fill the gap with the last object
+	unsigned int objectIndex = slots[handle.index].objectIndex;
+	unsigned int last = (unsigned int)objects.size() - 1;
+	if (objectIndex != last)
+	{
+		objects[objectIndex] = std::move(objects[last]);
+		objectToSlot[objectIndex] = objectToSlot[last];
+		slots[objectToSlot[objectIndex]].objectIndex = objectIndex;
+	}
+	objects.pop_back();
+	objectToSlot.pop_back();
+
+	slots[handle.index].generation++;
+	freeSlots.push_back(handle.index);
+}
+
+template<typename T>
+bool HandlePool<T>::IsValid(Handle<T> handle)
+{
+	return handle.index < slots.size() && slots[handle.index].generation == handle.generation;
+}
+
+template<typename T>
+T* HandlePool<T>::Get(Handle<T> handle)
+{
+	if (!IsValid(handle))
+		return 0;
+	return &objects[slots[handle.index].objectIndex];
+}
@@ -0,0 +1,426 @@
+#include "JobSystem.h"
+#include <stdio.h>
+
+struct Job
+{
+	std::function<void()> work;
+	JobCounter* counter;
+};
+
+// Which job system, and which of its workers, the current
+// thread is - null for threads it doesn't own
+static thread_local JobSystem* currentSystem = 0;
+static thread_local unsigned int currentWorker = 0;
+
+// Tries before an idle worker goes to sleep
+static const unsigned int SpinsBeforeSleep = 64;
+
+WorkStealingDeque::WorkStealingDeque()
+{
+	top = 0;
+	bottom = 0;
+	for (unsigned int i = 0; i < Capacity; i++)
+		jobs[i] = 0;
+}
+
+bool WorkStealingDeque::Push(Job* job)
+{
+	long long b = bottom.load(std::memory_order_relaxed);
+	long long t = top.load(std::memory_order_acquire);
+	if (b - t >= (long long)Capacity)
+		return false;
+
+	jobs[b & (Capacity - 1)].store(job, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	bottom.store(b + 1, std::memory_order_relaxed);
+	return true;
+}
+
+Job* WorkStealingDeque::Pop()
+{
+	long long b = bottom.load(std::memory_order_relaxed) - 1;
+	bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	long long t = top.load(std::memory_order_relaxed);
+
+	if (t > b)
+	{
+		// Empty
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return 0;
+	}
+
+	Job* job = jobs[b & (Capacity - 1)].load(std::memory_order_relaxed);
+	if (t == b)
+	{
+		// The last job - race any thieves for it
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			job = 0;
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+bool WorkStealingDeque::IsEmpty()
+{
+	return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+}
+
+Job* WorkStealingDeque::Steal()
+{
+	long long t = top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	long long b = bottom.load(std::memory_order_acquire);
+	if (t >= b)
+		return 0;
+
+	Job* job = jobs[t & (Capacity - 1)].load(std::memory_order_relaxed);
+	if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return 0;
+	return job;
+}
+
+
+JobSystem::JobSystem(unsigned int workerCount)
+{
+	if (workerCount == 0)
+	{
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	queuedJobs = 0;
+	sleepingWorkers = 0;
+	stopping = false;
+
+	// Worker 0 is this thread
+	for (unsigned int i = 0; i <= workerCount; i++)
+	{
+		Worker* worker = new Worker();
+		worker->randomState = 0x9E3779B9u * (i + 1);
+		workers.push_back(worker);
+	}
+	ResetStats();
+
+	SetMainThread();
+	for (unsigned int i = 1; i <= workerCount; i++)
+		workers[i]->thread = std::thread(&JobSystem::WorkerLoop, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stopping = true;
+	}
+	sleepCondition.notify_all();
+
+	for (unsigned int i = 1; i < workers.size(); i++)
+		workers[i]->thread.join();
+	for (Worker* worker : workers)
+		delete worker;
+
+	if (currentSystem == this)
+		currentSystem = 0;
+}
+
+void JobSystem::SetMainThread()
+{
+	currentSystem = this;
+	currentWorker = 0;
+	mainThread = std::this_thread::get_id();
+}
+
+void JobSystem::Run(std::function<void()> work, JobCounter* counter)
+{
+	if (counter)
+		counter->count++;
+	Schedule(new Job{ work, counter });
+}
+
+// --------------------------------------------------------
+// Holds the job on the dependency until it reaches zero
+//  - Checked under the dependency's lock, which Finish()
+//    also takes when it hits zero, so the job can't be missed
+// --------------------------------------------------------
+void JobSystem::RunAfter(JobCounter* dependency, std::function<void()> work, JobCounter* counter)
+{
+	if (counter)
+		counter->count++;
+	Job* job = new Job{ work, counter };
+
+	{
+		std::lock_guard<std::mutex> lock(dependency->continuationMutex);
+		if (dependency->count.load() != 0)
+		{
+			dependency->continuations.push_back(job);
+			return;
+		}
+	}
+	Schedule(job);
+}
+
+void JobSystem::Wait(JobCounter* counter)
+{
+	int index = GetCurrentWorker();
+	if (index < 0)
+	{
+		// Not one of ours, so nothing to help with
+		while (!counter->IsDone())
+			std::this_thread::yield();
+	}
+	else
+	{
+		Worker* worker = workers[index];
+		while (!counter->IsDone())
+		{
+			Job* job = FindJob(index);
+			if (job)
+			{
+				Execute(job, index);
+				continue;
+			}
+
+			auto idleStart = std::chrono::high_resolution_clock::now();
+			std::this_thread::yield();
+			std::chrono::duration<long long, std::nano> idle = std::chrono::high_resolution_clock::now() - idleStart;
+			worker->idleNanoseconds.store(worker->idleNanoseconds.load(std::memory_order_relaxed) + idle.count(), std::memory_order_relaxed);
+		}
+	}
+
+	// Let the last Finish() get out of the counter
+	std::lock_guard<std::mutex> lock(counter->continuationMutex);
+}
+
+void JobSystem::ParallelFor(unsigned int count, unsigned int minRange, const std::function<void(unsigned int, unsigned int)>& body)
+{
+	if (count == 0)
+		return;
+	if (minRange == 0)
+		minRange = 1;
+
+	// Threads we don't own have no deque to split into
+	if (GetCurrentWorker() < 0)
+	{
+		body(0, count);
+		return;
+	}
+
+	JobCounter counter;
+	ParallelRange(0, count, minRange, body, &counter);
+	Wait(&counter);
+}
+
+// --------------------------------------------------------
+// Works through [first, last) minRange at a time, splitting
+// off the back half whenever this thread's deque is empty
+// --------------------------------------------------------
+void JobSystem::ParallelRange(unsigned int first, unsigned int last, unsigned int minRange, const std::function<void(unsigned int, unsigned int)>& body, JobCounter* counter)
+{
+	WorkStealingDeque& deque = workers[GetCurrentWorker()]->deque;
+	while (first < last)
+	{
+		if (last - first >= minRange * 2 && deque.IsEmpty())
+		{
+			unsigned int middle = first + (last - first) / 2;
+			Run([this, middle, last, minRange, &body, counter]() { ParallelRange(middle, last, minRange, body, counter); }, counter);
+			last = middle;
+			continue;
+		}
+
+		unsigned int end = last - first > minRange ? first + minRange : last;
+		body(first, end);
+		first = end;
+	}
+}
+
+void JobSystem::PrintStats()
+{
+	std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - statsStart;
+	printf("---- Job system: %u threads, last %.1fms ----\n", GetThreadCount(), elapsed.count());
+	printf("Thread    Jobs    Steals  Attempts   Idle\n");
+	for (unsigned int i = 0; i < workers.size(); i++)
+	{
+		Worker* worker = workers[i];
+		float idleMs = worker->idleNanoseconds.load() / 1000000.0f;
+		printf("%4u %9llu %9llu %9llu  %6.1f%%%s\n",
+			i,
+			worker->jobsRun.load(),
+			worker->steals.load(),
+			worker->stealAttempts.load(),
+			elapsed.count() > 0 ? idleMs * 100.0f / elapsed.count() : 0.0f,
+			i == 0 ? " (main - only counts time in Wait)" : "");
+	}
+}
+
+void JobSystem::ResetStats()
+{
+	for (Worker* worker : workers)
+	{
+		worker->jobsRun = 0;
+		worker->steals = 0;
+		worker->stealAttempts = 0;
+		worker->idleNanoseconds = 0;
+	}
+	statsStart = std::chrono::high_resolution_clock::now();
+}
+
+void JobSystem::WorkerLoop(unsigned int index)
+{
+	currentSystem = this;
+	currentWorker = index;
+	Worker* worker = workers[index];
+
+	while (!stopping)
+	{
+		Job* job = FindJob(index);
+		if (job)
+		{
+			Execute(job, index);
+			continue;
+		}
+
+		// Keep looking for a little while, then sleep until a job shows up
+		auto idleStart = std::chrono::high_resolution_clock::now();
+		for (unsigned int spin = 0; spin < SpinsBeforeSleep && !job; spin++)
+		{
+			std::this_thread::yield();
+			job = FindJob(index);
+		}
+		if (!job)
+		{
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			sleepingWorkers++;
+			sleepCondition.wait(lock, [this]() { return queuedJobs.load() > 0 || stopping; });
+			sleepingWorkers--;
+		}
+
+		std::chrono::duration<long long, std::nano> idle = std::chrono::high_resolution_clock::now() - idleStart;
+		worker->idleNanoseconds.store(worker->idleNanoseconds.load(std::memory_order_relaxed) + idle.count(), std::memory_order_relaxed);
+
+		if (job)
+			Execute(job, index);
+	}
+}
+
+int JobSystem::GetCurrentWorker()
+{
+	if (currentSystem != this)
+		return -1;
+
+	// Thread 0 may have moved to another thread since
+	if (currentWorker == 0 && std::this_thread::get_id() != mainThread.load(std::memory_order_relaxed))
+		return -1;
+	return (int)currentWorker;
+}
+
+// --------------------------------------------------------
+// Puts a job where other threads can find it, and wakes
+// a sleeping worker if there is one
+//  - queuedJobs goes up before sleepingWorkers is checked,
+//    and a worker counts itself as sleeping before checking
+//    queuedJobs, so one of the two always sees the other
+// --------------------------------------------------------
+void JobSystem::Schedule(Job* job)
+{
+	queuedJobs++;
+
+	int index = GetCurrentWorker();
+	if (index < 0)
+	{
+		std::lock_guard<std::mutex> lock(sharedMutex);
+		sharedJobs.push_back(job);
+	}
+	else if (!workers[index]->deque.Push(job))
+	{
+		// Full, so just do it now
+		queuedJobs--;
+		Execute(job, index);
+		return;
+	}
+
+	if (sleepingWorkers.load() > 0)
+	{
+		{ std::lock_guard<std::mutex> lock(sleepMutex); }
+		sleepCondition.notify_one();
+	}
+}
+
+// --------------------------------------------------------
+// Own deque first, then the shared queue, then stealing
+// from the other threads, starting at a random one
+// --------------------------------------------------------
+Job* JobSystem::FindJob(unsigned int index)
+{
+	Worker* worker = workers[index];
+	Job* job = worker->deque.Pop();
+
+	if (!job && queuedJobs.load() > 0)
+	{
+		std::lock_guard<std::mutex> lock(sharedMutex);
+		if (!sharedJobs.empty())
+		{
+			job = sharedJobs.front();
+			sharedJobs.pop_front();
+		}
+	}
+
+	if (!job && queuedJobs.load() > 0)
+	{
+		// xorshift
+		worker->randomState ^= worker->randomState << 13;
+		worker->randomState ^= worker->randomState >> 17;
+		worker->randomState ^= worker->randomState << 5;
+
+		unsigned int workerCount = (unsigned int)workers.size();
+		unsigned int start = worker->randomState % workerCount;
+		for (unsigned int i = 0; i < workerCount && !job; i++)
+		{
+			unsigned int victim = (start + i) % workerCount;
+			if (victim == index)
+				continue;
+
+			worker->stealAttempts.store(worker->stealAttempts.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			job = workers[victim]->deque.Steal();
+			if (job)
+				worker->steals.store(worker->steals.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		}
+	}
+
+	if (job)
+		queuedJobs--;
+	return job;
+}
+
+void JobSystem::Execute(Job* job, unsigned int index)
+{
+	job->work();
+
+	Worker* worker = workers[index];
+	worker->jobsRun.store(worker->jobsRun.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+	JobCounter* counter = job->counter;
+	delete job;
+	if (counter)
+		Finish(counter);
+}
+
+// --------------------------------------------------------
+// Lowers the counter, and lets go of the jobs waiting on it
+// once it hits zero
+//  - The counter is only touched under its lock, which Wait()
+//    takes before returning, so a counter on the waiter's
+//    stack is never used after it's gone
+// --------------------------------------------------------
+void JobSystem::Finish(JobCounter* counter)
+{
+	std::vector<Job*> ready;
+	{
+		std::lock_guard<std::mutex> lock(counter->continuationMutex);
+		if (--counter->count != 0)
+			return;
+		ready.swap(counter->continuations);
+	}
+	for (Job* job : ready)
+		Schedule(job);
+}
@@ -0,0 +1,156 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+struct Job;
+
+// --------------------------------------------------------
+// Counts unfinished jobs, so they can be waited on or used
+// as a dependency
+//  - Goes up when a job is handed to the job system with it,
+//    and down when that job finishes
+//  - Must outlive the jobs using it - Wait() on it before
+//    letting it go
+// --------------------------------------------------------
+class JobCounter
+{
+public:
+	JobCounter() : count(0) { }
+	bool IsDone() { return count.load() == 0; }
+
+private:
+	friend class JobSystem;
+
+	std::atomic<int> count;
+
+	// Jobs waiting for this to reach zero
+	std::mutex continuationMutex;
+	std::vector<Job*> continuations;
+};
+
+// --------------------------------------------------------
+// Chase-Lev work-stealing deque of jobs
+//  - The owning thread pushes and pops at the bottom, so it
+//    works through its own jobs newest first, while the
+//    cache is still warm
+//  - Other threads steal from the top, taking the oldest
+//    (and, from a parallel for, the biggest) jobs
+//  - Fixed size; Push() fails when it's full
+// --------------------------------------------------------
+class WorkStealingDeque
+{
+public:
+	static const unsigned int Capacity = 4096;
+
+	WorkStealingDeque();
+
+	// Owner only
+	bool Push(Job* job);
+	Job* Pop();
+	bool IsEmpty();
+
+	// Any thread - null when empty or when another thread won
+	Job* Steal();
+
+private:
+	alignas(64) std::atomic<long long> top;
+	alignas(64) std::atomic<long long> bottom;
+	std::atomic<Job*> jobs[Capacity];
+};
+
+// --------------------------------------------------------
+// Work-stealing job scheduler for fine-grained, per-frame work
+//  - One deque per thread, including the thread that made the
+//    job system, which counts as thread 0 and runs jobs while
+//    it waits rather than blocking
+//  - Idle workers steal from a random other thread, and
+//    sleep once there's nothing left to take
+//  - Jobs added from threads the system doesn't know about
+//    (the ThreadPool's, say) go through a shared queue
+//  - Coarse, long-running work like asset loading belongs on
+//    the ThreadPool instead, so it can't hold up a frame
+// --------------------------------------------------------
+class JobSystem
+{
+public:
+	JobSystem(unsigned int workerCount = 0); // 0 = one per hardware thread, minus this one
+	~JobSystem();
+
+	// Threads that run jobs, including the one that made the system
+	unsigned int GetThreadCount() { return (unsigned int)workers.size(); }
+
+	// Makes the calling thread thread 0 in place of the one that
+	// was, which then counts as a foreign thread
+	//  - For when the work that drives the job system moves to
+	//    another thread; thread 0's deque must be empty, so call
+	//    it while the old thread isn't waiting on anything
+	void SetMainThread();
+
+	// Queues work; counter (optional) is raised now and lowered
+	// once the work is done
+	void Run(std::function<void()> work, JobCounter* counter = 0);
+
+	// Same, but holds the work back until dependency reaches zero
+	void RunAfter(JobCounter* dependency, std::function<void()> work, JobCounter* counter = 0);
+
+	// Runs queued jobs until counter reaches zero
+	void Wait(JobCounter* counter);
+
+	// Calls body on ranges covering [0, count), none smaller
+	// than minRange (except the last), and waits for them all
+	//  - Ranges are split off lazily: a thread only halves what
+	//    it has left when its own deque has run dry, meaning
+	//    another thread stole the last half it split off
+	//  - So few, big ranges when the other threads are busy,
+	//    and more, smaller ones when they're idle
+	void ParallelFor(unsigned int count, unsigned int minRange, const std::function<void(unsigned int, unsigned int)>& body);
+
+	// Per-thread counts and idle time since the last reset
+	void PrintStats();
+	void ResetStats();
+
+private:
+	struct alignas(64) Worker
+	{
+		WorkStealingDeque deque;
+		std::thread thread;
+		unsigned int randomState;
+
+		// Only written by the worker itself
+		std::atomic<unsigned long long> jobsRun;
+		std::atomic<unsigned long long> steals;
+		std::atomic<unsigned long long> stealAttempts;
+		std::atomic<unsigned long long> idleNanoseconds;
+	};
+
+	std::vector<Worker*> workers;
+	std::atomic<std::thread::id> mainThread;
+
+	// Jobs from threads without a deque
+	std::deque<Job*> sharedJobs;
+	std::mutex sharedMutex;
+
+	// Sleeping when there's nothing to do
+	std::atomic<int> queuedJobs;
+	std::atomic<int> sleepingWorkers;
+	std::mutex sleepMutex;
+	std::condition_variable sleepCondition;
+	std::atomic<bool> stopping;
+
+	std::chrono::high_resolution_clock::time_point statsStart;
+
+	void WorkerLoop(unsigned int index);
+	int GetCurrentWorker();
+	void Schedule(Job* job);
+	Job* FindJob(unsigned int index);
+	void Execute(Job* job, unsigned int index);
+	void Finish(JobCounter* counter);
+	void ParallelRange(unsigned int first, unsigned int last, unsigned int minRange, const std::function<void(unsigned int, unsigned int)>& body, JobCounter* counter);
+};
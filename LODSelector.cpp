@@ -0,0 +1,139 @@
+#include "LODSelector.h"
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+
+using namespace DirectX;
+
+// How much of each frame's time goes into the running average
+// the bias follows
+static const float FrameSmoothing = 0.1f;
+
+// The bias moves by this factor a frame, between 1 and MaxBias
+static const float BiasStep = 1.05f;
+static const float MaxBias = 8.0f;
+
+// Frames under this much of the budget let the bias back down
+static const float UnderBudget = 0.85f;
+
+// Bounds nearer than this to the camera are drawn at full detail
+static const float MinDistance = 0.01f;
+
+LODSelector::LODSelector()
+{
+	screenHeight = 720.0f;
+	threshold = 1.0f;
+	hysteresis = 0.25f;
+	budgetMs = 1000.0f / 60.0f;
+	bias = 1.0f;
+	averageFrameMs = 0.0f;
+	cameraPosition = XMFLOAT3(0, 0, 0);
+	pixelsPerUnit = 0.0f;
+	ResetStats();
+}
+
+LODState LODSelector::MakeState(const MeshLOD* lods, unsigned int count, float boundsRadius)
+{
+	LODState state = {};
+	state.count = count < MeshLoader::MaxLODs ? count : MeshLoader::MaxLODs;
+	for (unsigned int level = 0; level < state.count; level++)
+	{
+		state.errors[level] = boundsRadius > 0.0f ? lods[level].error / boundsRadius : 0.0f;
+		state.triangles[level] = lods[level].indexCount / 3;
+	}
+	return state;
+}
+
+// --------------------------------------------------------
+// The projection's _22 is how far a unit at a distance of 1
+// goes in clip space, from the middle of the screen to the
+// top, which is half the screen's height in pixels
+// --------------------------------------------------------
+void LODSelector::BeginFrame(const XMFLOAT4X4& projection, const XMFLOAT3& cameraPosition, float frameMs)
+{
+	this->cameraPosition = cameraPosition;
+	pixelsPerUnit = projection._22 * screenHeight * 0.5f;
+
+	averageFrameMs = averageFrameMs > 0.0f ? averageFrameMs + (frameMs - averageFrameMs) * FrameSmoothing : frameMs;
+	if (budgetMs <= 0.0f)
+		bias = 1.0f;
+	else if (averageFrameMs > budgetMs)
+		bias = std::min(bias * BiasStep, MaxBias);
+	else if (averageFrameMs < budgetMs * UnderBudget)
+		bias = std::max(bias / BiasStep, 1.0f);
+
+	frames++;
+	biasTotal += bias;
+}
+
+unsigned int LODSelector::Select(LODState& state, const XMFLOAT3& center, float radius)
+{
+	if (state.count == 0)
+		return 0;
+
+	float x = center.x - cameraPosition.x;
+	float y = center.y - cameraPosition.y;
+	float z = center.z - cameraPosition.z;
+	float distance = sqrtf(x * x + y * y + z * z) - radius;
+
+	unsigned int level = std::min(state.current, state.count - 1);
+	if (distance <= MinDistance)
+		level = 0;
+	else
+	{
+		// Pixels per unit of relative error
+		float scale = radius * pixelsPerUnit / distance;
+		float limit = threshold * bias;
+		if (state.errors[level] * scale > limit * (1.0f + hysteresis))
+		{
+			while (level > 0 && state.errors[level] * scale > limit)
+				level--;
+		}
+		else
+		{
+			while (level + 1 < state.count && state.errors[level + 1] * scale <= limit * (1.0f - hysteresis))
+				level++;
+		}
+	}
+
+	entities++;
+	fullTriangles += state.triangles[0];
+	submittedTriangles += state.triangles[level];
+	changes += level != state.current ? 1 : 0;
+	levelCounts[level]++;
+	state.current = level;
+	return level;
+}
+
+void LODSelector::PrintStats()
+{
+	printf("---- LOD selection: %llu frames ----\n", frames);
+	if (frames == 0)
+		return;
+
+	printf("Threshold %.2f pixels, average bias %.2f (budget %.2fms, frames averaging %.2fms)\n",
+		threshold, biasTotal / frames, budgetMs, averageFrameMs);
+	printf("Per frame: %.1f entities, %.2f level changes\n",
+		(double)entities / frames,
+		(double)changes / frames);
+	printf("Triangles per frame: %.0f at full detail, %.0f submitted (%.1f%%)\n",
+		(double)fullTriangles / frames,
+		(double)submittedTriangles / frames,
+		fullTriangles > 0 ? submittedTriangles * 100.0 / fullTriangles : 0.0);
+	printf("Entities at each level:");
+	for (unsigned int level = 0; level < MeshLoader::MaxLODs; level++)
+		printf(" %.1f", (double)levelCounts[level] / frames);
+	printf("\n");
+}
+
+void LODSelector::ResetStats()
+{
+	frames = 0;
+	entities = 0;
+	fullTriangles = 0;
+	submittedTriangles = 0;
+	changes = 0;
+	for (unsigned long long& count : levelCounts)
+		count = 0;
+	biasTotal = 0.0;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <DirectXMath.h>
+#include "MeshLoader.h"
+
+// An entity's mesh's levels of detail, as LODSelector needs them,
+// and the level it was last drawn at
+//  - A component, copied off the mesh when it's assigned (like
+//    LocalBounds), so the simulation never has to look at it
+//  - Errors are relative to the mesh's bounding radius, so they
+//    scale with the entity along with its Bounds
+struct LODState
+{
+	float errors[MeshLoader::MaxLODs];
+	unsigned int triangles[MeshLoader::MaxLODs];
+	unsigned int count;
+	unsigned int current;
+};
+
+// --------------------------------------------------------
+// Picks each entity's level of detail by how big its error
+// would look on screen
+//  - A level's error, scaled by the entity's bounding radius and
+//    projected from the nearest point of its bounds, is how many
+//    pixels its vertices could be out by; the coarsest level
+//    under the threshold (a pixel, by default) is the one wanted
+//  - With hysteresis: an entity only goes coarser once the next
+//    level is comfortably under the threshold, and only goes
+//    finer once its own is comfortably over it, so ones sitting
+//    near a boundary don't flicker between levels
+//  - The threshold is scaled by a bias that follows the frame
+//    time: over budget, it creeps up, trading detail for speed;
+//    well under, it creeps back down to 1
+//  - Counts the triangles the picked levels come to, against what
+//    drawing everything at full detail would have, for stats
+// --------------------------------------------------------
+class LODSelector
+{
+public:
+	LODSelector();
+
+	// The chain off a mesh, for its entities' LODState
+	static LODState MakeState(const MeshLOD* lods, unsigned int count, float boundsRadius);
+
+	// Once a frame, before any Select()
+	//  - frameMs is how long the last frame took, for the bias
+	void BeginFrame(const DirectX::XMFLOAT4X4& projection, const DirectX::XMFLOAT3& cameraPosition, float frameMs);
+
+	// Picks the level to draw an entity with these world bounds
+	// at, and keeps it in state for next time
+	unsigned int Select(LODState& state, const DirectX::XMFLOAT3& center, float radius);
+
+	// The render target's height, which error is measured against
+	void SetScreenHeight(float screenHeight) { this->screenHeight = screenHeight; }
+
+	// Error allowed on screen, in pixels, before the bias
+	void SetThreshold(float pixels) { threshold = pixels; }
+
+	// How far past the threshold (as a fraction of it) a change
+	// of level has to be
+	void SetHysteresis(float hysteresis) { this->hysteresis = hysteresis; }
+
+	// Frame time the bias aims to keep under; 0 turns it off
+	void SetBudget(float milliseconds) { budgetMs = milliseconds; }
+	float GetBias() { return bias; }
+
+	void PrintStats();
+	void ResetStats();
+
+private:
+	float screenHeight;
+	float threshold;
+	float hysteresis;
+	float budgetMs;
+	float bias;
+	float averageFrameMs;
+
+	// This frame's
+	DirectX::XMFLOAT3 cameraPosition;
+	float pixelsPerUnit;	// At a distance of 1
+
+	// Stats
+	unsigned long long frames;
+	unsigned long long entities;
+	unsigned long long fullTriangles;
+	unsigned long long submittedTriangles;
+	unsigned long long changes;
+	unsigned long long levelCounts[MeshLoader::MaxLODs];
+	double biasTotal;
+};
@@ -38,11 +38,37 @@ void Material::SetColorTint(DirectX::XMFLOAT4 tint)
 	colorTint = tint;
 }
 
+void Material::SetPixelShader(SimplePixelShader* ps)
+{
+	pixelShader = ps;
+}
+
+void Material::SetVertexShader(SimpleVertexShader* vs)
+{
+	vertexShader = vs;
+}
+
+void Material::SetSRV(ID3D11ShaderResourceView* srv)
+{
+	this->srv = srv;
+}
+
+void Material::SetNormalMap(ID3D11ShaderResourceView* normalMap)
+{
+	this->normalMap = normalMap;
+}
+
 DirectX::XMFLOAT4 Material::GetColorTint()
 {
 	return colorTint;
 }
 
+// The tint's alpha is what the shaders blend with
+bool Material::IsTransparent()
+{
+	return colorTint.w < 1.0f;
+}
+
 SimplePixelShader* Material::GetPixelShader()
 {
 	return pixelShader;
@@ -42,8 +42,13 @@ public:
 		ID3D11SamplerState* samplerState);
 
 	void SetColorTint(DirectX::XMFLOAT4 tint);
+	void SetPixelShader(SimplePixelShader* ps);
+	void SetVertexShader(SimpleVertexShader* vs);
+	void SetSRV(ID3D11ShaderResourceView* srv);
+	void SetNormalMap(ID3D11ShaderResourceView* normalMap);
 
 	DirectX::XMFLOAT4 GetColorTint();
+	bool IsTransparent();
 	SimplePixelShader* GetPixelShader();
 	SimpleVertexShader* GetVertexShader();
 	float GetSpecularIntensity();
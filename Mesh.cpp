@@ -1,252 +1,145 @@
 #include "Mesh.h"
+#include <math.h>
+#include <string.h>
 
 // For the DirectX Math library
 using namespace DirectX;
 
 Mesh::Mesh(Vertex* vertices, int numberOfVertices, unsigned int* indices, int numberOfIndices, Microsoft::WRL::ComPtr<ID3D11Device> device)
 {
-	// Set up the indices
-	this->numberOfIndices = numberOfIndices;
-
 	// Calculate tangents - must be done before creating buffers
 	CalculateTangents(vertices, numberOfVertices, indices, numberOfIndices);
 
-	// Create the VERTEX BUFFER description -----------------------------------
-	// - The description is created on the stack because we only need
-	//    it to create the buffer.  The description is then useless.
-	D3D11_BUFFER_DESC vbd;
-	vbd.Usage = D3D11_USAGE_IMMUTABLE;
-	vbd.ByteWidth = sizeof(Vertex) * numberOfVertices;
-	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER; // Tells DirectX this is a vertex buffer
-	vbd.CPUAccessFlags = 0;
-	vbd.MiscFlags = 0;
-	vbd.StructureByteStride = 0;
-	
-	// Create the proper struct to hold the initial vertex data
-	// - This is how we put the initial data into the buffer
-	D3D11_SUBRESOURCE_DATA initialVertexData;
-	initialVertexData.pSysMem = vertices;
-
-	// Actually create the buffer with the initial data
-	// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
-	device->CreateBuffer(&vbd, &initialVertexData, vertexBuffer.GetAddressOf());
-
-
-	// Create the INDEX BUFFER description ------------------------------------
-	// - The description is created on the stack because we only need
-	//    it to create the buffer.  The description is then useless.
-	D3D11_BUFFER_DESC ibd;
-	ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = sizeof(int) * numberOfIndices;
-	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER; // Tells DirectX this is an index buffer
-	ibd.CPUAccessFlags = 0;
-	ibd.MiscFlags = 0;
-	ibd.StructureByteStride = 0;
+	bvh = std::make_shared<MeshBVH>();
+	bvh->Build(&vertices[0].Position, numberOfVertices, sizeof(Vertex), indices, numberOfIndices);
 
-	// Create the proper struct to hold the initial index data
-	// - This is how we put the initial data into the buffer
-	D3D11_SUBRESOURCE_DATA initialIndexData;
-	initialIndexData.pSysMem = indices;
-
-	// Actually create the buffer with the initial data
-	// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
-	device->CreateBuffer(&ibd, &initialIndexData, indexBuffer.GetAddressOf());
+	// The levels of detail go after the full one in the index buffer
+	std::vector<Vertex> verts(vertices, vertices + numberOfVertices);
+	std::vector<unsigned int> allIndices(indices, indices + numberOfIndices);
+	MeshLoader::BuildLODs(verts, allIndices, lods);
+	CreateBuffers(vertices, numberOfVertices, &allIndices[0], (int)allIndices.size(), device);
 }
 
+// --------------------------------------------------------
+// Loads a mesh from disk
+//  - ".cmesh" files come from the asset cooker and are
+//    already in their final layout
+//  - Anything else is treated as an OBJ and parsed here
+// --------------------------------------------------------
 Mesh::Mesh(const char* filename, Microsoft::WRL::ComPtr<ID3D11Device> device)
 {
-	// File input object
-	std::ifstream obj(filename);
+	this->numberOfIndices = 0;
+	this->boundsCenter = XMFLOAT3(0, 0, 0);
+	this->boundsRadius = 0;
+	this->bvh = std::make_shared<MeshBVH>();
 
-	// Check for successful open
-	if (!obj.is_open())
-		return;
-
-	// Variables used while reading the file
-	std::vector<XMFLOAT3> positions;     // Positions from the file
-	std::vector<XMFLOAT3> normals;       // Normals from the file
-	std::vector<XMFLOAT2> uvs;           // UVs from the file
 	std::vector<Vertex> verts;           // Verts we're assembling
 	std::vector<UINT> indices;           // Indices of these verts
-	unsigned int vertCounter = 0;        // Count of vertices/indices
-	char chars[100];                     // String for line reading
-
-	// Still have data left?
-	while (obj.good())
-	{
-		// Get the line (100 characters should be more than enough)
-		obj.getline(chars, 100);
-
-		// Check the type of line
-		if (chars[0] == 'v' && chars[1] == 'n')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 norm;
-			sscanf_s(
-				chars,
-				"vn %f %f %f",
-				&norm.x, &norm.y, &norm.z);
-
-			// Add to the list of normals
-			normals.push_back(norm);
-		}
-		else if (chars[0] == 'v' && chars[1] == 't')
-		{
-			// Read the 2 numbers directly into an XMFLOAT2
-			XMFLOAT2 uv;
-			sscanf_s(
-				chars,
-				"vt %f %f",
-				&uv.x, &uv.y);
-
-			// Add to the list of uv's
-			uvs.push_back(uv);
-		}
-		else if (chars[0] == 'v')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 pos;
-			sscanf_s(
-				chars,
-				"v %f %f %f",
-				&pos.x, &pos.y, &pos.z);
-
-			// Add to the positions
-			positions.push_back(pos);
-		}
-		else if (chars[0] == 'f')
-		{
-			// Read the face indices into an array
-			// NOTE: This assumes the given obj file contains
-			//  vertex positions, uv coordinates AND normals.
-			//  If the model is missing any of these, this 
-			//  code will not handle the file correctly!
-			unsigned int i[12];
-			int facesRead = sscanf_s(
-				chars,
-				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
-				&i[0], &i[1], &i[2],
-				&i[3], &i[4], &i[5],
-				&i[6], &i[7], &i[8],
-				&i[9], &i[10], &i[11]);
-
-			// - Create the verts by looking up
-			//    corresponding data from vectors
-			// - OBJ File indices are 1-based, so
-			//    they need to be adusted
-			Vertex v1;
-			v1.Position = positions[i[0] - 1];
-			v1.UV = uvs[i[1] - 1];
-			v1.Normal = normals[i[2] - 1];
 
-			Vertex v2;
-			v2.Position = positions[i[3] - 1];
-			v2.UV = uvs[i[4] - 1];
-			v2.Normal = normals[i[5] - 1];
+	// Pick the loader based on the file extension
+	size_t length = strlen(filename);
+	bool cooked = length > 6 && _stricmp(filename + length - 6, ".cmesh") == 0;
 
-			Vertex v3;
-			v3.Position = positions[i[6] - 1];
-			v3.UV = uvs[i[7] - 1];
-			v3.Normal = normals[i[8] - 1];
-
-			// The model is most likely in a right-handed space,
-			// especially if it came from Maya.  We want to convert
-			// to a left-handed space for DirectX.  This means we 
-			// need to:
-			//  - Invert the Z position
-			//  - Invert the normal's Z
-			//  - Flip the winding order
-			// We also need to flip the UV coordinate since DirectX
-			// defines (0,0) as the top left of the texture, and many
-			// 3D modeling packages use the bottom left as (0,0)
-
-			// Flip the UV's since they're probably "upside down"
-			v1.UV.y = 1.0f - v1.UV.y;
-			v2.UV.y = 1.0f - v2.UV.y;
-			v3.UV.y = 1.0f - v3.UV.y;
+	bool loaded = cooked ?
+		MeshLoader::LoadCookedMesh(filename, verts, indices, bvh.get(), &lods) :
+		MeshLoader::LoadOBJ(filename, verts, indices);
+	if (!loaded)
+		return;
 
-			// Flip Z (LH vs. RH)
-			v1.Position.z *= -1.0f;
-			v2.Position.z *= -1.0f;
-			v3.Position.z *= -1.0f;
+	// Cooked meshes normally come with their BVH and levels of detail
+	if (bvh->IsEmpty())
+		MeshLoader::BuildBVH(verts, indices, *bvh, &lods);
+	if (lods.empty())
+		MeshLoader::BuildLODs(verts, indices, lods);
 
-			// Flip normal Z
-			v1.Normal.z *= -1.0f;
-			v2.Normal.z *= -1.0f;
-			v3.Normal.z *= -1.0f;
+	// - At this point, "verts" is a vector of Vertex structs, and can be used
+	//    directly to create a vertex buffer:  &verts[0] is the address of the first vert
+	//
+	// - The vector "indices" is similar. It's a vector of unsigned ints and
+	//    can be used directly for the index buffer: &indices[0] is the address of the first int
+	CreateBuffers(&verts[0], (int)verts.size(), &indices[0], (int)indices.size(), device);
+}
 
-			// Add the verts to the vector (flipping the winding order)
-			verts.push_back(v1);
-			verts.push_back(v3);
-			verts.push_back(v2);
+// --------------------------------------------------------
+// Creates a mesh from data that's already been loaded
+// (by MeshLoader, for instance) and has its tangents
+//  - Handy when the file reading and parsing happened on
+//    another thread and only the buffers are left to make
+//  - Takes the data's BVH rather than copying it, so that
+//    should be built already too, along with the levels of
+//    detail (without them, it's all one level)
+// --------------------------------------------------------
+Mesh::Mesh(MeshData& data, Microsoft::WRL::ComPtr<ID3D11Device> device)
+{
+	this->numberOfIndices = 0;
+	this->boundsCenter = XMFLOAT3(0, 0, 0);
+	this->boundsRadius = 0;
+	this->bvh = std::make_shared<MeshBVH>();
+	if (!data.success || data.vertices.empty() || data.indices.empty())
+		return;
 
-			// Add three more indices
-			indices.push_back(vertCounter); vertCounter += 1;
-			indices.push_back(vertCounter); vertCounter += 1;
-			indices.push_back(vertCounter); vertCounter += 1;
+	*bvh = std::move(data.bvh);
+	lods = data.lods;
+	if (lods.empty())
+		lods.push_back(MeshLOD{ 0, (unsigned int)data.indices.size(), 0.0f });
 
-			// Was there a 4th face?
-			if (facesRead == 12)
-			{
-				// Make the last vertex
-				Vertex v4;
-				v4.Position = positions[i[9] - 1];
-				v4.UV = uvs[i[10] - 1];
-				v4.Normal = normals[i[11] - 1];
+	CreateBuffers(&data.vertices[0], (int)data.vertices.size(), &data.indices[0], (int)data.indices.size(), device);
+}
 
-				// Flip the UV, Z pos and normal
-				v4.UV.y = 1.0f - v4.UV.y;
-				v4.Position.z *= -1.0f;
-				v4.Normal.z *= -1.0f;
+Mesh::~Mesh()
+{
+}
 
-				// Add a whole triangle (flipping the winding order)
-				verts.push_back(v1);
-				verts.push_back(v4);
-				verts.push_back(v3);
+// --------------------------------------------------------
+// Creates the immutable vertex and index buffers, and works
+// out the bounding sphere while the vertices are on hand
+//  - Tangents must already be calculated at this point
+// --------------------------------------------------------
+void Mesh::CreateBuffers(const Vertex* vertices, int numberOfVertices, const unsigned int* indices, int numberOfIndices, Microsoft::WRL::ComPtr<ID3D11Device> device)
+{
+	// Set up the indices
+	this->numberOfIndices = numberOfIndices;
 
-				// Add three more indices
-				indices.push_back(vertCounter); vertCounter += 1;
-				indices.push_back(vertCounter); vertCounter += 1;
-				indices.push_back(vertCounter); vertCounter += 1;
-			}
-		}
+	// Sphere around the center of the bounding box
+	XMVECTOR boxMin = XMLoadFloat3(&vertices[0].Position);
+	XMVECTOR boxMax = boxMin;
+	for (int i = 1; i < numberOfVertices; i++)
+	{
+		XMVECTOR p = XMLoadFloat3(&vertices[i].Position);
+		boxMin = XMVectorMin(boxMin, p);
+		boxMax = XMVectorMax(boxMax, p);
 	}
-
-	// Close the file and create the actual buffers
-	obj.close();
-
-
-	// - At this point, "verts" is a vector of Vertex structs, and can be used
-	//    directly to create a vertex buffer:  &verts[0] is the address of the first vert
-	//
-	// - The vector "indices" is similar. It's a vector of unsigned ints and
-	//    can be used directly for the index buffer: &indices[0] is the address of the first int
-	//
-	// - "vertCounter" is BOTH the number of vertices and the number of indices
-	// - Yes, the indices are a bit redundant here (one per vertex).  Could you skip using
-	//    an index buffer in this case?  Sure!  Though, if your mesh class assumes you have
-	//    one, you'll need to write some extra code to handle cases when you don't.
-
-	// Calculate tangents - must be done before creating buffers
-	CalculateTangents(&verts[0], vertCounter, &indices[0], vertCounter);
+	XMVECTOR center = (boxMin + boxMax) * 0.5f;
+	XMVECTOR radiusSq = XMVectorZero();
+	for (int i = 0; i < numberOfVertices; i++)
+		radiusSq = XMVectorMax(radiusSq, XMVector3LengthSq(XMLoadFloat3(&vertices[i].Position) - center));
+	XMStoreFloat3(&boundsCenter, center);
+	boundsRadius = sqrtf(XMVectorGetX(radiusSq));
 
 	// Create the VERTEX BUFFER description -----------------------------------
+	// - The description is created on the stack because we only need
+	//    it to create the buffer.  The description is then useless.
 	D3D11_BUFFER_DESC vbd;
 	vbd.Usage = D3D11_USAGE_IMMUTABLE;
-	vbd.ByteWidth = sizeof(Vertex) * vertCounter;
+	vbd.ByteWidth = sizeof(Vertex) * numberOfVertices;
 	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER; // Tells DirectX this is a vertex buffer
 	vbd.CPUAccessFlags = 0;
 	vbd.MiscFlags = 0;
 	vbd.StructureByteStride = 0;
+	
 	// Create the proper struct to hold the initial vertex data
+	// - This is how we put the initial data into the buffer
 	D3D11_SUBRESOURCE_DATA initialVertexData;
-	initialVertexData.pSysMem = &verts[0];
+	initialVertexData.pSysMem = vertices;
+
 	// Actually create the buffer with the initial data
+	// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
 	device->CreateBuffer(&vbd, &initialVertexData, vertexBuffer.GetAddressOf());
 
 
 	// Create the INDEX BUFFER description ------------------------------------
-	this->numberOfIndices = vertCounter;
+	// - The description is created on the stack because we only need
+	//    it to create the buffer.  The description is then useless.
 	D3D11_BUFFER_DESC ibd;
 	ibd.Usage = D3D11_USAGE_IMMUTABLE;
 	ibd.ByteWidth = sizeof(int) * numberOfIndices;
@@ -254,94 +147,22 @@ Mesh::Mesh(const char* filename, Microsoft::WRL::ComPtr<ID3D11Device> device)
 	ibd.CPUAccessFlags = 0;
 	ibd.MiscFlags = 0;
 	ibd.StructureByteStride = 0;
+
 	// Create the proper struct to hold the initial index data
+	// - This is how we put the initial data into the buffer
 	D3D11_SUBRESOURCE_DATA initialIndexData;
-	initialIndexData.pSysMem = &indices[0];
+	initialIndexData.pSysMem = indices;
+
 	// Actually create the buffer with the initial data
+	// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
 	device->CreateBuffer(&ibd, &initialIndexData, indexBuffer.GetAddressOf());
 }
 
-Mesh::~Mesh()
-{
-}
-
 // Calculates the tangents of the vertices in a mesh
-// - Code originally adapted from: http://www.terathon.com/code/tangent.html
-//   - Updated version now found here: http://foundationsofgameenginedev.com/FGED2-sample.pdf
-//   - See listing 7.4 in section 7.5 (page 9 of the PDF)
-//
-// - Note: For this code to work, your Vertex format must
-//         contain an XMFLOAT3 called Tangent
+// - See MeshLoader::CalculateTangents(), which the asset cooker shares
 void Mesh::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices)
 {
-	// Reset tangents
-	for (int i = 0; i < numVerts; i++)
-	{
-		verts[i].Tangent = XMFLOAT3(0, 0, 0);
-	}
-
-	// Calculate tangents one whole triangle at a time
-	for (int i = 0; i < numIndices;)
-	{
-		// Grab indices and vertices of first triangle
-		unsigned int i1 = indices[i++];
-		unsigned int i2 = indices[i++];
-		unsigned int i3 = indices[i++];
-		Vertex* v1 = &verts[i1];
-		Vertex* v2 = &verts[i2];
-		Vertex* v3 = &verts[i3];
-
-		// Calculate vectors relative to triangle positions
-		float x1 = v2->Position.x - v1->Position.x;
-		float y1 = v2->Position.y - v1->Position.y;
-		float z1 = v2->Position.z - v1->Position.z;
-
-		float x2 = v3->Position.x - v1->Position.x;
-		float y2 = v3->Position.y - v1->Position.y;
-		float z2 = v3->Position.z - v1->Position.z;
-
-		// Do the same for vectors relative to triangle uv's
-		float s1 = v2->UV.x - v1->UV.x;
-		float t1 = v2->UV.y - v1->UV.y;
-
-		float s2 = v3->UV.x - v1->UV.x;
-		float t2 = v3->UV.y - v1->UV.y;
-
-		// Create vectors for tangent calculation
-		float r = 1.0f / (s1 * t2 - s2 * t1);
-
-		float tx = (t2 * x1 - t1 * x2) * r;
-		float ty = (t2 * y1 - t1 * y2) * r;
-		float tz = (t2 * z1 - t1 * z2) * r;
-
-		// Adjust tangents of each vert of the triangle
-		v1->Tangent.x += tx;
-		v1->Tangent.y += ty;
-		v1->Tangent.z += tz;
-
-		v2->Tangent.x += tx;
-		v2->Tangent.y += ty;
-		v2->Tangent.z += tz;
-
-		v3->Tangent.x += tx;
-		v3->Tangent.y += ty;
-		v3->Tangent.z += tz;
-	}
-
-	// Ensure all of the tangents are orthogonal to the normals
-	for (int i = 0; i < numVerts; i++)
-	{
-		// Grab the two vectors
-		XMVECTOR normal = XMLoadFloat3(&verts[i].Normal);
-		XMVECTOR tangent = XMLoadFloat3(&verts[i].Tangent);
-
-		// Use Gram-Schmidt orthogonalize
-		tangent = XMVector3Normalize(
-			tangent - normal * XMVector3Dot(normal, tangent));
-
-		// Store the tangent
-		XMStoreFloat3(&verts[i].Tangent, tangent);
-	}
+	MeshLoader::CalculateTangents(verts, numVerts, indices, numIndices);
 }
 
 Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetVertexBuffer()
@@ -356,5 +177,30 @@ Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetIndexBuffer()
 
 int Mesh::GetIndexCount()
 {
-	return numberOfIndices;
+	return lods.empty() ? 0 : (int)lods[0].indexCount;
+}
+
+unsigned int Mesh::GetLODCount()
+{
+	return (unsigned int)lods.size();
+}
+
+const MeshLOD& Mesh::GetLOD(unsigned int level)
+{
+	return lods[level];
+}
+
+DirectX::XMFLOAT3 Mesh::GetBoundsCenter()
+{
+	return boundsCenter;
+}
+
+float Mesh::GetBoundsRadius()
+{
+	return boundsRadius;
+}
+
+std::shared_ptr<MeshBVH> Mesh::GetBVH()
+{
+	return bvh;
 }
@@ -1,8 +1,10 @@
 #pragma once
 #include "Vertex.h"
+#include "MeshLoader.h"
 #include <d3d11.h>
 #include <wrl/client.h>
 #include <fstream>
+#include <memory>
 #include <vector>
 
 class Mesh
@@ -12,7 +14,24 @@ private:
 	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
 	Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
 	// int to hold the number of indices in the index buffer
+	//  - Every level of detail's; see lods for each one's range
 	int numberOfIndices;
+	// Levels of detail, finest first
+	std::vector<MeshLOD> lods;
+	// Bounding sphere around the vertices, in model space
+	DirectX::XMFLOAT3 boundsCenter;
+	float boundsRadius;
+	// Triangles, for ray casts in model space
+	//  - Shared, so copies of the mesh (and anything else that
+	//    casts rays at it, like a RayQuery) don't copy the tree
+	std::shared_ptr<MeshBVH> bvh;
+
+	void CreateBuffers(
+		const Vertex* vertices,
+		int numberOfVertices,
+		const unsigned int* indices,
+		int numberOfIndices,
+		Microsoft::WRL::ComPtr<ID3D11Device> device);
 
 public:
 	Mesh(
@@ -24,12 +43,20 @@ public:
 	Mesh(
 		const char* filename,
 		Microsoft::WRL::ComPtr<ID3D11Device> device);
+	Mesh(
+		MeshData& data,
+		Microsoft::WRL::ComPtr<ID3D11Device> device);
 	~Mesh();
 
 	void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
 
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer();
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer();
-	int GetIndexCount();
+	int GetIndexCount(); // Just the full-detail level's
+	unsigned int GetLODCount();
+	const MeshLOD& GetLOD(unsigned int level);
+	DirectX::XMFLOAT3 GetBoundsCenter();
+	float GetBoundsRadius();
+	std::shared_ptr<MeshBVH> GetBVH();
 };
 
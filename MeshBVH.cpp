@@ -0,0 +1,615 @@
+#include "MeshBVH.h"
+#include "CPUFeatures.h"
+#include "RayPacket.h"
+#include <algorithm>
+#include <float.h>
+#include <string.h>
+
+using namespace DirectX;
+
+// Buckets per axis when looking for the best split
+static const int SplitBins = 16;
+
+// Relative cost of visiting a node, against testing one
+// triangle, for deciding when a leaf is cheaper than a split
+static const float TraversalCost = 2.0f;
+
+// Leaves never hold more than this, however the costs work out
+static const unsigned int MaxLeafSize = 16;
+
+// Triangles whose determinant is smaller than this are seen
+// edge on, and skipped
+static const float ParallelEpsilon = 1e-12f;
+
+static AABB GetNodeBox(const MeshBVH::Node& node)
+{
+	return AABB{
+		XMFLOAT3(node.lower[0], node.lower[1], node.lower[2]),
+		XMFLOAT3(node.upper[0], node.upper[1], node.upper[2]) };
+}
+
+static void SetNodeBox(MeshBVH::Node& node, const AABB& box)
+{
+	node.lower[0] = box.lower.x;
+	node.lower[1] = box.lower.y;
+	node.lower[2] = box.lower.z;
+	node.upper[0] = box.upper.x;
+	node.upper[1] = box.upper.y;
+	node.upper[2] = box.upper.z;
+}
+
+static const XMFLOAT3& GetPosition(const XMFLOAT3* positions, unsigned int stride, unsigned int index)
+{
+	return *(const XMFLOAT3*)((const char*)positions + (size_t)stride * index);
+}
+
+MeshBVH::MeshBVH()
+{
+	packetWidth = HasAVX2() ? 8 : 4;
+}
+
+void MeshBVH::SetPacketWidth(unsigned int width)
+{
+	if (width >= 8 && HasAVX2())
+		packetWidth = 8;
+	else if (width >= 4)
+		packetWidth = 4;
+	else
+		packetWidth = 1;
+}
+
+void MeshBVH::Clear()
+{
+	nodes.clear();
+	triangles.clear();
+	triangleOrder.clear();
+}
+
+// --------------------------------------------------------
+// Copies each triangle's corner and edges out of the mesh,
+// in the order the leaves want them
+//  - Triangles with a corner past the end of the vertices are
+//    left with nothing in them, so no ray ever hits them
+// --------------------------------------------------------
+void MeshBVH::GatherTriangles(const XMFLOAT3* positions, unsigned int vertexCount, unsigned int stride, const unsigned int* indices)
+{
+	triangles.resize(triangleOrder.size());
+	for (size_t i = 0; i < triangleOrder.size(); i++)
+	{
+		const unsigned int* corners = &indices[triangleOrder[i] * 3];
+		if (corners[0] >= vertexCount || corners[1] >= vertexCount || corners[2] >= vertexCount)
+		{
+			memset(&triangles[i], 0, sizeof(Triangle));
+			continue;
+		}
+
+		XMVECTOR a = XMLoadFloat3(&GetPosition(positions, stride, corners[0]));
+		XMVECTOR b = XMLoadFloat3(&GetPosition(positions, stride, corners[1]));
+		XMVECTOR c = XMLoadFloat3(&GetPosition(positions, stride, corners[2]));
+		XMStoreFloat3(&triangles[i].corner, a);
+		XMStoreFloat3(&triangles[i].edge1, b - a);
+		XMStoreFloat3(&triangles[i].edge2, c - a);
+	}
+}
+
+void MeshBVH::Build(const XMFLOAT3* positions, unsigned int vertexCount, unsigned int stride, const unsigned int* indices, unsigned int indexCount)
+{
+	Clear();
+	unsigned int triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	std::vector<BuildItem> items(triangleCount);
+	for (unsigned int t = 0; t < triangleCount; t++)
+	{
+		BuildItem& item = items[t];
+		item.triangle = t;
+		item.box = AABB{
+			XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX),
+			XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX) };
+		for (int corner = 0; corner < 3; corner++)
+		{
+			unsigned int index = indices[t * 3 + corner];
+			XMFLOAT3 p = index < vertexCount ? GetPosition(positions, stride, index) : XMFLOAT3(0, 0, 0);
+			item.box = Union(item.box, AABB{ p, p });
+		}
+		XMFLOAT3 center = GetCenter(item.box);
+		item.center[0] = center.x;
+		item.center[1] = center.y;
+		item.center[2] = center.z;
+	}
+
+	// At most 2n - 1 nodes, which is a lot less once leaves hold
+	// a few triangles each
+	nodes.reserve(triangleCount * 2);
+	nodes.push_back(Node());
+	nodes[0].leftOrFirst = 0;
+	nodes[0].count = triangleCount;
+	Subdivide(items, 0);
+	nodes.shrink_to_fit();
+
+	triangleOrder.resize(triangleCount);
+	for (unsigned int i = 0; i < triangleCount; i++)
+		triangleOrder[i] = items[i].triangle;
+	GatherTriangles(positions, vertexCount, stride, indices);
+}
+
+// --------------------------------------------------------
+// Splits the node's triangles up until splitting stops
+// paying off
+//  - Works from its own stack of nodes rather than recursing,
+//    since a lopsided mesh can make a deep tree
+//  - Each node's triangles are binned by center along all three
+//    axes in one pass, and split at the cheapest bin boundary,
+//    if that's cheaper than testing them all as a leaf
+// --------------------------------------------------------
+void MeshBVH::Subdivide(std::vector<BuildItem>& items, unsigned int nodeIndex)
+{
+	const AABB empty = {
+		XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX),
+		XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX) };
+
+	std::vector<unsigned int> pending;
+	pending.push_back(nodeIndex);
+	while (!pending.empty())
+	{
+		unsigned int index = pending.back();
+		pending.pop_back();
+		unsigned int first = nodes[index].leftOrFirst;
+		unsigned int count = nodes[index].count;
+
+		// Bounds of the boxes, and of their centers, which are
+		// what get binned
+		AABB box = empty;
+		float centerLower[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float centerUpper[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (unsigned int i = first; i < first + count; i++)
+		{
+			const BuildItem& item = items[i];
+			box = Union(box, item.box);
+			for (int axis = 0; axis < 3; axis++)
+			{
+				centerLower[axis] = std::min(centerLower[axis], item.center[axis]);
+				centerUpper[axis] = std::max(centerUpper[axis], item.center[axis]);
+			}
+		}
+		SetNodeBox(nodes[index], box);
+		if (count == 1)
+			continue;
+
+		float scales[3];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float extent = centerUpper[axis] - centerLower[axis];
+			scales[axis] = extent > 0.0f ? SplitBins * 0.9999f / extent : 0.0f;
+		}
+
+		AABB binBoxes[3][SplitBins];
+		unsigned int binCounts[3][SplitBins] = {};
+		for (int axis = 0; axis < 3; axis++)
+		{
+			for (int b = 0; b < SplitBins; b++)
+				binBoxes[axis][b] = empty;
+		}
+		for (unsigned int i = first; i < first + count; i++)
+		{
+			const BuildItem& item = items[i];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				int bin = (int)((item.center[axis] - centerLower[axis]) * scales[axis]);
+				binBoxes[axis][bin] = Union(binBoxes[axis][bin], item.box);
+				binCounts[axis][bin]++;
+			}
+		}
+
+		// Cheapest split over every axis: area * count on each side
+		int bestAxis = -1;
+		int bestSplit = 0;
+		float bestCost = FLT_MAX;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (scales[axis] == 0.0f)
+				continue;
+
+			// Sweep from the right for the costs of the right sides
+			float rightCosts[SplitBins];
+			AABB rightBox = empty;
+			unsigned int rightCount = 0;
+			for (int b = SplitBins - 1; b > 0; b--)
+			{
+				rightBox = Union(rightBox, binBoxes[axis][b]);
+				rightCount += binCounts[axis][b];
+				rightCosts[b] = rightCount > 0 ? HalfArea(rightBox) * rightCount : 0.0f;
+			}
+
+			// Then from the left, splitting before bin b
+			AABB leftBox = empty;
+			unsigned int leftCount = 0;
+			for (int b = 1; b < SplitBins; b++)
+			{
+				leftBox = Union(leftBox, binBoxes[axis][b - 1]);
+				leftCount += binCounts[axis][b - 1];
+				if (leftCount == 0 || leftCount == count)
+					continue;
+
+				float cost = HalfArea(leftBox) * leftCount + rightCosts[b];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = b;
+				}
+			}
+		}
+
+		// Keep it as a leaf if testing everything in it is no
+		// dearer than the split (costs here are relative to the
+		// node's area), unless there's too much in it
+		float leafCost = HalfArea(box) * count;
+		float splitCost = HalfArea(box) * TraversalCost + bestCost;
+		unsigned int middle;
+		if (bestAxis >= 0 && (splitCost < leafCost || count > MaxLeafSize))
+		{
+			float scale = scales[bestAxis];
+			float lower = centerLower[bestAxis];
+			middle = (unsigned int)(std::partition(items.begin() + first, items.begin() + first + count, [=](const BuildItem& item)
+			{
+				return (int)((item.center[bestAxis] - lower) * scale) < bestSplit;
+			}) - items.begin());
+		}
+		else if (count > MaxLeafSize)
+		{
+			// Every center's in the same place, so any split is as good
+			middle = first + count / 2;
+		}
+		else
+			continue;
+
+		unsigned int left = (unsigned int)nodes.size();
+		nodes.push_back(Node());
+		nodes.push_back(Node());
+		nodes[left].leftOrFirst = first;
+		nodes[left].count = middle - first;
+		nodes[left + 1].leftOrFirst = middle;
+		nodes[left + 1].count = first + count - middle;
+		nodes[index].leftOrFirst = left;
+		nodes[index].count = 0;
+		pending.push_back(left + 1);
+		pending.push_back(left);
+	}
+}
+
+// --------------------------------------------------------
+// Checks that every node points somewhere that exists, and
+// that the leaves between them cover each triangle once
+// --------------------------------------------------------
+bool MeshBVH::Load(const Node* nodes, unsigned int nodeCount, const unsigned int* triangleOrder, const XMFLOAT3* positions, unsigned int vertexCount, unsigned int stride, const unsigned int* indices, unsigned int indexCount)
+{
+	Clear();
+	unsigned int triangleCount = indexCount / 3;
+	if (nodeCount == 0 || triangleCount == 0)
+		return false;
+
+	unsigned long long covered = 0;
+	for (unsigned int i = 0; i < nodeCount; i++)
+	{
+		const Node& node = nodes[i];
+		if (node.count > 0)
+		{
+			if (node.leftOrFirst > triangleCount || node.count > triangleCount - node.leftOrFirst)
+				return false;
+			covered += node.count;
+		}
+		else if (node.leftOrFirst <= i || node.leftOrFirst >= nodeCount - 1)
+			return false;
+	}
+	if (covered != triangleCount)
+		return false;
+
+	std::vector<bool> seen(triangleCount, false);
+	for (unsigned int i = 0; i < triangleCount; i++)
+	{
+		unsigned int t = triangleOrder[i];
+		if (t >= triangleCount || seen[t])
+			return false;
+		seen[t] = true;
+	}
+	this->nodes.assign(nodes, nodes + nodeCount);
+	this->triangleOrder.assign(triangleOrder, triangleOrder + triangleCount);
+	GatherTriangles(positions, vertexCount, stride, indices);
+	return true;
+}
+
+float MeshBVH::GetCost()
+{
+	if (nodes.empty() || nodes[0].count > 0)
+		return 0.0f;
+
+	float rootArea = HalfArea(GetNodeBox(nodes[0]));
+	float total = 0.0f;
+	for (const Node& node : nodes)
+	{
+		if (node.count == 0)
+			total += HalfArea(GetNodeBox(node));
+	}
+	return rootArea > 0.0f ? total / rootArea : 0.0f;
+}
+
+// --------------------------------------------------------
+// Slab test against a node's box, where the ray's nearest hit
+// so far is nearest
+// --------------------------------------------------------
+static bool RayIntersectsNode(const Ray& ray, const XMFLOAT3& inverseDirection, const MeshBVH::Node& node, float nearest, float& entry)
+{
+	return RayIntersectsAABB(ray.origin, inverseDirection, GetNodeBox(node), nearest, entry);
+}
+
+bool MeshBVH::RayCast(const Ray& ray, float maxDistance, MeshHit& hit)
+{
+	return Trace<false>(ray, maxDistance, hit);
+}
+
+bool MeshBVH::Occluded(const Ray& ray, float maxDistance)
+{
+	MeshHit hit;
+	return Trace<true>(ray, maxDistance, hit);
+}
+
+// --------------------------------------------------------
+// Walks the tree nearest child first, testing leaves'
+// triangles with Moller-Trumbore (both sides count)
+//  - With AnyHit it returns at the first triangle hit, which
+//    isn't necessarily the nearest
+// --------------------------------------------------------
+template<bool AnyHit>
+bool MeshBVH::Trace(const Ray& ray, float maxDistance, MeshHit& hit)
+{
+	if (nodes.empty())
+		return false;
+
+	XMFLOAT3 inverseDirection = GetInverseDirection(ray.direction);
+	float nearest = maxDistance;
+	bool found = false;
+
+	float entry;
+	if (!RayIntersectsNode(ray, inverseDirection, nodes[0], nearest, entry))
+		return false;
+
+	TraversalStack stack;
+	stack.Push(0, entry);
+	while (!stack.IsEmpty())
+	{
+		unsigned int index;
+		stack.Pop(index, entry);
+		if (entry > nearest)
+			continue;
+
+		const Node& node = nodes[index];
+		if (node.count > 0)
+		{
+			const XMFLOAT3& o = ray.origin;
+			const XMFLOAT3& d = ray.direction;
+			for (unsigned int i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++)
+			{
+				const Triangle& triangle = triangles[i];
+				const XMFLOAT3& e1 = triangle.edge1;
+				const XMFLOAT3& e2 = triangle.edge2;
+
+				float hx = d.y * e2.z - d.z * e2.y;
+				float hy = d.z * e2.x - d.x * e2.z;
+				float hz = d.x * e2.y - d.y * e2.x;
+				float determinant = e1.x * hx + e1.y * hy + e1.z * hz;
+				if (determinant > -ParallelEpsilon && determinant < ParallelEpsilon)
+					continue;
+
+				float inverse = 1.0f / determinant;
+				float sx = o.x - triangle.corner.x;
+				float sy = o.y - triangle.corner.y;
+				float sz = o.z - triangle.corner.z;
+				float u = (sx * hx + sy * hy + sz * hz) * inverse;
+				if (u < 0.0f || u > 1.0f)
+					continue;
+
+				float qx = sy * e1.z - sz * e1.y;
+				float qy = sz * e1.x - sx * e1.z;
+				float qz = sx * e1.y - sy * e1.x;
+				float v = (d.x * qx + d.y * qy + d.z * qz) * inverse;
+				if (v < 0.0f || u + v > 1.0f)
+					continue;
+
+				float t = (e2.x * qx + e2.y * qy + e2.z * qz) * inverse;
+				if (t < 0.0f || t > nearest)
+					continue;
+
+				nearest = t;
+				hit.triangle = triangleOrder[i];
+				hit.distance = t;
+				hit.u = u;
+				hit.v = v;
+				found = true;
+				if (AnyHit)
+					return true;
+			}
+			continue;
+		}
+
+		// Push the further child first, so the nearer one's next
+		unsigned int left = node.leftOrFirst;
+		float entries[2];
+		bool hits[2];
+		for (int c = 0; c < 2; c++)
+			hits[c] = RayIntersectsNode(ray, inverseDirection, nodes[left + c], nearest, entries[c]);
+
+		int nearChild = hits[0] && (!hits[1] || entries[0] <= entries[1]) ? 0 : 1;
+		if (hits[1 - nearChild])
+			stack.Push(left + 1 - nearChild, entries[1 - nearChild]);
+		if (hits[nearChild])
+			stack.Push(left + nearChild, entries[nearChild]);
+	}
+
+	return found;
+}
+
+unsigned int MeshBVH::RayCastPacket(const Ray* rays, unsigned int count, float maxDistance, MeshHit* results, bool* hits)
+{
+	// Packets of the same distance, a packet at a time
+	float maxDistances[8] = { maxDistance, maxDistance, maxDistance, maxDistance, maxDistance, maxDistance, maxDistance, maxDistance };
+	unsigned int hitCount = 0;
+	for (unsigned int first = 0; first < count; first += 8)
+	{
+		unsigned int packet = std::min(count - first, 8u);
+		float distances[8];
+		memcpy(distances, maxDistances, sizeof(distances));
+		hitCount += RayCastPacket(&rays[first], packet, distances, &results[first], &hits[first]);
+	}
+	return hitCount;
+}
+
+unsigned int MeshBVH::RayCastPacket(const Ray* rays, unsigned int count, float* maxDistances, MeshHit* results, bool* hits)
+{
+	if (packetWidth == 8)
+		RayCastPacket<Lanes8>(rays, count, maxDistances, results, hits);
+	else if (packetWidth == 4)
+		RayCastPacket<Lanes4>(rays, count, maxDistances, results, hits);
+	else
+	{
+		for (unsigned int i = 0; i < count; i++)
+		{
+			hits[i] = maxDistances[i] >= 0.0f && RayCast(rays[i], maxDistances[i], results[i]);
+			if (hits[i])
+				maxDistances[i] = results[i].distance;
+		}
+	}
+
+	unsigned int hitCount = 0;
+	for (unsigned int i = 0; i < count; i++)
+		hitCount += hits[i] ? 1 : 0;
+	return hitCount;
+}
+
+// --------------------------------------------------------
+// Walks the tree once for each packet of rays, one ray per
+// lane, visiting a node if any ray in the packet hits its box
+//  - Children are visited nearest first, going by the nearest
+//    entry of any ray that hits them, and nodes that start past
+//    every ray's nearest hit so far are dropped
+//  - Each leaf triangle is tested against the whole packet at
+//    once, with the same test as Trace()
+// --------------------------------------------------------
+template<typename Lanes>
+void MeshBVH::RayCastPacket(const Ray* rays, unsigned int count, float* maxDistances, MeshHit* results, bool* hits)
+{
+	typedef typename Lanes::Value Value;
+	const unsigned int Width = Lanes::Width;
+	const unsigned int NoTriangle = 0xFFFFFFFF;
+
+	for (unsigned int first = 0; first < count; first += Width)
+	{
+		unsigned int lanes = std::min(count - first, Width);
+		for (unsigned int lane = 0; lane < lanes; lane++)
+			hits[first + lane] = false;
+		if (nodes.empty())
+			continue;
+
+		RayPacket<Lanes> packet(&rays[first], lanes, &maxDistances[first]);
+		const Value zero = Lanes::Set(0.0f);
+		const Value one = Lanes::Set(1.0f);
+		Value hitTriangle = Lanes::FromBits(NoTriangle);
+		Value hitU = zero;
+		Value hitV = zero;
+
+		TraversalStack stack;
+		float entry;
+		if (packet.TestBox(nodes[0].lower, nodes[0].upper, entry))
+			stack.Push(0, entry);
+		float furthest = packet.GetFurthest();
+		while (!stack.IsEmpty())
+		{
+			unsigned int index;
+			stack.Pop(index, entry);
+			if (entry > furthest)
+				continue;
+
+			const Node& node = nodes[index];
+			if (node.count > 0)
+			{
+				for (unsigned int i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++)
+				{
+					const Triangle& triangle = triangles[i];
+					Value e1x = Lanes::Set(triangle.edge1.x), e1y = Lanes::Set(triangle.edge1.y), e1z = Lanes::Set(triangle.edge1.z);
+					Value e2x = Lanes::Set(triangle.edge2.x), e2y = Lanes::Set(triangle.edge2.y), e2z = Lanes::Set(triangle.edge2.z);
+
+					Value hx = Lanes::Sub(Lanes::Mul(packet.directionY, e2z), Lanes::Mul(packet.directionZ, e2y));
+					Value hy = Lanes::Sub(Lanes::Mul(packet.directionZ, e2x), Lanes::Mul(packet.directionX, e2z));
+					Value hz = Lanes::Sub(Lanes::Mul(packet.directionX, e2y), Lanes::Mul(packet.directionY, e2x));
+					Value determinant = Lanes::Add(Lanes::Add(Lanes::Mul(e1x, hx), Lanes::Mul(e1y, hy)), Lanes::Mul(e1z, hz));
+					Value inverse = Lanes::Div(one, determinant);
+
+					Value sx = Lanes::Sub(packet.originX, Lanes::Set(triangle.corner.x));
+					Value sy = Lanes::Sub(packet.originY, Lanes::Set(triangle.corner.y));
+					Value sz = Lanes::Sub(packet.originZ, Lanes::Set(triangle.corner.z));
+					Value u = Lanes::Mul(Lanes::Add(Lanes::Add(Lanes::Mul(sx, hx), Lanes::Mul(sy, hy)), Lanes::Mul(sz, hz)), inverse);
+
+					Value qx = Lanes::Sub(Lanes::Mul(sy, e1z), Lanes::Mul(sz, e1y));
+					Value qy = Lanes::Sub(Lanes::Mul(sz, e1x), Lanes::Mul(sx, e1z));
+					Value qz = Lanes::Sub(Lanes::Mul(sx, e1y), Lanes::Mul(sy, e1x));
+					Value v = Lanes::Mul(Lanes::Add(Lanes::Add(Lanes::Mul(packet.directionX, qx), Lanes::Mul(packet.directionY, qy)), Lanes::Mul(packet.directionZ, qz)), inverse);
+					Value t = Lanes::Mul(Lanes::Add(Lanes::Add(Lanes::Mul(e2x, qx), Lanes::Mul(e2y, qy)), Lanes::Mul(e2z, qz)), inverse);
+
+					// Comparisons with NaN are false, so a ray that's edge
+					// on (an infinite inverse) drops out here too
+					Value absolute = Lanes::Max(determinant, Lanes::Sub(zero, determinant));
+					Value hit = Lanes::Less(Lanes::Set(ParallelEpsilon), absolute);
+					hit = Lanes::And(hit, Lanes::LessEqual(zero, u));
+					hit = Lanes::And(hit, Lanes::LessEqual(zero, v));
+					hit = Lanes::And(hit, Lanes::LessEqual(Lanes::Add(u, v), one));
+					hit = Lanes::And(hit, Lanes::LessEqual(zero, t));
+					hit = Lanes::And(hit, Lanes::LessEqual(t, packet.nearest));
+					if (Lanes::Mask(hit) == 0)
+						continue;
+
+					packet.nearest = Lanes::Select(hit, t, packet.nearest);
+					hitU = Lanes::Select(hit, u, hitU);
+					hitV = Lanes::Select(hit, v, hitV);
+					hitTriangle = Lanes::Select(hit, Lanes::FromBits(triangleOrder[i]), hitTriangle);
+				}
+				furthest = packet.GetFurthest();
+				continue;
+			}
+
+			// Push the further child first, so the nearer one's next
+			unsigned int left = node.leftOrFirst;
+			float entries[2];
+			bool childHits[2];
+			for (int c = 0; c < 2; c++)
+				childHits[c] = packet.TestBox(nodes[left + c].lower, nodes[left + c].upper, entries[c]) != 0;
+
+			int nearChild = childHits[0] && (!childHits[1] || entries[0] <= entries[1]) ? 0 : 1;
+			if (childHits[1 - nearChild])
+				stack.Push(left + 1 - nearChild, entries[1 - nearChild]);
+			if (childHits[nearChild])
+				stack.Push(left + nearChild, entries[nearChild]);
+		}
+
+		float distances[Width], us[Width], vs[Width], triangleBits[Width];
+		unsigned int triangleIndices[Width];
+		Lanes::Store(distances, packet.nearest);
+		Lanes::Store(us, hitU);
+		Lanes::Store(vs, hitV);
+		Lanes::Store(triangleBits, hitTriangle);
+		memcpy(triangleIndices, triangleBits, sizeof(triangleIndices));
+		for (unsigned int lane = 0; lane < lanes; lane++)
+		{
+			hits[first + lane] = triangleIndices[lane] != NoTriangle;
+			if (!hits[first + lane])
+				continue;
+
+			MeshHit& hit = results[first + lane];
+			hit.triangle = triangleIndices[lane];
+			hit.distance = distances[lane];
+			hit.u = us[lane];
+			hit.v = vs[lane];
+			maxDistances[first + lane] = distances[lane];
+		}
+	}
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+#include "Collision.h"
+
+// Where a ray hit a mesh
+//  - triangle is the triangle's index in the mesh's own index
+//    list (its indices start at triangle * 3)
+//  - u and v are the barycentrics of the triangle's second and
+//    third corners at the hit
+struct MeshHit
+{
+	unsigned int triangle;
+	float distance;
+	float u, v;
+};
+
+// --------------------------------------------------------
+// Bounding volume hierarchy over one mesh's triangles, for
+// exact ray casts against it in model space
+//  - Built once from the CPU-side vertex and index data with a
+//    binned SAH split, and never changed after that; the asset
+//    cooker builds it offline and stores it in the .cmesh, so
+//    loading one is just a copy
+//  - Nodes are 32 bytes, two to a cache line: a box, and either
+//    where the children are or which triangles are in the leaf
+//  - Keeps its own copy of each triangle's corner and edges, in
+//    leaf order, so the mesh's vertices can go once they're
+//    uploaded
+//  - RayCast() traces a single ray; RayCastPacket() traces them
+//    8 at a time with AVX2 (4 with SSE without it), walking the
+//    tree once for each group, which pays off when the rays are
+//    coherent - a screen's worth of picks, or sight lines from
+//    one point
+//  - Immutable once built, so any number of threads can trace
+//    against it at once
+// --------------------------------------------------------
+class MeshBVH
+{
+public:
+	// 32 bytes; an internal node's children are next to each
+	// other, at leftOrFirst and leftOrFirst + 1
+	struct Node
+	{
+		float lower[3];
+		unsigned int leftOrFirst;	// First child, or first triangle for leaves
+		float upper[3];
+		unsigned int count;			// Triangles in the leaf; 0 for internal nodes
+	};
+
+	MeshBVH();
+
+	// Positions are read stride bytes apart, so they can come
+	// straight out of a vertex array
+	void Build(const DirectX::XMFLOAT3* positions, unsigned int vertexCount, unsigned int stride, const unsigned int* indices, unsigned int indexCount);
+
+	// Takes a tree made by Build() somewhere else (see GetNodes()
+	// and GetTriangleOrder()), for the same positions and indices
+	//  - Returns false, and stays empty, if it doesn't fit them
+	bool Load(const Node* nodes, unsigned int nodeCount, const unsigned int* triangleOrder, const DirectX::XMFLOAT3* positions, unsigned int vertexCount, unsigned int stride, const unsigned int* indices, unsigned int indexCount);
+
+	void Clear();
+	bool IsEmpty() { return nodes.empty(); }
+
+	// What Load() needs, for writing out
+	unsigned int GetNodeCount() { return (unsigned int)nodes.size(); }
+	const Node* GetNodes() { return nodes.data(); }
+	unsigned int GetTriangleCount() { return (unsigned int)triangleOrder.size(); }
+	const unsigned int* GetTriangleOrder() { return triangleOrder.data(); }
+
+	// Sum of internal nodes' areas, relative to the root's - the
+	// expected number of nodes a random ray visits, near enough
+	float GetCost();
+
+	// Nearest hit within maxDistance, if any
+	bool RayCast(const Ray& ray, float maxDistance, MeshHit& hit);
+
+	// Whether anything is hit within maxDistance, stopping at the
+	// first triangle found - for sight lines
+	bool Occluded(const Ray& ray, float maxDistance);
+
+	// Casts count rays, a packet at a time, writing whether each
+	// one hit to hits[i] and where to results[i]
+	//  - Returns how many hit
+	unsigned int RayCastPacket(const Ray* rays, unsigned int count, float maxDistance, MeshHit* results, bool* hits);
+
+	// The same, with a distance per ray, which is brought in to
+	// the hit for the rays that hit (a negative one skips the ray)
+	unsigned int RayCastPacket(const Ray* rays, unsigned int count, float* maxDistances, MeshHit* results, bool* hits);
+
+	// Packets can be turned off (or forced down to 4 wide) for
+	// comparison; 8 wide needs AVX2
+	void SetPacketWidth(unsigned int width);
+	unsigned int GetPacketWidth() { return packetWidth; }
+
+private:
+	// A triangle as the intersection test wants it
+	struct Triangle
+	{
+		DirectX::XMFLOAT3 corner;
+		DirectX::XMFLOAT3 edge1;
+		DirectX::XMFLOAT3 edge2;
+	};
+
+	// Scratch for Build()
+	struct BuildItem
+	{
+		AABB box;
+		float center[3];
+		unsigned int triangle;
+	};
+
+	std::vector<Node> nodes;
+	std::vector<Triangle> triangles;		// In leaf order
+	std::vector<unsigned int> triangleOrder;	// Original index of each of those
+	unsigned int packetWidth;
+
+	void GatherTriangles(const DirectX::XMFLOAT3* positions, unsigned int vertexCount, unsigned int stride, const unsigned int* indices);
+	void Subdivide(std::vector<BuildItem>& items, unsigned int nodeIndex);
+
+	template<typename Lanes> void RayCastPacket(const Ray* rays, unsigned int count, float* maxDistances, MeshHit* results, bool* hits);
+	template<bool AnyHit> bool Trace(const Ray& ray, float maxDistance, MeshHit& hit);
+};
@@ -0,0 +1,613 @@
+#include "MeshLoader.h"
+#include <fstream>
+#include <string.h>
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+#include <unordered_map>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Header at the front of every cooked mesh file
+//  - Followed directly by vertexCount Vertex structs and
+//    then indexCount 32-bit indices (every level of detail),
+//    ready for upload
+//  - Then lodCount MeshLODs; with none, the indices are all
+//    one level
+//  - Then, if bvhNodeCount isn't 0, the triangle BVH's nodes
+//    and its triangle order (a 32-bit index for each triangle
+//    of the full-detail level)
+// --------------------------------------------------------
+struct CookedMeshHeader
+{
+	unsigned int magic;		// Always 'CMSH'
+	unsigned int version;	// MeshLoader::CookedMeshVersion
+	unsigned int vertexSize;// sizeof(Vertex) when cooked
+	unsigned int vertexCount;
+	unsigned int indexCount;
+	unsigned int bvhNodeCount;
+	unsigned int lodCount;
+};
+
+static const unsigned int CookedMeshMagic = 0x48534D43; // "CMSH" in little endian
+
+// Grid cells across the mesh's longest side for the first
+// level of detail's clustering; each level after halves it
+static const unsigned int LODStartResolution = 256;
+
+// Resolutions that don't bring the triangle count below this
+// much of the last level's are skipped
+static const float LODReduction = 0.6f;
+
+// --------------------------------------------------------
+// Reads an entire file into memory
+// --------------------------------------------------------
+static bool ReadWholeFile(const char* filename, std::vector<char>& data)
+{
+	std::ifstream file(filename, std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+		return false;
+
+	std::streamsize size = file.tellg();
+	file.seekg(0, std::ios::beg);
+	data.resize((size_t)size);
+	return size == 0 || file.read(&data[0], size).good();
+}
+
+// --------------------------------------------------------
+// Loads an OBJ file from disk
+//  - See ParseOBJ() for details
+// --------------------------------------------------------
+bool MeshLoader::LoadOBJ(const char* filename, std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	std::vector<char> data;
+	if (!ReadWholeFile(filename, data) || data.empty())
+		return false;
+
+	return ParseOBJ(&data[0], data.size(), verts, indices);
+}
+
+// --------------------------------------------------------
+// Parses an OBJ file that is already in memory
+//  - Converts from right-handed to left-handed space and
+//    calculates tangents, so the results can go straight
+//    into vertex and index buffers
+// --------------------------------------------------------
+bool MeshLoader::ParseOBJ(const char* data, size_t size, std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	// Variables used while reading the file
+	std::vector<XMFLOAT3> positions;     // Positions from the file
+	std::vector<XMFLOAT3> normals;       // Normals from the file
+	std::vector<XMFLOAT2> uvs;           // UVs from the file
+	unsigned int vertCounter = 0;        // Count of vertices/indices
+	char chars[100];                     // String for line reading
+
+	verts.clear();
+	indices.clear();
+
+	// Still have data left?
+	const char* end = data + size;
+	while (data < end)
+	{
+		// Get the line (100 characters should be more than enough)
+		const char* lineEnd = (const char*)memchr(data, '\n', end - data);
+		if (!lineEnd)
+			lineEnd = end;
+		size_t length = std::min((size_t)(lineEnd - data), sizeof(chars) - 1);
+		memcpy(chars, data, length);
+		chars[length] = 0;
+		data = lineEnd + 1;
+
+		// Check the type of line
+		if (chars[0] == 'v' && chars[1] == 'n')
+		{
+			// Read the 3 numbers directly into an XMFLOAT3
+			XMFLOAT3 norm;
+			sscanf_s(
+				chars,
+				"vn %f %f %f",
+				&norm.x, &norm.y, &norm.z);
+
+			// Add to the list of normals
+			normals.push_back(norm);
+		}
+		else if (chars[0] == 'v' && chars[1] == 't')
+		{
+			// Read the 2 numbers directly into an XMFLOAT2
+			XMFLOAT2 uv;
+			sscanf_s(
+				chars,
+				"vt %f %f",
+				&uv.x, &uv.y);
+
+			// Add to the list of uv's
+			uvs.push_back(uv);
+		}
+		else if (chars[0] == 'v')
+		{
+			// Read the 3 numbers directly into an XMFLOAT3
+			XMFLOAT3 pos;
+			sscanf_s(
+				chars,
+				"v %f %f %f",
+				&pos.x, &pos.y, &pos.z);
+
+			// Add to the positions
+			positions.push_back(pos);
+		}
+		else if (chars[0] == 'f')
+		{
+			// Read the face indices into an array
+			// NOTE: This assumes the given obj file contains
+			//  vertex positions, uv coordinates AND normals.
+			//  If the model is missing any of these, this 
+			//  code will not handle the file correctly!
+			unsigned int i[12];
+			int facesRead = sscanf_s(
+				chars,
+				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
+				&i[0], &i[1], &i[2],
+				&i[3], &i[4], &i[5],
+				&i[6], &i[7], &i[8],
+				&i[9], &i[10], &i[11]);
+
+			// - Create the verts by looking up
+			//    corresponding data from vectors
+			// - OBJ File indices are 1-based, so
+			//    they need to be adusted
+			Vertex v1;
+			v1.Position = positions[i[0] - 1];
+			v1.UV = uvs[i[1] - 1];
+			v1.Normal = normals[i[2] - 1];
+
+			Vertex v2;
+			v2.Position = positions[i[3] - 1];
+			v2.UV = uvs[i[4] - 1];
+			v2.Normal = normals[i[5] - 1];
+
+			Vertex v3;
+			v3.Position = positions[i[6] - 1];
+			v3.UV = uvs[i[7] - 1];
+			v3.Normal = normals[i[8] - 1];
+
+			// The model is most likely in a right-handed space,
+			// especially if it came from Maya.  We want to convert
+			// to a left-handed space for DirectX.  This means we 
+			// need to:
+			//  - Invert the Z position
+			//  - Invert the normal's Z
+			//  - Flip the winding order
+			// We also need to flip the UV coordinate since DirectX
+			// defines (0,0) as the top left of the texture, and many
+			// 3D modeling packages use the bottom left as (0,0)
+
+			// Flip the UV's since they're probably "upside down"
+			v1.UV.y = 1.0f - v1.UV.y;
+			v2.UV.y = 1.0f - v2.UV.y;
+			v3.UV.y = 1.0f - v3.UV.y;
+
+			// Flip Z (LH vs. RH)
+			v1.Position.z *= -1.0f;
+			v2.Position.z *= -1.0f;
+			v3.Position.z *= -1.0f;
+
+			// Flip normal Z
+			v1.Normal.z *= -1.0f;
+			v2.Normal.z *= -1.0f;
+			v3.Normal.z *= -1.0f;
+
+			// Add the verts to the vector (flipping the winding order)
+			verts.push_back(v1);
+			verts.push_back(v3);
+			verts.push_back(v2);
+
+			// Add three more indices
+			indices.push_back(vertCounter); vertCounter += 1;
+			indices.push_back(vertCounter); vertCounter += 1;
+			indices.push_back(vertCounter); vertCounter += 1;
+
+			// Was there a 4th face?
+			if (facesRead == 12)
+			{
+				// Make the last vertex
+				Vertex v4;
+				v4.Position = positions[i[9] - 1];
+				v4.UV = uvs[i[10] - 1];
+				v4.Normal = normals[i[11] - 1];
+
+				// Flip the UV, Z pos and normal
+				v4.UV.y = 1.0f - v4.UV.y;
+				v4.Position.z *= -1.0f;
+				v4.Normal.z *= -1.0f;
+
+				// Add a whole triangle (flipping the winding order)
+				verts.push_back(v1);
+				verts.push_back(v4);
+				verts.push_back(v3);
+
+				// Add three more indices
+				indices.push_back(vertCounter); vertCounter += 1;
+				indices.push_back(vertCounter); vertCounter += 1;
+				indices.push_back(vertCounter); vertCounter += 1;
+			}
+		}
+	}
+
+	// Nothing usable in the file?
+	if (vertCounter == 0)
+		return false;
+
+	// - "vertCounter" is BOTH the number of vertices and the number of indices
+	// - Yes, the indices are a bit redundant here (one per vertex).  Could you skip using
+	//    an index buffer in this case?  Sure!  Though, if your mesh class assumes you have
+	//    one, you'll need to write some extra code to handle cases when you don't.
+	CalculateTangents(&verts[0], vertCounter, &indices[0], vertCounter);
+	return true;
+}
+
+// --------------------------------------------------------
+// Loads a mesh written by WriteCookedMesh()
+//  - No parsing or tangent generation: the file is just
+//    the vertex and index data in their final layout
+// --------------------------------------------------------
+bool MeshLoader::LoadCookedMesh(const char* filename, std::vector<Vertex>& verts, std::vector<unsigned int>& indices, MeshBVH* bvh, std::vector<MeshLOD>* lods)
+{
+	std::vector<char> data;
+	if (!ReadWholeFile(filename, data) || data.empty())
+		return false;
+
+	return ParseCookedMesh(&data[0], data.size(), verts, indices, bvh, lods);
+}
+
+// --------------------------------------------------------
+// Same as LoadCookedMesh(), but from a file already in memory
+//  - A BVH that doesn't fit the mesh is ignored rather than
+//    failing the load, since the mesh can still be drawn; levels
+//    of detail that don't fit the indices fail it, since it
+//    can't be drawn without knowing where they are
+// --------------------------------------------------------
+bool MeshLoader::ParseCookedMesh(const char* data, size_t size, std::vector<Vertex>& verts, std::vector<unsigned int>& indices, MeshBVH* bvh, std::vector<MeshLOD>* lods)
+{
+	// Validate the header before trusting any counts
+	CookedMeshHeader header = {};
+	if (size < sizeof(CookedMeshHeader))
+		return false;
+	memcpy(&header, data, sizeof(CookedMeshHeader));
+
+	if (header.magic != CookedMeshMagic ||
+		header.version != CookedMeshVersion ||
+		header.vertexSize != sizeof(Vertex) ||
+		header.vertexCount == 0 ||
+		header.indexCount == 0)
+		return false;
+
+	size_t vertexBytes = sizeof(Vertex) * header.vertexCount;
+	size_t indexBytes = sizeof(unsigned int) * header.indexCount;
+	size_t lodBytes = sizeof(MeshLOD) * header.lodCount;
+	size_t lodOffset = sizeof(CookedMeshHeader) + vertexBytes + indexBytes;
+	if (header.lodCount > MaxLODs || size < lodOffset + lodBytes)
+		return false;
+
+	std::vector<MeshLOD> fileLODs(header.lodCount);
+	if (header.lodCount > 0)
+		memcpy(&fileLODs[0], data + lodOffset, lodBytes);
+	for (const MeshLOD& lod : fileLODs)
+	{
+		if (lod.indexCount == 0 || lod.indexCount % 3 != 0 ||
+			lod.firstIndex > header.indexCount || lod.indexCount > header.indexCount - lod.firstIndex)
+			return false;
+	}
+	unsigned int fullIndexCount = fileLODs.empty() ? header.indexCount : fileLODs[0].indexCount;
+
+	verts.resize(header.vertexCount);
+	indices.resize(header.indexCount);
+	memcpy(&verts[0], data + sizeof(CookedMeshHeader), vertexBytes);
+	memcpy(&indices[0], data + sizeof(CookedMeshHeader) + vertexBytes, indexBytes);
+
+	if (bvh)
+	{
+		bvh->Clear();
+		size_t nodeBytes = sizeof(MeshBVH::Node) * header.bvhNodeCount;
+		size_t orderBytes = sizeof(unsigned int) * (fullIndexCount / 3);
+		size_t bvhOffset = lodOffset + lodBytes;
+		if (header.bvhNodeCount > 0 && (fileLODs.empty() || fileLODs[0].firstIndex == 0) && size >= bvhOffset + nodeBytes + orderBytes)
+		{
+			std::vector<MeshBVH::Node> nodes(header.bvhNodeCount);
+			std::vector<unsigned int> order(fullIndexCount / 3);
+			memcpy(&nodes[0], data + bvhOffset, nodeBytes);
+			if (!order.empty())
+				memcpy(&order[0], data + bvhOffset + nodeBytes, orderBytes);
+			bvh->Load(&nodes[0], header.bvhNodeCount, order.data(), &verts[0].Position, header.vertexCount, sizeof(Vertex), &indices[0], fullIndexCount);
+		}
+	}
+
+	// Without anywhere to put the levels, only the full one is kept
+	if (lods)
+		*lods = fileLODs;
+	else if (!fileLODs.empty())
+	{
+		std::vector<unsigned int> fullIndices(indices.begin() + fileLODs[0].firstIndex, indices.begin() + fileLODs[0].firstIndex + fullIndexCount);
+		indices.swap(fullIndices);
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Writes vertex and index data in the cooked runtime format,
+// along with the levels of detail and BVH if there are any
+// --------------------------------------------------------
+bool MeshLoader::WriteCookedMesh(const char* filename, const std::vector<Vertex>& verts, const std::vector<unsigned int>& indices, MeshBVH* bvh, const std::vector<MeshLOD>* lods)
+{
+	if (verts.empty() || indices.empty())
+		return false;
+
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return false;
+
+	CookedMeshHeader header = {};
+	header.magic = CookedMeshMagic;
+	header.version = CookedMeshVersion;
+	header.vertexSize = sizeof(Vertex);
+	header.vertexCount = (unsigned int)verts.size();
+	header.indexCount = (unsigned int)indices.size();
+	header.lodCount = lods ? (unsigned int)std::min(lods->size(), (size_t)MaxLODs) : 0;
+	size_t fullIndexCount = header.lodCount > 0 ? (*lods)[0].indexCount : indices.size();
+	header.bvhNodeCount = bvh && bvh->GetTriangleCount() == fullIndexCount / 3 ? bvh->GetNodeCount() : 0;
+
+	file.write((const char*)&header, sizeof(CookedMeshHeader));
+	file.write((const char*)&verts[0], sizeof(Vertex) * verts.size());
+	file.write((const char*)&indices[0], sizeof(unsigned int) * indices.size());
+	if (header.lodCount > 0)
+		file.write((const char*)lods->data(), sizeof(MeshLOD) * header.lodCount);
+	if (header.bvhNodeCount > 0)
+	{
+		file.write((const char*)bvh->GetNodes(), sizeof(MeshBVH::Node) * header.bvhNodeCount);
+		file.write((const char*)bvh->GetTriangleOrder(), sizeof(unsigned int) * bvh->GetTriangleCount());
+	}
+	return file.good();
+}
+
+// --------------------------------------------------------
+// Builds the BVH straight from the vertices' positions
+// --------------------------------------------------------
+void MeshLoader::BuildBVH(const std::vector<Vertex>& verts, const std::vector<unsigned int>& indices, MeshBVH& bvh, const std::vector<MeshLOD>* lods)
+{
+	unsigned int first = lods && !lods->empty() ? (*lods)[0].firstIndex : 0;
+	unsigned int count = lods && !lods->empty() ? (*lods)[0].indexCount : (unsigned int)indices.size();
+	if (verts.empty() || count == 0 || first + count > indices.size())
+	{
+		bvh.Clear();
+		return;
+	}
+
+	bvh.Build(&verts[0].Position, (unsigned int)verts.size(), sizeof(Vertex), &indices[first], count);
+}
+
+// --------------------------------------------------------
+// Makes each coarser level by snapping every vertex to one
+// vertex in its cell of a grid over the mesh, and dropping
+// the triangles that collapse
+//  - The vertex kept for a cell is the one nearest the average
+//    of the cell's vertices, so every level still uses the
+//    full-detail vertex buffer as is
+//  - Each grid is half the resolution of the last one tried;
+//    a level is kept once its triangles are down to
+//    LODReduction of the last level's, so levels are spaced
+//    out whatever the mesh's density
+//  - A level's error is the furthest any vertex was moved
+//  - Triangles are rotated to start at their lowest index and
+//    sorted, which drops duplicates (common where the OBJ
+//    loader split vertices along seams) and keeps ones sharing
+//    vertices near each other
+// --------------------------------------------------------
+void MeshLoader::BuildLODs(const std::vector<Vertex>& verts, std::vector<unsigned int>& indices, std::vector<MeshLOD>& lods)
+{
+	lods.clear();
+	if (verts.empty() || indices.empty())
+		return;
+
+	unsigned int fullIndexCount = (unsigned int)indices.size();
+	lods.push_back(MeshLOD{ 0, fullIndexCount, 0.0f });
+
+	XMFLOAT3 lower = verts[0].Position;
+	XMFLOAT3 upper = verts[0].Position;
+	for (const Vertex& vertex : verts)
+	{
+		lower = XMFLOAT3(std::min(lower.x, vertex.Position.x), std::min(lower.y, vertex.Position.y), std::min(lower.z, vertex.Position.z));
+		upper = XMFLOAT3(std::max(upper.x, vertex.Position.x), std::max(upper.y, vertex.Position.y), std::max(upper.z, vertex.Position.z));
+	}
+	float extent = std::max(upper.x - lower.x, std::max(upper.y - lower.y, upper.z - lower.z));
+	if (extent <= 0.0f)
+		return;
+
+	struct Cell
+	{
+		XMFLOAT3 sum;
+		unsigned int count;
+		unsigned int vertex;
+		float nearest;
+	};
+	struct Triangle
+	{
+		unsigned int a, b, c;
+		bool operator<(const Triangle& other) const { return a != other.a ? a < other.a : b != other.b ? b < other.b : c < other.c; }
+		bool operator==(const Triangle& other) const { return a == other.a && b == other.b && c == other.c; }
+	};
+
+	unsigned int vertexCount = (unsigned int)verts.size();
+	std::vector<unsigned int> vertexCells(vertexCount);
+	std::vector<Cell> cells;
+	std::unordered_map<unsigned long long, unsigned int> cellLookup;
+	std::vector<Triangle> triangles;
+	unsigned int lastTriangleCount = fullIndexCount / 3;
+
+	for (unsigned int resolution = LODStartResolution; resolution >= 2 && lods.size() < MaxLODs; resolution /= 2)
+	{
+		// Which cell each vertex is in, and the average of each cell
+		float scale = resolution / extent;
+		cells.clear();
+		cellLookup.clear();
+		for (unsigned int v = 0; v < vertexCount; v++)
+		{
+			const XMFLOAT3& position = verts[v].Position;
+			unsigned long long x = std::min((unsigned int)((position.x - lower.x) * scale), resolution - 1);
+			unsigned long long y = std::min((unsigned int)((position.y - lower.y) * scale), resolution - 1);
+			unsigned long long z = std::min((unsigned int)((position.z - lower.z) * scale), resolution - 1);
+			auto inserted = cellLookup.emplace(x | (y << 21) | (z << 42), (unsigned int)cells.size());
+			if (inserted.second)
+				cells.push_back(Cell{ XMFLOAT3(0, 0, 0), 0, v, FLT_MAX });
+
+			Cell& cell = cells[inserted.first->second];
+			cell.sum = XMFLOAT3(cell.sum.x + position.x, cell.sum.y + position.y, cell.sum.z + position.z);
+			cell.count++;
+			vertexCells[v] = inserted.first->second;
+		}
+
+		for (unsigned int v = 0; v < vertexCount; v++)
+		{
+			Cell& cell = cells[vertexCells[v]];
+			const XMFLOAT3& position = verts[v].Position;
+			float x = position.x - cell.sum.x / cell.count;
+			float y = position.y - cell.sum.y / cell.count;
+			float z = position.z - cell.sum.z / cell.count;
+			float distance = x * x + y * y + z * z;
+			if (distance < cell.nearest)
+			{
+				cell.nearest = distance;
+				cell.vertex = v;
+			}
+		}
+
+		// Snap the full-detail triangles, keeping the ones left whole
+		triangles.clear();
+		for (unsigned int i = 0; i + 2 < fullIndexCount; i += 3)
+		{
+			unsigned int a = indices[i], b = indices[i + 1], c = indices[i + 2];
+			if (a >= vertexCount || b >= vertexCount || c >= vertexCount)
+				continue;
+
+			a = cells[vertexCells[a]].vertex;
+			b = cells[vertexCells[b]].vertex;
+			c = cells[vertexCells[c]].vertex;
+			if (a == b || b == c || c == a)
+				continue;
+
+			if (b < a && b < c)
+				triangles.push_back(Triangle{ b, c, a });
+			else if (c < a && c < b)
+				triangles.push_back(Triangle{ c, a, b });
+			else
+				triangles.push_back(Triangle{ a, b, c });
+		}
+		std::sort(triangles.begin(), triangles.end());
+		triangles.erase(std::unique(triangles.begin(), triangles.end()), triangles.end());
+
+		unsigned int triangleCount = (unsigned int)triangles.size();
+		if (triangleCount == 0)
+			break;
+		if (triangleCount > lastTriangleCount * LODReduction)
+			continue;
+
+		float error = 0.0f;
+		for (unsigned int v = 0; v < vertexCount; v++)
+		{
+			const XMFLOAT3& position = verts[v].Position;
+			const XMFLOAT3& snapped = verts[cells[vertexCells[v]].vertex].Position;
+			float x = position.x - snapped.x;
+			float y = position.y - snapped.y;
+			float z = position.z - snapped.z;
+			error = std::max(error, x * x + y * y + z * z);
+		}
+
+		lods.push_back(MeshLOD{ (unsigned int)indices.size(), triangleCount * 3, sqrtf(error) });
+		for (const Triangle& triangle : triangles)
+		{
+			indices.push_back(triangle.a);
+			indices.push_back(triangle.b);
+			indices.push_back(triangle.c);
+		}
+		lastTriangleCount = triangleCount;
+	}
+}
+
+// Calculates the tangents of the vertices in a mesh
+// - Code originally adapted from: http://www.terathon.com/code/tangent.html
+//   - Updated version now found here: http://foundationsofgameenginedev.com/FGED2-sample.pdf
+//   - See listing 7.4 in section 7.5 (page 9 of the PDF)
+//
+// - Note: For this code to work, your Vertex format must
+//         contain an XMFLOAT3 called Tangent
+void MeshLoader::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices)
+{
+	// Reset tangents
+	for (int i = 0; i < numVerts; i++)
+	{
+		verts[i].Tangent = XMFLOAT3(0, 0, 0);
+	}
+
+	// Calculate tangents one whole triangle at a time
+	for (int i = 0; i < numIndices;)
+	{
+		// Grab indices and vertices of first triangle
+		unsigned int i1 = indices[i++];
+		unsigned int i2 = indices[i++];
+		unsigned int i3 = indices[i++];
+		Vertex* v1 = &verts[i1];
+		Vertex* v2 = &verts[i2];
+		Vertex* v3 = &verts[i3];
+
+		// Calculate vectors relative to triangle positions
+		float x1 = v2->Position.x - v1->Position.x;
+		float y1 = v2->Position.y - v1->Position.y;
+		float z1 = v2->Position.z - v1->Position.z;
+
+		float x2 = v3->Position.x - v1->Position.x;
+		float y2 = v3->Position.y - v1->Position.y;
+		float z2 = v3->Position.z - v1->Position.z;
+
+		// Do the same for vectors relative to triangle uv's
+		float s1 = v2->UV.x - v1->UV.x;
+		float t1 = v2->UV.y - v1->UV.y;
+
+		float s2 = v3->UV.x - v1->UV.x;
+		float t2 = v3->UV.y - v1->UV.y;
+
+		// Create vectors for tangent calculation
+		float r = 1.0f / (s1 * t2 - s2 * t1);
+
+		float tx = (t2 * x1 - t1 * x2) * r;
+		float ty = (t2 * y1 - t1 * y2) * r;
+		float tz = (t2 * z1 - t1 * z2) * r;
+
+		// Adjust tangents of each vert of the triangle
+		v1->Tangent.x += tx;
+		v1->Tangent.y += ty;
+		v1->Tangent.z += tz;
+
+		v2->Tangent.x += tx;
+		v2->Tangent.y += ty;
+		v2->Tangent.z += tz;
+
+		v3->Tangent.x += tx;
+		v3->Tangent.y += ty;
+		v3->Tangent.z += tz;
+	}
+
+	// Ensure all of the tangents are orthogonal to the normals
+	for (int i = 0; i < numVerts; i++)
+	{
+		// Grab the two vectors
+		XMVECTOR normal = XMLoadFloat3(&verts[i].Normal);
+		XMVECTOR tangent = XMLoadFloat3(&verts[i].Tangent);
+
+		// Use Gram-Schmidt orthogonalize
+		tangent = XMVector3Normalize(
+			tangent - normal * XMVector3Dot(normal, tangent));
+
+		// Store the tangent
+		XMStoreFloat3(&verts[i].Tangent, tangent);
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "Vertex.h"
+#include "MeshBVH.h"
+#include <vector>
+
+// One level of detail: a range of the mesh's indices, over
+// the same vertices as every other level
+//  - error is the furthest any vertex was moved to make it, in
+//    model space (0 for the full-detail level)
+struct MeshLOD
+{
+	unsigned int firstIndex;
+	unsigned int indexCount;
+	float error;
+};
+
+// --------------------------------------------------------
+// Loaded vertex and index data, ready for buffer creation,
+// and the triangle BVH for ray casts against it
+//  - indices holds every level of detail, one after another,
+//    finest first, as lods describes
+// --------------------------------------------------------
+struct MeshData
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<MeshLOD> lods;
+	MeshBVH bvh;
+	bool success = false;
+};
+
+// --------------------------------------------------------
+// CPU-side mesh loading helpers, shared by the runtime Mesh
+// class and the offline asset cooker
+//  - Nothing in here touches the GPU, so it is safe to call
+//    from any thread
+// --------------------------------------------------------
+class MeshLoader
+{
+public:
+	// Bump this whenever the cooked layout (or Vertex) changes so
+	// the cooker knows every .cmesh file needs to be rebuilt
+	static const unsigned int CookedMeshVersion = 3;
+
+	// Most levels of detail a mesh has, counting the full one
+	static const unsigned int MaxLODs = 4;
+
+	// Parses an OBJ file into a flat, left-handed vertex/index list
+	static bool LoadOBJ(const char* filename, std::vector<Vertex>& verts, std::vector<unsigned int>& indices);
+	static bool ParseOBJ(const char* data, size_t size, std::vector<Vertex>& verts, std::vector<unsigned int>& indices);
+
+	// Reads and writes the cooked (.cmesh) runtime format
+	//  - The mesh's triangle BVH can go in the file too; pass one
+	//    in to read it back, and it's left empty if there isn't one
+	//  - So can its levels of detail, which come back the same way;
+	//    without lods, indices is just the full-detail level
+	static bool LoadCookedMesh(const char* filename, std::vector<Vertex>& verts, std::vector<unsigned int>& indices, MeshBVH* bvh = 0, std::vector<MeshLOD>* lods = 0);
+	static bool ParseCookedMesh(const char* data, size_t size, std::vector<Vertex>& verts, std::vector<unsigned int>& indices, MeshBVH* bvh = 0, std::vector<MeshLOD>* lods = 0);
+	static bool WriteCookedMesh(const char* filename, const std::vector<Vertex>& verts, const std::vector<unsigned int>& indices, MeshBVH* bvh = 0, const std::vector<MeshLOD>* lods = 0);
+
+	// Builds the triangle BVH for a mesh's vertices and indices
+	//  - Only over the full-detail level, when there are lods
+	static void BuildBVH(const std::vector<Vertex>& verts, const std::vector<unsigned int>& indices, MeshBVH& bvh, const std::vector<MeshLOD>* lods = 0);
+
+	// Makes coarser levels of detail by clustering vertices
+	//  - indices must be just the full-detail level; the others
+	//    are added after it, and lods gets all of them
+	static void BuildLODs(const std::vector<Vertex>& verts, std::vector<unsigned int>& indices, std::vector<MeshLOD>& lods);
+
+	// Tangent generation - must be done before creating buffers
+	static void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
+};
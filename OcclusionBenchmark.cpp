@@ -0,0 +1,99 @@
+#include "OcclusionBenchmark.h"
+#include "BenchmarkTiming.h"
+#include "FrustumCuller.h"
+#include "OcclusionCuller.h"
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+using namespace DirectX;
+
+static const unsigned int BlocksPerSide = 16;
+static const float BlockSpacing = 12.0f;
+static const unsigned int OccludeeCount = 100000;
+
+void RunOcclusionBenchmark(JobSystem* jobSystem, unsigned int iterations)
+{
+	printf("---- Occlusion benchmark: %u buildings, %u boxes, %u views ----\n", BlocksPerSide * BlocksPerSide, OccludeeCount, iterations);
+
+	// A cube from -1 to 1, scaled into each building
+	XMFLOAT3 positions[8];
+	for (int i = 0; i < 8; i++)
+		positions[i] = XMFLOAT3((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f);
+	unsigned int indices[36] = {
+		0, 2, 3, 0, 3, 1,	4, 5, 7, 4, 7, 6,	0, 1, 5, 0, 5, 4,
+		2, 6, 7, 2, 7, 3,	0, 4, 6, 0, 6, 2,	1, 3, 7, 1, 7, 5 };
+
+	OcclusionCuller culler;
+	unsigned int cube = culler.AddMesh(positions, 8, indices, 36);
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> height(2.0f, 10.0f);
+	std::vector<XMFLOAT4X4> buildings;
+	for (unsigned int z = 0; z < BlocksPerSide; z++)
+	{
+		for (unsigned int x = 0; x < BlocksPerSide; x++)
+		{
+			float h = height(random);
+			XMFLOAT4X4 world;
+			XMStoreFloat4x4(&world, XMMatrixScaling(4.0f, h, 4.0f) * XMMatrixTranslation(x * BlockSpacing, h, z * BlockSpacing));
+			buildings.push_back(world);
+		}
+	}
+
+	// Small things on the streets and up on the roofs alike
+	float citySize = BlocksPerSide * BlockSpacing;
+	std::uniform_real_distribution<float> across(-BlockSpacing * 0.5f, citySize);
+	std::uniform_real_distribution<float> up(0.5f, 12.0f);
+	std::vector<AABB> boxes(OccludeeCount);
+	FrustumCuller frustumCuller;
+	for (unsigned int i = 0; i < OccludeeCount; i++)
+	{
+		XMFLOAT3 center(across(random), up(random), across(random));
+		boxes[i] = MakeAABB(center, 0.5f);
+		frustumCuller.Add(center, 0.87f, i);
+	}
+
+	// Cameras standing in the streets, looking along them
+	std::uniform_int_distribution<int> street(0, BlocksPerSide - 1);
+	std::uniform_real_distribution<float> along(0.0f, citySize);
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 500.0f);
+	std::vector<XMFLOAT4X4> views(iterations);
+	for (unsigned int i = 0; i < iterations; i++)
+	{
+		float streetCenter = street(random) * BlockSpacing + BlockSpacing * 0.5f;
+		bool alongX = (i & 1) != 0;
+		XMVECTOR eye = alongX ? XMVectorSet(along(random), 1.7f, streetCenter, 0.0f) : XMVectorSet(streetCenter, 1.7f, along(random), 0.0f);
+		XMVECTOR direction = alongX ? XMVectorSet(1.0f, 0.0f, 0.1f, 0.0f) : XMVectorSet(0.1f, 0.0f, 1.0f, 0.0f);
+		XMStoreFloat4x4(&views[i], XMMatrixLookToLH(eye, direction, XMVectorSet(0, 1, 0, 0)) * projection);
+	}
+
+	// Only what's in the frustum gets as far as occlusion culling,
+	// as in the game
+	std::vector<std::vector<unsigned int>> inFrustum(iterations);
+	for (unsigned int i = 0; i < iterations; i++)
+		frustumCuller.Cull(MakeFrustum(views[i]), inFrustum[i]);
+
+	std::vector<unsigned int> ids;
+	for (int threaded = 0; threaded < 2; threaded++)
+	{
+		culler.ResetStats();
+		float total = 0.0f;
+		for (unsigned int v = 0; v < iterations; v++)
+		{
+			const XMFLOAT4X4& view = views[v];
+			ids = inFrustum[v];
+			auto start = std::chrono::high_resolution_clock::now();
+			culler.BeginFrame(view);
+			for (const XMFLOAT4X4& building : buildings)
+				culler.AddOccluder(cube, building);
+			culler.Rasterize(threaded ? jobSystem : 0);
+			culler.Cull(boxes.data(), ids, threaded ? jobSystem : 0);
+			total += GetElapsed(start);
+		}
+
+		printf("%s: %.3fms per view in all\n", threaded ? "Job system" : "One thread", total / iterations);
+		culler.PrintStats();
+	}
+}
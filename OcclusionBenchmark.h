@@ -0,0 +1,11 @@
+#pragma once
+#include "JobSystem.h"
+
+// --------------------------------------------------------
+// Times occlusion culling for a city of box buildings, seen
+// from street level, with 100k small boxes scattered through
+// it to cull, and prints the results
+//  - Timed on one thread, then with rasterizing and testing
+//    both spread across the job system
+// --------------------------------------------------------
+void RunOcclusionBenchmark(JobSystem* jobSystem, unsigned int iterations = 20);
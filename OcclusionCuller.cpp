@@ -0,0 +1,445 @@
+#include "OcclusionCuller.h"
+#include <algorithm>
+#include <chrono>
+#include <emmintrin.h>
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+
+using namespace DirectX;
+
+static const unsigned int TileWidth = 32;
+static const unsigned int TileHeight = 16;
+static const unsigned int TilePixels = TileWidth * TileHeight;
+
+// Screen coordinates are clamped to this far outside the
+// buffer before they become ints, so a vertex just past the
+// near plane can't overflow them
+static const float GuardBand = 4096.0f;
+
+OcclusionCuller::OcclusionCuller(unsigned int width, unsigned int height)
+{
+	// Whole tiles only, so rasterizing never needs an edge case
+	tilesX = (std::max(width, 1u) + TileWidth - 1) / TileWidth;
+	tilesY = (std::max(height, 1u) + TileHeight - 1) / TileHeight;
+	this->width = tilesX * TileWidth;
+	this->height = tilesY * TileHeight;
+
+	depth.resize(tilesX * tilesY * TilePixels, 1.0f);
+	tileMaxDepth.resize(tilesX * tilesY, 1.0f);
+	tileBins.resize(tilesX * tilesY);
+	XMStoreFloat4x4(&viewProjection, XMMatrixIdentity());
+	ResetStats();
+}
+
+unsigned int OcclusionCuller::AddMesh(const XMFLOAT3* positions, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount)
+{
+	OccluderMesh mesh;
+	mesh.positions.assign(positions, positions + vertexCount);
+	mesh.indices.assign(indices, indices + indexCount - indexCount % 3);
+	meshes.push_back(mesh);
+	return (unsigned int)meshes.size() - 1;
+}
+
+void OcclusionCuller::BeginFrame(const XMFLOAT4X4& viewProjection)
+{
+	this->viewProjection = viewProjection;
+	triangles.clear();
+	for (std::vector<unsigned int>& bin : tileBins)
+		bin.clear();
+	frames++;
+}
+
+// --------------------------------------------------------
+// Transforms the mesh's vertices to clip space, then sets up
+// and bins each of its triangles
+// --------------------------------------------------------
+void OcclusionCuller::AddOccluder(unsigned int mesh, const XMFLOAT4X4& world)
+{
+	if (mesh >= meshes.size())
+		return;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	const OccluderMesh& occluder = meshes[mesh];
+	XMMATRIX worldViewProjection = XMLoadFloat4x4(&world) * XMLoadFloat4x4(&viewProjection);
+	clipVertices.resize(occluder.positions.size());
+	for (size_t i = 0; i < occluder.positions.size(); i++)
+		XMStoreFloat4(&clipVertices[i], XMVector3Transform(XMLoadFloat3(&occluder.positions[i]), worldViewProjection));
+
+	for (size_t i = 0; i < occluder.indices.size(); i += 3)
+	{
+		AddTriangle(
+			clipVertices[occluder.indices[i]],
+			clipVertices[occluder.indices[i + 1]],
+			clipVertices[occluder.indices[i + 2]]);
+	}
+	occluders++;
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	setupMs += elapsed.count();
+}
+
+// --------------------------------------------------------
+// Drops triangles entirely outside one of the frustum's
+// planes, and clips the rest against the near plane
+//  - Clipping a triangle against one plane leaves at most a
+//    quad, which goes in as two triangles
+//  - The other planes are left to the screen clamps
+// --------------------------------------------------------
+void OcclusionCuller::AddTriangle(const XMFLOAT4& a, const XMFLOAT4& b, const XMFLOAT4& c)
+{
+	if ((a.x > a.w && b.x > b.w && c.x > c.w) ||
+		(a.x < -a.w && b.x < -b.w && c.x < -c.w) ||
+		(a.y > a.w && b.y > b.w && c.y > c.w) ||
+		(a.y < -a.w && b.y < -b.w && c.y < -c.w) ||
+		(a.z > a.w && b.z > b.w && c.z > c.w) ||
+		(a.z < 0.0f && b.z < 0.0f && c.z < 0.0f))
+		return;
+
+	if (a.z >= 0.0f && b.z >= 0.0f && c.z >= 0.0f)
+	{
+		AddScreenTriangle(ToScreen(a), ToScreen(b), ToScreen(c));
+		return;
+	}
+
+	const XMFLOAT4* input[3] = { &a, &b, &c };
+	XMFLOAT4 clipped[4];
+	int clippedCount = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		const XMFLOAT4& from = *input[i];
+		const XMFLOAT4& to = *input[(i + 1) % 3];
+		if (from.z >= 0.0f)
+			clipped[clippedCount++] = from;
+		if ((from.z >= 0.0f) != (to.z >= 0.0f))
+		{
+			float t = from.z / (from.z - to.z);
+			clipped[clippedCount++] = XMFLOAT4(
+				from.x + (to.x - from.x) * t,
+				from.y + (to.y - from.y) * t,
+				0.0f,
+				from.w + (to.w - from.w) * t);
+		}
+	}
+
+	XMFLOAT3 first = ToScreen(clipped[0]);
+	for (int i = 1; i + 1 < clippedCount; i++)
+		AddScreenTriangle(first, ToScreen(clipped[i]), ToScreen(clipped[i + 1]));
+}
+
+XMFLOAT3 OcclusionCuller::ToScreen(const XMFLOAT4& clip)
+{
+	float inverseW = 1.0f / clip.w;
+	return XMFLOAT3(
+		(clip.x * inverseW * 0.5f + 0.5f) * width,
+		(0.5f - clip.y * inverseW * 0.5f) * height,
+		clip.z * inverseW);
+}
+
+// --------------------------------------------------------
+// Works out the triangle's edge functions and depth plane,
+// and adds it to the bin of every tile its bounds touch
+//  - Edges are flipped as needed so that inside is always
+//    positive, whichever way the triangle winds
+//  - Pixels are covered when their centers are inside, so
+//    the bounds are the centers between the extremes
+// --------------------------------------------------------
+void OcclusionCuller::AddScreenTriangle(const XMFLOAT3& a, const XMFLOAT3& b, const XMFLOAT3& c)
+{
+	float area = (b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y);
+	if (area == 0.0f || !(area == area))
+		return;
+
+	float lowX = std::max(std::min(std::min(a.x, b.x), c.x), -GuardBand);
+	float highX = std::min(std::max(std::max(a.x, b.x), c.x), GuardBand);
+	float lowY = std::max(std::min(std::min(a.y, b.y), c.y), -GuardBand);
+	float highY = std::min(std::max(std::max(a.y, b.y), c.y), GuardBand);
+
+	ScreenTriangle triangle;
+	triangle.minX = std::max((int)ceilf(lowX - 0.5f), 0);
+	triangle.maxX = std::min((int)floorf(highX - 0.5f), (int)width - 1);
+	triangle.minY = std::max((int)ceilf(lowY - 0.5f), 0);
+	triangle.maxY = std::min((int)floorf(highY - 0.5f), (int)height - 1);
+	if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+		return;
+
+	const XMFLOAT3* vertices[3] = { &a, &b, &c };
+	float sign = area > 0.0f ? -1.0f : 1.0f;
+	for (int i = 0; i < 3; i++)
+	{
+		const XMFLOAT3& from = *vertices[i];
+		const XMFLOAT3& to = *vertices[(i + 1) % 3];
+		triangle.edgeA[i] = (to.y - from.y) * sign;
+		triangle.edgeB[i] = (from.x - to.x) * sign;
+		triangle.edgeC[i] = -(triangle.edgeA[i] * from.x + triangle.edgeB[i] * from.y);
+	}
+
+	triangle.depthA = ((b.z - a.z) * (c.y - a.y) - (c.z - a.z) * (b.y - a.y)) / area;
+	triangle.depthB = ((c.z - a.z) * (b.x - a.x) - (b.z - a.z) * (c.x - a.x)) / area;
+	triangle.depthC = a.z - triangle.depthA * a.x - triangle.depthB * a.y;
+	triangle.minDepth = std::min(std::min(a.z, b.z), c.z);
+	triangle.maxDepth = std::max(std::max(a.z, b.z), c.z);
+
+	unsigned int index = (unsigned int)triangles.size();
+	triangles.push_back(triangle);
+	for (int ty = triangle.minY / (int)TileHeight; ty <= triangle.maxY / (int)TileHeight; ty++)
+	{
+		for (int tx = triangle.minX / (int)TileWidth; tx <= triangle.maxX / (int)TileWidth; tx++)
+			tileBins[ty * tilesX + tx].push_back(index);
+	}
+	trianglesBinned++;
+}
+
+// --------------------------------------------------------
+// Rasterizes every tile's bin, across the job system if
+// there is one; tiles only write to their own pixels
+// --------------------------------------------------------
+void OcclusionCuller::Rasterize(JobSystem* jobSystem)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	unsigned int tileCount = tilesX * tilesY;
+	if (jobSystem)
+	{
+		jobSystem->ParallelFor(tileCount, 4, [this](unsigned int first, unsigned int last)
+		{
+			for (unsigned int t = first; t < last; t++)
+				RasterizeTile(t);
+		});
+	}
+	else
+	{
+		for (unsigned int t = 0; t < tileCount; t++)
+			RasterizeTile(t);
+	}
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	rasterizeMs += elapsed.count();
+}
+
+// --------------------------------------------------------
+// Clears the tile, then rasterizes its triangles 4 pixels at
+// a time, keeping the nearest depth where they're covered
+//  - Interpolated depth is clamped to the triangle's own
+//    range, so pixels at its edges can't come out nearer
+//    than any part of it really is
+// --------------------------------------------------------
+void OcclusionCuller::RasterizeTile(unsigned int tile)
+{
+	int originX = (int)(tile % tilesX * TileWidth);
+	int originY = (int)(tile / tilesX * TileHeight);
+	float* tileDepth = &depth[tile * TilePixels];
+
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 columnOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+	for (unsigned int i = 0; i < TilePixels; i += 4)
+		_mm_storeu_ps(&tileDepth[i], one);
+
+	for (unsigned int index : tileBins[tile])
+	{
+		const ScreenTriangle& triangle = triangles[index];
+		int firstColumn = (std::max(triangle.minX, originX) - originX) & ~3;
+		int lastColumn = std::min(triangle.maxX, originX + (int)TileWidth - 1) - originX;
+		int firstRow = std::max(triangle.minY, originY) - originY;
+		int lastRow = std::min(triangle.maxY, originY + (int)TileHeight - 1) - originY;
+
+		__m128 edgeA0 = _mm_set1_ps(triangle.edgeA[0]);
+		__m128 edgeA1 = _mm_set1_ps(triangle.edgeA[1]);
+		__m128 edgeA2 = _mm_set1_ps(triangle.edgeA[2]);
+		__m128 depthA = _mm_set1_ps(triangle.depthA);
+		__m128 minDepth = _mm_set1_ps(triangle.minDepth);
+		__m128 maxDepth = _mm_set1_ps(triangle.maxDepth);
+
+		for (int row = firstRow; row <= lastRow; row++)
+		{
+			float y = originY + row + 0.5f;
+			__m128 rowEdge0 = _mm_set1_ps(triangle.edgeB[0] * y + triangle.edgeC[0]);
+			__m128 rowEdge1 = _mm_set1_ps(triangle.edgeB[1] * y + triangle.edgeC[1]);
+			__m128 rowEdge2 = _mm_set1_ps(triangle.edgeB[2] * y + triangle.edgeC[2]);
+			__m128 rowDepth = _mm_set1_ps(triangle.depthB * y + triangle.depthC);
+			float* rowPixels = &tileDepth[row * TileWidth];
+
+			for (int column = firstColumn; column <= lastColumn; column += 4)
+			{
+				__m128 x = _mm_add_ps(_mm_set1_ps((float)(originX + column)), columnOffsets);
+				__m128 covered = _mm_and_ps(
+					_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA0, x), rowEdge0), zero),
+					_mm_and_ps(
+						_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA1, x), rowEdge1), zero),
+						_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA2, x), rowEdge2), zero)));
+				if (_mm_movemask_ps(covered) == 0)
+					continue;
+
+				__m128 z = _mm_add_ps(_mm_mul_ps(depthA, x), rowDepth);
+				z = _mm_min_ps(_mm_max_ps(z, minDepth), maxDepth);
+				__m128 current = _mm_loadu_ps(&rowPixels[column]);
+				__m128 nearest = _mm_min_ps(current, z);
+				_mm_storeu_ps(&rowPixels[column], _mm_or_ps(_mm_and_ps(covered, nearest), _mm_andnot_ps(covered, current)));
+			}
+		}
+	}
+
+	__m128 farthest = _mm_loadu_ps(tileDepth);
+	for (unsigned int i = 4; i < TilePixels; i += 4)
+		farthest = _mm_max_ps(farthest, _mm_loadu_ps(&tileDepth[i]));
+	farthest = _mm_max_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(1, 0, 3, 2)));
+	farthest = _mm_max_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(2, 3, 0, 1)));
+	tileMaxDepth[tile] = _mm_cvtss_f32(farthest);
+}
+
+// --------------------------------------------------------
+// Projects the box's corners and takes the screen rectangle
+// around them at the depth of the nearest one
+//  - Hidden if every tile it touches is nearer everywhere, or
+//    failing that, every pixel it touches is
+// --------------------------------------------------------
+bool OcclusionCuller::IsVisible(const AABB& box)
+{
+	const XMFLOAT4X4& m = viewProjection;
+	float lowX = FLT_MAX, highX = -FLT_MAX;
+	float lowY = FLT_MAX, highY = -FLT_MAX;
+	float boxDepth = FLT_MAX;
+	for (int i = 0; i < 8; i++)
+	{
+		float x = (i & 1) ? box.upper.x : box.lower.x;
+		float y = (i & 2) ? box.upper.y : box.lower.y;
+		float z = (i & 4) ? box.upper.z : box.lower.z;
+		float clipX = x * m._11 + y * m._21 + z * m._31 + m._41;
+		float clipY = x * m._12 + y * m._22 + z * m._32 + m._42;
+		float clipZ = x * m._13 + y * m._23 + z * m._33 + m._43;
+		float clipW = x * m._14 + y * m._24 + z * m._34 + m._44;
+
+		// Crosses the near plane
+		if (clipZ < 0.0f || clipW <= 0.0f)
+			return true;
+
+		float inverseW = 1.0f / clipW;
+		lowX = std::min(lowX, clipX * inverseW);
+		highX = std::max(highX, clipX * inverseW);
+		lowY = std::min(lowY, clipY * inverseW);
+		highY = std::max(highY, clipY * inverseW);
+		boxDepth = std::min(boxDepth, clipZ * inverseW);
+	}
+
+	// Every pixel the rectangle touches, even partly
+	float screenLowX = std::max((lowX * 0.5f + 0.5f) * width, -1.0f);
+	float screenHighX = std::min((highX * 0.5f + 0.5f) * width, (float)width);
+	float screenLowY = std::max((0.5f - highY * 0.5f) * height, -1.0f);
+	float screenHighY = std::min((0.5f - lowY * 0.5f) * height, (float)height);
+	int minX = std::max((int)floorf(screenLowX), 0);
+	int maxX = std::min((int)floorf(screenHighX), (int)width - 1);
+	int minY = std::max((int)floorf(screenLowY), 0);
+	int maxY = std::min((int)floorf(screenHighY), (int)height - 1);
+	if (minX > maxX || minY > maxY)
+		return false;
+
+	for (int ty = minY / (int)TileHeight; ty <= maxY / (int)TileHeight; ty++)
+	{
+		for (int tx = minX / (int)TileWidth; tx <= maxX / (int)TileWidth; tx++)
+		{
+			unsigned int tile = ty * tilesX + tx;
+			if (tileMaxDepth[tile] < boxDepth)
+				continue;
+			if (IsAnyPixelBehind(tile, minX, maxX, minY, maxY, boxDepth))
+				return true;
+		}
+	}
+	return false;
+}
+
+// Whether any pixel of the rectangle, within the tile, is at
+// or behind boxDepth
+bool OcclusionCuller::IsAnyPixelBehind(unsigned int tile, int minX, int maxX, int minY, int maxY, float boxDepth)
+{
+	int originX = (int)(tile % tilesX * TileWidth);
+	int originY = (int)(tile / tilesX * TileHeight);
+	const float* tileDepth = &depth[tile * TilePixels];
+
+	int firstColumn = std::max(minX, originX) - originX;
+	int lastColumn = std::min(maxX, originX + (int)TileWidth - 1) - originX;
+	int firstRow = std::max(minY, originY) - originY;
+	int lastRow = std::min(maxY, originY + (int)TileHeight - 1) - originY;
+
+	__m128 depthVector = _mm_set1_ps(boxDepth);
+	__m128 low = _mm_set1_ps((float)firstColumn);
+	__m128 high = _mm_set1_ps((float)lastColumn);
+	for (int row = firstRow; row <= lastRow; row++)
+	{
+		const float* rowPixels = &tileDepth[row * TileWidth];
+		for (int column = firstColumn & ~3; column <= lastColumn; column += 4)
+		{
+			__m128 columns = _mm_add_ps(_mm_set1_ps((float)column), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+			__m128 inside = _mm_and_ps(_mm_cmpge_ps(columns, low), _mm_cmple_ps(columns, high));
+			__m128 behind = _mm_cmpge_ps(_mm_loadu_ps(&rowPixels[column]), depthVector);
+			if (_mm_movemask_ps(_mm_and_ps(inside, behind)) != 0)
+				return true;
+		}
+	}
+	return false;
+}
+
+// --------------------------------------------------------
+// Tests every box, across the job system if there is one,
+// then packs the visible ids down in order
+//  - IsVisible() only reads, so the tests can run in parallel
+// --------------------------------------------------------
+void OcclusionCuller::Cull(const AABB* boxes, std::vector<unsigned int>& ids, JobSystem* jobSystem)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	visibleFlags.resize(ids.size());
+	auto test = [this, boxes, &ids](unsigned int first, unsigned int last)
+	{
+		for (unsigned int i = first; i < last; i++)
+			visibleFlags[i] = IsVisible(boxes[ids[i]]) ? 1 : 0;
+	};
+	if (jobSystem)
+		jobSystem->ParallelFor((unsigned int)ids.size(), 256, test);
+	else
+		test(0, (unsigned int)ids.size());
+
+	size_t kept = 0;
+	for (size_t i = 0; i < ids.size(); i++)
+	{
+		if (visibleFlags[i])
+			ids[kept++] = ids[i];
+	}
+	tested += ids.size();
+	culled += ids.size() - kept;
+	ids.resize(kept);
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	testMs += elapsed.count();
+}
+
+void OcclusionCuller::PrintStats()
+{
+	printf("---- Occlusion culling: %ux%u, %llu frames ----\n", width, height, frames);
+	if (frames == 0)
+		return;
+
+	printf("Per frame: %.1f occluders, %.1f triangles; %.1f tested, %.1f culled (%.1f%%)\n",
+		(double)occluders / frames,
+		(double)trianglesBinned / frames,
+		(double)tested / frames,
+		(double)culled / frames,
+		tested > 0 ? culled * 100.0 / tested : 0.0);
+	printf("Time per frame: setup %.3fms, rasterize %.3fms, test %.3fms\n",
+		setupMs / frames,
+		rasterizeMs / frames,
+		testMs / frames);
+}
+
+void OcclusionCuller::ResetStats()
+{
+	frames = 0;
+	occluders = 0;
+	trianglesBinned = 0;
+	tested = 0;
+	culled = 0;
+	setupMs = 0.0;
+	rasterizeMs = 0.0;
+	testMs = 0.0;
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+#include "Collision.h"
+#include "JobSystem.h"
+
+// --------------------------------------------------------
+// Software occlusion culling, entirely on the CPU
+//  - Occluders (a few simple meshes that are known to be
+//    inside what's really drawn) are rasterized into a small
+//    depth buffer, then occludees' boxes are tested against it
+//    and dropped if every pixel they cover is nearer
+//  - The depth buffer is split into 32x16 tiles, stored one
+//    tile after another; triangles are binned into the tiles
+//    they touch, and each tile is rasterized on its own, so
+//    tiles can go to different threads
+//  - Rasterizing works out coverage for 4 pixels at a time
+//    with SSE, and only writes depth where that mask is set
+//  - Each tile also keeps its farthest depth, as a coarse level
+//    to test against first; most hidden boxes never get as far
+//    as looking at pixels
+//  - Depth is post-projection z / w, from 0 (near) to 1 (far),
+//    as DirectXMath's projections make it
+//  - Nothing here touches the GPU or the OS, so it runs the same
+//    anywhere SSE2 does
+// --------------------------------------------------------
+class OcclusionCuller
+{
+public:
+	OcclusionCuller(unsigned int width = 320, unsigned int height = 192);
+
+	// Occluder geometry, in its own model space
+	//  - Returns the mesh's id, for AddOccluder()
+	unsigned int AddMesh(const DirectX::XMFLOAT3* positions, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount);
+
+	// A frame goes BeginFrame(), AddOccluder() for each occluder,
+	// Rasterize(), then any number of IsVisible() or Cull()
+	void BeginFrame(const DirectX::XMFLOAT4X4& viewProjection);
+	void AddOccluder(unsigned int mesh, const DirectX::XMFLOAT4X4& world);
+	void Rasterize(JobSystem* jobSystem = 0);
+
+	// Conservative: anything that can't be shown to be hidden
+	// (like a box that crosses the near plane) is visible
+	bool IsVisible(const AABB& box);
+
+	// Removes the ids whose boxes[id] are hidden, keeping the
+	// rest in order
+	//  - Pass a job system to test across it
+	void Cull(const AABB* boxes, std::vector<unsigned int>& ids, JobSystem* jobSystem = 0);
+
+	unsigned int GetWidth() { return width; }
+	unsigned int GetHeight() { return height; }
+
+	// Culled counts and time spent, per frame, since the last reset
+	void PrintStats();
+	void ResetStats();
+
+private:
+	// A triangle ready to rasterize: edge functions and a depth
+	// plane, all in pixels
+	//  - Pixel (x, y) is covered when A * x + B * y + C >= 0 for
+	//    all three edges, at its center
+	struct ScreenTriangle
+	{
+		float edgeA[3], edgeB[3], edgeC[3];
+		float depthA, depthB, depthC; // depth = A * x + B * y + C
+		float minDepth, maxDepth;
+		int minX, maxX, minY, maxY; // Covered pixels, inclusive
+	};
+
+	struct OccluderMesh
+	{
+		std::vector<DirectX::XMFLOAT3> positions;
+		std::vector<unsigned int> indices;
+	};
+
+	unsigned int width;
+	unsigned int height;
+	unsigned int tilesX;
+	unsigned int tilesY;
+
+	std::vector<float> depth;
+	std::vector<float> tileMaxDepth;
+	std::vector<std::vector<unsigned int>> tileBins;
+
+	std::vector<OccluderMesh> meshes;
+	std::vector<ScreenTriangle> triangles;
+	std::vector<DirectX::XMFLOAT4> clipVertices;
+	std::vector<unsigned char> visibleFlags;
+	DirectX::XMFLOAT4X4 viewProjection;
+
+	// Stats
+	unsigned long long frames;
+	unsigned long long occluders;
+	unsigned long long trianglesBinned;
+	unsigned long long tested;
+	unsigned long long culled;
+	double setupMs;
+	double rasterizeMs;
+	double testMs;
+
+	void AddTriangle(const DirectX::XMFLOAT4& a, const DirectX::XMFLOAT4& b, const DirectX::XMFLOAT4& c);
+	void AddScreenTriangle(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b, const DirectX::XMFLOAT3& c);
+	DirectX::XMFLOAT3 ToScreen(const DirectX::XMFLOAT4& clip);
+	void RasterizeTile(unsigned int tile);
+	bool IsAnyPixelBehind(unsigned int tile, int minX, int maxX, int minY, int maxY, float boxDepth);
+};
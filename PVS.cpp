@@ -0,0 +1,319 @@
+#include "PVS.h"
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Header at the front of a written PVS
+//  - Followed by a 32-bit offset into the packed bytes for
+//    each cell, and then packedBytes of packed sets
+// --------------------------------------------------------
+struct PVSHeader
+{
+	unsigned int magic;		// Always 'PVS1'
+	unsigned int objectCount;
+	unsigned int cellsX, cellsY, cellsZ;
+	float lower[3];
+	float cellSize;
+	unsigned int packedBytes;
+};
+
+static const unsigned int PVSMagic = 0x31535650; // "PVS1" in little endian
+
+// Longest run of clear bytes one count can hold
+static const unsigned int MaxRun = 255;
+
+PVS::PVS()
+{
+	Clear();
+	ResetStats();
+}
+
+void PVS::Clear()
+{
+	lower = XMFLOAT3(0, 0, 0);
+	cellSize = 0.0f;
+	cellsX = cellsY = cellsZ = 0;
+	objectCount = 0;
+	wordCount = 0;
+	byteCount = 0;
+	packed.clear();
+	cellStarts.clear();
+	currentCell = NoCell;
+	currentBits.clear();
+}
+
+// --------------------------------------------------------
+// Grows the cells if there'd be too many along an axis, so
+// the grid always covers the bounds
+// --------------------------------------------------------
+void PVS::Create(const AABB& bounds, float cellSize, unsigned int objectCount)
+{
+	Clear();
+	XMFLOAT3 extent(bounds.upper.x - bounds.lower.x, bounds.upper.y - bounds.lower.y, bounds.upper.z - bounds.lower.z);
+	float largest = std::max(extent.x, std::max(extent.y, extent.z));
+	if (cellSize <= 0.0f || largest < 0.0f)
+		return;
+
+	this->cellSize = std::max(cellSize, largest / MaxCellsPerAxis);
+	this->lower = bounds.lower;
+	this->cellsX = std::max((unsigned int)ceilf(extent.x / this->cellSize), 1u);
+	this->cellsY = std::max((unsigned int)ceilf(extent.y / this->cellSize), 1u);
+	this->cellsZ = std::max((unsigned int)ceilf(extent.z / this->cellSize), 1u);
+	this->objectCount = objectCount;
+	this->wordCount = (objectCount + 63) / 64;
+	this->byteCount = (objectCount + 7) / 8;
+
+	// Every cell starts out sharing the one empty set
+	std::vector<unsigned long long> empty(wordCount, 0);
+	Pack(empty.data(), packed);
+	cellStarts.assign(cellsX * cellsY * cellsZ, 0);
+	currentBits.assign(wordCount, 0);
+}
+
+AABB PVS::GetCellBounds(unsigned int cell)
+{
+	unsigned int x = cell % cellsX;
+	unsigned int y = (cell / cellsX) % cellsY;
+	unsigned int z = cell / (cellsX * cellsY);
+	AABB box;
+	box.lower = XMFLOAT3(lower.x + x * cellSize, lower.y + y * cellSize, lower.z + z * cellSize);
+	box.upper = XMFLOAT3(box.lower.x + cellSize, box.lower.y + cellSize, box.lower.z + cellSize);
+	return box;
+}
+
+unsigned int PVS::FindCell(const XMFLOAT3& position)
+{
+	if (cellStarts.empty())
+		return NoCell;
+
+	float x = (position.x - lower.x) / cellSize;
+	float y = (position.y - lower.y) / cellSize;
+	float z = (position.z - lower.z) / cellSize;
+	if (!(x >= 0.0f && y >= 0.0f && z >= 0.0f && x < cellsX && y < cellsY && z < cellsZ))
+		return NoCell;
+
+	return GetCellIndex((unsigned int)x, (unsigned int)y, (unsigned int)z);
+}
+
+// --------------------------------------------------------
+// Byte i of a set is bits i * 8 to i * 8 + 7, whatever order
+// the words' bytes are in in memory
+// --------------------------------------------------------
+void PVS::Pack(const unsigned long long* bits, std::vector<unsigned char>& output)
+{
+	unsigned int i = 0;
+	while (i < byteCount)
+	{
+		unsigned char byte = (unsigned char)(bits[i >> 3] >> ((i & 7) * 8));
+		if (byte != 0)
+		{
+			output.push_back(byte);
+			i++;
+			continue;
+		}
+
+		unsigned int run = 1;
+		while (i + run < byteCount && run < MaxRun && (unsigned char)(bits[(i + run) >> 3] >> (((i + run) & 7) * 8)) == 0)
+			run++;
+		output.push_back(0);
+		output.push_back((unsigned char)run);
+		i += run;
+	}
+}
+
+bool PVS::Unpack(unsigned int cell, unsigned long long* bits)
+{
+	for (unsigned int w = 0; w < wordCount; w++)
+		bits[w] = 0;
+
+	size_t p = cellStarts[cell];
+	unsigned int i = 0;
+	while (i < byteCount)
+	{
+		if (p >= packed.size())
+			return false;
+
+		unsigned char byte = packed[p++];
+		if (byte != 0)
+		{
+			bits[i >> 3] |= (unsigned long long)byte << ((i & 7) * 8);
+			i++;
+			continue;
+		}
+
+		if (p >= packed.size() || packed[p] == 0 || packed[p] > byteCount - i)
+			return false;
+		i += packed[p++];
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Bits past the last object are cleared first, so they can't
+// stop a byte joining a run
+//  - A set is only ever packed one way, and unpacking stops
+//    once it has every byte, so a neighbour whose bytes start
+//    with this cell's packed bytes has the same set
+// --------------------------------------------------------
+void PVS::SetCell(unsigned int cell, const unsigned long long* bits)
+{
+	if (cell >= cellStarts.size())
+		return;
+
+	std::vector<unsigned long long> words(bits, bits + wordCount);
+	if (objectCount % 64 != 0)
+		words[wordCount - 1] &= (1ull << (objectCount % 64)) - 1;
+
+	std::vector<unsigned char> cellBytes;
+	Pack(words.data(), cellBytes);
+
+	unsigned int neighbours[3] = { 1, cellsX, cellsX * cellsY };
+	for (unsigned int neighbour : neighbours)
+	{
+		if (cell < neighbour)
+			continue;
+
+		unsigned int start = cellStarts[cell - neighbour];
+		if (cellBytes.size() <= packed.size() - start && (cellBytes.empty() || memcmp(packed.data() + start, cellBytes.data(), cellBytes.size()) == 0))
+		{
+			cellStarts[cell] = start;
+			if (cell == currentCell)
+				currentCell = NoCell;
+			return;
+		}
+	}
+
+	cellStarts[cell] = (unsigned int)packed.size();
+	packed.insert(packed.end(), cellBytes.begin(), cellBytes.end());
+	if (cell == currentCell)
+		currentCell = NoCell;
+}
+
+void PVS::GetCell(unsigned int cell, unsigned long long* bits)
+{
+	if (cell < cellStarts.size())
+		Unpack(cell, bits);
+}
+
+bool PVS::Lookup(const XMFLOAT3& position)
+{
+	lookups++;
+	unsigned int cell = FindCell(position);
+	if (cell != currentCell && cell != NoCell)
+	{
+		Unpack(cell, currentBits.data());
+		unpacks++;
+	}
+	currentCell = cell;
+	return cell != NoCell;
+}
+
+void PVS::Write(std::vector<char>& data)
+{
+	PVSHeader header = {};
+	header.magic = PVSMagic;
+	header.objectCount = objectCount;
+	header.cellsX = cellsX;
+	header.cellsY = cellsY;
+	header.cellsZ = cellsZ;
+	header.lower[0] = lower.x;
+	header.lower[1] = lower.y;
+	header.lower[2] = lower.z;
+	header.cellSize = cellSize;
+	header.packedBytes = (unsigned int)packed.size();
+
+	size_t start = data.size();
+	size_t cellBytes = cellStarts.size() * sizeof(unsigned int);
+	data.resize(start + sizeof(PVSHeader) + cellBytes + packed.size());
+	char* output = &data[start];
+	memcpy(output, &header, sizeof(PVSHeader));
+	if (cellBytes > 0)
+		memcpy(output + sizeof(PVSHeader), cellStarts.data(), cellBytes);
+	if (!packed.empty())
+		memcpy(output + sizeof(PVSHeader) + cellBytes, packed.data(), packed.size());
+}
+
+// --------------------------------------------------------
+// Every cell is unpacked once to check it, so nothing read
+// from a bad file can take Lookup() out of bounds later
+// --------------------------------------------------------
+bool PVS::Read(const char* data, size_t size)
+{
+	Clear();
+	PVSHeader header = {};
+	if (size < sizeof(PVSHeader))
+		return false;
+	memcpy(&header, data, sizeof(PVSHeader));
+
+	unsigned long long cellCount = (unsigned long long)header.cellsX * header.cellsY * header.cellsZ;
+	if (header.magic != PVSMagic ||
+		header.cellsX > MaxCellsPerAxis || header.cellsY > MaxCellsPerAxis || header.cellsZ > MaxCellsPerAxis ||
+		!(header.cellSize > 0.0f))
+		return false;
+
+	size_t cellBytes = (size_t)cellCount * sizeof(unsigned int);
+	if (size < sizeof(PVSHeader) + cellBytes + header.packedBytes)
+		return false;
+
+	// Every packed byte unpacks to at most a run's worth, so a
+	// count the packed bytes can't cover is a bad file, and
+	// would otherwise have us allocate for it
+	if ((header.objectCount + 7ull) / 8 > MaxRun * (size_t)header.packedBytes)
+		return false;
+
+	lower = XMFLOAT3(header.lower[0], header.lower[1], header.lower[2]);
+	cellSize = header.cellSize;
+	cellsX = header.cellsX;
+	cellsY = header.cellsY;
+	cellsZ = header.cellsZ;
+	objectCount = header.objectCount;
+	wordCount = (objectCount + 63) / 64;
+	byteCount = (objectCount + 7) / 8;
+	cellStarts.resize((size_t)cellCount);
+	packed.resize(header.packedBytes);
+	if (cellBytes > 0)
+		memcpy(cellStarts.data(), data + sizeof(PVSHeader), cellBytes);
+	if (!packed.empty())
+		memcpy(packed.data(), data + sizeof(PVSHeader) + cellBytes, packed.size());
+
+	currentBits.assign(wordCount, 0);
+	for (unsigned int cell = 0; cell < cellCount; cell++)
+	{
+		if (!Unpack(cell, currentBits.data()))
+		{
+			Clear();
+			return false;
+		}
+	}
+	return true;
+}
+
+size_t PVS::GetPackedBytes()
+{
+	return packed.size() + cellStarts.size() * sizeof(unsigned int);
+}
+
+size_t PVS::GetUnpackedBytes()
+{
+	return cellStarts.size() * byteCount;
+}
+
+void PVS::PrintStats()
+{
+	printf("---- PVS: %ux%ux%u cells of %.2f, %u objects ----\n", cellsX, cellsY, cellsZ, cellSize, objectCount);
+	printf("Packed into %zu bytes, from %zu (%.1f%%)\n",
+		GetPackedBytes(),
+		GetUnpackedBytes(),
+		GetUnpackedBytes() > 0 ? GetPackedBytes() * 100.0 / GetUnpackedBytes() : 0.0);
+	printf("%llu lookups, %llu cell changes\n", lookups, unpacks);
+}
+
+void PVS::ResetStats()
+{
+	lookups = 0;
+	unpacks = 0;
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+#include "Collision.h"
+
+// --------------------------------------------------------
+// Precomputed potentially visible sets for a static scene
+//  - The scene's bounds are split into a grid of cells, and each
+//    cell has a bit per static object: whether any of it can be
+//    seen from anywhere in the cell (see PVSBuilder)
+//  - Sets are kept compressed a byte at a time: a clear byte is
+//    followed by how many clear bytes there are in its run, and
+//    anything else is copied as is; a cell with the same set as
+//    a neighbour before it (in x, y or z) shares its bytes
+//  - At runtime, Lookup() finds the camera's cell and unpacks its
+//    set (only when the cell changes), and IsVisible() is then a
+//    bit test, for dropping hidden objects before they get as far
+//    as frustum culling
+//  - Outside the grid nothing's known, so everything is visible
+// --------------------------------------------------------
+class PVS
+{
+public:
+	static const unsigned int NoCell = 0xFFFFFFFF;
+
+	PVS();
+
+	// A grid of cellSize cubes over bounds, with every set empty
+	//  - Cells are clamped to MaxCellsPerAxis along each axis
+	void Create(const AABB& bounds, float cellSize, unsigned int objectCount);
+	void Clear();
+	bool IsEmpty() { return cellStarts.empty(); }
+
+	unsigned int GetObjectCount() { return objectCount; }
+	unsigned int GetCellCount() { return (unsigned int)cellStarts.size(); }
+	unsigned int GetCellsX() { return cellsX; }
+	unsigned int GetCellsY() { return cellsY; }
+	unsigned int GetCellsZ() { return cellsZ; }
+	unsigned int GetCellIndex(unsigned int x, unsigned int y, unsigned int z) { return (z * cellsY + y) * cellsX + x; }
+	AABB GetCellBounds(unsigned int cell);
+
+	// The cell position is in, or NoCell outside the grid
+	unsigned int FindCell(const DirectX::XMFLOAT3& position);
+
+	// Words in one cell's unpacked set
+	unsigned int GetWordCount() { return wordCount; }
+
+	// Packs a cell's set, from GetWordCount() words
+	//  - Sharing only happens with neighbours that are already
+	//    set, so set them in order for the best packing
+	void SetCell(unsigned int cell, const unsigned long long* bits);
+	void GetCell(unsigned int cell, unsigned long long* bits);
+
+	// Moves to the cell position is in, if it isn't there already
+	//  - Returns false outside the grid, where IsVisible() is
+	//    always true
+	bool Lookup(const DirectX::XMFLOAT3& position);
+	bool IsVisible(unsigned int object)
+	{
+		return currentCell == NoCell || object >= objectCount || (currentBits[object >> 6] >> (object & 63)) & 1;
+	}
+
+	// The whole thing as bytes, for keeping in a file
+	//  - Read() returns false for anything that doesn't look like
+	//    what Write() makes, and leaves the PVS empty
+	void Write(std::vector<char>& data);
+	bool Read(const char* data, size_t size);
+
+	// Packed size, with the cells' offsets, against a plain bit
+	// per object per cell
+	size_t GetPackedBytes();
+	size_t GetUnpackedBytes();
+
+	void PrintStats();
+	void ResetStats();
+
+private:
+	static const unsigned int MaxCellsPerAxis = 256;
+
+	DirectX::XMFLOAT3 lower;
+	float cellSize;
+	unsigned int cellsX, cellsY, cellsZ;
+	unsigned int objectCount;
+	unsigned int wordCount;
+	unsigned int byteCount;	// In a set, before packing
+
+	std::vector<unsigned char> packed;
+	std::vector<unsigned int> cellStarts;	// Into packed, for each cell
+
+	// What Lookup() last unpacked
+	unsigned int currentCell;
+	std::vector<unsigned long long> currentBits;
+
+	// Stats
+	unsigned long long lookups;
+	unsigned long long unpacks;
+
+	// Packs a set's bytes onto the end of output
+	void Pack(const unsigned long long* bits, std::vector<unsigned char>& output);
+
+	// Returns false if the cell's bytes run off the end, or don't
+	// come to exactly byteCount
+	bool Unpack(unsigned int cell, unsigned long long* bits);
+};
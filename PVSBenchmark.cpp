@@ -0,0 +1,251 @@
+#include "PVSBenchmark.h"
+#include "BenchmarkTiming.h"
+#include "FrustumCuller.h"
+#include "MeshBVH.h"
+#include "PVS.h"
+#include "PVSBuilder.h"
+#include <chrono>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+using namespace DirectX;
+
+// Buildings across and down the city, and how far apart they
+// are; the gaps between them are the streets
+//  - Every other row is shifted half a block along, so only the
+//    streets along x run straight through
+static const unsigned int Blocks = 8;
+static const float BlockPitch = 12.0f;
+static const float BuildingSide = 10.0f;
+
+static const float EyeHeight = 1.7f;
+static const unsigned int WalkFrames = 400;
+
+// Sample points per object when checking with exact rays
+static const unsigned int CheckRays = 64;
+
+// Adds a box's 12 triangles, in world space, facing out
+static void AddBox(const AABB& box, std::vector<XMFLOAT3>& positions, std::vector<unsigned int>& indices)
+{
+	unsigned int first = (unsigned int)positions.size();
+	for (unsigned int corner = 0; corner < 8; corner++)
+	{
+		positions.push_back(XMFLOAT3(
+			corner & 1 ? box.upper.x : box.lower.x,
+			corner & 2 ? box.upper.y : box.lower.y,
+			corner & 4 ? box.upper.z : box.lower.z));
+	}
+
+	static const unsigned int faces[36] =
+	{
+		0, 2, 3, 0, 3, 1,	// -z
+		4, 5, 7, 4, 7, 6,	// +z
+		0, 4, 6, 0, 6, 2,	// -x
+		1, 3, 7, 1, 7, 5,	// +x
+		0, 1, 5, 0, 5, 4,	// -y
+		2, 6, 7, 2, 7, 3,	// +y
+	};
+	for (unsigned int index : faces)
+		indices.push_back(first + index);
+}
+
+// --------------------------------------------------------
+// Whether any of CheckRays sight lines from eye to points on
+// the object's triangles gets there unblocked
+// --------------------------------------------------------
+static bool CanSee(MeshBVH& bvh, const std::vector<XMFLOAT3>& positions, const std::vector<unsigned int>& indices,
+	unsigned int firstTriangle, unsigned int triangleCount, const XMFLOAT3& eye, std::mt19937& random)
+{
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	for (unsigned int r = 0; r < CheckRays; r++)
+	{
+		unsigned int triangle = firstTriangle + (unsigned int)(unit(random) * triangleCount) % triangleCount;
+		float s = sqrtf(unit(random));
+		float t = unit(random);
+		XMVECTOR target =
+			XMLoadFloat3(&positions[indices[triangle * 3]]) * (1.0f - s) +
+			XMLoadFloat3(&positions[indices[triangle * 3 + 1]]) * (s * (1.0f - t)) +
+			XMLoadFloat3(&positions[indices[triangle * 3 + 2]]) * (s * t);
+
+		Ray ray;
+		ray.origin = eye;
+		XMStoreFloat3(&ray.direction, target - XMLoadFloat3(&eye));
+		MeshHit hit;
+		if (!bvh.RayCast(ray, 1.0001f, hit) || (hit.triangle >= firstTriangle && hit.triangle < firstTriangle + triangleCount))
+			return true;
+	}
+	return false;
+}
+
+void RunPVSBenchmark(JobSystem* jobSystem)
+{
+	printf("---- PVS benchmark: %u threads ----\n", jobSystem->GetThreadCount());
+
+	// The ground, then a building on each block, with a prop in
+	// the street on two sides of it
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> height(10.0f, 30.0f);
+	std::uniform_real_distribution<float> propSize(0.5f, 1.0f);
+	std::vector<AABB> boxes;
+	float citySide = Blocks * BlockPitch;
+	boxes.push_back(AABB{ XMFLOAT3(-BlockPitch, -1.0f, -BlockPitch), XMFLOAT3(citySide + BlockPitch, 0.0f, citySide) });
+	for (unsigned int z = 0; z < Blocks; z++)
+	{
+		for (unsigned int x = 0; x < Blocks; x++)
+		{
+			XMFLOAT3 corner((x + (z & 1) * 0.5f) * BlockPitch, 0.0f, z * BlockPitch);
+			boxes.push_back(AABB{ corner, XMFLOAT3(corner.x + BuildingSide, height(random), corner.z + BuildingSide) });
+
+			XMFLOAT3 props[2] =
+			{
+				XMFLOAT3(corner.x + BuildingSide + 0.5f, 0.0f, corner.z + 3.0f),
+				XMFLOAT3(corner.x + 3.0f, 0.0f, corner.z + BuildingSide + 0.5f),
+			};
+			for (const XMFLOAT3& prop : props)
+			{
+				float size = propSize(random);
+				boxes.push_back(AABB{ prop, XMFLOAT3(prop.x + size, size, prop.z + size) });
+			}
+		}
+	}
+
+	// Everything in world space, for the builder and for checking
+	std::vector<XMFLOAT3> positions;
+	std::vector<unsigned int> indices;
+	std::vector<unsigned int> firstTriangles;
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+	PVSBuilder builder;
+	builder.SetCellSize(4.0f);
+	builder.SetRaysPerObject(32);
+	for (const AABB& box : boxes)
+	{
+		std::vector<XMFLOAT3> boxPositions;
+		std::vector<unsigned int> boxIndices;
+		AddBox(box, boxPositions, boxIndices);
+		builder.AddObject(boxPositions.data(), (unsigned int)boxPositions.size(), sizeof(XMFLOAT3), boxIndices.data(), (unsigned int)boxIndices.size(), identity);
+
+		firstTriangles.push_back((unsigned int)indices.size() / 3);
+		AddBox(box, positions, indices);
+	}
+	unsigned int objectCount = (unsigned int)boxes.size();
+
+	PVS pvs;
+	float buildTime = Time([&]() { builder.Build(pvs, jobSystem); });
+	printf("Built in %.1fms: %llu rays (%.1fM rays/s)\n",
+		buildTime, builder.GetRayCount(), builder.GetRayCount() / (buildTime * 1000.0f));
+	pvs.PrintStats();
+
+	// Through Write() and Read(), which should give every set back
+	std::vector<char> data;
+	pvs.Write(data);
+	PVS reread;
+	bool same = reread.Read(data.data(), data.size()) && reread.GetCellCount() == pvs.GetCellCount();
+	std::vector<unsigned long long> bits(pvs.GetWordCount()), rereadBits(pvs.GetWordCount());
+	for (unsigned int cell = 0; same && cell < pvs.GetCellCount(); cell++)
+	{
+		pvs.GetCell(cell, bits.data());
+		reread.GetCell(cell, rereadBits.data());
+		same = bits == rereadBits;
+	}
+	printf("Written to %zu bytes, read back %s\n", data.size(), same ? "the same" : "DIFFERENT");
+
+	unsigned long long setTotal = 0;
+	for (unsigned int cell = 0; cell < pvs.GetCellCount(); cell++)
+	{
+		pvs.GetCell(cell, bits.data());
+		for (unsigned int o = 0; o < objectCount; o++)
+			setTotal += (bits[o >> 6] >> (o & 63)) & 1;
+	}
+	printf("Each cell sees %.1f of %u objects on average\n", (double)setTotal / pvs.GetCellCount(), objectCount);
+
+	// Bounding spheres for the culler
+	std::vector<XMFLOAT3> centers(objectCount);
+	std::vector<float> radii(objectCount);
+	for (unsigned int o = 0; o < objectCount; o++)
+	{
+		centers[o] = GetCenter(boxes[o]);
+		XMFLOAT3 half(boxes[o].upper.x - centers[o].x, boxes[o].upper.y - centers[o].y, boxes[o].upper.z - centers[o].z);
+		radii[o] = sqrtf(half.x * half.x + half.y * half.y + half.z * half.z);
+	}
+
+	MeshBVH bvh;
+	bvh.Build(positions.data(), (unsigned int)positions.size(), sizeof(XMFLOAT3), indices.data(), (unsigned int)indices.size());
+
+	// Along one street, then back along another
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, citySide * 2.0f);
+	float street = BuildingSide + (BlockPitch - BuildingSide) * 0.5f;
+	FrustumCuller culler;
+	std::vector<unsigned int> fullVisible, visible;
+	std::vector<bool> inPVS(objectCount);
+	float fullTime = 0.0f;
+	float pvsTime = 0.0f;
+	size_t fullSubmitted = 0, pvsSubmitted = 0;
+	size_t fullTotal = 0, pvsTotal = 0;
+	unsigned int wronglyHidden = 0;
+	pvs.ResetStats();
+	for (unsigned int frame = 0; frame < WalkFrames; frame++)
+	{
+		float along = (float)(frame % (WalkFrames / 2)) / (WalkFrames / 2) * citySide;
+		float wobble = sinf(frame * 0.05f) * 0.3f;
+		bool firstHalf = frame < WalkFrames / 2;
+		XMFLOAT3 eye = firstHalf ?
+			XMFLOAT3(along, EyeHeight, street + 3 * BlockPitch) :
+			XMFLOAT3(citySide - along, EyeHeight, street + 6 * BlockPitch);
+		XMVECTOR direction = firstHalf ?
+			XMVectorSet(cosf(wobble), 0.0f, sinf(wobble), 0.0f) :
+			XMVectorSet(-cosf(wobble), 0.0f, sinf(wobble), 0.0f);
+		XMFLOAT4X4 viewProjection;
+		XMStoreFloat4x4(&viewProjection, XMMatrixLookToLH(XMLoadFloat3(&eye), direction, XMVectorSet(0, 1, 0, 0)) * projection);
+		Frustum frustum = MakeFrustum(viewProjection);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		culler.Clear();
+		for (unsigned int o = 0; o < objectCount; o++)
+			culler.Add(centers[o], radii[o], o);
+		culler.Cull(frustum, fullVisible);
+		fullTime += GetElapsed(start);
+		fullSubmitted += objectCount;
+
+		// As the runtime would: the PVS first, then the frustum
+		start = std::chrono::high_resolution_clock::now();
+		pvs.Lookup(eye);
+		culler.Clear();
+		for (unsigned int o = 0; o < objectCount; o++)
+		{
+			if (pvs.IsVisible(o))
+				culler.Add(centers[o], radii[o], o);
+		}
+		pvsSubmitted += culler.GetCount();
+		culler.Cull(frustum, visible);
+		pvsTime += GetElapsed(start);
+
+		fullTotal += fullVisible.size();
+		pvsTotal += visible.size();
+
+		// Anything in view that the PVS dropped had better not be
+		// visible from here
+		for (unsigned int o = 0; o < objectCount; o++)
+			inPVS[o] = false;
+		for (unsigned int o : visible)
+			inPVS[o] = true;
+		for (unsigned int o : fullVisible)
+		{
+			unsigned int lastTriangle = o + 1 < objectCount ? firstTriangles[o + 1] : (unsigned int)indices.size() / 3;
+			if (!inPVS[o] && CanSee(bvh, positions, indices, firstTriangles[o], lastTriangle - firstTriangles[o], eye, random))
+				wronglyHidden++;
+		}
+	}
+
+	printf("Walk, frustum only:  %8.4fms  %6.1f objects tested  %6.1f visible\n",
+		fullTime / WalkFrames, (double)fullSubmitted / WalkFrames, (double)fullTotal / WalkFrames);
+	printf("Walk, PVS + frustum: %8.4fms  %6.1f objects tested  %6.1f visible\n",
+		pvsTime / WalkFrames, (double)pvsSubmitted / WalkFrames, (double)pvsTotal / WalkFrames);
+	pvs.PrintStats();
+	if (wronglyHidden > 0)
+		printf("%u objects in view were hidden by the PVS but could be seen!\n", wronglyHidden);
+	else
+		printf("Nothing the PVS hid could be seen\n");
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include "JobSystem.h"
+
+// --------------------------------------------------------
+// Builds potentially visible sets for a made-up city of box
+// buildings with props in the streets between them, then
+// walks a camera down the streets, frustum culling every
+// object each frame and again after dropping the ones the
+// PVS says are hidden, and prints the results
+//  - Also checks every object the PVS dropped that was in the
+//    frustum with rays from the camera, to catch any that
+//    could actually be seen
+// --------------------------------------------------------
+void RunPVSBenchmark(JobSystem* jobSystem);
@@ -0,0 +1,272 @@
+#include "PVSBuilder.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <atomic>
+#include <float.h>
+#include <math.h>
+#include <random>
+
+using namespace DirectX;
+
+// Rays are cast this many at a time, a packet's worth
+static const unsigned int RayBatch = 8;
+
+// Rays reach just past the point they aim at, so the surface
+// they're aimed at is hit rather than missed by rounding
+static const float RayReach = 1.0001f;
+
+// Points tried in each cell for rays to start from, and the
+// rays checking each is in open space
+static const unsigned int OriginTries = 64;
+static const unsigned int OriginProbes = 4;
+
+PVSBuilder::PVSBuilder()
+{
+	cellSize = 4.0f;
+	raysPerObject = 64;
+	dilate = true;
+	rayCount = 0;
+}
+
+unsigned int PVSBuilder::AddObject(const XMFLOAT3* positions, unsigned int vertexCount, unsigned int stride, const unsigned int* indices, unsigned int indexCount, const XMFLOAT4X4& world)
+{
+	Object object = {};
+	object.bounds.lower = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+	object.bounds.upper = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	object.firstTriangle = (unsigned int)triangleObjects.size();
+
+	// Into world space, after everything else's
+	unsigned int firstVertex = (unsigned int)this->positions.size();
+	XMMATRIX worldMatrix = XMLoadFloat4x4(&world);
+	for (unsigned int v = 0; v < vertexCount; v++)
+	{
+		const XMFLOAT3* position = (const XMFLOAT3*)((const char*)positions + (size_t)v * stride);
+		XMFLOAT3 worldPosition;
+		XMStoreFloat3(&worldPosition, XMVector3TransformCoord(XMLoadFloat3(position), worldMatrix));
+		this->positions.push_back(worldPosition);
+		object.bounds = Union(object.bounds, AABB{ worldPosition, worldPosition });
+	}
+
+	unsigned int objectIndex = (unsigned int)objects.size();
+	for (unsigned int i = 0; i + 2 < indexCount; i += 3)
+	{
+		if (indices[i] >= vertexCount || indices[i + 1] >= vertexCount || indices[i + 2] >= vertexCount)
+			continue;
+
+		XMVECTOR a = XMLoadFloat3(&this->positions[firstVertex + indices[i]]);
+		XMVECTOR b = XMLoadFloat3(&this->positions[firstVertex + indices[i + 1]]);
+		XMVECTOR c = XMLoadFloat3(&this->positions[firstVertex + indices[i + 2]]);
+		object.area += 0.5f * XMVectorGetX(XMVector3Length(XMVector3Cross(b - a, c - a)));
+
+		for (unsigned int corner = 0; corner < 3; corner++)
+			this->indices.push_back(firstVertex + indices[i + corner]);
+		triangleObjects.push_back(objectIndex);
+		triangleAreas.push_back(object.area);
+	}
+	object.triangleCount = (unsigned int)triangleObjects.size() - object.firstTriangle;
+
+	if (vertexCount == 0)
+		object.bounds = AABB{ XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 0) };
+	objects.push_back(object);
+	return objectIndex;
+}
+
+void PVSBuilder::Clear()
+{
+	objects.clear();
+	positions.clear();
+	indices.clear();
+	triangleObjects.clear();
+	triangleAreas.clear();
+	bvh.Clear();
+	rayCount = 0;
+}
+
+bool PVSBuilder::Build(PVS& pvs, JobSystem* jobSystem)
+{
+	rayCount = 0;
+	if (objects.empty())
+	{
+		pvs.Clear();
+		return false;
+	}
+
+	AABB bounds = objects[0].bounds;
+	for (const Object& object : objects)
+		bounds = Union(bounds, object.bounds);
+	bounds.lower = XMFLOAT3(bounds.lower.x - cellSize, bounds.lower.y - cellSize, bounds.lower.z - cellSize);
+	bounds.upper = XMFLOAT3(bounds.upper.x + cellSize, bounds.upper.y + cellSize, bounds.upper.z + cellSize);
+	pvs.Create(bounds, cellSize, (unsigned int)objects.size());
+	if (pvs.IsEmpty())
+		return false;
+
+	if (!indices.empty())
+		bvh.Build(positions.data(), (unsigned int)positions.size(), sizeof(XMFLOAT3), indices.data(), (unsigned int)indices.size());
+
+	// Every cell's set, unpacked, until they're all done
+	unsigned int cellCount = pvs.GetCellCount();
+	unsigned int wordCount = pvs.GetWordCount();
+	std::vector<unsigned long long> bits((size_t)cellCount * wordCount, 0);
+	std::atomic<unsigned long long> rays(0);
+	auto buildCells = [this, &pvs, &bits, &rays, wordCount](unsigned int first, unsigned int last)
+	{
+		unsigned long long cellRays = 0;
+		for (unsigned int cell = first; cell < last; cell++)
+			cellRays += BuildCell(pvs, cell, &bits[(size_t)cell * wordCount]);
+		rays += cellRays;
+	};
+
+	if (jobSystem)
+		jobSystem->ParallelFor(cellCount, 1, buildCells);
+	else
+		buildCells(0, cellCount);
+	rayCount = rays;
+
+	// Widen each set with its face neighbours', from a copy so
+	// nothing spreads more than one cell
+	if (dilate)
+	{
+		std::vector<unsigned long long> sampled(bits);
+		unsigned int cellsX = pvs.GetCellsX();
+		unsigned int cellsY = pvs.GetCellsY();
+		unsigned int cellsZ = pvs.GetCellsZ();
+		for (unsigned int z = 0; z < cellsZ; z++)
+		{
+			for (unsigned int y = 0; y < cellsY; y++)
+			{
+				for (unsigned int x = 0; x < cellsX; x++)
+				{
+					unsigned int neighbours[6];
+					unsigned int neighbourCount = 0;
+					if (x > 0) neighbours[neighbourCount++] = pvs.GetCellIndex(x - 1, y, z);
+					if (x + 1 < cellsX) neighbours[neighbourCount++] = pvs.GetCellIndex(x + 1, y, z);
+					if (y > 0) neighbours[neighbourCount++] = pvs.GetCellIndex(x, y - 1, z);
+					if (y + 1 < cellsY) neighbours[neighbourCount++] = pvs.GetCellIndex(x, y + 1, z);
+					if (z > 0) neighbours[neighbourCount++] = pvs.GetCellIndex(x, y, z - 1);
+					if (z + 1 < cellsZ) neighbours[neighbourCount++] = pvs.GetCellIndex(x, y, z + 1);
+
+					unsigned long long* cellBits = &bits[(size_t)pvs.GetCellIndex(x, y, z) * wordCount];
+					for (unsigned int n = 0; n < neighbourCount; n++)
+					{
+						const unsigned long long* neighbourBits = &sampled[(size_t)neighbours[n] * wordCount];
+						for (unsigned int w = 0; w < wordCount; w++)
+							cellBits[w] |= neighbourBits[w];
+					}
+				}
+			}
+		}
+	}
+
+	// In order, so neighbours with the same set share it
+	for (unsigned int cell = 0; cell < cellCount; cell++)
+		pvs.SetCell(cell, &bits[(size_t)cell * wordCount]);
+	return true;
+}
+
+// --------------------------------------------------------
+// Each ray aims at a point on the object and reaches just
+// past it, so the nearest hit is either the object itself or
+// something in the way
+//  - Rays only start from open space: a point is inside
+//    something if a ray from it in a random direction first
+//    hits the back of a triangle (one facing away, going by
+//    the winding the rasterizer culls with), and those are
+//    dropped; a camera can't be there, and rays from inside the
+//    ground would see the bottom of everything standing on it
+//  - Each point gets a few of those rays, since one straight
+//    up from inside the ground could hit the bottom of what's
+//    standing there instead of the ground's top
+//  - A ray that hits nothing at all grazed an edge and slipped
+//    through, which counts as seeing the object; erring that
+//    way only costs a draw
+// --------------------------------------------------------
+unsigned long long PVSBuilder::BuildCell(PVS& pvs, unsigned int cell, unsigned long long* bits)
+{
+	AABB cellBounds = pvs.GetCellBounds(cell);
+	std::mt19937 random(cell);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	Ray rays[RayBatch];
+	MeshHit results[RayBatch];
+	bool hits[RayBatch];
+	unsigned long long cellRays = 0;
+
+	std::vector<XMFLOAT3> origins;
+	for (unsigned int tried = 0; tried < OriginTries; tried += RayBatch / OriginProbes)
+	{
+		for (unsigned int r = 0; r < RayBatch; r++)
+		{
+			if (r % OriginProbes == 0)
+			{
+				rays[r].origin = XMFLOAT3(
+					cellBounds.lower.x + unit(random) * (cellBounds.upper.x - cellBounds.lower.x),
+					cellBounds.lower.y + unit(random) * (cellBounds.upper.y - cellBounds.lower.y),
+					cellBounds.lower.z + unit(random) * (cellBounds.upper.z - cellBounds.lower.z));
+			}
+			else
+				rays[r].origin = rays[r - 1].origin;
+
+			float y = unit(random) * 2.0f - 1.0f;
+			float angle = unit(random) * XM_2PI;
+			float across = sqrtf(1.0f - y * y);
+			rays[r].direction = XMFLOAT3(across * cosf(angle), y, across * sinf(angle));
+		}
+
+		bvh.RayCastPacket(rays, RayBatch, FLT_MAX, results, hits);
+		cellRays += RayBatch;
+		bool open = true;
+		for (unsigned int r = 0; r < RayBatch; r++)
+		{
+			if (hits[r])
+			{
+				unsigned int triangle = results[r].triangle;
+				XMVECTOR a = XMLoadFloat3(&positions[indices[triangle * 3]]);
+				XMVECTOR normal = XMVector3Cross(XMLoadFloat3(&positions[indices[triangle * 3 + 1]]) - a, XMLoadFloat3(&positions[indices[triangle * 3 + 2]]) - a);
+				open &= XMVectorGetX(XMVector3Dot(normal, XMLoadFloat3(&rays[r].direction))) <= 0.0f;
+			}
+
+			if (r % OriginProbes == OriginProbes - 1)
+			{
+				if (open)
+					origins.push_back(rays[r].origin);
+				open = true;
+			}
+		}
+	}
+
+	for (unsigned int o = 0; o < objects.size(); o++)
+	{
+		const Object& object = objects[o];
+		bool visible = Overlaps(object.bounds, cellBounds) || object.area <= 0.0f;
+		for (unsigned int cast = 0; cast < raysPerObject && !visible && !origins.empty(); cast += RayBatch)
+		{
+			unsigned int count = std::min(raysPerObject - cast, RayBatch);
+			for (unsigned int r = 0; r < count; r++)
+			{
+				// A triangle by area, then a point on it
+				const float* areas = &triangleAreas[object.firstTriangle];
+				unsigned int triangle = (unsigned int)(std::upper_bound(areas, areas + object.triangleCount, unit(random) * object.area) - areas);
+				triangle = object.firstTriangle + std::min(triangle, object.triangleCount - 1);
+
+				float s = sqrtf(unit(random));
+				float t = unit(random);
+				XMVECTOR a = XMLoadFloat3(&positions[indices[triangle * 3]]);
+				XMVECTOR b = XMLoadFloat3(&positions[indices[triangle * 3 + 1]]);
+				XMVECTOR c = XMLoadFloat3(&positions[indices[triangle * 3 + 2]]);
+				XMVECTOR target = a * (1.0f - s) + b * (s * (1.0f - t)) + c * (s * t);
+
+				rays[r].origin = origins[random() % origins.size()];
+				XMStoreFloat3(&rays[r].direction, target - XMLoadFloat3(&rays[r].origin));
+			}
+
+			bvh.RayCastPacket(rays, count, RayReach, results, hits);
+			cellRays += count;
+			for (unsigned int r = 0; r < count; r++)
+				visible |= !hits[r] || triangleObjects[results[r].triangle] == o;
+		}
+
+		if (visible)
+			bits[o >> 6] |= 1ull << (o & 63);
+	}
+	return cellRays;
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+#include "Collision.h"
+#include "MeshBVH.h"
+#include "PVS.h"
+
+class JobSystem;
+
+// --------------------------------------------------------
+// Works out a static scene's potentially visible sets
+//  - Every object's triangles go into one world-space BVH, with
+//    a note of which object each triangle came from
+//  - For each cell, rays go from random points in the cell to
+//    random points on each object's surface (weighted by area);
+//    if one gets to the object - the first thing it hits is one
+//    of the object's triangles - the object is visible from the
+//    cell, and no more rays are cast at it
+//  - Objects whose bounds touch the cell are visible without
+//    any rays, since the camera could be right up against them
+//  - Sampling can miss a gap that's only seen from a corner of a
+//    cell, so by default each cell's set is then widened with its
+//    six neighbours' - a little more gets drawn, but nothing
+//    that should be seen is dropped
+//  - Cells are independent, so a JobSystem spreads them across
+//    threads; each has its own random sequence, so the result
+//    doesn't depend on how the work is split
+//  - Meant for offline use (see the asset cooker): a big scene's
+//    worth of rays takes a while
+// --------------------------------------------------------
+class PVSBuilder
+{
+public:
+	PVSBuilder();
+
+	// Adds an object, in model space with its world matrix, and
+	// returns its index in the PVS
+	//  - Positions are read stride bytes apart, as MeshBVH does
+	unsigned int AddObject(const DirectX::XMFLOAT3* positions, unsigned int vertexCount, unsigned int stride, const unsigned int* indices, unsigned int indexCount, const DirectX::XMFLOAT4X4& world);
+	void Clear();
+
+	unsigned int GetObjectCount() { return (unsigned int)objects.size(); }
+	const AABB& GetObjectBounds(unsigned int object) { return objects[object].bounds; }
+
+	// Size of a cell's sides, in world units
+	void SetCellSize(float cellSize) { this->cellSize = cellSize; }
+
+	// Most rays cast from a cell at any one object
+	void SetRaysPerObject(unsigned int rays) { raysPerObject = rays; }
+
+	// Whether cells take on their neighbours' sets too
+	void SetDilate(bool dilate) { this->dilate = dilate; }
+
+	// Fills in pvs with a grid over every object, padded by a cell
+	// on each side so a camera standing on the edge is still in it
+	//  - Returns false if there's nothing to build from
+	bool Build(PVS& pvs, JobSystem* jobSystem = 0);
+
+	// Rays cast by the last Build()
+	unsigned long long GetRayCount() { return rayCount; }
+
+private:
+	struct Object
+	{
+		AABB bounds;
+		unsigned int firstTriangle;
+		unsigned int triangleCount;
+		float area;
+	};
+
+	std::vector<Object> objects;
+
+	// Every object's triangles, in world space
+	std::vector<DirectX::XMFLOAT3> positions;
+	std::vector<unsigned int> indices;
+	std::vector<unsigned int> triangleObjects;	// Which object each triangle is from
+	std::vector<float> triangleAreas;			// Running total within its object, for sampling
+
+	MeshBVH bvh;
+	float cellSize;
+	unsigned int raysPerObject;
+	bool dilate;
+	unsigned long long rayCount;
+
+	// One cell's set, a bit per object; returns the rays it took
+	unsigned long long BuildCell(PVS& pvs, unsigned int cell, unsigned long long* bits);
+};
@@ -113,7 +113,7 @@ float4 main(VertexToPixel input) : SV_TARGET
 	float3 totalLight = finalDLColor + finalPLColor + ambientColor;
 
 
-	return float4(totalLight, 1);
+	return float4(totalLight, input.color.a);
 
 	//float4 directionalLightColor =
 	//	GetFinalColorDir(dLight1, input.normal, surfaceColor) +
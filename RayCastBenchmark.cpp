@@ -0,0 +1,160 @@
+#include "RayCastBenchmark.h"
+#include "BenchmarkTiming.h"
+#include "MeshBVH.h"
+#include <atomic>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+using namespace DirectX;
+
+static float GetHeight(float x, float z)
+{
+	return sinf(x * 0.05f) * cosf(z * 0.07f) * 8.0f + sinf(x * 0.31f + z * 0.17f) * 1.5f;
+}
+
+// Casts rays every way MeshBVH can, checking they all agree
+static void CastAll(JobSystem* jobSystem, MeshBVH& bvh, const std::vector<Ray>& rays, float maxDistance)
+{
+	unsigned int count = (unsigned int)rays.size();
+	std::vector<MeshHit> results(count);
+	bool* hits = new bool[count];
+
+	unsigned int singleHits = 0;
+	float singleTime = Time([&]()
+	{
+		for (unsigned int i = 0; i < count; i++)
+			singleHits += bvh.RayCast(rays[i], maxDistance, results[i]) ? 1 : 0;
+	});
+	PrintRays("Single:", count, singleTime, singleHits);
+
+	unsigned int widths[2] = { 4, 8 };
+	for (unsigned int width : widths)
+	{
+		bvh.SetPacketWidth(width);
+		if (bvh.GetPacketWidth() != width)
+		{
+			printf("Packets of %u:          (not supported)\n", width);
+			continue;
+		}
+
+		unsigned int packetHits = 0;
+		float packetTime = Time([&]() { packetHits = bvh.RayCastPacket(rays.data(), count, maxDistance, results.data(), hits); });
+		char name[32];
+		snprintf(name, sizeof(name), "Packets of %u:", width);
+		PrintRays(name, count, packetTime, packetHits);
+		if (packetHits != singleHits)
+			printf("  (%u hits, against %u one at a time)\n", packetHits, singleHits);
+	}
+
+	// Tiles of rays, so each packet stays coherent
+	bvh.SetPacketWidth(8);
+	std::atomic<unsigned int> threadedHits(0);
+	float threadedTime = Time([&]()
+	{
+		jobSystem->ParallelFor(count, 1024, [&](unsigned int first, unsigned int last)
+		{
+			threadedHits += bvh.RayCastPacket(&rays[first], last - first, maxDistance, &results[first], &hits[first]);
+		});
+	});
+	PrintRays("Threaded packets:", count, threadedTime, threadedHits);
+
+	unsigned int occludedHits = 0;
+	float occludedTime = Time([&]()
+	{
+		for (unsigned int i = 0; i < count; i++)
+			occludedHits += bvh.Occluded(rays[i], maxDistance) ? 1 : 0;
+	});
+	PrintRays("Any hit:", count, occludedTime, occludedHits);
+
+	delete[] hits;
+}
+
+static void RunAtSize(JobSystem* jobSystem, unsigned int quads)
+{
+	// A square heightfield, two triangles per quad
+	std::vector<XMFLOAT3> positions;
+	std::vector<unsigned int> indices;
+	positions.reserve((quads + 1) * (quads + 1));
+	indices.reserve(quads * quads * 6);
+	for (unsigned int z = 0; z <= quads; z++)
+	{
+		for (unsigned int x = 0; x <= quads; x++)
+			positions.push_back(XMFLOAT3((float)x, GetHeight((float)x, (float)z), (float)z));
+	}
+	for (unsigned int z = 0; z < quads; z++)
+	{
+		for (unsigned int x = 0; x < quads; x++)
+		{
+			unsigned int corner = z * (quads + 1) + x;
+			unsigned int quad[6] = { corner, corner + quads + 1, corner + 1, corner + 1, corner + quads + 1, corner + quads + 2 };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+
+	MeshBVH bvh;
+	float buildTime = Time([&]() { bvh.Build(positions.data(), (unsigned int)positions.size(), sizeof(XMFLOAT3), indices.data(), (unsigned int)indices.size()); });
+	printf("-- %u triangles: built in %.1fms, %u nodes, cost %.1f --\n", (unsigned int)indices.size() / 3, buildTime, bvh.GetNodeCount(), bvh.GetCost());
+
+	// A 512x288 screen from a camera above one corner, looking
+	// across the terrain
+	const unsigned int width = 512;
+	const unsigned int height = 288;
+	float side = (float)quads;
+	XMMATRIX view = XMMatrixLookAtLH(
+		XMVectorSet(-side * 0.1f, 30.0f, -side * 0.1f, 0.0f),
+		XMVectorSet(side * 0.5f, 0.0f, side * 0.5f, 0.0f),
+		XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+	XMMATRIX inverseView = XMMatrixInverse(0, view);
+	float tanHalf = tanf(XM_PIDIV4 * 0.5f);
+	float aspect = (float)width / height;
+
+	std::vector<Ray> rays;
+	rays.reserve(width * height);
+	for (unsigned int tileY = 0; tileY < height; tileY += 4)
+	{
+		for (unsigned int tileX = 0; tileX < width; tileX += 2)
+		{
+			// 2x4 tiles, one per 8-wide packet
+			for (unsigned int y = tileY; y < tileY + 4; y++)
+			{
+				for (unsigned int x = tileX; x < tileX + 2; x++)
+				{
+					float screenX = ((x + 0.5f) / width * 2.0f - 1.0f) * tanHalf * aspect;
+					float screenY = (1.0f - (y + 0.5f) / height * 2.0f) * tanHalf;
+					Ray ray;
+					XMStoreFloat3(&ray.origin, XMVector3TransformCoord(XMVectorZero(), inverseView));
+					XMStoreFloat3(&ray.direction, XMVector3Normalize(XMVector3TransformNormal(XMVectorSet(screenX, screenY, 1.0f, 0.0f), inverseView)));
+					rays.push_back(ray);
+				}
+			}
+		}
+	}
+	printf("Camera rays:\n");
+	CastAll(jobSystem, bvh, rays, side * 2.0f);
+
+	// Sight lines between random points a little above the
+	// ground, which are as incoherent as rays get
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> position(0.0f, side);
+	std::uniform_real_distribution<float> lift(0.5f, 4.0f);
+	for (Ray& ray : rays)
+	{
+		float fromX = position(random), fromZ = position(random);
+		float toX = position(random), toZ = position(random);
+		ray.origin = XMFLOAT3(fromX, GetHeight(fromX, fromZ) + lift(random), fromZ);
+		XMFLOAT3 to(toX, GetHeight(toX, toZ) + lift(random), toZ);
+		ray.direction = XMFLOAT3(to.x - ray.origin.x, to.y - ray.origin.y, to.z - ray.origin.z);
+	}
+	printf("Sight lines:\n");
+	CastAll(jobSystem, bvh, rays, 1.0f);
+}
+
+void RunRayCastBenchmark(JobSystem* jobSystem)
+{
+	printf("---- Ray cast benchmark: %u threads ----\n", jobSystem->GetThreadCount());
+
+	RunAtSize(jobSystem, 256);
+	RunAtSize(jobSystem, 1024);
+}
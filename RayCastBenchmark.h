@@ -0,0 +1,11 @@
+#pragma once
+#include "JobSystem.h"
+
+// --------------------------------------------------------
+// Builds triangle BVHs over bumpy terrain meshes of 130k and
+// 2M triangles, then casts a screen's worth of camera rays and
+// a batch of random sight lines at each, one ray at a time, in
+// 4 and 8 wide packets, and in packets across the job system,
+// and prints the build time and rays per second of each
+// --------------------------------------------------------
+void RunRayCastBenchmark(JobSystem* jobSystem);
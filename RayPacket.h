@@ -0,0 +1,201 @@
+#pragma once
+#include <DirectXMath.h>
+#include <float.h>
+#include <immintrin.h>
+#include <vector>
+#include "Collision.h"
+
+// --------------------------------------------------------
+// The handful of operations packet traversal needs, for 4
+// lanes of SSE and 8 of AVX, so it can be written once
+//  - Lanes8 needs AVX2 (see HasAVX2() in CPUFeatures.h)
+// --------------------------------------------------------
+struct Lanes4
+{
+	typedef __m128 Value;
+	static const unsigned int Width = 4;
+
+	static Value Set(float value) { return _mm_set1_ps(value); }
+	static Value Load(const float* values) { return _mm_loadu_ps(values); }
+	static void Store(float* values, Value value) { _mm_storeu_ps(values, value); }
+	static Value Add(Value a, Value b) { return _mm_add_ps(a, b); }
+	static Value Sub(Value a, Value b) { return _mm_sub_ps(a, b); }
+	static Value Mul(Value a, Value b) { return _mm_mul_ps(a, b); }
+	static Value Div(Value a, Value b) { return _mm_div_ps(a, b); }
+	static Value Min(Value a, Value b) { return _mm_min_ps(a, b); }
+	static Value Max(Value a, Value b) { return _mm_max_ps(a, b); }
+	static Value Less(Value a, Value b) { return _mm_cmplt_ps(a, b); }
+	static Value LessEqual(Value a, Value b) { return _mm_cmple_ps(a, b); }
+	static Value And(Value a, Value b) { return _mm_and_ps(a, b); }
+	static Value Select(Value mask, Value a, Value b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+	static int Mask(Value value) { return _mm_movemask_ps(value); }
+	static Value FromBits(unsigned int bits) { return _mm_castsi128_ps(_mm_set1_epi32((int)bits)); }
+};
+
+struct Lanes8
+{
+	typedef __m256 Value;
+	static const unsigned int Width = 8;
+
+	static Value Set(float value) { return _mm256_set1_ps(value); }
+	static Value Load(const float* values) { return _mm256_loadu_ps(values); }
+	static void Store(float* values, Value value) { _mm256_storeu_ps(values, value); }
+	static Value Add(Value a, Value b) { return _mm256_add_ps(a, b); }
+	static Value Sub(Value a, Value b) { return _mm256_sub_ps(a, b); }
+	static Value Mul(Value a, Value b) { return _mm256_mul_ps(a, b); }
+	static Value Div(Value a, Value b) { return _mm256_div_ps(a, b); }
+	static Value Min(Value a, Value b) { return _mm256_min_ps(a, b); }
+	static Value Max(Value a, Value b) { return _mm256_max_ps(a, b); }
+	static Value Less(Value a, Value b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	static Value LessEqual(Value a, Value b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+	static Value And(Value a, Value b) { return _mm256_and_ps(a, b); }
+	static Value Select(Value mask, Value a, Value b) { return _mm256_blendv_ps(b, a, mask); }
+	static int Mask(Value value) { return _mm256_movemask_ps(value); }
+	static Value FromBits(unsigned int bits) { return _mm256_castsi256_ps(_mm256_set1_epi32((int)bits)); }
+};
+
+// --------------------------------------------------------
+// Up to Lanes::Width rays, a component at a time, and how far
+// along each one is still worth looking
+//  - Lanes past the rays given start with a negative distance,
+//    so they never hit anything
+// --------------------------------------------------------
+template<typename Lanes>
+struct RayPacket
+{
+	typedef typename Lanes::Value Value;
+
+	Value originX, originY, originZ;
+	Value directionX, directionY, directionZ;
+	Value inverseX, inverseY, inverseZ;
+	Value nearest;
+	unsigned int count;
+
+	// maxDistances is per ray; a negative one turns the ray off
+	RayPacket(const Ray* rays, unsigned int count, const float* maxDistances)
+	{
+		this->count = count;
+		float values[10][Lanes::Width];
+		for (unsigned int lane = 0; lane < Lanes::Width; lane++)
+		{
+			const Ray& ray = rays[lane < count ? lane : count - 1];
+			DirectX::XMFLOAT3 inverse = GetInverseDirection(ray.direction);
+			values[0][lane] = ray.origin.x;
+			values[1][lane] = ray.origin.y;
+			values[2][lane] = ray.origin.z;
+			values[3][lane] = ray.direction.x;
+			values[4][lane] = ray.direction.y;
+			values[5][lane] = ray.direction.z;
+			values[6][lane] = inverse.x;
+			values[7][lane] = inverse.y;
+			values[8][lane] = inverse.z;
+			values[9][lane] = lane < count ? maxDistances[lane] : -1.0f;
+		}
+		originX = Lanes::Load(values[0]);
+		originY = Lanes::Load(values[1]);
+		originZ = Lanes::Load(values[2]);
+		directionX = Lanes::Load(values[3]);
+		directionY = Lanes::Load(values[4]);
+		directionZ = Lanes::Load(values[5]);
+		inverseX = Lanes::Load(values[6]);
+		inverseY = Lanes::Load(values[7]);
+		inverseZ = Lanes::Load(values[8]);
+		nearest = Lanes::Load(values[9]);
+	}
+
+	// Picks up distances brought in from outside
+	void SetNearest(const float* maxDistances)
+	{
+		float values[Lanes::Width];
+		for (unsigned int lane = 0; lane < Lanes::Width; lane++)
+			values[lane] = lane < count ? maxDistances[lane] : -1.0f;
+		nearest = Lanes::Load(values);
+	}
+
+	// Slab test of every ray against the box, within its nearest
+	//  - Returns a bit per ray that hits it, and sets entry to
+	//    the nearest of those rays' entry distances
+	int TestBox(const float lower[3], const float upper[3], float& entry) const
+	{
+		Value x1 = Lanes::Mul(Lanes::Sub(Lanes::Set(lower[0]), originX), inverseX);
+		Value x2 = Lanes::Mul(Lanes::Sub(Lanes::Set(upper[0]), originX), inverseX);
+		Value y1 = Lanes::Mul(Lanes::Sub(Lanes::Set(lower[1]), originY), inverseY);
+		Value y2 = Lanes::Mul(Lanes::Sub(Lanes::Set(upper[1]), originY), inverseY);
+		Value z1 = Lanes::Mul(Lanes::Sub(Lanes::Set(lower[2]), originZ), inverseZ);
+		Value z2 = Lanes::Mul(Lanes::Sub(Lanes::Set(upper[2]), originZ), inverseZ);
+		Value tNear = Lanes::Max(Lanes::Max(Lanes::Min(x1, x2), Lanes::Min(y1, y2)), Lanes::Max(Lanes::Min(z1, z2), Lanes::Set(0.0f)));
+		Value tFar = Lanes::Min(Lanes::Min(Lanes::Max(x1, x2), Lanes::Max(y1, y2)), Lanes::Min(Lanes::Max(z1, z2), nearest));
+		Value hit = Lanes::LessEqual(tNear, tFar);
+		int mask = Lanes::Mask(hit);
+		if (mask == 0)
+			return 0;
+
+		float entries[Lanes::Width];
+		Lanes::Store(entries, Lanes::Select(hit, tNear, Lanes::Set(FLT_MAX)));
+		entry = entries[0];
+		for (unsigned int lane = 1; lane < Lanes::Width; lane++)
+			entry = entries[lane] < entry ? entries[lane] : entry;
+		return mask;
+	}
+
+	// Furthest any ray still needs to look
+	float GetFurthest() const
+	{
+		float distances[Lanes::Width];
+		Lanes::Store(distances, nearest);
+		float furthest = distances[0];
+		for (unsigned int lane = 1; lane < Lanes::Width; lane++)
+			furthest = distances[lane] > furthest ? distances[lane] : furthest;
+		return furthest;
+	}
+};
+
+// --------------------------------------------------------
+// Stack of nodes still to visit, with how far along the ray
+// each one starts, so ones beyond the nearest hit so far can
+// be dropped without looking at them again
+//  - Stays in a fixed array unless the tree is unusually deep
+// --------------------------------------------------------
+class TraversalStack
+{
+public:
+	TraversalStack() : count(0) { }
+
+	void Push(unsigned int node, float entry)
+	{
+		if (count < LocalSize)
+			local[count] = Entry{ node, entry };
+		else
+			overflow.push_back(Entry{ node, entry });
+		count++;
+	}
+
+	void Pop(unsigned int& node, float& entry)
+	{
+		count--;
+		Entry top;
+		if (count < LocalSize)
+			top = local[count];
+		else
+		{
+			top = overflow.back();
+			overflow.pop_back();
+		}
+		node = top.node;
+		entry = top.entry;
+	}
+
+	bool IsEmpty() { return count == 0; }
+
+private:
+	struct Entry
+	{
+		unsigned int node;
+		float entry;
+	};
+
+	static const unsigned int LocalSize = 64;
+	Entry local[LocalSize];
+	std::vector<Entry> overflow;
+	unsigned int count;
+};
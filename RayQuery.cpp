@@ -0,0 +1,213 @@
+#include "RayQuery.h"
+#include "CPUFeatures.h"
+#include <algorithm>
+#include <float.h>
+
+using namespace DirectX;
+
+// Bits per axis of the Morton code rays are sorted by
+static const unsigned int MortonBits = 9;
+
+// Packets per job when casting across the job system
+static const unsigned int PacketsPerJob = 32;
+
+// Spreads the low 9 bits out to every third bit
+static unsigned int SpreadBits(unsigned int value)
+{
+	value &= 0x1FF;
+	value = (value | (value << 16)) & 0x030000FF;
+	value = (value | (value << 8)) & 0x0300F00F;
+	value = (value | (value << 4)) & 0x030C30C3;
+	value = (value | (value << 2)) & 0x09249249;
+	return value;
+}
+
+RayQuery::RayQuery()
+{
+	sortRays = true;
+	packetSize = HasAVX2() ? 8 : 4;
+}
+
+void RayQuery::SetPacketSize(unsigned int packetSize)
+{
+	if (packetSize >= 8 && HasAVX2())
+		this->packetSize = 8;
+	else if (packetSize >= 4)
+		this->packetSize = 4;
+	else
+		this->packetSize = 1;
+}
+
+unsigned int RayQuery::AddMesh(std::shared_ptr<MeshBVH> bvh)
+{
+	meshes.push_back(bvh);
+	return (unsigned int)meshes.size() - 1;
+}
+
+void RayQuery::SetInstance(EntityId entity, unsigned int mesh, const XMFLOAT4X4& world)
+{
+	if (mesh >= meshes.size())
+		return;
+	if (entity.index >= instances.size())
+		instances.resize(entity.index + 1, Instance{ 0 });
+
+	Instance& instance = instances[entity.index];
+	instance.generation = entity.generation;
+	instance.mesh = mesh;
+	XMStoreFloat4x4(&instance.inverseWorld, XMMatrixInverse(0, XMLoadFloat4x4(&world)));
+}
+
+void RayQuery::RemoveInstance(EntityId entity)
+{
+	if (entity.index < instances.size() && instances[entity.index].generation == entity.generation)
+		instances[entity.index].generation = 0;
+}
+
+// --------------------------------------------------------
+// Puts the rays in an order where neighbours go the same
+// way from nearby, in order
+//  - Keys are the direction's octant, then the Morton code of
+//    the origin within the batch's bounds, then the ray's index
+// --------------------------------------------------------
+void RayQuery::SortRays(const Ray* rays, unsigned int count)
+{
+	XMFLOAT3 lower(FLT_MAX, FLT_MAX, FLT_MAX);
+	XMFLOAT3 upper(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const XMFLOAT3& origin = rays[i].origin;
+		lower = XMFLOAT3(std::min(lower.x, origin.x), std::min(lower.y, origin.y), std::min(lower.z, origin.z));
+		upper = XMFLOAT3(std::max(upper.x, origin.x), std::max(upper.y, origin.y), std::max(upper.z, origin.z));
+	}
+
+	float cells = (float)((1 << MortonBits) - 1);
+	XMFLOAT3 scale(
+		upper.x > lower.x ? cells / (upper.x - lower.x) : 0.0f,
+		upper.y > lower.y ? cells / (upper.y - lower.y) : 0.0f,
+		upper.z > lower.z ? cells / (upper.z - lower.z) : 0.0f);
+
+	sortKeys.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const Ray& ray = rays[i];
+		unsigned int octant =
+			(ray.direction.x < 0.0f ? 1 : 0) |
+			(ray.direction.y < 0.0f ? 2 : 0) |
+			(ray.direction.z < 0.0f ? 4 : 0);
+		unsigned int morton =
+			SpreadBits((unsigned int)((ray.origin.x - lower.x) * scale.x)) |
+			(SpreadBits((unsigned int)((ray.origin.y - lower.y) * scale.y)) << 1) |
+			(SpreadBits((unsigned int)((ray.origin.z - lower.z) * scale.z)) << 2);
+		unsigned long long key = ((unsigned long long)octant << (MortonBits * 3)) | morton;
+		sortKeys[i] = (key << 32) | i;
+	}
+	std::sort(sortKeys.begin(), sortKeys.end());
+
+	order.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+		order[i] = (unsigned int)sortKeys[i];
+}
+
+unsigned int RayQuery::Cast(EntityBVH& entities, const Ray* rays, unsigned int count, float maxDistance, RayQueryHit* results, bool* hits, JobSystem* jobSystem)
+{
+	if (sortRays)
+		SortRays(rays, count);
+	else
+	{
+		order.resize(count);
+		for (unsigned int i = 0; i < count; i++)
+			order[i] = i;
+	}
+
+	unsigned int packetCount = (count + packetSize - 1) / packetSize;
+	auto castPackets = [&](unsigned int first, unsigned int last)
+	{
+		for (unsigned int packet = first; packet < last; packet++)
+		{
+			unsigned int firstRay = packet * packetSize;
+			CastPacket(entities, rays, &order[firstRay], std::min(packetSize, count - firstRay), maxDistance, results, hits);
+		}
+	};
+
+	if (jobSystem)
+		jobSystem->ParallelFor(packetCount, PacketsPerJob, castPackets);
+	else
+		castPackets(0, packetCount);
+
+	unsigned int hitCount = 0;
+	for (unsigned int i = 0; i < count; i++)
+		hitCount += hits[i] ? 1 : 0;
+	return hitCount;
+}
+
+// --------------------------------------------------------
+// Walks the entity BVH with the packet, and casts the rays
+// that reach each entity against its mesh as they're found,
+// which brings those rays in for the rest of the walk
+// --------------------------------------------------------
+void RayQuery::CastPacket(EntityBVH& entities, const Ray* rays, const unsigned int* rayIndices, unsigned int count, float maxDistance, RayQueryHit* results, bool* hits)
+{
+	Ray packet[8];
+	float nearest[8];
+	for (unsigned int lane = 0; lane < count; lane++)
+	{
+		packet[lane] = rays[rayIndices[lane]];
+		nearest[lane] = maxDistance;
+		hits[rayIndices[lane]] = false;
+	}
+
+	entities.RayCastPacket(packet, count, nearest, [&](EntityId entity, const XMFLOAT3& center, float radius, unsigned int lanes)
+	{
+		const Instance* instance = entity.index < instances.size() && instances[entity.index].generation == entity.generation ?
+			&instances[entity.index] : 0;
+
+		if (!instance)
+		{
+			for (unsigned int lane = 0; lane < count; lane++)
+			{
+				float distance;
+				if ((lanes & (1 << lane)) && RayIntersectsSphere(packet[lane], center, radius, nearest[lane], distance))
+				{
+					nearest[lane] = distance;
+					hits[rayIndices[lane]] = true;
+					results[rayIndices[lane]] = RayQueryHit{ entity, NoTriangle, distance, 0.0f, 0.0f };
+				}
+			}
+			return;
+		}
+
+		// Into the mesh's space, where distances along the rays
+		// stay the same since the directions aren't normalized
+		XMMATRIX inverseWorld = XMLoadFloat4x4(&instance->inverseWorld);
+		Ray local[8];
+		float distances[8];
+		for (unsigned int lane = 0; lane < count; lane++)
+		{
+			XMStoreFloat3(&local[lane].origin, XMVector3TransformCoord(XMLoadFloat3(&packet[lane].origin), inverseWorld));
+			XMStoreFloat3(&local[lane].direction, XMVector3TransformNormal(XMLoadFloat3(&packet[lane].direction), inverseWorld));
+			distances[lane] = (lanes & (1 << lane)) ? nearest[lane] : -1.0f;
+		}
+
+		MeshBVH* mesh = meshes[instance->mesh].get();
+		MeshHit meshHits[8];
+		bool meshHit[8];
+		if (packetSize == 1)
+		{
+			for (unsigned int lane = 0; lane < count; lane++)
+				meshHit[lane] = distances[lane] >= 0.0f && mesh->RayCast(local[lane], distances[lane], meshHits[lane]);
+		}
+		else
+			mesh->RayCastPacket(local, count, distances, meshHits, meshHit);
+
+		for (unsigned int lane = 0; lane < count; lane++)
+		{
+			if (!meshHit[lane])
+				continue;
+
+			const MeshHit& hit = meshHits[lane];
+			nearest[lane] = hit.distance;
+			hits[rayIndices[lane]] = true;
+			results[rayIndices[lane]] = RayQueryHit{ entity, hit.triangle, hit.distance, hit.u, hit.v };
+		}
+	});
+}
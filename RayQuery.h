@@ -0,0 +1,81 @@
+#pragma once
+#include <DirectXMath.h>
+#include <memory>
+#include <vector>
+#include "EntityBVH.h"
+#include "JobSystem.h"
+#include "MeshBVH.h"
+
+// Where one of a batch of rays hit
+//  - triangle and u, v are as in MeshHit, for entities that have
+//    a mesh; entities without one are hit on their bounding
+//    sphere, and triangle is RayQuery::NoTriangle
+struct RayQueryHit
+{
+	EntityId entity;
+	unsigned int triangle;
+	float distance;
+	float u, v;
+};
+
+// --------------------------------------------------------
+// Casts batches of rays against entities, down to their
+// triangles, for gameplay queries like sight lines and probes
+//  - Entities come from an EntityBVH, which gives each ray's
+//    candidates nearest first; any with a mesh here are then
+//    cast against that mesh's MeshBVH, in the entity's model
+//    space, and the rest count as hit on their sphere
+//  - Rays are sorted first (by direction octant, then along a
+//    Morton curve through their origins), so rays that go
+//    through the same parts of the trees end up together
+//  - Then they go in packets of 8 (4 without AVX2): each packet
+//    walks the entity BVH together, and then each mesh it hits
+//  - Packets are split across the job system when one's given
+//  - Meshes are shared with the Mesh they came from, and an
+//    entity's instance needs updating whenever it moves
+//  - Cast() only reads, so nothing may change the entity BVH or
+//    the instances while it runs
+// --------------------------------------------------------
+class RayQuery
+{
+public:
+	static const unsigned int NoTriangle = 0xFFFFFFFF;
+
+	RayQuery();
+
+	// Returns the mesh's id, for SetInstance()
+	unsigned int AddMesh(std::shared_ptr<MeshBVH> bvh);
+
+	// Which mesh the entity is, and where
+	void SetInstance(EntityId entity, unsigned int mesh, const DirectX::XMFLOAT4X4& world);
+	void RemoveInstance(EntityId entity);
+
+	// Casts count rays at the entities in entities, writing whether
+	// each hit to hits[i] and the nearest hit to results[i]
+	//  - Returns how many hit
+	unsigned int Cast(EntityBVH& entities, const Ray* rays, unsigned int count, float maxDistance, RayQueryHit* results, bool* hits, JobSystem* jobSystem = 0);
+
+	// Sorting, and packets (1 turns them off, 8 needs AVX2), can
+	// be turned off for comparison
+	void SetSortRays(bool sortRays) { this->sortRays = sortRays; }
+	void SetPacketSize(unsigned int packetSize);
+	unsigned int GetPacketSize() { return packetSize; }
+
+private:
+	struct Instance
+	{
+		unsigned int generation; // 0 when there's no instance
+		unsigned int mesh;
+		DirectX::XMFLOAT4X4 inverseWorld;
+	};
+
+	std::vector<std::shared_ptr<MeshBVH>> meshes;
+	std::vector<Instance> instances; // By entity index
+	std::vector<unsigned long long> sortKeys;
+	std::vector<unsigned int> order;
+	bool sortRays;
+	unsigned int packetSize;
+
+	void SortRays(const Ray* rays, unsigned int count);
+	void CastPacket(EntityBVH& entities, const Ray* rays, const unsigned int* rayIndices, unsigned int count, float maxDistance, RayQueryHit* results, bool* hits);
+};
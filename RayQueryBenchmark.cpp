@@ -0,0 +1,146 @@
+#include "RayQueryBenchmark.h"
+#include "BenchmarkTiming.h"
+#include "RayQuery.h"
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+using namespace DirectX;
+
+// A lumpy sphere of about 2 * rings * rings triangles, inside
+// the unit sphere
+static std::shared_ptr<MeshBVH> MakeRock(unsigned int rings, float lumpiness)
+{
+	std::vector<XMFLOAT3> positions;
+	std::vector<unsigned int> indices;
+	unsigned int segments = rings * 2;
+	for (unsigned int ring = 0; ring <= rings; ring++)
+	{
+		float theta = XM_PI * ring / rings;
+		for (unsigned int segment = 0; segment <= segments; segment++)
+		{
+			float phi = XM_2PI * segment / segments;
+			float radius = 1.0f - lumpiness * (0.5f + 0.5f * sinf(theta * 5.0f) * cosf(phi * 3.0f));
+			positions.push_back(XMFLOAT3(radius * sinf(theta) * cosf(phi), radius * cosf(theta), radius * sinf(theta) * sinf(phi)));
+		}
+	}
+	for (unsigned int ring = 0; ring < rings; ring++)
+	{
+		for (unsigned int segment = 0; segment < segments; segment++)
+		{
+			unsigned int corner = ring * (segments + 1) + segment;
+			unsigned int quad[6] = { corner, corner + 1, corner + segments + 1, corner + 1, corner + segments + 2, corner + segments + 1 };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+
+	std::shared_ptr<MeshBVH> bvh = std::make_shared<MeshBVH>();
+	bvh->Build(positions.data(), (unsigned int)positions.size(), sizeof(XMFLOAT3), indices.data(), (unsigned int)indices.size());
+	return bvh;
+}
+
+static void Cast(const char* name, RayQuery& query, EntityBVH& entities, const std::vector<Ray>& rays, float maxDistance, JobSystem* jobSystem)
+{
+	unsigned int count = (unsigned int)rays.size();
+	std::vector<RayQueryHit> results(count);
+	bool* hits = new bool[count];
+
+	unsigned int hitCount = 0;
+	float milliseconds = Time([&]() { hitCount = query.Cast(entities, rays.data(), count, maxDistance, results.data(), hits, jobSystem); });
+	PrintRays(name, count, milliseconds, hitCount);
+
+	delete[] hits;
+}
+
+static void CastEveryWay(RayQuery& query, EntityBVH& entities, const std::vector<Ray>& rays, float maxDistance, JobSystem* jobSystem)
+{
+	query.SetSortRays(false);
+	query.SetPacketSize(1);
+	Cast("Unsorted, single:", query, entities, rays, maxDistance, 0);
+	query.SetSortRays(true);
+	Cast("Sorted, single:", query, entities, rays, maxDistance, 0);
+	query.SetPacketSize(4);
+	Cast("Sorted, packets of 4:", query, entities, rays, maxDistance, 0);
+	query.SetPacketSize(8);
+	if (query.GetPacketSize() == 8)
+		Cast("Sorted, packets of 8:", query, entities, rays, maxDistance, 0);
+	else
+		printf("Sorted, packets of 8:  (not supported)\n");
+	query.SetSortRays(false);
+	Cast("Unsorted, packets:", query, entities, rays, maxDistance, 0);
+	query.SetSortRays(true);
+	Cast("Threaded:", query, entities, rays, maxDistance, jobSystem);
+}
+
+static void RunAtCount(JobSystem* jobSystem, unsigned int count)
+{
+	printf("-- %u entities --\n", count);
+
+	std::shared_ptr<MeshBVH> rocks[3] = { MakeRock(16, 0.2f), MakeRock(32, 0.3f), MakeRock(48, 0.1f) };
+	RayQuery query;
+	unsigned int meshes[3];
+	for (int i = 0; i < 3; i++)
+		meshes[i] = query.AddMesh(rocks[i]);
+
+	// Rocks of all sizes and turns, spread so there are about the
+	// same number near any point whatever the count
+	std::mt19937 random(1234);
+	float side = cbrtf((float)count) * 6.0f;
+	std::uniform_real_distribution<float> position(0.0f, side);
+	std::uniform_real_distribution<float> size(0.5f, 2.0f);
+	std::uniform_real_distribution<float> angle(0.0f, XM_2PI);
+	EntityBVH entities;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		XMFLOAT3 center(position(random), position(random), position(random));
+		float scale = size(random);
+		XMFLOAT4X4 world;
+		XMStoreFloat4x4(&world,
+			XMMatrixScaling(scale, scale, scale) *
+			XMMatrixRotationRollPitchYaw(angle(random), angle(random), angle(random)) *
+			XMMatrixTranslation(center.x, center.y, center.z));
+
+		EntityId entity;
+		entity.index = i;
+		entity.generation = 1;
+		entities.Insert(entity, center, scale);
+		query.SetInstance(entity, meshes[i % 3], world);
+	}
+	entities.Build();
+
+	// Sight lines from a few observers to points all around them,
+	// as AI visibility checks would be
+	const unsigned int rayCount = 100000;
+	std::vector<Ray> rays(rayCount);
+	XMFLOAT3 observers[16];
+	for (XMFLOAT3& observer : observers)
+		observer = XMFLOAT3(position(random), position(random), position(random));
+	std::uniform_real_distribution<float> offset(-30.0f, 30.0f);
+	for (unsigned int i = 0; i < rayCount; i++)
+	{
+		Ray& ray = rays[i];
+		ray.origin = observers[i % 16];
+		ray.direction = XMFLOAT3(offset(random), offset(random), offset(random));
+	}
+	printf("Sight lines:\n");
+	CastEveryWay(query, entities, rays, 1.0f, jobSystem);
+
+	// Short probes from anywhere, in any direction
+	std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+	for (Ray& ray : rays)
+	{
+		ray.origin = XMFLOAT3(position(random), position(random), position(random));
+		ray.direction = XMFLOAT3(direction(random), direction(random), direction(random));
+	}
+	printf("Probes:\n");
+	CastEveryWay(query, entities, rays, 10.0f, jobSystem);
+}
+
+void RunRayQueryBenchmark(JobSystem* jobSystem)
+{
+	printf("---- Ray query benchmark: %u threads ----\n", jobSystem->GetThreadCount());
+
+	RunAtCount(jobSystem, 10000);
+	RunAtCount(jobSystem, 100000);
+}
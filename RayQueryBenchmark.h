@@ -0,0 +1,10 @@
+#pragma once
+#include "JobSystem.h"
+
+// --------------------------------------------------------
+// Casts batches of sight lines and random probes through
+// scenes of 10k and 100k meshed entities with RayQuery, with
+// and without sorting, packets and the job system, and prints
+// the rays per second of each
+// --------------------------------------------------------
+void RunRayQueryBenchmark(JobSystem* jobSystem);
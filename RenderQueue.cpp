@@ -0,0 +1,165 @@
+#include "RenderQueue.h"
+#include <stdio.h>
+#include <string.h>
+
+// Bits of each part of a key
+static const unsigned int PassBits = 2;
+static const unsigned int ShaderBits = 10;
+static const unsigned int MaterialBits = 16;
+static const unsigned int MeshBits = 16;
+static const unsigned int DepthBits = 20;
+
+static const unsigned long long DepthMax = (1ull << DepthBits) - 1;
+
+// Ids too big for their bits wrap, which only costs some order
+static unsigned long long Field(unsigned int value, unsigned int bits)
+{
+	return value & ((1ull << bits) - 1);
+}
+
+RenderQueue::RenderQueue()
+{
+	nearZ = 0.1f;
+	farZ = 100.0f;
+	ResetStats();
+}
+
+void RenderQueue::Begin(float nearZ, float farZ)
+{
+	this->nearZ = nearZ;
+	this->farZ = farZ;
+	draws.clear();
+	keys.clear();
+}
+
+unsigned int RenderQueue::GetShaderId(SimpleVertexShader* vertexShader, SimplePixelShader* pixelShader)
+{
+	for (unsigned int id = 0; id < vertexShaders.size(); id++)
+	{
+		if (vertexShaders[id] == vertexShader && pixelShaders[id] == pixelShader)
+			return id;
+	}
+
+	vertexShaders.push_back(vertexShader);
+	pixelShaders.push_back(pixelShader);
+	return (unsigned int)vertexShaders.size() - 1;
+}
+
+void RenderQueue::Add(RenderPass pass, unsigned int shader, unsigned int material, unsigned int mesh, float depth, unsigned int item)
+{
+	float range = farZ - nearZ;
+	float t = range > 0.0f ? (depth - nearZ) / range : 0.0f;
+	t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+	unsigned long long nearToFar = (unsigned long long)(t * DepthMax);
+
+	// Everything below the pass is shifted up from the bottom
+	unsigned long long key = (unsigned long long)pass << (64 - PassBits);
+	if (pass == RenderPass::Transparent)
+	{
+		key |= (DepthMax - nearToFar) << (ShaderBits + MaterialBits + MeshBits);
+		key |= Field(shader, ShaderBits) << (MaterialBits + MeshBits);
+		key |= Field(material, MaterialBits) << MeshBits;
+		key |= Field(mesh, MeshBits);
+	}
+	else
+	{
+		key |= Field(shader, ShaderBits) << (MaterialBits + MeshBits + DepthBits);
+		key |= Field(material, MaterialBits) << (MeshBits + DepthBits);
+		key |= Field(mesh, MeshBits) << DepthBits;
+		key |= nearToFar;
+	}
+
+	SortKey sortKey = { key, (unsigned int)draws.size() };
+	keys.push_back(sortKey);
+	draws.push_back(QueuedDraw{ item, shader, material, mesh, pass });
+}
+
+void RenderQueue::Sort()
+{
+	CountChanges(false, unsortedChanges);
+	RadixSort();
+	CountChanges(true, sortedChanges);
+	frames++;
+	drawCount += keys.size();
+}
+
+// --------------------------------------------------------
+// Every byte's counts are taken in one pass over the keys,
+// then each byte that isn't the same everywhere scatters the
+// keys into the other buffer, keeping the order from the last
+// byte for equal ones
+// --------------------------------------------------------
+void RenderQueue::RadixSort()
+{
+	unsigned int count = (unsigned int)keys.size();
+	if (count < 2)
+		return;
+
+	unsigned int counts[8][256];
+	memset(counts, 0, sizeof(counts));
+	for (const SortKey& sortKey : keys)
+	{
+		for (unsigned int byte = 0; byte < 8; byte++)
+			counts[byte][(sortKey.key >> (byte * 8)) & 0xFF]++;
+	}
+
+	scratch.resize(count);
+	for (unsigned int byte = 0; byte < 8; byte++)
+	{
+		unsigned int* byteCounts = counts[byte];
+		if (byteCounts[(keys[0].key >> (byte * 8)) & 0xFF] == count)
+			continue;
+
+		// Counts into where each value's keys start
+		unsigned int start = 0;
+		for (unsigned int value = 0; value < 256; value++)
+		{
+			unsigned int valueCount = byteCounts[value];
+			byteCounts[value] = start;
+			start += valueCount;
+		}
+
+		for (const SortKey& sortKey : keys)
+			scratch[byteCounts[(sortKey.key >> (byte * 8)) & 0xFF]++] = sortKey;
+		keys.swap(scratch);
+	}
+}
+
+void RenderQueue::CountChanges(bool sorted, Changes& changes)
+{
+	const QueuedDraw* last = 0;
+	for (unsigned int i = 0; i < keys.size(); i++)
+	{
+		const QueuedDraw& draw = sorted ? Get(i) : draws[i];
+		bool shaderChanged = !last || draw.shader != last->shader;
+		changes.shaders += shaderChanged ? 1 : 0;
+		changes.materials += shaderChanged || draw.material != last->material ? 1 : 0;
+		changes.meshes += !last || draw.mesh != last->mesh ? 1 : 0;
+		last = &draw;
+	}
+}
+
+void RenderQueue::PrintStats()
+{
+	printf("---- Render queue: %llu frames ----\n", frames);
+	if (frames == 0)
+		return;
+
+	printf("Per frame: %.1f draws\n", (double)drawCount / frames);
+	printf("State changes per frame, sorted:   %.1f shaders, %.1f materials, %.1f meshes\n",
+		(double)sortedChanges.shaders / frames,
+		(double)sortedChanges.materials / frames,
+		(double)sortedChanges.meshes / frames);
+	printf("State changes per frame, unsorted: %.1f shaders, %.1f materials, %.1f meshes\n",
+		(double)unsortedChanges.shaders / frames,
+		(double)unsortedChanges.materials / frames,
+		(double)unsortedChanges.meshes / frames);
+}
+
+void RenderQueue::ResetStats()
+{
+	frames = 0;
+	drawCount = 0;
+	sortedChanges = Changes{};
+	unsortedChanges = Changes{};
+}
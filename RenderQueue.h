@@ -0,0 +1,105 @@
+#pragma once
+#include <vector>
+
+class SimpleVertexShader;
+class SimplePixelShader;
+
+// Which pass a draw is in; passes are drawn in this order
+enum class RenderPass
+{
+	Opaque,
+	Transparent
+};
+
+// One draw, as RenderQueue hands them back
+//  - item is whatever the caller uses to find what to draw
+//    (Game uses the snapshot's item index)
+struct QueuedDraw
+{
+	unsigned int item;
+	unsigned int shader;	// From RenderQueue::GetShaderId()
+	unsigned int material;
+	unsigned int mesh;
+	RenderPass pass;
+};
+
+// --------------------------------------------------------
+// Puts a frame's draws in the order that changes state least
+//  - Each draw gets a 64-bit key, most significant bits first:
+//      opaque:      pass, shaders, material, mesh, depth
+//      transparent: pass, depth, shaders, material, mesh
+//    with 2 bits of pass, 10 of shaders, 16 each of material
+//    and mesh, and 20 of depth
+//  - Sorting by key draws everything with the same shaders
+//    together, then within that everything with the same
+//    material, then the same mesh; opaque depth only breaks
+//    ties, near to far, so the depth test can skip pixels
+//    behind what's already drawn
+//  - Transparent draws have to blend far to near, so there
+//    depth comes first, and state changes go where they must
+//  - Sorted with an LSD radix sort a byte at a time, skipping
+//    bytes that every key has the same
+//  - Counts the state changes drawing in key order takes, next
+//    to what drawing in the order they were added would have
+// --------------------------------------------------------
+class RenderQueue
+{
+public:
+	static const unsigned int NoId = 0xFFFFFFFF;
+
+	RenderQueue();
+
+	// Starts a frame's draws; depth is view-space z, and is
+	// measured between nearZ and farZ
+	void Begin(float nearZ, float farZ);
+
+	// Numbers shader pairs as they're first seen
+	unsigned int GetShaderId(SimpleVertexShader* vertexShader, SimplePixelShader* pixelShader);
+
+	void Add(RenderPass pass, unsigned int shader, unsigned int material, unsigned int mesh, float depth, unsigned int item);
+
+	// Puts the draws in key order, and counts state changes
+	void Sort();
+
+	unsigned int GetCount() { return (unsigned int)keys.size(); }
+	const QueuedDraw& Get(unsigned int index) { return draws[keys[index].draw]; }
+
+	void PrintStats();
+	void ResetStats();
+
+private:
+	struct SortKey
+	{
+		unsigned long long key;
+		unsigned int draw;	// Into draws
+	};
+
+	// State changes in one order of draws
+	//  - A material counts as changed whenever the shaders do
+	//    too, since its values go into their constant buffers
+	struct Changes
+	{
+		unsigned long long shaders;
+		unsigned long long materials;
+		unsigned long long meshes;
+	};
+
+	float nearZ;
+	float farZ;
+
+	std::vector<QueuedDraw> draws;
+	std::vector<SortKey> keys;
+	std::vector<SortKey> scratch;
+
+	std::vector<SimpleVertexShader*> vertexShaders;
+	std::vector<SimplePixelShader*> pixelShaders;
+
+	// Stats
+	unsigned long long frames;
+	unsigned long long drawCount;
+	Changes sortedChanges;
+	Changes unsortedChanges;
+
+	void RadixSort();
+	void CountChanges(bool sorted, Changes& changes);
+};
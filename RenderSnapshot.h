@@ -0,0 +1,54 @@
+#pragma once
+#include <DirectXMath.h>
+#include <chrono>
+#include <vector>
+#include "Components.h"
+#include "Lights.h"
+
+// One thing to draw, with everything it needs from the simulation
+//  - Its world matrix from the update before too, so Draw() can
+//    blend between the two (the same matrix twice if it wasn't
+//    drawn then)
+//  - lod is the mesh's level of detail to draw
+struct RenderItem
+{
+	MeshHandle mesh;
+	MaterialHandle material;
+	unsigned int lod;
+	DirectX::XMFLOAT4X4 previousWorld;
+	DirectX::XMFLOAT4X4 world;
+};
+
+// --------------------------------------------------------
+// Everything Draw() needs from one simulation update
+//  - Made by the simulation and never changed once published,
+//    so the render thread can read it while the simulation
+//    moves on to the next update
+//  - Holds no pointers into the simulation's data; meshes and
+//    materials are looked up by handle on the render side
+//  - Has the previous update's camera and world matrices as
+//    well as this one's, so a frame that falls between the two
+//    updates can be drawn as it would look at that moment
+// --------------------------------------------------------
+struct RenderSnapshot
+{
+	std::vector<RenderItem> items;
+
+	DirectX::XMFLOAT4X4 previousView;
+	DirectX::XMFLOAT4X4 view;
+	DirectX::XMFLOAT4X4 projection;
+	DirectX::XMFLOAT3 previousCameraPosition;
+	DirectX::XMFLOAT3 cameraPosition;
+
+	std::vector<DirectionalLight> directionalLights;
+	std::vector<PointLight> pointLights;
+
+	// The total time this update's state is for, and how long
+	// after the previous update's that is
+	float time = 0.0f;
+	float timeStep = 0.0f;
+
+	// Which update made this, and when that update read its input
+	unsigned long long update = 0;
+	std::chrono::high_resolution_clock::time_point inputTime;
+};
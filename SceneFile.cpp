@@ -0,0 +1,192 @@
+#include "SceneFile.h"
+#include <fstream>
+#include <sstream>
+#include <string.h>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Header at the front of every cooked scene file
+//  - Followed by objectCount objects, each a world matrix,
+//    then a 32-bit length and that many characters of path
+//  - Then pvsBytes of PVS, as PVS::Write() makes it
+// --------------------------------------------------------
+struct CookedSceneHeader
+{
+	unsigned int magic;		// Always 'CSCN'
+	unsigned int version;	// SceneFile::CookedSceneVersion
+	unsigned int objectCount;
+	float cellSize;
+	unsigned int raysPerObject;
+	unsigned int pvsBytes;
+};
+
+static const unsigned int CookedSceneMagic = 0x4E435343; // "CSCN" in little endian
+
+// Longest mesh path a cooked scene can have
+static const unsigned int MaxPathLength = 1024;
+
+// --------------------------------------------------------
+// Reads an entire file into memory
+// --------------------------------------------------------
+static bool ReadWholeFile(const char* filename, std::vector<char>& data)
+{
+	std::ifstream file(filename, std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+		return false;
+
+	std::streamsize size = file.tellg();
+	file.seekg(0, std::ios::beg);
+	data.resize((size_t)size);
+	return size == 0 || file.read(&data[0], size).good();
+}
+
+bool SceneFile::LoadScene(const char* filename, SceneData& scene)
+{
+	std::vector<char> data;
+	if (!ReadWholeFile(filename, data))
+		return false;
+
+	return ParseScene(data.data(), data.size(), scene);
+}
+
+// --------------------------------------------------------
+// Parses a source scene that is already in memory
+//  - Fails on any line it doesn't understand, so a typo
+//    doesn't quietly drop an object
+// --------------------------------------------------------
+bool SceneFile::ParseScene(const char* data, size_t size, SceneData& scene)
+{
+	scene = SceneData();
+
+	std::istringstream text(std::string(data, size));
+	std::string line;
+	while (std::getline(text, line))
+	{
+		size_t comment = line.find('#');
+		if (comment != std::string::npos)
+			line.resize(comment);
+
+		std::istringstream words(line);
+		std::string command;
+		if (!(words >> command))
+			continue;
+
+		if (command == "cell")
+		{
+			if (!(words >> scene.cellSize) || scene.cellSize <= 0.0f)
+				return false;
+		}
+		else if (command == "rays")
+		{
+			if (!(words >> scene.raysPerObject))
+				return false;
+		}
+		else if (command == "object")
+		{
+			SceneObject object;
+			XMFLOAT3 position, rotation, scale;
+			if (!(words >> object.mesh >>
+				position.x >> position.y >> position.z >>
+				rotation.x >> rotation.y >> rotation.z >>
+				scale.x >> scale.y >> scale.z))
+				return false;
+
+			const float toRadians = XM_PI / 180.0f;
+			XMMATRIX world =
+				XMMatrixScaling(scale.x, scale.y, scale.z) *
+				XMMatrixRotationRollPitchYaw(rotation.x * toRadians, rotation.y * toRadians, rotation.z * toRadians) *
+				XMMatrixTranslation(position.x, position.y, position.z);
+			XMStoreFloat4x4(&object.world, world);
+			scene.objects.push_back(object);
+		}
+		else
+			return false;
+	}
+
+	scene.success = true;
+	return true;
+}
+
+bool SceneFile::LoadCookedScene(const char* filename, SceneData& scene)
+{
+	std::vector<char> data;
+	if (!ReadWholeFile(filename, data) || data.empty())
+		return false;
+
+	return ParseCookedScene(data.data(), data.size(), scene);
+}
+
+// --------------------------------------------------------
+// Same as LoadCookedScene(), but from a file already in memory
+//  - A PVS that doesn't match the objects fails the load, as
+//    it would hide the wrong ones
+// --------------------------------------------------------
+bool SceneFile::ParseCookedScene(const char* data, size_t size, SceneData& scene)
+{
+	scene = SceneData();
+
+	CookedSceneHeader header = {};
+	if (size < sizeof(CookedSceneHeader))
+		return false;
+	memcpy(&header, data, sizeof(CookedSceneHeader));
+	if (header.magic != CookedSceneMagic || header.version != CookedSceneVersion)
+		return false;
+
+	size_t offset = sizeof(CookedSceneHeader);
+	for (unsigned int o = 0; o < header.objectCount; o++)
+	{
+		SceneObject object;
+		unsigned int pathLength = 0;
+		if (size - offset < sizeof(XMFLOAT4X4) + sizeof(unsigned int))
+			return false;
+		memcpy(&object.world, data + offset, sizeof(XMFLOAT4X4));
+		memcpy(&pathLength, data + offset + sizeof(XMFLOAT4X4), sizeof(unsigned int));
+		offset += sizeof(XMFLOAT4X4) + sizeof(unsigned int);
+
+		if (pathLength > MaxPathLength || size - offset < pathLength)
+			return false;
+		object.mesh.assign(data + offset, pathLength);
+		offset += pathLength;
+		scene.objects.push_back(object);
+	}
+
+	if (size - offset < header.pvsBytes ||
+		!scene.pvs.Read(data + offset, header.pvsBytes) ||
+		scene.pvs.GetObjectCount() != header.objectCount)
+		return false;
+
+	scene.cellSize = header.cellSize;
+	scene.raysPerObject = header.raysPerObject;
+	scene.success = true;
+	return true;
+}
+
+bool SceneFile::WriteCookedScene(const char* filename, SceneData& scene)
+{
+	std::vector<char> pvsData;
+	scene.pvs.Write(pvsData);
+
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return false;
+
+	CookedSceneHeader header = {};
+	header.magic = CookedSceneMagic;
+	header.version = CookedSceneVersion;
+	header.objectCount = (unsigned int)scene.objects.size();
+	header.cellSize = scene.cellSize;
+	header.raysPerObject = scene.raysPerObject;
+	header.pvsBytes = (unsigned int)pvsData.size();
+
+	file.write((const char*)&header, sizeof(CookedSceneHeader));
+	for (const SceneObject& object : scene.objects)
+	{
+		unsigned int pathLength = (unsigned int)object.mesh.size();
+		file.write((const char*)&object.world, sizeof(XMFLOAT4X4));
+		file.write((const char*)&pathLength, sizeof(unsigned int));
+		file.write(object.mesh.data(), pathLength);
+	}
+	file.write(pvsData.data(), pvsData.size());
+	return file.good();
+}
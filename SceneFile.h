@@ -0,0 +1,54 @@
+#pragma once
+#include <DirectXMath.h>
+#include <string>
+#include <vector>
+#include "PVS.h"
+
+// One static object in a scene: a mesh, and where it goes
+//  - mesh is relative to the directory the scene is in
+struct SceneObject
+{
+	std::string mesh;
+	DirectX::XMFLOAT4X4 world;
+};
+
+// --------------------------------------------------------
+// A static scene's objects, and their potentially visible
+// sets once cooked
+//  - pvs has a bit per object, in the same order
+// --------------------------------------------------------
+struct SceneData
+{
+	std::vector<SceneObject> objects;
+	float cellSize = 4.0f;
+	unsigned int raysPerObject = 64;
+	PVS pvs;
+	bool success = false;
+};
+
+// --------------------------------------------------------
+// Scene file helpers, shared by the runtime and the offline
+// asset cooker, like MeshLoader
+//  - Source scenes (.scene) are text, a line each:
+//      cell <size>
+//      rays <per object>
+//      object <mesh> <x y z> <pitch yaw roll> <sx sy sz>
+//    with angles in degrees, and # starting a comment
+//  - The cooker turns them into .cscene files, which carry
+//    the objects and the PVS it worked out for them
+// --------------------------------------------------------
+class SceneFile
+{
+public:
+	// Bump this whenever the cooked layout (or PVS's) changes
+	static const unsigned int CookedSceneVersion = 1;
+
+	// Reads the source (.scene) format; no PVS
+	static bool LoadScene(const char* filename, SceneData& scene);
+	static bool ParseScene(const char* data, size_t size, SceneData& scene);
+
+	// Reads and writes the cooked (.cscene) format
+	static bool LoadCookedScene(const char* filename, SceneData& scene);
+	static bool ParseCookedScene(const char* data, size_t size, SceneData& scene);
+	static bool WriteCookedScene(const char* filename, SceneData& scene);
+};
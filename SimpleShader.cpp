@@ -18,6 +18,7 @@ ISimpleShader::ISimpleShader(ID3D11Device* device, ID3D11DeviceContext* context)
 	this->constantBuffers = 0;
 	this->shaderBlob = 0;
 	this->shaderValid = false;
+	this->stateCache = 0;
 }
 
 // --------------------------------------------------------
@@ -79,6 +80,41 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		return false;
 	}
 
+	return LoadShaderBlob();
+}
+
+// --------------------------------------------------------
+// Same as LoadShaderFile(), but with compiled shader code
+// that has already been read into memory (for instance,
+// by an asynchronous file loader)
+//
+// shaderData - The contents of a compiled shader (.cso) file
+// shaderSize - The size of that data in bytes
+// 
+// Returns true if shader is loaded properly, false otherwise
+// --------------------------------------------------------
+bool ISimpleShader::LoadShaderData(const void* shaderData, size_t shaderSize)
+{
+	// Copy the data into a blob, since that's what the rest
+	// of the loading and reflection process works with
+	HRESULT hr = D3DCreateBlob(shaderSize, &shaderBlob);
+	if (hr != S_OK)
+	{
+		return false;
+	}
+	memcpy(shaderBlob->GetBufferPointer(), shaderData, shaderSize);
+
+	return LoadShaderBlob();
+}
+
+// --------------------------------------------------------
+// Creates the shader from the already-loaded shader blob
+// and builds the variable table using shader reflection.
+// 
+// Returns true if shader is loaded properly, false otherwise
+// --------------------------------------------------------
+bool ISimpleShader::LoadShaderBlob()
+{
 	// Create the shader - Calls an overloaded version of this abstract
 	// method in the appropriate child class
 	shaderValid = CreateShader(shaderBlob);
@@ -594,6 +630,23 @@ SimpleVertexShader::SimpleVertexShader(ID3D11Device* device, ID3D11DeviceContext
 	this->LoadShaderFile(shaderFile);
 }
 
+// --------------------------------------------------------
+// Constructor overload which takes compiled shader code that
+// has already been read into memory
+// --------------------------------------------------------
+SimpleVertexShader::SimpleVertexShader(ID3D11Device* device, ID3D11DeviceContext* context, const void* shaderData, size_t shaderSize)
+	: ISimpleShader(device, context)
+{
+	// Ensure we set to zero to successfully trigger
+	// the Input Layout creation during LoadShaderData()
+	this->inputLayout = 0;
+	this->shader = 0;
+	this->perInstanceCompatible = false;
+
+	// Create the shader from the data
+	this->LoadShaderData(shaderData, shaderSize);
+}
+
 // --------------------------------------------------------
 // Constructor overload which takes a custom input layout
 //
@@ -764,6 +817,17 @@ void SimpleVertexShader::SetShaderAndCBs()
 	// Is shader valid?
 	if (!shaderValid) return;
 
+	// Through the state cache, if there is one, which skips
+	// whatever's already bound
+	if (stateCache)
+	{
+		stateCache->SetInputLayout(inputLayout);
+		stateCache->SetShader(ShaderStage::Vertex, shader);
+		for (unsigned int i = 0; i < constantBufferCount; i++)
+			stateCache->SetConstantBuffer(ShaderStage::Vertex, constantBuffers[i].BindIndex, constantBuffers[i].ConstantBuffer);
+		return;
+	}
+
 	// Set the shader and input layout
 	deviceContext->IASetInputLayout(inputLayout);
 	deviceContext->VSSetShader(shader, 0, 0);
@@ -794,7 +858,10 @@ bool SimpleVertexShader::SetShaderResourceView(std::string name, ID3D11ShaderRes
 		return false;
 
 	// Set the shader resource view
-	deviceContext->VSSetShaderResources(srvInfo->BindIndex, 1, &srv);
+	if (stateCache)
+		stateCache->SetShaderResource(ShaderStage::Vertex, srvInfo->BindIndex, srv);
+	else
+		deviceContext->VSSetShaderResources(srvInfo->BindIndex, 1, &srv);
 
 	// Success
 	return true;
@@ -816,7 +883,10 @@ bool SimpleVertexShader::SetSamplerState(std::string name, ID3D11SamplerState* s
 		return false;
 
 	// Set the shader resource view
-	deviceContext->VSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
+	if (stateCache)
+		stateCache->SetSampler(ShaderStage::Vertex, sampInfo->BindIndex, samplerState);
+	else
+		deviceContext->VSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
 
 	// Success
 	return true;
@@ -839,6 +909,19 @@ SimplePixelShader::SimplePixelShader(ID3D11Device* device, ID3D11DeviceContext*
 	this->LoadShaderFile(shaderFile);
 }
 
+// --------------------------------------------------------
+// Constructor overload which takes compiled shader code that
+// has already been read into memory
+// --------------------------------------------------------
+SimplePixelShader::SimplePixelShader(ID3D11Device* device, ID3D11DeviceContext* context, const void* shaderData, size_t shaderSize)
+	: ISimpleShader(device, context)
+{
+	this->shader = 0;
+
+	// Create the shader from the data
+	this->LoadShaderData(shaderData, shaderSize);
+}
+
 // --------------------------------------------------------
 // Destructor - Clean up actual shader (base will be called automatically)
 // --------------------------------------------------------
@@ -889,6 +972,16 @@ void SimplePixelShader::SetShaderAndCBs()
 	// Is shader valid?
 	if (!shaderValid) return;
 	
+	// Through the state cache, if there is one, which skips
+	// whatever's already bound
+	if (stateCache)
+	{
+		stateCache->SetShader(ShaderStage::Pixel, shader);
+		for (unsigned int i = 0; i < constantBufferCount; i++)
+			stateCache->SetConstantBuffer(ShaderStage::Pixel, constantBuffers[i].BindIndex, constantBuffers[i].ConstantBuffer);
+		return;
+	}
+
 	// Set the shader
 	deviceContext->PSSetShader(shader, 0, 0);
 
@@ -918,7 +1011,10 @@ bool SimplePixelShader::SetShaderResourceView(std::string name, ID3D11ShaderReso
 		return false;
 
 	// Set the shader resource view
-	deviceContext->PSSetShaderResources(srvInfo->BindIndex, 1, &srv);
+	if (stateCache)
+		stateCache->SetShaderResource(ShaderStage::Pixel, srvInfo->BindIndex, srv);
+	else
+		deviceContext->PSSetShaderResources(srvInfo->BindIndex, 1, &srv);
 
 	// Success
 	return true;
@@ -940,7 +1036,10 @@ bool SimplePixelShader::SetSamplerState(std::string name, ID3D11SamplerState* sa
 		return false;
 
 	// Set the shader resource view
-	deviceContext->PSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
+	if (stateCache)
+		stateCache->SetSampler(ShaderStage::Pixel, sampInfo->BindIndex, samplerState);
+	else
+		deviceContext->PSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
 
 	// Success
 	return true;
@@ -1015,6 +1114,16 @@ void SimpleDomainShader::SetShaderAndCBs()
 	// Is shader valid?
 	if (!shaderValid) return;
 
+	// Through the state cache, if there is one, which skips
+	// whatever's already bound
+	if (stateCache)
+	{
+		stateCache->SetShader(ShaderStage::Domain, shader);
+		for (unsigned int i = 0; i < constantBufferCount; i++)
+			stateCache->SetConstantBuffer(ShaderStage::Domain, constantBuffers[i].BindIndex, constantBuffers[i].ConstantBuffer);
+		return;
+	}
+
 	// Set the shader
 	deviceContext->DSSetShader(shader, 0, 0);
 
@@ -1044,7 +1153,10 @@ bool SimpleDomainShader::SetShaderResourceView(std::string name, ID3D11ShaderRes
 		return false;
 
 	// Set the shader resource view
-	deviceContext->DSSetShaderResources(srvInfo->BindIndex, 1, &srv);
+	if (stateCache)
+		stateCache->SetShaderResource(ShaderStage::Domain, srvInfo->BindIndex, srv);
+	else
+		deviceContext->DSSetShaderResources(srvInfo->BindIndex, 1, &srv);
 
 	// Success
 	return true;
@@ -1066,7 +1178,10 @@ bool SimpleDomainShader::SetSamplerState(std::string name, ID3D11SamplerState* s
 		return false;
 
 	// Set the shader resource view
-	deviceContext->DSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
+	if (stateCache)
+		stateCache->SetSampler(ShaderStage::Domain, sampInfo->BindIndex, samplerState);
+	else
+		deviceContext->DSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
 
 	// Success
 	return true;
@@ -1140,6 +1255,16 @@ void SimpleHullShader::SetShaderAndCBs()
 	// Is shader valid?
 	if (!shaderValid) return;
 
+	// Through the state cache, if there is one, which skips
+	// whatever's already bound
+	if (stateCache)
+	{
+		stateCache->SetShader(ShaderStage::Hull, shader);
+		for (unsigned int i = 0; i < constantBufferCount; i++)
+			stateCache->SetConstantBuffer(ShaderStage::Hull, constantBuffers[i].BindIndex, constantBuffers[i].ConstantBuffer);
+		return;
+	}
+
 	// Set the shader
 	deviceContext->HSSetShader(shader, 0, 0);
 
@@ -1169,7 +1294,10 @@ bool SimpleHullShader::SetShaderResourceView(std::string name, ID3D11ShaderResou
 		return false;
 
 	// Set the shader resource view
-	deviceContext->HSSetShaderResources(srvInfo->BindIndex, 1, &srv);
+	if (stateCache)
+		stateCache->SetShaderResource(ShaderStage::Hull, srvInfo->BindIndex, srv);
+	else
+		deviceContext->HSSetShaderResources(srvInfo->BindIndex, 1, &srv);
 
 	// Success
 	return true;
@@ -1191,7 +1319,10 @@ bool SimpleHullShader::SetSamplerState(std::string name, ID3D11SamplerState* sam
 		return false;
 
 	// Set the shader resource view
-	deviceContext->HSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
+	if (stateCache)
+		stateCache->SetSampler(ShaderStage::Hull, sampInfo->BindIndex, samplerState);
+	else
+		deviceContext->HSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
 
 	// Success
 	return true;
@@ -1388,6 +1519,16 @@ void SimpleGeometryShader::SetShaderAndCBs()
 	// Is shader valid?
 	if (!shaderValid) return;
 
+	// Through the state cache, if there is one, which skips
+	// whatever's already bound
+	if (stateCache)
+	{
+		stateCache->SetShader(ShaderStage::Geometry, shader);
+		for (unsigned int i = 0; i < constantBufferCount; i++)
+			stateCache->SetConstantBuffer(ShaderStage::Geometry, constantBuffers[i].BindIndex, constantBuffers[i].ConstantBuffer);
+		return;
+	}
+
 	// Set the shader
 	deviceContext->GSSetShader(shader, 0, 0);
 
@@ -1417,7 +1558,10 @@ bool SimpleGeometryShader::SetShaderResourceView(std::string name, ID3D11ShaderR
 		return false;
 
 	// Set the shader resource view
-	deviceContext->GSSetShaderResources(srvInfo->BindIndex, 1, &srv);
+	if (stateCache)
+		stateCache->SetShaderResource(ShaderStage::Geometry, srvInfo->BindIndex, srv);
+	else
+		deviceContext->GSSetShaderResources(srvInfo->BindIndex, 1, &srv);
 
 	// Success
 	return true;
@@ -1439,7 +1583,10 @@ bool SimpleGeometryShader::SetSamplerState(std::string name, ID3D11SamplerState*
 		return false;
 
 	// Set the shader resource view
-	deviceContext->GSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
+	if (stateCache)
+		stateCache->SetSampler(ShaderStage::Geometry, sampInfo->BindIndex, samplerState);
+	else
+		deviceContext->GSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
 
 	// Success
 	return true;
@@ -1580,6 +1727,16 @@ void SimpleComputeShader::SetShaderAndCBs()
 	// Is shader valid?
 	if (!shaderValid) return;
 
+	// Through the state cache, if there is one, which skips
+	// whatever's already bound
+	if (stateCache)
+	{
+		stateCache->SetShader(ShaderStage::Compute, shader);
+		for (unsigned int i = 0; i < constantBufferCount; i++)
+			stateCache->SetConstantBuffer(ShaderStage::Compute, constantBuffers[i].BindIndex, constantBuffers[i].ConstantBuffer);
+		return;
+	}
+
 	// Set the shader
 	deviceContext->CSSetShader(shader, 0, 0);
 
@@ -1662,7 +1819,10 @@ bool SimpleComputeShader::SetShaderResourceView(std::string name, ID3D11ShaderRe
 		return false;
 
 	// Set the shader resource view
-	deviceContext->CSSetShaderResources(srvInfo->BindIndex, 1, &srv);
+	if (stateCache)
+		stateCache->SetShaderResource(ShaderStage::Compute, srvInfo->BindIndex, srv);
+	else
+		deviceContext->CSSetShaderResources(srvInfo->BindIndex, 1, &srv);
 
 	// Success
 	return true;
@@ -1684,7 +1844,10 @@ bool SimpleComputeShader::SetSamplerState(std::string name, ID3D11SamplerState*
 		return false;
 
 	// Set the shader resource view
-	deviceContext->CSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
+	if (stateCache)
+		stateCache->SetSampler(ShaderStage::Compute, sampInfo->BindIndex, samplerState);
+	else
+		deviceContext->CSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
 
 	// Success
 	return true;
@@ -1709,6 +1872,11 @@ bool SimpleComputeShader::SetUnorderedAccessView(std::string name, ID3D11Unorder
 	// Set the shader resource view
 	deviceContext->CSSetUnorderedAccessViews(bindIndex, 1, &uav, &appendConsumeOffset);
 
+	// Binding a resource for writing unbinds it from anywhere
+	// it was bound to be read, behind the cache's back
+	if (stateCache)
+		stateCache->Invalidate();
+
 	// Success
 	return true;
 }
@@ -6,6 +6,8 @@
 #include <d3dcompiler.h>
 #include <DirectXMath.h>
 
+#include "StateCache.h"
+
 #include <unordered_map>
 #include <vector>
 #include <string>
@@ -66,6 +68,10 @@ public:
 	// Simple helpers
 	bool IsShaderValid() { return shaderValid; }
 
+	// Binds go through the cache when there is one, instead of
+	// straight to the context
+	void SetStateCache(StateCache* stateCache) { this->stateCache = stateCache; }
+
 	// Activating the shader and copying data
 	void SetShader();
 	void CopyAllBufferData();
@@ -116,6 +122,7 @@ protected:
 	ID3DBlob* shaderBlob;
 	ID3D11Device* device;
 	ID3D11DeviceContext* deviceContext;
+	StateCache* stateCache;
 
 	// Resource counts
 	unsigned int constantBufferCount;
@@ -129,8 +136,10 @@ protected:
 	std::unordered_map<std::string, SimpleSRV*> textureTable;
 	std::unordered_map<std::string, SimpleSampler*> samplerTable;
 
-	// Initialization method
+	// Initialization methods
 	bool LoadShaderFile(LPCWSTR shaderFile);
+	bool LoadShaderData(const void* shaderData, size_t shaderSize);
+	bool LoadShaderBlob();
 
 	// Pure virtual functions for dealing with shader types
 	virtual bool CreateShader(ID3DBlob* shaderBlob) = 0;
@@ -150,6 +159,7 @@ class SimpleVertexShader : public ISimpleShader
 {
 public:
 	SimpleVertexShader(ID3D11Device* device, ID3D11DeviceContext* context, LPCWSTR shaderFile);
+	SimpleVertexShader(ID3D11Device* device, ID3D11DeviceContext* context, const void* shaderData, size_t shaderSize);
 	SimpleVertexShader(ID3D11Device* device, ID3D11DeviceContext* context, LPCWSTR shaderFile, ID3D11InputLayout* inputLayout, bool perInstanceCompatible);
 	~SimpleVertexShader();
 	ID3D11VertexShader* GetDirectXShader() { return shader; }
@@ -176,6 +186,7 @@ class SimplePixelShader : public ISimpleShader
 {
 public:
 	SimplePixelShader(ID3D11Device* device, ID3D11DeviceContext* context, LPCWSTR shaderFile);
+	SimplePixelShader(ID3D11Device* device, ID3D11DeviceContext* context, const void* shaderData, size_t shaderSize);
 	~SimplePixelShader();
 	ID3D11PixelShader* GetDirectXShader() { return shader; }
 
@@ -0,0 +1,352 @@
+#include "SpatialGrid.h"
+#include <math.h>
+#include <stdlib.h>
+
+using namespace DirectX;
+
+// Proxy::cell values that aren't cells
+static const unsigned int OversizedCell = 0xFFFFFFFE;
+static const unsigned int FreeCell = 0xFFFFFFFF;
+
+// Cell coordinates are packed into 21 bits each for the hash
+// key, so positions are clamped to this many cells either way
+static const int CoordinateLimit = (1 << 20) - 1;
+
+SpatialGrid::SpatialGrid(float cellSize)
+{
+	this->cellSize = cellSize > 0.0f ? cellSize : 1.0f;
+	inverseCellSize = 1.0f / this->cellSize;
+	count = 0;
+}
+
+int SpatialGrid::GetCoordinate(float position) const
+{
+	float cell = floorf(position * inverseCellSize);
+	if (cell < (float)-CoordinateLimit)
+		return -CoordinateLimit;
+	if (cell > (float)CoordinateLimit)
+		return CoordinateLimit;
+	return (int)cell;
+}
+
+unsigned long long SpatialGrid::GetKey(int x, int y, int z)
+{
+	const unsigned long long mask = (1ull << 21) - 1;
+	return
+		((unsigned long long)(x + CoordinateLimit + 1) & mask) |
+		(((unsigned long long)(y + CoordinateLimit + 1) & mask) << 21) |
+		(((unsigned long long)(z + CoordinateLimit + 1) & mask) << 42);
+}
+
+// The cell grown by half a cell each way, which holds all of
+// every sphere in it
+AABB SpatialGrid::GetLooseBox(const Cell& cell) const
+{
+	float half = cellSize * 0.5f;
+	return AABB{
+		XMFLOAT3(cell.x * cellSize - half, cell.y * cellSize - half, cell.z * cellSize - half),
+		XMFLOAT3((cell.x + 1) * cellSize + half, (cell.y + 1) * cellSize + half, (cell.z + 1) * cellSize + half) };
+}
+
+SpatialProxy SpatialGrid::Insert(EntityId entity, const XMFLOAT3& center, float radius)
+{
+	unsigned int index;
+	if (!freeProxies.empty())
+	{
+		index = freeProxies.back();
+		freeProxies.pop_back();
+	}
+	else
+	{
+		index = (unsigned int)proxies.size();
+		proxies.push_back(Proxy());
+	}
+
+	Proxy& proxy = proxies[index];
+	proxy.entity = entity;
+	proxy.center = center;
+	proxy.radius = radius;
+	AddToCell(index);
+	count++;
+	return index;
+}
+
+void SpatialGrid::Remove(SpatialProxy proxy)
+{
+	if (proxy >= proxies.size() || proxies[proxy].cell == FreeCell)
+		return;
+
+	RemoveFromCell(proxy);
+	proxies[proxy].cell = FreeCell;
+	freeProxies.push_back(proxy);
+	count--;
+}
+
+// --------------------------------------------------------
+// Just updates the sphere if it's still in the same cell (or
+// still oversized), and otherwise moves it between lists
+// --------------------------------------------------------
+void SpatialGrid::Move(SpatialProxy proxy, const XMFLOAT3& center, float radius)
+{
+	if (proxy >= proxies.size() || proxies[proxy].cell == FreeCell)
+		return;
+
+	Proxy& entry = proxies[proxy];
+	bool oversizedNow = radius > cellSize * 0.5f;
+	bool stays;
+	if (entry.cell == OversizedCell)
+		stays = oversizedNow;
+	else
+	{
+		const Cell& cell = cells[entry.cell];
+		stays = !oversizedNow &&
+			cell.x == GetCoordinate(center.x) &&
+			cell.y == GetCoordinate(center.y) &&
+			cell.z == GetCoordinate(center.z);
+	}
+
+	if (!stays)
+		RemoveFromCell(proxy);
+	entry.center = center;
+	entry.radius = radius;
+	if (!stays)
+		AddToCell(proxy);
+}
+
+void SpatialGrid::AddToCell(unsigned int proxy)
+{
+	Proxy& entry = proxies[proxy];
+	if (entry.radius > cellSize * 0.5f)
+	{
+		entry.cell = OversizedCell;
+		entry.slot = (unsigned int)oversized.size();
+		oversized.push_back(proxy);
+		return;
+	}
+
+	int x = GetCoordinate(entry.center.x);
+	int y = GetCoordinate(entry.center.y);
+	int z = GetCoordinate(entry.center.z);
+	unsigned long long key = GetKey(x, y, z);
+
+	unsigned int cellIndex;
+	auto found = cellLookup.find(key);
+	if (found != cellLookup.end())
+		cellIndex = found->second;
+	else
+	{
+		if (!freeCells.empty())
+		{
+			cellIndex = freeCells.back();
+			freeCells.pop_back();
+		}
+		else
+		{
+			cellIndex = (unsigned int)cells.size();
+			cells.push_back(Cell());
+		}
+		cells[cellIndex].x = x;
+		cells[cellIndex].y = y;
+		cells[cellIndex].z = z;
+		cellLookup[key] = cellIndex;
+	}
+
+	std::vector<unsigned int>& list = cells[cellIndex].proxies;
+	entry.cell = cellIndex;
+	entry.slot = (unsigned int)list.size();
+	list.push_back(proxy);
+}
+
+// --------------------------------------------------------
+// Swaps the last entry of the list into the proxy's place,
+// and lets the cell go if that empties it
+// --------------------------------------------------------
+void SpatialGrid::RemoveFromCell(unsigned int proxy)
+{
+	Proxy& entry = proxies[proxy];
+	std::vector<unsigned int>& list = entry.cell == OversizedCell ? oversized : cells[entry.cell].proxies;
+
+	unsigned int last = list.back();
+	list[entry.slot] = last;
+	proxies[last].slot = entry.slot;
+	list.pop_back();
+
+	if (entry.cell != OversizedCell && list.empty())
+	{
+		const Cell& cell = cells[entry.cell];
+		cellLookup.erase(GetKey(cell.x, cell.y, cell.z));
+		freeCells.push_back(entry.cell);
+	}
+}
+
+// --------------------------------------------------------
+// Looks each cell in the range up by its coordinates, unless
+// the range has more cells than actually exist, in which case
+// it goes through the ones that exist instead
+// --------------------------------------------------------
+template<typename Visit>
+void SpatialGrid::VisitNear(const AABB& box, Visit visit)
+{
+	float half = cellSize * 0.5f;
+	int lowX = GetCoordinate(box.lower.x - half);
+	int lowY = GetCoordinate(box.lower.y - half);
+	int lowZ = GetCoordinate(box.lower.z - half);
+	int highX = GetCoordinate(box.upper.x + half);
+	int highY = GetCoordinate(box.upper.y + half);
+	int highZ = GetCoordinate(box.upper.z + half);
+
+	double rangeCells = (double)(highX - lowX + 1) * (highY - lowY + 1) * (highZ - lowZ + 1);
+	if (rangeCells <= (double)GetCellCount())
+	{
+		for (int z = lowZ; z <= highZ; z++)
+		{
+			for (int y = lowY; y <= highY; y++)
+			{
+				for (int x = lowX; x <= highX; x++)
+				{
+					auto found = cellLookup.find(GetKey(x, y, z));
+					if (found == cellLookup.end())
+						continue;
+					for (unsigned int proxy : cells[found->second].proxies)
+						visit(proxy);
+				}
+			}
+		}
+	}
+	else
+	{
+		for (const Cell& cell : cells)
+		{
+			if (cell.proxies.empty() ||
+				cell.x < lowX || cell.x > highX ||
+				cell.y < lowY || cell.y > highY ||
+				cell.z < lowZ || cell.z > highZ)
+				continue;
+			for (unsigned int proxy : cell.proxies)
+				visit(proxy);
+		}
+	}
+
+	for (unsigned int proxy : oversized)
+		visit(proxy);
+}
+
+// --------------------------------------------------------
+// Tests each cell's loose box first, taking whole cells that
+// are inside and skipping whole cells that are outside
+// --------------------------------------------------------
+void SpatialGrid::QueryFrustum(const Frustum& frustum, std::vector<EntityId>& results)
+{
+	for (const Cell& cell : cells)
+	{
+		if (cell.proxies.empty())
+			continue;
+
+		Containment containment = TestAABB(frustum, GetLooseBox(cell));
+		if (containment == Containment::Outside)
+			continue;
+
+		for (unsigned int proxy : cell.proxies)
+		{
+			const Proxy& entry = proxies[proxy];
+			if (containment == Containment::Inside || TestSphere(frustum, entry.center, entry.radius) != Containment::Outside)
+				results.push_back(entry.entity);
+		}
+	}
+
+	for (unsigned int proxy : oversized)
+	{
+		const Proxy& entry = proxies[proxy];
+		if (TestSphere(frustum, entry.center, entry.radius) != Containment::Outside)
+			results.push_back(entry.entity);
+	}
+}
+
+void SpatialGrid::QuerySphere(const XMFLOAT3& center, float radius, std::vector<EntityId>& results)
+{
+	VisitNear(MakeAABB(center, radius), [&](unsigned int proxy)
+	{
+		const Proxy& entry = proxies[proxy];
+		if (SpheresOverlap(center, radius, entry.center, entry.radius))
+			results.push_back(entry.entity);
+	});
+}
+
+void SpatialGrid::QueryBox(const AABB& box, std::vector<EntityId>& results)
+{
+	VisitNear(box, [&](unsigned int proxy)
+	{
+		const Proxy& entry = proxies[proxy];
+		if (SphereOverlapsAABB(entry.center, entry.radius, box))
+			results.push_back(entry.entity);
+	});
+}
+
+// --------------------------------------------------------
+// Searches shells of cells outwards from the point's cell
+//  - Everything in shell k (cells k steps away on some axis)
+//    is at least (k - 1) cells away, less the half a cell a
+//    sphere can stick out, so the search stops once that's
+//    further than the worst entity kept
+//  - Falls back to going through every cell once a shell
+//    would mean looking up more cells than there are
+// --------------------------------------------------------
+void SpatialGrid::QueryNearest(const XMFLOAT3& point, unsigned int count, std::vector<EntityId>& results)
+{
+	if (count == 0 || this->count == 0)
+		return;
+
+	NearestCollector nearest(count);
+	for (unsigned int proxy : oversized)
+		nearest.Offer(proxies[proxy].entity, DistanceToSphere(point, proxies[proxy].center, proxies[proxy].radius));
+
+	auto visitCell = [&](const Cell& cell)
+	{
+		for (unsigned int proxy : cell.proxies)
+			nearest.Offer(proxies[proxy].entity, DistanceToSphere(point, proxies[proxy].center, proxies[proxy].radius));
+		return (unsigned int)cell.proxies.size();
+	};
+
+	int centerX = GetCoordinate(point.x);
+	int centerY = GetCoordinate(point.y);
+	int centerZ = GetCoordinate(point.z);
+	unsigned int inCells = this->count - (unsigned int)oversized.size();
+	unsigned int seen = 0;
+	for (int k = 0; seen < inCells; k++)
+	{
+		float bound = (k - 1.5f) * cellSize;
+		if (bound > nearest.GetWorstDistance())
+			break;
+
+		double shellCells = k == 0 ? 1.0 : (double)(2 * k + 1) * (2 * k + 1) * (2 * k + 1) - (double)(2 * k - 1) * (2 * k - 1) * (2 * k - 1);
+		if (shellCells > (double)GetCellCount())
+		{
+			// Everything from this shell out, in one pass
+			for (const Cell& cell : cells)
+			{
+				int distance = std::max(std::max(abs(cell.x - centerX), abs(cell.y - centerY)), abs(cell.z - centerZ));
+				if (!cell.proxies.empty() && distance >= k)
+					visitCell(cell);
+			}
+			break;
+		}
+
+		for (int dz = -k; dz <= k; dz++)
+		{
+			for (int dy = -k; dy <= k; dy++)
+			{
+				// Only the shell's surface: every x on its faces,
+				// and the two ends of each row through the middle
+				bool onFace = abs(dz) == k || abs(dy) == k;
+				for (int dx = -k; dx <= k; dx += onFace || k == 0 ? 1 : 2 * k)
+				{
+					auto found = cellLookup.find(GetKey(centerX + dx, centerY + dy, centerZ + dz));
+					if (found != cellLookup.end())
+						seen += visitCell(cells[found->second]);
+				}
+			}
+		}
+	}
+
+	nearest.AppendSorted(results);
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <DirectXMath.h>
+#include <unordered_map>
+#include <vector>
+#include "SpatialIndex.h"
+
+// --------------------------------------------------------
+// Loose, hashed uniform grid over entities' world space
+// bounding spheres
+//  - Each entity lives in the one cell its center is in, and
+//    only cells with something in them exist, found through a
+//    hash of their coordinates
+//  - Cells are loose: a sphere can stick out of its cell by up
+//    to half a cell, so queries look that much further out
+//    instead of entities being added to every cell they touch
+//  - Spheres too big for that go in a list of their own that
+//    every query checks
+//  - Insert(), Move() and Remove() are O(1), and there's no
+//    tree to keep up, so it doesn't matter how many entities
+//    move or how far - Update() has nothing to do
+//  - Best when entities are about the same size, and somewhere
+//    around a cell across
+// --------------------------------------------------------
+class SpatialGrid : public SpatialIndex
+{
+public:
+	SpatialGrid(float cellSize = 4.0f);
+
+	SpatialProxy Insert(EntityId entity, const DirectX::XMFLOAT3& center, float radius);
+	void Remove(SpatialProxy proxy);
+	void Move(SpatialProxy proxy, const DirectX::XMFLOAT3& center, float radius);
+	void Update() { }
+
+	unsigned int GetCount() { return count; }
+	float GetCellSize() { return cellSize; }
+	unsigned int GetCellCount() { return (unsigned int)(cells.size() - freeCells.size()); }
+
+	void QueryFrustum(const Frustum& frustum, std::vector<EntityId>& results);
+	void QuerySphere(const DirectX::XMFLOAT3& center, float radius, std::vector<EntityId>& results);
+	void QueryBox(const AABB& box, std::vector<EntityId>& results);
+	void QueryNearest(const DirectX::XMFLOAT3& point, unsigned int count, std::vector<EntityId>& results);
+
+private:
+	struct Proxy
+	{
+		EntityId entity;
+		DirectX::XMFLOAT3 center;
+		float radius;
+		unsigned int cell;	// OversizedCell for the oversized list, FreeCell when unused
+		unsigned int slot;	// Where it is in its cell's list
+	};
+
+	struct Cell
+	{
+		int x, y, z;
+		std::vector<unsigned int> proxies; // Empty when the cell's unused
+	};
+
+	float cellSize;
+	float inverseCellSize;
+	unsigned int count;
+
+	std::vector<Proxy> proxies;
+	std::vector<unsigned int> freeProxies;
+	std::vector<Cell> cells;
+	std::vector<unsigned int> freeCells;
+	std::unordered_map<unsigned long long, unsigned int> cellLookup;
+	std::vector<unsigned int> oversized;
+
+	int GetCoordinate(float position) const;
+	static unsigned long long GetKey(int x, int y, int z);
+	AABB GetLooseBox(const Cell& cell) const;
+
+	void AddToCell(unsigned int proxy);
+	void RemoveFromCell(unsigned int proxy);
+
+	// Calls visit(proxy) for everything in cells whose loose
+	// bounds might overlap box, and everything oversized
+	template<typename Visit> void VisitNear(const AABB& box, Visit visit);
+};
@@ -0,0 +1,116 @@
+#pragma once
+#include <DirectXMath.h>
+#include <algorithm>
+#include <float.h>
+#include <vector>
+#include "Collision.h"
+#include "World.h"
+
+// Identifies an entity's entry in a SpatialIndex
+typedef unsigned int SpatialProxy;
+const SpatialProxy InvalidSpatialProxy = 0xFFFFFFFF;
+
+// The nearest thing a ray hit
+struct RayHit
+{
+	EntityId entity;
+	float distance;
+};
+
+// --------------------------------------------------------
+// Somewhere to look entities up by their world space bounding
+// spheres, whatever the structure underneath
+//  - EntityBVH suits things that stay put or move a little;
+//    SpatialGrid suits things that all move, all the time
+//  - Move() only changes the entity's entry; Update() then does
+//    whatever upkeep the structure needs, once all the moves
+//    are in for the frame
+//  - Queries append what they find to results
+// --------------------------------------------------------
+class SpatialIndex
+{
+public:
+	virtual ~SpatialIndex() { }
+
+	virtual SpatialProxy Insert(EntityId entity, const DirectX::XMFLOAT3& center, float radius) = 0;
+	virtual void Remove(SpatialProxy proxy) = 0;
+	virtual void Move(SpatialProxy proxy, const DirectX::XMFLOAT3& center, float radius) = 0;
+	virtual void Update() = 0;
+
+	virtual unsigned int GetCount() = 0;
+
+	virtual void QueryFrustum(const Frustum& frustum, std::vector<EntityId>& results) = 0;
+	virtual void QuerySphere(const DirectX::XMFLOAT3& center, float radius, std::vector<EntityId>& results) = 0;
+	virtual void QueryBox(const AABB& box, std::vector<EntityId>& results) = 0;
+
+	// The count entities whose spheres are nearest the point,
+	// nearest first (distance is to the sphere's surface, and 0
+	// for spheres the point's inside)
+	virtual void QueryNearest(const DirectX::XMFLOAT3& point, unsigned int count, std::vector<EntityId>& results) = 0;
+};
+
+// --------------------------------------------------------
+// Keeps the nearest count of the entities offered to it, for
+// QueryNearest()
+//  - A max-heap on distance, so the worst of the ones kept is
+//    always on top, ready to be replaced
+// --------------------------------------------------------
+class NearestCollector
+{
+public:
+	NearestCollector(unsigned int count)
+	{
+		this->count = count;
+		found.reserve(count);
+	}
+
+	void Offer(EntityId entity, float distance)
+	{
+		if (found.size() < count)
+		{
+			found.push_back(RayHit{ entity, distance });
+			std::push_heap(found.begin(), found.end(), IsNearer);
+		}
+		else if (count > 0 && distance < found.front().distance)
+		{
+			std::pop_heap(found.begin(), found.end(), IsNearer);
+			found.back() = RayHit{ entity, distance };
+			std::push_heap(found.begin(), found.end(), IsNearer);
+		}
+	}
+
+	// Anything further than this can't make the list
+	float GetWorstDistance() { return found.size() < count ? FLT_MAX : found.front().distance; }
+
+	void AppendSorted(std::vector<EntityId>& results)
+	{
+		std::sort_heap(found.begin(), found.end(), IsNearer);
+		for (const RayHit& hit : found)
+			results.push_back(hit.entity);
+	}
+
+private:
+	unsigned int count;
+	std::vector<RayHit> found;
+
+	static bool IsNearer(const RayHit& a, const RayHit& b) { return a.distance < b.distance; }
+};
+
+// Distance from a point to a sphere's surface, or 0 inside it
+inline float DistanceToSphere(const DirectX::XMFLOAT3& point, const DirectX::XMFLOAT3& center, float radius)
+{
+	float dx = point.x - center.x;
+	float dy = point.y - center.y;
+	float dz = point.z - center.z;
+	float distance = sqrtf(dx * dx + dy * dy + dz * dz) - radius;
+	return distance > 0.0f ? distance : 0.0f;
+}
+
+// Distance from a point to a box, or 0 inside it
+inline float DistanceToAABB(const DirectX::XMFLOAT3& point, const AABB& box)
+{
+	float dx = point.x < box.lower.x ? box.lower.x - point.x : (point.x > box.upper.x ? point.x - box.upper.x : 0.0f);
+	float dy = point.y < box.lower.y ? box.lower.y - point.y : (point.y > box.upper.y ? point.y - box.upper.y : 0.0f);
+	float dz = point.z < box.lower.z ? box.lower.z - point.z : (point.z > box.upper.z ? point.z - box.upper.z : 0.0f);
+	return sqrtf(dx * dx + dy * dy + dz * dz);
+}
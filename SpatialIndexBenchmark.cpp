@@ -0,0 +1,128 @@
+#include "SpatialIndexBenchmark.h"
+#include "BenchmarkTiming.h"
+#include "EntityBVH.h"
+#include "SpatialGrid.h"
+#include <chrono>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+using namespace DirectX;
+
+static const unsigned int FrustumQueries = 100;
+static const unsigned int OverlapQueries = 10000;
+static const unsigned int NearestQueries = 10000;
+static const unsigned int NearestCount = 8;
+
+// --------------------------------------------------------
+// Runs the same motion and the same queries on one index
+//  - Everything bounces around inside a cube, moving a fair
+//    way every frame, which is the worst case for a refit
+// --------------------------------------------------------
+static void RunIndex(const char* name, SpatialIndex& index, unsigned int count, unsigned int frames)
+{
+	std::mt19937 random(1234);
+	float side = cbrtf((float)count) * 4.0f;
+	std::uniform_real_distribution<float> position(0.0f, side);
+	std::uniform_real_distribution<float> size(0.25f, 1.5f);
+	std::uniform_real_distribution<float> speed(-20.0f, 20.0f);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	std::vector<XMFLOAT3> centers(count);
+	std::vector<XMFLOAT3> velocities(count);
+	std::vector<float> radii(count);
+	std::vector<SpatialProxy> proxies(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		centers[i] = XMFLOAT3(position(random), position(random), position(random));
+		velocities[i] = XMFLOAT3(speed(random), speed(random), speed(random));
+		radii[i] = size(random);
+
+		EntityId entity;
+		entity.index = i;
+		entity.generation = 1;
+		proxies[i] = index.Insert(entity, centers[i], radii[i]);
+	}
+	index.Update();
+
+	float timeStep = 1.0f / 60.0f;
+	float upkeep = 0.0f;
+	for (unsigned int frame = 0; frame < frames; frame++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < count; i++)
+		{
+			float* p = &centers[i].x;
+			float* v = &velocities[i].x;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				p[axis] += v[axis] * timeStep;
+				if (p[axis] < 0.0f || p[axis] > side)
+					v[axis] = -v[axis];
+			}
+			index.Move(proxies[i], centers[i], radii[i]);
+		}
+		index.Update();
+		upkeep += GetElapsed(start);
+	}
+	printf("%s\n  %-16s %8.3fms per frame, moving everything\n", name, "Move + Update:", upkeep / frames);
+
+	std::vector<EntityId> results;
+	results.reserve(count);
+
+	std::vector<Frustum> frustums(FrustumQueries);
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, side * 0.25f);
+	for (Frustum& frustum : frustums)
+	{
+		XMVECTOR eye = XMVectorSet(position(random), position(random), position(random), 0.0f);
+		XMVECTOR direction = XMVectorSet(unit(random), unit(random), unit(random) + 0.01f, 0.0f);
+		XMFLOAT4X4 viewProjection;
+		XMStoreFloat4x4(&viewProjection, XMMatrixLookToLH(eye, direction, XMVectorSet(0, 1, 0, 0)) * projection);
+		frustum = MakeFrustum(viewProjection);
+	}
+	auto start = std::chrono::high_resolution_clock::now();
+	for (const Frustum& frustum : frustums)
+		index.QueryFrustum(frustum, results);
+	PrintQueries("  Frustum:", FrustumQueries, GetElapsed(start), results.size());
+
+	std::vector<XMFLOAT3> points(OverlapQueries);
+	for (XMFLOAT3& point : points)
+		point = XMFLOAT3(position(random), position(random), position(random));
+
+	results.clear();
+	start = std::chrono::high_resolution_clock::now();
+	for (const XMFLOAT3& point : points)
+		index.QuerySphere(point, 5.0f, results);
+	PrintQueries("  Sphere (r = 5):", OverlapQueries, GetElapsed(start), results.size());
+
+	results.clear();
+	start = std::chrono::high_resolution_clock::now();
+	for (const XMFLOAT3& point : points)
+		index.QueryBox(MakeAABB(point, 5.0f), results);
+	PrintQueries("  Box (5 x 2):", OverlapQueries, GetElapsed(start), results.size());
+
+	results.clear();
+	start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < NearestQueries; i++)
+		index.QueryNearest(points[i % points.size()], NearestCount, results);
+	PrintQueries("  Nearest 8:", NearestQueries, GetElapsed(start), results.size());
+}
+
+void RunSpatialIndexBenchmark(unsigned int frames)
+{
+	printf("---- Spatial index benchmark: %u frames of motion ----\n", frames);
+
+	unsigned int counts[] = { 10000, 100000 };
+	for (unsigned int count : counts)
+	{
+		printf("-- %u entities --\n", count);
+
+		// Inserted one at a time, then only ever refit
+		EntityBVH bvh;
+		RunIndex("Entity BVH (refit + rotate)", bvh, count, frames);
+
+		SpatialGrid grid(4.0f);
+		RunIndex("Spatial grid (4 unit cells)", grid, count, frames);
+	}
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+// --------------------------------------------------------
+// Pits the entity BVH against the spatial grid with every
+// entity moving every frame, at 10k and 100k entities, and
+// prints the per-frame upkeep and query times of each
+// --------------------------------------------------------
+void RunSpatialIndexBenchmark(unsigned int frames = 60);
@@ -0,0 +1,186 @@
+#include "StateCache.h"
+#include <stdio.h>
+
+StateCache::StateCache(ID3D11DeviceContext* context)
+{
+	this->context = context;
+	Invalidate();
+	ResetStats();
+}
+
+void StateCache::Invalidate()
+{
+	for (Stage& stage : stages)
+	{
+		stage.shader.known = false;
+		for (auto& slot : stage.constantBuffers)
+			slot.known = false;
+		for (auto& slot : stage.shaderResources)
+			slot.known = false;
+		for (auto& slot : stage.samplers)
+			slot.known = false;
+	}
+
+	inputLayout.known = false;
+	for (auto& slot : vertexBuffers)
+		slot.known = false;
+	indexBuffer.known = false;
+	topology.known = false;
+}
+
+template<typename T>
+bool StateCache::Change(Bind bind, Slot<T>& slot, const T& value)
+{
+	if (slot.known && slot.value == value)
+	{
+		skipped[(int)bind]++;
+		return false;
+	}
+
+	slot.value = value;
+	slot.known = true;
+	issued[(int)bind]++;
+	return true;
+}
+
+void StateCache::SetShader(ShaderStage stage, ID3D11DeviceChild* shader)
+{
+	if (!Change(Bind::Shader, stages[(int)stage].shader, shader))
+		return;
+
+	switch (stage)
+	{
+	case ShaderStage::Vertex: context->VSSetShader((ID3D11VertexShader*)shader, 0, 0); break;
+	case ShaderStage::Hull: context->HSSetShader((ID3D11HullShader*)shader, 0, 0); break;
+	case ShaderStage::Domain: context->DSSetShader((ID3D11DomainShader*)shader, 0, 0); break;
+	case ShaderStage::Geometry: context->GSSetShader((ID3D11GeometryShader*)shader, 0, 0); break;
+	case ShaderStage::Pixel: context->PSSetShader((ID3D11PixelShader*)shader, 0, 0); break;
+	case ShaderStage::Compute: context->CSSetShader((ID3D11ComputeShader*)shader, 0, 0); break;
+	default: break;
+	}
+}
+
+// --------------------------------------------------------
+// Slots past what D3D has can't be bound anyway, so those
+// calls just go through and let the runtime complain
+// --------------------------------------------------------
+void StateCache::SetConstantBuffer(ShaderStage stage, unsigned int slot, ID3D11Buffer* buffer)
+{
+	if (slot < D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT &&
+		!Change(Bind::ConstantBuffer, stages[(int)stage].constantBuffers[slot], buffer))
+		return;
+
+	switch (stage)
+	{
+	case ShaderStage::Vertex: context->VSSetConstantBuffers(slot, 1, &buffer); break;
+	case ShaderStage::Hull: context->HSSetConstantBuffers(slot, 1, &buffer); break;
+	case ShaderStage::Domain: context->DSSetConstantBuffers(slot, 1, &buffer); break;
+	case ShaderStage::Geometry: context->GSSetConstantBuffers(slot, 1, &buffer); break;
+	case ShaderStage::Pixel: context->PSSetConstantBuffers(slot, 1, &buffer); break;
+	case ShaderStage::Compute: context->CSSetConstantBuffers(slot, 1, &buffer); break;
+	default: break;
+	}
+}
+
+void StateCache::SetShaderResource(ShaderStage stage, unsigned int slot, ID3D11ShaderResourceView* srv)
+{
+	if (slot < D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT &&
+		!Change(Bind::ShaderResource, stages[(int)stage].shaderResources[slot], srv))
+		return;
+
+	switch (stage)
+	{
+	case ShaderStage::Vertex: context->VSSetShaderResources(slot, 1, &srv); break;
+	case ShaderStage::Hull: context->HSSetShaderResources(slot, 1, &srv); break;
+	case ShaderStage::Domain: context->DSSetShaderResources(slot, 1, &srv); break;
+	case ShaderStage::Geometry: context->GSSetShaderResources(slot, 1, &srv); break;
+	case ShaderStage::Pixel: context->PSSetShaderResources(slot, 1, &srv); break;
+	case ShaderStage::Compute: context->CSSetShaderResources(slot, 1, &srv); break;
+	default: break;
+	}
+}
+
+void StateCache::SetSampler(ShaderStage stage, unsigned int slot, ID3D11SamplerState* sampler)
+{
+	if (slot < D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT &&
+		!Change(Bind::Sampler, stages[(int)stage].samplers[slot], sampler))
+		return;
+
+	switch (stage)
+	{
+	case ShaderStage::Vertex: context->VSSetSamplers(slot, 1, &sampler); break;
+	case ShaderStage::Hull: context->HSSetSamplers(slot, 1, &sampler); break;
+	case ShaderStage::Domain: context->DSSetSamplers(slot, 1, &sampler); break;
+	case ShaderStage::Geometry: context->GSSetSamplers(slot, 1, &sampler); break;
+	case ShaderStage::Pixel: context->PSSetSamplers(slot, 1, &sampler); break;
+	case ShaderStage::Compute: context->CSSetSamplers(slot, 1, &sampler); break;
+	default: break;
+	}
+}
+
+void StateCache::SetInputLayout(ID3D11InputLayout* inputLayout)
+{
+	if (Change(Bind::InputLayout, this->inputLayout, inputLayout))
+		context->IASetInputLayout(inputLayout);
+}
+
+void StateCache::SetVertexBuffer(unsigned int slot, ID3D11Buffer* buffer, unsigned int stride, unsigned int offset)
+{
+	if (slot < D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT &&
+		!Change(Bind::VertexBuffer, vertexBuffers[slot], VertexBuffer{ buffer, stride, offset }))
+		return;
+
+	context->IASetVertexBuffers(slot, 1, &buffer, &stride, &offset);
+}
+
+void StateCache::SetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, unsigned int offset)
+{
+	if (Change(Bind::IndexBuffer, indexBuffer, IndexBuffer{ buffer, format, offset }))
+		context->IASetIndexBuffer(buffer, format, offset);
+}
+
+void StateCache::SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology)
+{
+	if (Change(Bind::Topology, this->topology, topology))
+		context->IASetPrimitiveTopology(topology);
+}
+
+void StateCache::PrintStats()
+{
+	static const char* names[(int)Bind::Count] =
+	{
+		"Shaders",
+		"Constant buffers",
+		"Resource views",
+		"Samplers",
+		"Input layouts",
+		"Vertex buffers",
+		"Index buffers",
+		"Topology",
+	};
+
+	unsigned long long totalIssued = 0;
+	unsigned long long totalSkipped = 0;
+	printf("---- State cache ----\n");
+	for (int bind = 0; bind < (int)Bind::Count; bind++)
+	{
+		unsigned long long calls = issued[bind] + skipped[bind];
+		printf("%-16s %10llu issued %10llu skipped (%.1f%%)\n",
+			names[bind], issued[bind], skipped[bind], calls > 0 ? 100.0 * skipped[bind] / calls : 0.0);
+		totalIssued += issued[bind];
+		totalSkipped += skipped[bind];
+	}
+
+	unsigned long long totalCalls = totalIssued + totalSkipped;
+	printf("%-16s %10llu issued %10llu skipped (%.1f%%)\n",
+		"Total", totalIssued, totalSkipped, totalCalls > 0 ? 100.0 * totalSkipped / totalCalls : 0.0);
+}
+
+void StateCache::ResetStats()
+{
+	for (int bind = 0; bind < (int)Bind::Count; bind++)
+	{
+		issued[bind] = 0;
+		skipped[bind] = 0;
+	}
+}
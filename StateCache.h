@@ -0,0 +1,122 @@
+#pragma once
+#include <d3d11.h>
+
+// The programmable stages, in the order StateCache keeps them
+enum class ShaderStage
+{
+	Vertex,
+	Hull,
+	Domain,
+	Geometry,
+	Pixel,
+	Compute,
+	Count
+};
+
+// --------------------------------------------------------
+// Sits in front of the device context and drops binds that
+// wouldn't change anything
+//  - Remembers what each stage has bound (shader, constant
+//    buffers, shader resource views and samplers) and what the
+//    input assembler has (input layout, vertex buffers, index
+//    buffer and topology), and only calls the context when a
+//    bind is different
+//  - Nothing is known to start with, or after Invalidate(), so
+//    the first bind of every slot always goes through
+//  - Anything that binds to the context without going through
+//    here has to call Invalidate() after; so does anything that
+//    binds a resource for writing while it might be bound as a
+//    shader resource, since D3D quietly unbinds it
+//  - Bound objects can't be freed and have their address reused
+//    while we think they're bound, since the context keeps a
+//    reference to them
+//  - Counts the calls it made and the ones it skipped, by kind
+// --------------------------------------------------------
+class StateCache
+{
+public:
+	StateCache(ID3D11DeviceContext* context);
+
+	// Forgets everything, so the next binds all go through
+	void Invalidate();
+
+	// Shaders of the stage's type, as ID3D11VertexShader etc.
+	void SetShader(ShaderStage stage, ID3D11DeviceChild* shader);
+	void SetConstantBuffer(ShaderStage stage, unsigned int slot, ID3D11Buffer* buffer);
+	void SetShaderResource(ShaderStage stage, unsigned int slot, ID3D11ShaderResourceView* srv);
+	void SetSampler(ShaderStage stage, unsigned int slot, ID3D11SamplerState* sampler);
+
+	void SetInputLayout(ID3D11InputLayout* inputLayout);
+	void SetVertexBuffer(unsigned int slot, ID3D11Buffer* buffer, unsigned int stride, unsigned int offset);
+	void SetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, unsigned int offset);
+	void SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology);
+
+	void PrintStats();
+	void ResetStats();
+
+private:
+	// What the counters are kept by
+	enum class Bind
+	{
+		Shader,
+		ConstantBuffer,
+		ShaderResource,
+		Sampler,
+		InputLayout,
+		VertexBuffer,
+		IndexBuffer,
+		Topology,
+		Count
+	};
+
+	// A slot's value, and whether we know it
+	template<typename T>
+	struct Slot
+	{
+		T value;
+		bool known;
+	};
+
+	struct VertexBuffer
+	{
+		ID3D11Buffer* buffer;
+		unsigned int stride;
+		unsigned int offset;
+
+		bool operator==(const VertexBuffer& other) const { return buffer == other.buffer && stride == other.stride && offset == other.offset; }
+	};
+
+	struct IndexBuffer
+	{
+		ID3D11Buffer* buffer;
+		DXGI_FORMAT format;
+		unsigned int offset;
+
+		bool operator==(const IndexBuffer& other) const { return buffer == other.buffer && format == other.format && offset == other.offset; }
+	};
+
+	struct Stage
+	{
+		Slot<ID3D11DeviceChild*> shader;
+		Slot<ID3D11Buffer*> constantBuffers[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT];
+		Slot<ID3D11ShaderResourceView*> shaderResources[D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT];
+		Slot<ID3D11SamplerState*> samplers[D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT];
+	};
+
+	ID3D11DeviceContext* context;
+
+	Stage stages[(int)ShaderStage::Count];
+	Slot<ID3D11InputLayout*> inputLayout;
+	Slot<VertexBuffer> vertexBuffers[D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT];
+	Slot<IndexBuffer> indexBuffer;
+	Slot<D3D11_PRIMITIVE_TOPOLOGY> topology;
+
+	// Stats
+	unsigned long long issued[(int)Bind::Count];
+	unsigned long long skipped[(int)Bind::Count];
+
+	// Whether a bind of value needs to go through, remembering
+	// it if so
+	template<typename T>
+	bool Change(Bind bind, Slot<T>& slot, const T& value);
+};
@@ -0,0 +1,165 @@
+#pragma once
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <utility>
+
+// --------------------------------------------------------
+// A coroutine that produces a T (or nothing, for Task<void>)
+//  - Lazy: nothing runs until the task is either co_awaited
+//    by another coroutine or started with Detach()
+//  - When a task finishes, whoever was awaiting it resumes
+//    right away on the same thread
+//  - Where the code runs in between is up to whatever it
+//    awaits (see ThreadPool::Schedule(), AsyncFileLoader::ReadFileAsync()
+//    and AssetLoader::ResumeOnMainThread())
+// --------------------------------------------------------
+template<typename T>
+class Task;
+
+namespace TaskDetail
+{
+	// Everything the promise types have in common
+	struct PromiseBase
+	{
+		std::coroutine_handle<> continuation;
+		bool detached = false;
+
+		// Resumes whoever was waiting on us, or cleans up
+		// after ourselves if nobody is
+		struct FinalAwaiter
+		{
+			bool await_ready() noexcept { return false; }
+			void await_resume() noexcept { }
+
+			template<typename Promise>
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+			{
+				PromiseBase& promise = handle.promise();
+				if (promise.continuation)
+					return promise.continuation;
+
+				if (promise.detached)
+					handle.destroy();
+				return std::noop_coroutine();
+			}
+		};
+
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		FinalAwaiter final_suspend() noexcept { return {}; }
+
+		// This code base doesn't use exceptions
+		void unhandled_exception() { std::terminate(); }
+	};
+
+	template<typename T>
+	struct Promise : PromiseBase
+	{
+		std::optional<T> value;
+
+		Task<T> get_return_object();
+		void return_value(T result) { value.emplace(std::move(result)); }
+	};
+
+	template<>
+	struct Promise<void> : PromiseBase
+	{
+		Task<void> get_return_object();
+		void return_void() { }
+	};
+}
+
+template<typename T>
+class Task
+{
+public:
+	using promise_type = TaskDetail::Promise<T>;
+
+	Task() { }
+	explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) { }
+	Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) { }
+	Task(const Task&) = delete;
+	~Task() { if (handle) handle.destroy(); }
+
+	Task& operator=(Task&& other) noexcept
+	{
+		if (this != &other)
+		{
+			if (handle) handle.destroy();
+			handle = std::exchange(other.handle, nullptr);
+		}
+		return *this;
+	}
+
+	// Starts the task and lets it run on its own
+	//  - Its frame is freed automatically when it finishes
+	void Detach()
+	{
+		std::coroutine_handle<promise_type> h = std::exchange(handle, nullptr);
+		h.promise().detached = true;
+		h.resume();
+	}
+
+	// Awaiting a task starts it and resumes us when it's done
+	bool await_ready() { return false; }
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting)
+	{
+		handle.promise().continuation = awaiting;
+		return handle;
+	}
+	T await_resume()
+	{
+		if constexpr (!std::is_void_v<T>)
+			return std::move(*handle.promise().value);
+	}
+
+private:
+	std::coroutine_handle<promise_type> handle;
+};
+
+namespace TaskDetail
+{
+	template<typename T>
+	Task<T> Promise<T>::get_return_object()
+	{
+		return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+	}
+
+	inline Task<void> Promise<void>::get_return_object()
+	{
+		return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+	}
+}
+
+// --------------------------------------------------------
+// Cooperative cancellation
+//  - Hand out tokens from a source, and call Cancel() on the
+//    source to ask everything holding a token to stop early
+//  - Tasks check IsCancelled() between steps
+//  - A default-constructed token can never be cancelled
+// --------------------------------------------------------
+class CancellationToken
+{
+public:
+	CancellationToken() { }
+	explicit CancellationToken(std::shared_ptr<std::atomic<bool>> flag) : flag(flag) { }
+
+	bool IsCancelled() const { return flag && flag->load(); }
+
+private:
+	std::shared_ptr<std::atomic<bool>> flag;
+};
+
+class CancellationSource
+{
+public:
+	CancellationSource() : flag(std::make_shared<std::atomic<bool>>(false)) { }
+
+	void Cancel() { flag->store(true); }
+	CancellationToken GetToken() { return CancellationToken(flag); }
+
+private:
+	std::shared_ptr<std::atomic<bool>> flag;
+};
@@ -0,0 +1,270 @@
+#include "TaskGraph.h"
+#include <stdio.h>
+
+TaskGraph::TaskGraph(ThreadPool* threadPool)
+{
+	this->threadPool = threadPool;
+	this->unfinishedCount = 0;
+	this->activeWorkerTasks = 0;
+	this->stopping = false;
+}
+
+// --------------------------------------------------------
+// Stops launching new tasks and waits for any worker tasks
+// that are queued or running
+//  - Async tasks that haven't called done() are abandoned,
+//    so whatever they're waiting on must not call it later
+// --------------------------------------------------------
+TaskGraph::~TaskGraph()
+{
+	{
+		std::unique_lock<std::mutex> lock(mainThreadMutex);
+		stopping = true;
+		mainThreadChanged.wait(lock, [this]() { return activeWorkerTasks == 0; });
+	}
+
+	for (int i = 0; i < nodes.size(); i++)
+		delete nodes[i];
+}
+
+TaskGraph::TaskId TaskGraph::Add(
+	const std::string& name,
+	std::function<void()> work,
+	const std::vector<TaskId>& dependencies,
+	TaskThread thread,
+	TaskPriority priority)
+{
+	return AddNode(
+		name,
+		[work](std::function<void()> done) { work(); done(); },
+		dependencies,
+		thread,
+		priority,
+		false);
+}
+
+TaskGraph::TaskId TaskGraph::AddAsync(
+	const std::string& name,
+	std::function<void(std::function<void()> done)> start,
+	const std::vector<TaskId>& dependencies,
+	TaskThread thread,
+	TaskPriority priority)
+{
+	return AddNode(name, start, dependencies, thread, priority, true);
+}
+
+TaskGraph::TaskId TaskGraph::AddNode(
+	const std::string& name,
+	std::function<void(std::function<void()>)> start,
+	const std::vector<TaskId>& dependencies,
+	TaskThread thread,
+	TaskPriority priority,
+	bool async)
+{
+	TaskId id = (TaskId)nodes.size();
+
+	Node* node = new Node();
+	node->name = name;
+	node->start = start;
+	node->dependencies = dependencies;
+	node->thread = thread;
+	node->priority = priority;
+	node->async = async;
+	node->remainingDependencies = (int)dependencies.size();
+	node->finished = false;
+	nodes.push_back(node);
+
+	for (int i = 0; i < dependencies.size(); i++)
+		nodes[dependencies[i]]->dependents.push_back(id);
+
+	unfinishedCount++;
+	return id;
+}
+
+void TaskGraph::Start()
+{
+	graphStartTime = Clock::now();
+	for (int i = 0; i < nodes.size(); i++)
+	{
+		if (nodes[i]->dependencies.empty())
+			Launch(i);
+	}
+}
+
+void TaskGraph::RunMainThreadTasks()
+{
+	while (true)
+	{
+		TaskId task;
+		{
+			std::lock_guard<std::mutex> lock(mainThreadMutex);
+			if (mainThreadQueue.empty())
+				return;
+
+			task = mainThreadQueue.front();
+			mainThreadQueue.pop_front();
+		}
+		Run(task);
+	}
+}
+
+void TaskGraph::Wait(TaskId task)
+{
+	std::unique_lock<std::mutex> lock(mainThreadMutex);
+	while (true)
+	{
+		mainThreadChanged.wait(lock, [this, task]() { return nodes[task]->finished || !mainThreadQueue.empty(); });
+		if (nodes[task]->finished)
+			return;
+
+		TaskId next = mainThreadQueue.front();
+		mainThreadQueue.pop_front();
+
+		lock.unlock();
+		Run(next);
+		lock.lock();
+	}
+}
+
+// --------------------------------------------------------
+// Sends a task whose dependencies are all done to the
+// thread it's meant to run on
+// --------------------------------------------------------
+void TaskGraph::Launch(TaskId task)
+{
+	Node* node = nodes[task];
+	node->readyTime = Clock::now();
+
+	std::lock_guard<std::mutex> lock(mainThreadMutex);
+	if (stopping)
+		return;
+
+	if (node->thread == TaskThread::Main)
+	{
+		mainThreadQueue.push_back(task);
+		mainThreadChanged.notify_all();
+		return;
+	}
+
+	activeWorkerTasks++;
+	threadPool->Enqueue([this, task]()
+	{
+		if (!stopping)
+			Run(task);
+
+		std::lock_guard<std::mutex> lock(mainThreadMutex);
+		activeWorkerTasks--;
+		mainThreadChanged.notify_all();
+	}, node->priority);
+}
+
+void TaskGraph::Run(TaskId task)
+{
+	nodes[task]->startTime = Clock::now();
+	nodes[task]->start([this, task]() { Finish(task); });
+}
+
+// --------------------------------------------------------
+// Records the end time and launches any dependents that
+// were only waiting on this task
+// --------------------------------------------------------
+void TaskGraph::Finish(TaskId task)
+{
+	Node* node = nodes[task];
+	node->endTime = Clock::now();
+
+	for (int i = 0; i < node->dependents.size(); i++)
+	{
+		TaskId dependent = node->dependents[i];
+		if (--nodes[dependent]->remainingDependencies == 0)
+			Launch(dependent);
+	}
+
+	// Flip the flags under the lock so Wait() can't miss them
+	std::lock_guard<std::mutex> lock(mainThreadMutex);
+	node->finished = true;
+	unfinishedCount--;
+	mainThreadChanged.notify_all();
+}
+
+// --------------------------------------------------------
+// Prints every task's timings, then the critical path
+//  - Times are relative to Start()
+//  - "Wait" is how long a task sat ready before it ran,
+//    which shows where more threads (or a higher priority)
+//    would help
+//  - The critical path is found by starting from the task
+//    that finished last and repeatedly stepping back to the
+//    dependency that finished last, since that's the one
+//    that actually held things up
+// --------------------------------------------------------
+void TaskGraph::PrintReport()
+{
+	if (!IsFinished())
+		return;
+
+	printf("---- Startup report ----\n");
+	printf("%-28s %9s %9s %9s %9s\n", "Task", "Start", "Wait", "Time", "End");
+
+	float totalTaskTime = 0.0f;
+	TaskId last = -1;
+	for (int i = 0; i < nodes.size(); i++)
+	{
+		Node* node = nodes[i];
+		float time = Milliseconds(node->startTime, node->endTime);
+		printf("%-28s %8.2fms %8.2fms %8.2fms %8.2fms%s\n",
+			node->name.c_str(),
+			Milliseconds(graphStartTime, node->startTime),
+			Milliseconds(node->readyTime, node->startTime),
+			time,
+			Milliseconds(graphStartTime, node->endTime),
+			node->thread == TaskThread::Main ? " (main)" : "");
+
+		// Async tasks are mostly spent waiting, so they'd
+		// throw off the parallelism numbers
+		if (!node->async)
+			totalTaskTime += time;
+
+		if (last == -1 || node->endTime > nodes[last]->endTime)
+			last = i;
+	}
+	if (last == -1)
+		return;
+
+	// Walk the critical path backwards
+	std::vector<TaskId> path;
+	for (TaskId task = last; task != -1;)
+	{
+		path.push_back(task);
+
+		TaskId latest = -1;
+		std::vector<TaskId>& dependencies = nodes[task]->dependencies;
+		for (int i = 0; i < dependencies.size(); i++)
+		{
+			if (latest == -1 || nodes[dependencies[i]]->endTime > nodes[latest]->endTime)
+				latest = dependencies[i];
+		}
+		task = latest;
+	}
+
+	printf("Critical path:\n");
+	for (int i = (int)path.size() - 1; i >= 0; i--)
+	{
+		Node* node = nodes[path[i]];
+		printf("  %-26s %8.2fms (+%.2fms waiting)\n",
+			node->name.c_str(),
+			Milliseconds(node->startTime, node->endTime),
+			Milliseconds(node->readyTime, node->startTime));
+	}
+
+	float totalTime = Milliseconds(graphStartTime, nodes[last]->endTime);
+	printf("Total: %.2fms, %.2fms of synchronous work (%.2fx parallel)\n",
+		totalTime,
+		totalTaskTime,
+		totalTime > 0.0f ? totalTaskTime / totalTime : 0.0f);
+}
+
+float TaskGraph::Milliseconds(Clock::time_point from, Clock::time_point to)
+{
+	return std::chrono::duration<float, std::milli>(to - from).count();
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ThreadPool.h"
+
+// --------------------------------------------------------
+// Which thread a graph task runs on
+//  - Main tasks only run inside RunMainThreadTasks() or
+//    Wait(), so they're safe to use the immediate context
+// --------------------------------------------------------
+enum class TaskThread
+{
+	Worker,
+	Main
+};
+
+// --------------------------------------------------------
+// A set of tasks with dependencies between them
+//  - Every task starts as soon as everything it depends on
+//    has finished, so independent work runs on all cores
+//  - Async tasks are handed a "done" function and finish
+//    whenever it gets called (from any thread), which lets
+//    things like asset loads be part of the graph
+//  - Start, end and wait times are recorded for every task
+//    so PrintReport() can show where the time went
+// --------------------------------------------------------
+class TaskGraph
+{
+public:
+	typedef int TaskId;
+
+	TaskGraph(ThreadPool* threadPool);
+	~TaskGraph();
+
+	// Building the graph - everything is added before Start()
+	TaskId Add(
+		const std::string& name,
+		std::function<void()> work,
+		const std::vector<TaskId>& dependencies = std::vector<TaskId>(),
+		TaskThread thread = TaskThread::Worker,
+		TaskPriority priority = TaskPriority::Normal);
+	TaskId AddAsync(
+		const std::string& name,
+		std::function<void(std::function<void()> done)> start,
+		const std::vector<TaskId>& dependencies = std::vector<TaskId>(),
+		TaskThread thread = TaskThread::Worker,
+		TaskPriority priority = TaskPriority::Normal);
+
+	// Kicks off every task with no dependencies
+	void Start();
+
+	// Runs whatever main thread tasks are ready
+	void RunMainThreadTasks();
+
+	// Runs main thread tasks until the given task has finished
+	void Wait(TaskId task);
+
+	bool IsFinished() { return unfinishedCount == 0; }
+	bool IsFinished(TaskId task) { return nodes[task]->finished; }
+
+	// Per-task timings and the critical path, once finished
+	void PrintReport();
+
+private:
+	typedef std::chrono::high_resolution_clock Clock;
+
+	struct Node
+	{
+		std::string name;
+		std::function<void(std::function<void()>)> start;
+		std::vector<TaskId> dependencies;
+		std::vector<TaskId> dependents;
+		TaskThread thread;
+		TaskPriority priority;
+		bool async;
+
+		std::atomic<int> remainingDependencies;
+		std::atomic<bool> finished;
+
+		// When it could have run, when it did, and when it was done
+		Clock::time_point readyTime;
+		Clock::time_point startTime;
+		Clock::time_point endTime;
+	};
+
+	ThreadPool* threadPool;
+	std::vector<Node*> nodes;
+	Clock::time_point graphStartTime;
+	std::atomic<int> unfinishedCount;
+
+	// Main thread tasks that are ready to go, and everything
+	// needed to wait on them
+	std::mutex mainThreadMutex;
+	std::condition_variable mainThreadChanged;
+	std::deque<TaskId> mainThreadQueue;
+
+	// Worker tasks that are queued or running, so the
+	// destructor doesn't pull the graph out from under them
+	int activeWorkerTasks;
+	std::atomic<bool> stopping;
+
+	TaskId AddNode(
+		const std::string& name,
+		std::function<void(std::function<void()>)> start,
+		const std::vector<TaskId>& dependencies,
+		TaskThread thread,
+		TaskPriority priority,
+		bool async);
+	void Launch(TaskId task);
+	void Run(TaskId task);
+	void Finish(TaskId task);
+	float Milliseconds(Clock::time_point from, Clock::time_point to);
+};
@@ -0,0 +1,72 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+{
+	stopping = false;
+
+	// Leave the main thread its own core by default
+	if (threadCount == 0)
+	{
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	for (unsigned int i = 0; i < threadCount; i++)
+		threads.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		stopping = true;
+	}
+	jobAvailable.notify_all();
+
+	for (auto& t : threads)
+		t.join();
+}
+
+void ThreadPool::Enqueue(std::function<void()> job, TaskPriority priority)
+{
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		jobs[(int)priority].push(std::move(job));
+	}
+	jobAvailable.notify_one();
+}
+
+// --------------------------------------------------------
+// Runs jobs, highest priority first, until the pool is
+// stopping AND the queues are empty, so nothing that was
+// enqueued is ever dropped
+// --------------------------------------------------------
+void ThreadPool::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(jobMutex);
+			std::queue<std::function<void()>>* queue = 0;
+			jobAvailable.wait(lock, [this, &queue]()
+			{
+				for (auto& q : jobs)
+				{
+					if (!q.empty())
+					{
+						queue = &q;
+						return true;
+					}
+				}
+				return stopping;
+			});
+			if (!queue)
+				return;
+
+			job = std::move(queue->front());
+			queue->pop();
+		}
+		job();
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <condition_variable>
+#include <coroutine>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// --------------------------------------------------------
+// Job priorities - higher priority jobs always go first
+// --------------------------------------------------------
+enum class TaskPriority
+{
+	High,
+	Normal,
+	Low,
+	Count
+};
+
+// --------------------------------------------------------
+// A fixed set of worker threads pulling jobs from a queue
+// per priority
+//  - Meant for coarse, longer-running work like loading and
+//    parsing assets, not for fine-grained per-frame jobs
+//  - The destructor finishes every queued job before joining
+// --------------------------------------------------------
+class ThreadPool
+{
+public:
+	ThreadPool(unsigned int threadCount = 0); // 0 = one per hardware thread, minus the main thread
+	~ThreadPool();
+
+	void Enqueue(std::function<void()> job, TaskPriority priority = TaskPriority::Normal);
+	unsigned int GetThreadCount() { return (unsigned int)threads.size(); }
+
+	// co_await pool->Schedule() to continue a coroutine on a worker
+	struct ScheduleAwaitable
+	{
+		ThreadPool* pool;
+		TaskPriority priority;
+
+		bool await_ready() { return false; }
+		void await_suspend(std::coroutine_handle<> handle) { pool->Enqueue([handle]() { handle.resume(); }, priority); }
+		void await_resume() { }
+	};
+	ScheduleAwaitable Schedule(TaskPriority priority = TaskPriority::Normal) { return ScheduleAwaitable{ this, priority }; }
+
+private:
+	std::vector<std::thread> threads;
+	std::queue<std::function<void()>> jobs[(int)TaskPriority::Count];
+	std::mutex jobMutex;
+	std::condition_variable jobAvailable;
+	bool stopping;
+
+	void WorkerLoop();
+};
@@ -1,4 +1,5 @@
 #include "Transform.h"
+#include <algorithm>
 
 using namespace DirectX;
 
@@ -10,32 +11,92 @@ Transform::Transform()
 	position = { 0, 0, 0 };
 	rotation = { 0, 0, 0 };
 	scale = { 1, 1, 1 };
+	rotationQuaternion = { 0, 0, 0, 1 };
+	XMStoreFloat4x4(&local, XMMatrixIdentity());
 	XMStoreFloat4x4(&world, XMMatrixIdentity());
+	XMStoreFloat4x4(&worldInverseTranspose, XMMatrixIdentity());
+
+	rotationDirty = false;
+	localDirty = false;
+	worldDirty = false;
+	parent = 0;
 }
 
 
 // Destructor
+// Leaves the hierarchy, so children become roots
 Transform::~Transform()
 {
+	SetParent(0);
+	while (!children.empty())
+		children.back()->SetParent(0);
+}
 
+
+// Something that affects the local matrix changed
+void Transform::MarkLocalDirty()
+{
+	localDirty = true;
+	MarkWorldDirty();
 }
 
 
-// Create World Matrix method
-// Creates the world matrix from the position, rotation, and scale vectors
-void Transform::CreateWorldMatrix()
+// Our world matrix (and so every descendant's) is out of date
+//  - Stops early at anything already dirty, since its
+//    subtree must be dirty too
+void Transform::MarkWorldDirty()
 {
-	// make the necessary matrices
-	XMMATRIX m4Translation = XMMatrixTranslation(position.x, position.y, position.z);
-	XMMATRIX m4Scale = XMMatrixScaling(scale.x, scale.y, scale.z);
-	XMMATRIX m4Rotation = XMMatrixRotationRollPitchYaw(rotation.x, rotation.y, rotation.z);
+	if (worldDirty)
+		return;
+
+	worldDirty = true;
+	for (int i = 0; i < children.size(); i++)
+		children[i]->MarkWorldDirty();
+}
+
 
-	// apply them to our world matrix
-	// applies translation, then rotation, then scale
-	XMMATRIX m4World = m4Scale * m4Rotation * m4Translation;
+// Rebuilds the quaternion from the Euler angles
+void Transform::UpdateRotation()
+{
+	if (!rotationDirty)
+		return;
+
+	XMStoreFloat4(&rotationQuaternion, XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&rotation)));
+	rotationDirty = false;
+}
+
+
+// Rebuilds whatever matrices are out of date
+//  - The parent's world matrix is brought up to date first
+void Transform::UpdateMatrices()
+{
+	if (!worldDirty)
+		return;
+
+	if (localDirty)
+	{
+		UpdateRotation();
+
+		// make the necessary matrices
+		XMMATRIX m4Translation = XMMatrixTranslation(position.x, position.y, position.z);
+		XMMATRIX m4Scale = XMMatrixScaling(scale.x, scale.y, scale.z);
+		XMMATRIX m4Rotation = XMMatrixRotationQuaternion(XMLoadFloat4(&rotationQuaternion));
+
+		// applies scale, then rotation, then translation
+		XMStoreFloat4x4(&local, m4Scale * m4Rotation * m4Translation);
+		localDirty = false;
+	}
+
+	XMMATRIX m4World = XMLoadFloat4x4(&local);
+	if (parent)
+	{
+		XMFLOAT4X4 parentWorld = parent->GetWorldMatrix();
+		m4World = m4World * XMLoadFloat4x4(&parentWorld);
+	}
 
-	// store the world matrix as a float4x4
 	XMStoreFloat4x4(&world, m4World);
+	XMStoreFloat4x4(&worldInverseTranspose, XMMatrixTranspose(XMMatrixInverse(0, m4World)));
+	worldDirty = false;
 }
 
 
@@ -44,20 +105,20 @@ void Transform::MoveAbsolute(float x, float y, float z)
 	position.x += x;
 	position.y += y;
 	position.z += z;
+	MarkLocalDirty();
 }
 
 void Transform::MoveRelative(float x, float y, float z)
 {
 	// Create a direction vector from the parameters
-	//  and a rotation quaternion
+	//  and rotate it by our (cached) rotation quaternion
+	UpdateRotation();
 	XMVECTOR movement = XMVectorSet(x, y, z, 0);
-	XMVECTOR rotQuat = XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&rotation));
-
-	// Rotate the movement by the quaternion
-	XMVECTOR dir = XMVector3Rotate(movement, rotQuat);
+	XMVECTOR dir = XMVector3Rotate(movement, XMLoadFloat4(&rotationQuaternion));
 
 	// Add and store
 	XMStoreFloat3(&position, XMLoadFloat3(&position) + dir);
+	MarkLocalDirty();
 }
 
 
@@ -66,6 +127,8 @@ void Transform::Rotate(float pitch, float yaw, float roll)
 	rotation.x += pitch;
 	rotation.y += yaw;
 	rotation.z += roll;
+	rotationDirty = true;
+	MarkLocalDirty();
 }
 
 
@@ -74,6 +137,7 @@ void Transform::Scale(float x, float y, float z)
 	scale.x *= x;
 	scale.y *= y;
 	scale.z *= z;
+	MarkLocalDirty();
 }
 
 
@@ -82,6 +146,7 @@ void Transform::Scale(float x, float y, float z)
 void Transform::SetPosition(float x, float y, float z)
 {
 	position = { x, y, z };
+	MarkLocalDirty();
 }
 
 
@@ -90,6 +155,8 @@ void Transform::SetPosition(float x, float y, float z)
 void Transform::SetRotation(float pitch, float yaw, float roll)
 {
 	rotation = { pitch, yaw, roll };
+	rotationDirty = true;
+	MarkLocalDirty();
 }
 
 
@@ -98,6 +165,7 @@ void Transform::SetRotation(float pitch, float yaw, float roll)
 void Transform::SetScale(float x, float y, float z)
 {
 	scale = { x, y, z };
+	MarkLocalDirty();
 }
 
 
@@ -119,7 +187,92 @@ DirectX::XMFLOAT3 Transform::GetScale()
 }
 
 
+DirectX::XMFLOAT4 Transform::GetRotationQuaternion()
+{
+	UpdateRotation();
+	return rotationQuaternion;
+}
+
+
+DirectX::XMFLOAT4X4 Transform::GetLocalMatrix()
+{
+	UpdateMatrices();
+	return local;
+}
+
+
 DirectX::XMFLOAT4X4 Transform::GetWorldMatrix()
 {
+	UpdateMatrices();
 	return world;
 }
+
+
+DirectX::XMFLOAT4X4 Transform::GetWorldInverseTransposeMatrix()
+{
+	UpdateMatrices();
+	return worldInverseTranspose;
+}
+
+
+// SetParent method
+// Moves this transform (and its subtree) under a new parent
+//  - Refuses to create a cycle
+void Transform::SetParent(Transform* newParent)
+{
+	if (newParent == parent || newParent == this)
+		return;
+
+	for (Transform* ancestor = newParent; ancestor; ancestor = ancestor->parent)
+	{
+		if (ancestor == this)
+			return;
+	}
+
+	if (parent)
+	{
+		std::vector<Transform*>& siblings = parent->children;
+		siblings.erase(std::find(siblings.begin(), siblings.end(), this));
+	}
+
+	parent = newParent;
+	if (parent)
+		parent->children.push_back(this);
+
+	// Force the whole subtree to rebuild, even if it was
+	// already clean relative to the old parent
+	worldDirty = false;
+	MarkWorldDirty();
+}
+
+
+void Transform::AddChild(Transform* child)
+{
+	if (child)
+		child->SetParent(this);
+}
+
+
+void Transform::RemoveChild(Transform* child)
+{
+	if (child && child->parent == this)
+		child->SetParent(0);
+}
+
+
+Transform* Transform::GetParent()
+{
+	return parent;
+}
+
+
+Transform* Transform::GetChild(unsigned int index)
+{
+	return index < children.size() ? children[index] : 0;
+}
+
+
+unsigned int Transform::GetChildCount()
+{
+	return (unsigned int)children.size();
+}
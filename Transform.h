@@ -1,19 +1,53 @@
 #pragma once
 #include "DXCore.h"
 #include <DirectXMath.h>
+#include <vector>
 
+// --------------------------------------------------------
+// Position, rotation and scale, optionally relative to a
+// parent transform
+//  - Matrices are only rebuilt when something they depend
+//    on has changed, and only when they're asked for, so
+//    transforms that never move cost nothing per frame
+//  - Changing a transform marks its whole subtree dirty,
+//    so getters never return stale data
+// --------------------------------------------------------
 class Transform
 {
 	DirectX::XMFLOAT3 position;
-	DirectX::XMFLOAT3 rotation;
+	DirectX::XMFLOAT3 rotation; // Pitch, yaw, roll
 	DirectX::XMFLOAT3 scale;
+
+	// Cached from the values above
+	DirectX::XMFLOAT4 rotationQuaternion;
+	DirectX::XMFLOAT4X4 local;
 	DirectX::XMFLOAT4X4 world;
+	DirectX::XMFLOAT4X4 worldInverseTranspose;
+
+	// What needs rebuilding
+	//  - If a transform's world matrix is dirty, so are
+	//    all of its descendants'
+	bool rotationDirty;
+	bool localDirty;
+	bool worldDirty;
+
+	// Hierarchy - a transform doesn't own its parent or children
+	Transform* parent;
+	std::vector<Transform*> children;
+
+	void MarkLocalDirty();
+	void MarkWorldDirty();
+	void UpdateRotation();
+	void UpdateMatrices();
 
 public:
 	Transform();
 	~Transform();
 
-	void CreateWorldMatrix();
+	// Parents and children point at each other, so copies
+	// would leave dangling pointers behind
+	Transform(const Transform&) = delete;
+	Transform& operator=(const Transform&) = delete;
 
 	void MoveAbsolute(float x, float y, float z);
 	void MoveRelative(float x, float y, float z);
@@ -27,6 +61,20 @@ public:
 	DirectX::XMFLOAT3 GetPosition();
 	DirectX::XMFLOAT3 GetRotation();
 	DirectX::XMFLOAT3 GetScale();
+	DirectX::XMFLOAT4 GetRotationQuaternion();
+
+	// Matrices - rebuilt here if they're out of date
+	DirectX::XMFLOAT4X4 GetLocalMatrix();
 	DirectX::XMFLOAT4X4 GetWorldMatrix();
-};
+	DirectX::XMFLOAT4X4 GetWorldInverseTransposeMatrix(); // For transforming normals
 
+	// Hierarchy
+	//  - Position, rotation and scale are relative to the parent
+	//  - Pass null to detach from the current parent
+	void SetParent(Transform* newParent);
+	void AddChild(Transform* child);
+	void RemoveChild(Transform* child);
+	Transform* GetParent();
+	Transform* GetChild(unsigned int index);
+	unsigned int GetChildCount();
+};
@@ -0,0 +1,95 @@
+#include "TransformBenchmark.h"
+#include "BenchmarkTiming.h"
+#include "Transform.h"
+#include "TransformSystem.h"
+#include <stdio.h>
+#include <vector>
+
+using namespace DirectX;
+
+// The old per-object data and path
+struct EulerTransform
+{
+	XMFLOAT3 position;
+	XMFLOAT3 rotation;
+	XMFLOAT3 scale;
+	XMFLOAT4X4 world;
+};
+
+void RunTransformBenchmark(JobSystem* jobSystem, unsigned int objectCount, unsigned int iterations)
+{
+	printf("---- Transform benchmark: %u objects, %u iterations ----\n", objectCount, iterations);
+
+	// Same starting values for every path
+	std::vector<EulerTransform> euler(objectCount);
+	for (unsigned int i = 0; i < objectCount; i++)
+	{
+		euler[i].position = XMFLOAT3((float)(i % 100), (float)(i / 100 % 100), (float)(i / 10000));
+		euler[i].rotation = XMFLOAT3(i * 0.01f, i * 0.02f, i * 0.03f);
+		euler[i].scale = XMFLOAT3(1.0f + (i % 3), 1.0f, 1.0f + (i % 5));
+	}
+
+	// Old path - everything rebuilt every time
+	float eulerTime = TimeAverage(iterations,
+		[&](unsigned int frame) { for (auto& t : euler) t.position.y += 0.01f; },
+		[&]()
+	{
+		for (auto& t : euler)
+		{
+			XMMATRIX m4Translation = XMMatrixTranslation(t.position.x, t.position.y, t.position.z);
+			XMMATRIX m4Scale = XMMatrixScaling(t.scale.x, t.scale.y, t.scale.z);
+			XMMATRIX m4Rotation = XMMatrixRotationRollPitchYaw(t.rotation.x, t.rotation.y, t.rotation.z);
+			XMStoreFloat4x4(&t.world, m4Scale * m4Rotation * m4Translation);
+		}
+	});
+	printf("Per-object, Euler:            %8.3fms\n", eulerTime);
+
+	// Transform objects, with their cached quaternions
+	Transform* transforms = new Transform[objectCount];
+	for (unsigned int i = 0; i < objectCount; i++)
+	{
+		transforms[i].SetPosition(euler[i].position.x, euler[i].position.y, euler[i].position.z);
+		transforms[i].SetRotation(euler[i].rotation.x, euler[i].rotation.y, euler[i].rotation.z);
+		transforms[i].SetScale(euler[i].scale.x, euler[i].scale.y, euler[i].scale.z);
+		transforms[i].GetWorldMatrix();
+	}
+	float transformTime = TimeAverage(iterations,
+		[&](unsigned int frame) { for (unsigned int i = 0; i < objectCount; i++) transforms[i].MoveAbsolute(0, 0.01f, 0); },
+		[&]() { for (unsigned int i = 0; i < objectCount; i++) transforms[i].GetWorldMatrix(); });
+	printf("Per-object, Transform:        %8.3fms\n", transformTime);
+	delete[] transforms;
+
+	// The transform system, each way it can run
+	TransformSystem system;
+	std::vector<TransformHandle> handles(objectCount);
+	for (unsigned int i = 0; i < objectCount; i++)
+	{
+		handles[i] = system.Create();
+		system.SetPosition(handles[i], euler[i].position.x, euler[i].position.y, euler[i].position.z);
+		system.SetRotation(handles[i], euler[i].rotation.x, euler[i].rotation.y, euler[i].rotation.z);
+		system.SetScale(handles[i], euler[i].scale.x, euler[i].scale.y, euler[i].scale.z);
+	}
+	auto moveAll = [&](unsigned int frame) { for (auto h : handles) system.MoveAbsolute(h, 0, 0.01f, 0); };
+
+	system.SetUseSIMD(false);
+	float scalarTime = TimeAverage(iterations, moveAll, [&]() { system.Update(); });
+	printf("TransformSystem, scalar:      %8.3fms\n", scalarTime);
+
+	if (HasAVX2())
+	{
+		system.SetUseSIMD(true);
+		float simdTime = TimeAverage(iterations, moveAll, [&]() { system.Update(); });
+		printf("TransformSystem, AVX2:        %8.3fms\n", simdTime);
+	}
+	else
+	{
+		printf("TransformSystem, AVX2:        (not supported)\n");
+	}
+
+	float threadedTime = TimeAverage(iterations, moveAll, [&]() { system.Update(jobSystem); });
+	printf("TransformSystem, %2u threads:  %8.3fms\n", jobSystem->GetThreadCount(), threadedTime);
+
+	// Nothing moved - what static scenes cost
+	float staticTime = TimeAverage(iterations, [](unsigned int frame) { }, [&]() { system.Update(jobSystem); });
+	printf("TransformSystem, none dirty:  %8.3fms\n", staticTime);
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include "JobSystem.h"
+
+// --------------------------------------------------------
+// Times rebuilding world matrices for a scene of moving
+// objects with each transform path, and prints the results
+//  - The per-object path does what Transform used to do:
+//    scaling * roll/pitch/yaw rotation * translation
+// --------------------------------------------------------
+void RunTransformBenchmark(JobSystem* jobSystem, unsigned int objectCount = 100000, unsigned int iterations = 20);
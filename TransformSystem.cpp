@@ -0,0 +1,633 @@
+#include "TransformSystem.h"
+#include <algorithm>
+#include <immintrin.h>
+#include <string.h>
+
+using namespace DirectX;
+
+// Smallest number of transforms worth splitting across threads
+//  - Below this, waking the pool costs more than it saves
+static const unsigned int MinCountForThreads = 4096;
+
+// parentIndex value for roots
+static const unsigned int NoParent = 0xFFFFFFFF;
+
+TransformSystem::TransformSystem()
+{
+	count = 0;
+	useSIMD = HasAVX2();
+}
+
+TransformSystem::~TransformSystem()
+{
+}
+
+// New transforms are roots, so they can go on the end
+TransformHandle TransformSystem::Create()
+{
+	// Grow by a whole batch at a time
+	if (count == dirty.size())
+		Resize(count + 8);
+
+	TransformHandle handle;
+	if (!freeHandles.empty())
+	{
+		handle = freeHandles.back();
+		freeHandles.pop_back();
+	}
+	else
+	{
+		handle = (TransformHandle)handleToIndex.size();
+		handleToIndex.push_back(0);
+	}
+
+	unsigned int index = count++;
+	handleToIndex[handle] = index;
+	indexToHandle[index] = handle;
+	ResetEntry(index);
+	return handle;
+}
+
+// --------------------------------------------------------
+// Removes a transform, turning its children into roots
+//  - A root with no children can be swapped with the last
+//    transform if that's also a childless root, which keeps
+//    flat scenes cheap
+//  - Otherwise it's made a root at the end first
+// --------------------------------------------------------
+void TransformSystem::Destroy(TransformHandle handle)
+{
+	unsigned int index = handleToIndex[handle];
+
+	// The first child moves away each time, so the next takes its place
+	while (subtreeSize[index] > 1)
+		MoveSubtree(index + 1, NoParent);
+
+	unsigned int last = count - 1;
+	if (index != last && parentIndex[index] == NoParent && parentIndex[last] == NoParent && subtreeSize[last] == 1)
+	{
+		MoveEntry(last, index);
+		indexToHandle[index] = indexToHandle[last];
+		handleToIndex[indexToHandle[index]] = index;
+	}
+	else if (index != last || parentIndex[index] != NoParent)
+	{
+		MoveSubtree(index, NoParent);
+	}
+
+	ResetEntry(last);
+	dirty[last] = 0;
+	indexToHandle[last] = InvalidTransformHandle;
+	handleToIndex[handle] = 0xFFFFFFFF;
+	freeHandles.push_back(handle);
+	count--;
+}
+
+void TransformSystem::Resize(unsigned int paddedCount)
+{
+	unsigned int oldSize = (unsigned int)dirty.size();
+
+	positionX.resize(paddedCount); positionY.resize(paddedCount); positionZ.resize(paddedCount);
+	rotationX.resize(paddedCount); rotationY.resize(paddedCount); rotationZ.resize(paddedCount);
+	quaternionX.resize(paddedCount); quaternionY.resize(paddedCount); quaternionZ.resize(paddedCount); quaternionW.resize(paddedCount);
+	scaleX.resize(paddedCount); scaleY.resize(paddedCount); scaleZ.resize(paddedCount);
+	dirty.resize(paddedCount);
+	local.resize(paddedCount);
+	localInverseTranspose.resize(paddedCount);
+	world.resize(paddedCount);
+	worldInverseTranspose.resize(paddedCount);
+	parentIndex.resize(paddedCount);
+	subtreeSize.resize(paddedCount);
+	indexToHandle.resize(paddedCount, InvalidTransformHandle);
+
+	for (unsigned int i = oldSize; i < paddedCount; i++)
+	{
+		ResetEntry(i);
+		dirty[i] = 0;
+	}
+}
+
+void TransformSystem::MoveEntry(unsigned int from, unsigned int to)
+{
+	positionX[to] = positionX[from]; positionY[to] = positionY[from]; positionZ[to] = positionZ[from];
+	rotationX[to] = rotationX[from]; rotationY[to] = rotationY[from]; rotationZ[to] = rotationZ[from];
+	quaternionX[to] = quaternionX[from]; quaternionY[to] = quaternionY[from];
+	quaternionZ[to] = quaternionZ[from]; quaternionW[to] = quaternionW[from];
+	scaleX[to] = scaleX[from]; scaleY[to] = scaleY[from]; scaleZ[to] = scaleZ[from];
+	dirty[to] = dirty[from];
+	local[to] = local[from];
+	localInverseTranspose[to] = localInverseTranspose[from];
+	world[to] = world[from];
+	worldInverseTranspose[to] = worldInverseTranspose[from];
+	parentIndex[to] = parentIndex[from];
+	subtreeSize[to] = subtreeSize[from];
+}
+
+// Identity root transform, with matrices to match
+void TransformSystem::ResetEntry(unsigned int index)
+{
+	positionX[index] = 0; positionY[index] = 0; positionZ[index] = 0;
+	rotationX[index] = 0; rotationY[index] = 0; rotationZ[index] = 0;
+	quaternionX[index] = 0; quaternionY[index] = 0; quaternionZ[index] = 0; quaternionW[index] = 1;
+	scaleX[index] = 1; scaleY[index] = 1; scaleZ[index] = 1;
+	XMStoreFloat4x4(&local[index], XMMatrixIdentity());
+	XMStoreFloat4x4(&localInverseTranspose[index], XMMatrixIdentity());
+	XMStoreFloat4x4(&world[index], XMMatrixIdentity());
+	XMStoreFloat4x4(&worldInverseTranspose[index], XMMatrixIdentity());
+	parentIndex[index] = NoParent;
+	subtreeSize[index] = 1;
+	dirty[index] = 1;
+}
+
+// The quaternion is cached here, so batches never need sin/cos
+void TransformSystem::MarkRotationChanged(unsigned int index)
+{
+	XMFLOAT4 q;
+	XMStoreFloat4(&q, XMQuaternionRotationRollPitchYaw(rotationX[index], rotationY[index], rotationZ[index]));
+	quaternionX[index] = q.x;
+	quaternionY[index] = q.y;
+	quaternionZ[index] = q.z;
+	quaternionW[index] = q.w;
+	dirty[index] = 1;
+}
+
+void TransformSystem::MoveAbsolute(TransformHandle handle, float x, float y, float z)
+{
+	unsigned int i = handleToIndex[handle];
+	positionX[i] += x;
+	positionY[i] += y;
+	positionZ[i] += z;
+	dirty[i] = 1;
+}
+
+void TransformSystem::MoveRelative(TransformHandle handle, float x, float y, float z)
+{
+	unsigned int i = handleToIndex[handle];
+	XMVECTOR rotQuat = XMVectorSet(quaternionX[i], quaternionY[i], quaternionZ[i], quaternionW[i]);
+	XMFLOAT3 dir;
+	XMStoreFloat3(&dir, XMVector3Rotate(XMVectorSet(x, y, z, 0), rotQuat));
+
+	positionX[i] += dir.x;
+	positionY[i] += dir.y;
+	positionZ[i] += dir.z;
+	dirty[i] = 1;
+}
+
+void TransformSystem::Rotate(TransformHandle handle, float pitch, float yaw, float roll)
+{
+	unsigned int i = handleToIndex[handle];
+	rotationX[i] += pitch;
+	rotationY[i] += yaw;
+	rotationZ[i] += roll;
+	MarkRotationChanged(i);
+}
+
+void TransformSystem::Scale(TransformHandle handle, float x, float y, float z)
+{
+	unsigned int i = handleToIndex[handle];
+	scaleX[i] *= x;
+	scaleY[i] *= y;
+	scaleZ[i] *= z;
+	dirty[i] = 1;
+}
+
+void TransformSystem::SetPosition(TransformHandle handle, float x, float y, float z)
+{
+	unsigned int i = handleToIndex[handle];
+	positionX[i] = x;
+	positionY[i] = y;
+	positionZ[i] = z;
+	dirty[i] = 1;
+}
+
+void TransformSystem::SetRotation(TransformHandle handle, float pitch, float yaw, float roll)
+{
+	unsigned int i = handleToIndex[handle];
+	rotationX[i] = pitch;
+	rotationY[i] = yaw;
+	rotationZ[i] = roll;
+	MarkRotationChanged(i);
+}
+
+void TransformSystem::SetScale(TransformHandle handle, float x, float y, float z)
+{
+	unsigned int i = handleToIndex[handle];
+	scaleX[i] = x;
+	scaleY[i] = y;
+	scaleZ[i] = z;
+	dirty[i] = 1;
+}
+
+DirectX::XMFLOAT3 TransformSystem::GetPosition(TransformHandle handle)
+{
+	unsigned int i = handleToIndex[handle];
+	return XMFLOAT3(positionX[i], positionY[i], positionZ[i]);
+}
+
+DirectX::XMFLOAT3 TransformSystem::GetRotation(TransformHandle handle)
+{
+	unsigned int i = handleToIndex[handle];
+	return XMFLOAT3(rotationX[i], rotationY[i], rotationZ[i]);
+}
+
+DirectX::XMFLOAT3 TransformSystem::GetScale(TransformHandle handle)
+{
+	unsigned int i = handleToIndex[handle];
+	return XMFLOAT3(scaleX[i], scaleY[i], scaleZ[i]);
+}
+
+DirectX::XMFLOAT4 TransformSystem::GetRotationQuaternion(TransformHandle handle)
+{
+	unsigned int i = handleToIndex[handle];
+	return XMFLOAT4(quaternionX[i], quaternionY[i], quaternionZ[i], quaternionW[i]);
+}
+
+void TransformSystem::SetParent(TransformHandle handle, TransformHandle parent)
+{
+	unsigned int index = handleToIndex[handle];
+	unsigned int newParent = parent == InvalidTransformHandle ? NoParent : handleToIndex[parent];
+	if (newParent == parentIndex[index])
+		return;
+
+	// Refuse to make a transform its own ancestor
+	if (newParent != NoParent && newParent >= index && newParent < index + subtreeSize[index])
+		return;
+
+	MoveSubtree(index, newParent);
+}
+
+TransformHandle TransformSystem::GetParent(TransformHandle handle)
+{
+	unsigned int i = handleToIndex[handle];
+	return parentIndex[i] == NoParent ? InvalidTransformHandle : indexToHandle[parentIndex[i]];
+}
+
+// --------------------------------------------------------
+// Moves a subtree so it sits at the end of its new parent's
+// subtree (or at the very end, for a new root)
+//  - Only the range between the old and new spots is touched:
+//    it's rotated into place, and the parent indices that
+//    pointed into it are shifted to match
+// --------------------------------------------------------
+void TransformSystem::MoveSubtree(unsigned int index, unsigned int newParent)
+{
+	unsigned int size = subtreeSize[index];
+	unsigned int end = index + size;
+
+	// Where the subtree goes, in terms of the current layout
+	unsigned int destination = newParent == NoParent ? count : newParent + subtreeSize[newParent];
+
+	// The range that shifts, and how each old index within it maps to a new one
+	unsigned int spanStart, spanMiddle, spanEnd;
+	if (destination <= index)
+	{
+		spanStart = destination;
+		spanMiddle = index;
+		spanEnd = end;
+	}
+	else
+	{
+		spanStart = index;
+		spanMiddle = end;
+		spanEnd = destination;
+	}
+	auto remap = [spanStart, spanMiddle, spanEnd](unsigned int i)
+	{
+		if (i < spanStart || i >= spanEnd) return i;
+		if (i < spanMiddle) return i + (spanEnd - spanMiddle);
+		return i - (spanMiddle - spanStart);
+	};
+
+	// Anything outside the span whose parent is inside it must
+	// be in the same root subtree as the span's last element
+	unsigned int fixupEnd = spanEnd;
+	if (spanEnd > spanStart)
+	{
+		unsigned int root = GetRootIndex(spanEnd - 1);
+		fixupEnd = std::max(spanEnd, root + subtreeSize[root]);
+	}
+
+	// Leave the old parent's subtree
+	for (unsigned int p = parentIndex[index]; p != NoParent; p = parentIndex[p])
+		subtreeSize[p] -= size;
+
+	// Rotate every array over the span
+	auto rotate = [spanStart, spanMiddle, spanEnd](auto& v)
+	{
+		std::rotate(v.begin() + spanStart, v.begin() + spanMiddle, v.begin() + spanEnd);
+	};
+	rotate(positionX); rotate(positionY); rotate(positionZ);
+	rotate(rotationX); rotate(rotationY); rotate(rotationZ);
+	rotate(quaternionX); rotate(quaternionY); rotate(quaternionZ); rotate(quaternionW);
+	rotate(scaleX); rotate(scaleY); rotate(scaleZ);
+	rotate(dirty);
+	rotate(local); rotate(localInverseTranspose);
+	rotate(world); rotate(worldInverseTranspose);
+	rotate(parentIndex); rotate(subtreeSize);
+	rotate(indexToHandle);
+
+	for (unsigned int i = spanStart; i < fixupEnd; i++)
+	{
+		if (parentIndex[i] != NoParent)
+			parentIndex[i] = remap(parentIndex[i]);
+	}
+	for (unsigned int i = spanStart; i < spanEnd; i++)
+		handleToIndex[indexToHandle[i]] = i;
+
+	// Join the new parent's subtree
+	unsigned int newIndex = remap(index);
+	parentIndex[newIndex] = newParent == NoParent ? NoParent : remap(newParent);
+	for (unsigned int p = parentIndex[newIndex]; p != NoParent; p = parentIndex[p])
+		subtreeSize[p] += size;
+
+	// Its matrices now come from somewhere else
+	dirty[newIndex] = 1;
+}
+
+unsigned int TransformSystem::GetRootIndex(unsigned int index)
+{
+	while (parentIndex[index] != NoParent)
+		index = parentIndex[index];
+	return index;
+}
+
+// Whether this transform or anything above it has changed
+bool TransformSystem::IsStale(unsigned int index)
+{
+	for (unsigned int i = index; i != NoParent; i = parentIndex[i])
+	{
+		if (dirty[i])
+			return true;
+	}
+	return false;
+}
+
+DirectX::XMFLOAT4X4 TransformSystem::GetWorldMatrix(TransformHandle handle)
+{
+	unsigned int i = handleToIndex[handle];
+	if (!IsStale(i))
+		return world[i];
+
+	XMMATRIX m4World, m4WorldInverseTranspose;
+	ComputeWorld(i, m4World, m4WorldInverseTranspose);
+
+	XMFLOAT4X4 result;
+	XMStoreFloat4x4(&result, m4World);
+	return result;
+}
+
+DirectX::XMFLOAT4X4 TransformSystem::GetWorldInverseTransposeMatrix(TransformHandle handle)
+{
+	unsigned int i = handleToIndex[handle];
+	if (!IsStale(i))
+		return worldInverseTranspose[i];
+
+	XMMATRIX m4World, m4WorldInverseTranspose;
+	ComputeWorld(i, m4World, m4WorldInverseTranspose);
+
+	XMFLOAT4X4 result;
+	XMStoreFloat4x4(&result, m4WorldInverseTranspose);
+	return result;
+}
+
+// --------------------------------------------------------
+// Works out a world matrix from scratch, without touching
+// anything cached, so Update() still does its job later
+// --------------------------------------------------------
+void TransformSystem::ComputeWorld(unsigned int index, DirectX::XMMATRIX& world, DirectX::XMMATRIX& worldInverseTranspose)
+{
+	XMMATRIX m4Rotation = XMMatrixRotationQuaternion(
+		XMVectorSet(quaternionX[index], quaternionY[index], quaternionZ[index], quaternionW[index]));
+	world =
+		XMMatrixScaling(scaleX[index], scaleY[index], scaleZ[index]) * m4Rotation *
+		XMMatrixTranslation(positionX[index], positionY[index], positionZ[index]);
+	worldInverseTranspose =
+		XMMatrixScaling(1.0f / scaleX[index], 1.0f / scaleY[index], 1.0f / scaleZ[index]) * m4Rotation;
+
+	if (parentIndex[index] != NoParent)
+	{
+		XMMATRIX parentWorld, parentWorldInverseTranspose;
+		ComputeWorld(parentIndex[index], parentWorld, parentWorldInverseTranspose);
+		world = world * parentWorld;
+		worldInverseTranspose = worldInverseTranspose * parentWorldInverseTranspose;
+	}
+}
+
+// --------------------------------------------------------
+// Rebuilds every dirty world matrix, in two passes
+//  - First the dirty local matrices, in batches of 8
+//  - Then parents' world matrices are pushed down to their
+//    children, in order, one root subtree range per thread
+// --------------------------------------------------------
+void TransformSystem::Update(JobSystem* jobSystem)
+{
+	if (count == 0)
+		return;
+
+	unsigned int jobCount = jobSystem && count >= MinCountForThreads ? jobSystem->GetThreadCount() : 1;
+
+	// Batches can be split anywhere
+	unsigned int batchCount = (count + 7) / 8;
+	std::vector<unsigned int> splits;
+	for (unsigned int j = 0; j <= jobCount; j++)
+		splits.push_back((unsigned int)((unsigned long long)batchCount * j / jobCount));
+	RunRanges(jobSystem, splits, &TransformSystem::UpdateBatches);
+
+	// Propagation has to start each range at a root, so bump
+	// each split forward to the end of the subtree it lands in
+	splits.clear();
+	splits.push_back(0);
+	for (unsigned int j = 1; j < jobCount; j++)
+	{
+		unsigned int split = (unsigned int)((unsigned long long)count * j / jobCount);
+		if (split < splits.back())
+			split = splits.back();
+		if (split < count && parentIndex[split] != NoParent)
+		{
+			unsigned int root = GetRootIndex(split);
+			split = root + subtreeSize[root];
+		}
+		splits.push_back(split);
+	}
+	splits.push_back(count);
+	RunRanges(jobSystem, splits, &TransformSystem::Propagate);
+}
+
+// --------------------------------------------------------
+// Calls func on each [splits[j], splits[j + 1]), with the
+// calling thread taking the last range itself
+// --------------------------------------------------------
+void TransformSystem::RunRanges(JobSystem* jobSystem, const std::vector<unsigned int>& splits, void (TransformSystem::*func)(unsigned int, unsigned int))
+{
+	unsigned int rangeCount = (unsigned int)splits.size() - 1;
+	if (rangeCount == 1)
+	{
+		(this->*func)(splits[0], splits[1]);
+		return;
+	}
+
+	JobCounter done;
+	for (unsigned int j = 0; j < rangeCount - 1; j++)
+	{
+		unsigned int first = splits[j];
+		unsigned int last = splits[j + 1];
+		if (first < last)
+			jobSystem->Run([this, func, first, last]() { (this->*func)(first, last); }, &done);
+	}
+
+	if (splits[rangeCount - 1] < splits[rangeCount])
+		(this->*func)(splits[rangeCount - 1], splits[rangeCount]);
+
+	jobSystem->Wait(&done);
+}
+
+void TransformSystem::UpdateBatches(unsigned int firstBatch, unsigned int lastBatch)
+{
+	if (useSIMD)
+	{
+		UpdateBatchesSIMD(firstBatch, lastBatch);
+		return;
+	}
+
+	for (unsigned int b = firstBatch; b < lastBatch; b++)
+	{
+		for (unsigned int i = b * 8; i < b * 8 + 8; i++)
+		{
+			if (dirty[i])
+				UpdateOne(i);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Builds scale * rotation * translation for 8 transforms at
+// once, with each __m256 holding one matrix element for all 8
+//  - The rotation comes from the cached quaternion, so this
+//    is nothing but multiplies and adds
+//  - Rotations are orthonormal, so the inverse transpose of
+//    scale * rotation is just the rotation divided by the scale
+//  - Results are written out per transform, since that's the
+//    layout the shaders want
+// --------------------------------------------------------
+void TransformSystem::UpdateBatchesSIMD(unsigned int firstBatch, unsigned int lastBatch)
+{
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 two = _mm256_set1_ps(2.0f);
+
+	for (unsigned int b = firstBatch; b < lastBatch; b++)
+	{
+		unsigned int i = b * 8;
+
+		// Skip the whole batch if none of it changed
+		unsigned long long anyDirty;
+		memcpy(&anyDirty, &dirty[i], sizeof(anyDirty));
+		if (!anyDirty)
+			continue;
+
+		__m256 qx = _mm256_loadu_ps(&quaternionX[i]);
+		__m256 qy = _mm256_loadu_ps(&quaternionY[i]);
+		__m256 qz = _mm256_loadu_ps(&quaternionZ[i]);
+		__m256 qw = _mm256_loadu_ps(&quaternionW[i]);
+		__m256 sx = _mm256_loadu_ps(&scaleX[i]);
+		__m256 sy = _mm256_loadu_ps(&scaleY[i]);
+		__m256 sz = _mm256_loadu_ps(&scaleZ[i]);
+		__m256 invSX = _mm256_div_ps(one, sx);
+		__m256 invSY = _mm256_div_ps(one, sy);
+		__m256 invSZ = _mm256_div_ps(one, sz);
+
+		// Products of the quaternion's components, doubled
+		__m256 x2 = _mm256_mul_ps(qx, two);
+		__m256 y2 = _mm256_mul_ps(qy, two);
+		__m256 z2 = _mm256_mul_ps(qz, two);
+		__m256 xx = _mm256_mul_ps(qx, x2);
+		__m256 yy = _mm256_mul_ps(qy, y2);
+		__m256 zz = _mm256_mul_ps(qz, z2);
+		__m256 xy = _mm256_mul_ps(qx, y2);
+		__m256 xz = _mm256_mul_ps(qx, z2);
+		__m256 yz = _mm256_mul_ps(qy, z2);
+		__m256 wx = _mm256_mul_ps(qw, x2);
+		__m256 wy = _mm256_mul_ps(qw, y2);
+		__m256 wz = _mm256_mul_ps(qw, z2);
+
+		// Rotation rows
+		__m256 r[9];
+		r[0] = _mm256_sub_ps(one, _mm256_add_ps(yy, zz));
+		r[1] = _mm256_add_ps(xy, wz);
+		r[2] = _mm256_sub_ps(xz, wy);
+		r[3] = _mm256_sub_ps(xy, wz);
+		r[4] = _mm256_sub_ps(one, _mm256_add_ps(xx, zz));
+		r[5] = _mm256_add_ps(yz, wx);
+		r[6] = _mm256_add_ps(xz, wy);
+		r[7] = _mm256_sub_ps(yz, wx);
+		r[8] = _mm256_sub_ps(one, _mm256_add_ps(xx, yy));
+
+		// Each row scaled (or unscaled) by its axis' scale
+		alignas(32) float m[9][8];
+		alignas(32) float n[9][8];
+		for (int e = 0; e < 9; e++)
+		{
+			__m256 s = e < 3 ? sx : (e < 6 ? sy : sz);
+			__m256 invS = e < 3 ? invSX : (e < 6 ? invSY : invSZ);
+			_mm256_store_ps(m[e], _mm256_mul_ps(s, r[e]));
+			_mm256_store_ps(n[e], _mm256_mul_ps(invS, r[e]));
+		}
+
+		for (unsigned int lane = 0; lane < 8; lane++)
+		{
+			bool root = parentIndex[i + lane] == NoParent;
+
+			XMFLOAT4X4& w = root ? world[i + lane] : local[i + lane];
+			w._11 = m[0][lane]; w._12 = m[1][lane]; w._13 = m[2][lane]; w._14 = 0.0f;
+			w._21 = m[3][lane]; w._22 = m[4][lane]; w._23 = m[5][lane]; w._24 = 0.0f;
+			w._31 = m[6][lane]; w._32 = m[7][lane]; w._33 = m[8][lane]; w._34 = 0.0f;
+			w._41 = positionX[i + lane]; w._42 = positionY[i + lane]; w._43 = positionZ[i + lane]; w._44 = 1.0f;
+
+			XMFLOAT4X4& it = root ? worldInverseTranspose[i + lane] : localInverseTranspose[i + lane];
+			it._11 = n[0][lane]; it._12 = n[1][lane]; it._13 = n[2][lane]; it._14 = 0.0f;
+			it._21 = n[3][lane]; it._22 = n[4][lane]; it._23 = n[5][lane]; it._24 = 0.0f;
+			it._31 = n[6][lane]; it._32 = n[7][lane]; it._33 = n[8][lane]; it._34 = 0.0f;
+			it._41 = 0.0f; it._42 = 0.0f; it._43 = 0.0f; it._44 = 1.0f;
+		}
+	}
+}
+
+// The one-at-a-time version, for non-AVX2 CPUs
+void TransformSystem::UpdateOne(unsigned int index)
+{
+	XMMATRIX m4Translation = XMMatrixTranslation(positionX[index], positionY[index], positionZ[index]);
+	XMMATRIX m4Scale = XMMatrixScaling(scaleX[index], scaleY[index], scaleZ[index]);
+	XMMATRIX m4InverseScale = XMMatrixScaling(1.0f / scaleX[index], 1.0f / scaleY[index], 1.0f / scaleZ[index]);
+	XMMATRIX m4Rotation = XMMatrixRotationQuaternion(
+		XMVectorSet(quaternionX[index], quaternionY[index], quaternionZ[index], quaternionW[index]));
+
+	bool root = parentIndex[index] == NoParent;
+	XMStoreFloat4x4(root ? &world[index] : &local[index], m4Scale * m4Rotation * m4Translation);
+	XMStoreFloat4x4(root ? &worldInverseTranspose[index] : &localInverseTranspose[index], m4InverseScale * m4Rotation);
+}
+
+// --------------------------------------------------------
+// Pushes world matrices down the hierarchy in one pass
+//  - Parents come first, so a parent's world matrix is
+//    always final by the time its children need it
+//  - A dirty transform makes its whole subtree range dirty,
+//    which is tracked by remembering where that range ends
+// --------------------------------------------------------
+void TransformSystem::Propagate(unsigned int first, unsigned int last)
+{
+	unsigned int dirtyEnd = first;
+	for (unsigned int i = first; i < last; i++)
+	{
+		if (dirty[i])
+		{
+			dirtyEnd = std::max(dirtyEnd, i + subtreeSize[i]);
+			dirty[i] = 0;
+		}
+
+		unsigned int p = parentIndex[i];
+		if (i >= dirtyEnd || p == NoParent)
+			continue;
+
+		XMStoreFloat4x4(&world[i], XMLoadFloat4x4(&local[i]) * XMLoadFloat4x4(&world[p]));
+		XMStoreFloat4x4(&worldInverseTranspose[i], XMLoadFloat4x4(&localInverseTranspose[i]) * XMLoadFloat4x4(&worldInverseTranspose[p]));
+	}
+}
@@ -0,0 +1,166 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+#include "CPUFeatures.h"
+#include "JobSystem.h"
+
+// Identifies one transform in a TransformSystem
+typedef unsigned int TransformHandle;
+const TransformHandle InvalidTransformHandle = 0xFFFFFFFF;
+
+// --------------------------------------------------------
+// Stores many transforms as structure-of-arrays and updates
+// their world matrices in batches
+//  - Each component (position x, position y, ...) lives in its
+//    own tightly packed array, so a batch of 8 transforms is
+//    one 256-bit load per component
+//  - Update() rebuilds dirty world matrices 8 at a time with
+//    AVX2 (when the CPU has it), split across the job system
+//    for big scenes
+//  - Batches with nothing dirty are skipped, so transforms
+//    that never move cost nothing per frame
+//  - Handles stay valid while other transforms come and go,
+//    since they go through an indirection table to the
+//    packed arrays
+//
+// Hierarchy
+//  - The arrays are kept in depth-first order: every parent
+//    comes before its children, and each transform's subtree
+//    is the contiguous range [index, index + subtree size)
+//  - That lets world matrices propagate in one linear pass,
+//    with independent root subtrees handed to different threads
+//  - Reparenting moves just the affected subtree to its new
+//    spot (a rotate of the range between old and new), rather
+//    than re-sorting everything
+// --------------------------------------------------------
+class TransformSystem
+{
+public:
+	TransformSystem();
+	~TransformSystem();
+
+	TransformHandle Create();
+	void Destroy(TransformHandle handle);
+	unsigned int GetCount() { return count; }
+
+	void MoveAbsolute(TransformHandle handle, float x, float y, float z);
+	void MoveRelative(TransformHandle handle, float x, float y, float z);
+	void Rotate(TransformHandle handle, float pitch, float yaw, float roll);
+	void Scale(TransformHandle handle, float x, float y, float z);
+
+	void SetPosition(TransformHandle handle, float x, float y, float z);
+	void SetRotation(TransformHandle handle, float pitch, float yaw, float roll);
+	void SetScale(TransformHandle handle, float x, float y, float z);
+
+	DirectX::XMFLOAT3 GetPosition(TransformHandle handle);
+	DirectX::XMFLOAT3 GetRotation(TransformHandle handle);
+	DirectX::XMFLOAT3 GetScale(TransformHandle handle);
+	DirectX::XMFLOAT4 GetRotationQuaternion(TransformHandle handle);
+
+	// Hierarchy - positions, rotations and scales are relative to the parent
+	//  - Pass InvalidTransformHandle to make a transform a root
+	//  - Destroying a transform turns its children into roots
+	void SetParent(TransformHandle handle, TransformHandle parent);
+	TransformHandle GetParent(TransformHandle handle);
+
+	// Worked out on the spot if they're out of date, so they're never stale
+	//  - The inverse transpose only covers the upper 3x3, since
+	//    it's just for transforming normals
+	DirectX::XMFLOAT4X4 GetWorldMatrix(TransformHandle handle);
+	DirectX::XMFLOAT4X4 GetWorldInverseTransposeMatrix(TransformHandle handle);
+
+	// Rebuilds every dirty world matrix
+	//  - Pass a job system to spread big updates across it
+	void Update(JobSystem* jobSystem = 0);
+
+	// Turns the SIMD path off, for comparing against it
+	void SetUseSIMD(bool useSIMD) { this->useSIMD = useSIMD && HasAVX2(); }
+
+private:
+	// Packed arrays, indexed by position in the arrays rather
+	// than by handle
+	//  - Always padded out to a multiple of 8 with harmless
+	//    identity transforms, so batches never need a tail case
+	//  - Roots write their matrices straight to world, while
+	//    children write to local and pick up their parent's world
+	//    in the propagation pass
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> rotationX, rotationY, rotationZ; // Pitch, yaw, roll - only for Get/Rotate
+	std::vector<float> quaternionX, quaternionY, quaternionZ, quaternionW;
+	std::vector<float> scaleX, scaleY, scaleZ;
+	std::vector<unsigned char> dirty;
+	std::vector<DirectX::XMFLOAT4X4> local;
+	std::vector<DirectX::XMFLOAT4X4> localInverseTranspose;
+	std::vector<DirectX::XMFLOAT4X4> world;
+	std::vector<DirectX::XMFLOAT4X4> worldInverseTranspose;
+
+	// Hierarchy, by index
+	std::vector<unsigned int> parentIndex;
+	std::vector<unsigned int> subtreeSize; // Including itself
+
+	// Handle <-> packed index
+	std::vector<unsigned int> handleToIndex;
+	std::vector<TransformHandle> indexToHandle;
+	std::vector<TransformHandle> freeHandles;
+
+	unsigned int count;
+	bool useSIMD;
+
+	void Resize(unsigned int paddedCount);
+	void MoveEntry(unsigned int from, unsigned int to);
+	void ResetEntry(unsigned int index);
+	void MarkRotationChanged(unsigned int index);
+	void MoveSubtree(unsigned int index, unsigned int newParent);
+	unsigned int GetRootIndex(unsigned int index);
+	bool IsStale(unsigned int index);
+
+	// Pass 1: rebuild the dirty local matrices in [firstBatch, lastBatch),
+	// where each batch is 8 transforms
+	void UpdateBatches(unsigned int firstBatch, unsigned int lastBatch);
+	void UpdateBatchesSIMD(unsigned int firstBatch, unsigned int lastBatch);
+	void UpdateOne(unsigned int index);
+
+	// Pass 2: push parents' world matrices down through [first, last),
+	// which must start at a root
+	void Propagate(unsigned int first, unsigned int last);
+
+	// From scratch, for transforms that are out of date
+	void ComputeWorld(unsigned int index, DirectX::XMMATRIX& world, DirectX::XMMATRIX& worldInverseTranspose);
+
+	// Runs func over each range, spread across the pool
+	void RunRanges(JobSystem* jobSystem, const std::vector<unsigned int>& splits, void (TransformSystem::*func)(unsigned int, unsigned int));
+};
+
+// --------------------------------------------------------
+// A handle paired with its system, so code holding one can
+// treat it like a Transform
+// --------------------------------------------------------
+class TransformRef
+{
+public:
+	TransformRef(TransformSystem* system, TransformHandle handle) : system(system), handle(handle) { }
+
+	void MoveAbsolute(float x, float y, float z) { system->MoveAbsolute(handle, x, y, z); }
+	void MoveRelative(float x, float y, float z) { system->MoveRelative(handle, x, y, z); }
+	void Rotate(float pitch, float yaw, float roll) { system->Rotate(handle, pitch, yaw, roll); }
+	void Scale(float x, float y, float z) { system->Scale(handle, x, y, z); }
+
+	void SetPosition(float x, float y, float z) { system->SetPosition(handle, x, y, z); }
+	void SetRotation(float pitch, float yaw, float roll) { system->SetRotation(handle, pitch, yaw, roll); }
+	void SetScale(float x, float y, float z) { system->SetScale(handle, x, y, z); }
+
+	DirectX::XMFLOAT3 GetPosition() { return system->GetPosition(handle); }
+	DirectX::XMFLOAT3 GetRotation() { return system->GetRotation(handle); }
+	DirectX::XMFLOAT3 GetScale() { return system->GetScale(handle); }
+	DirectX::XMFLOAT4X4 GetWorldMatrix() { return system->GetWorldMatrix(handle); }
+	DirectX::XMFLOAT4X4 GetWorldInverseTransposeMatrix() { return system->GetWorldInverseTransposeMatrix(handle); }
+
+	void SetParent(TransformRef parent) { system->SetParent(handle, parent.handle); }
+	void ClearParent() { system->SetParent(handle, InvalidTransformHandle); }
+
+	TransformHandle GetHandle() { return handle; }
+
+private:
+	TransformSystem* system;
+	TransformHandle handle;
+};
@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+
+// --------------------------------------------------------
+// Hands the newest of a stream of values from one producer
+// thread to one consumer thread, without locks or waiting
+//  - The producer fills GetBack() and calls Publish(); the
+//    consumer calls Consume() and reads GetFront()
+//  - Three copies: one being written, one being read, and the
+//    newest finished one in the middle, waiting to be picked up
+//  - Publishing again before the consumer gets to it replaces
+//    the waiting value, so the consumer always gets the newest
+//    and the producer never stalls on a slow consumer
+//  - Copies are reused, so a T holding vectors only allocates
+//    until they've grown to size
+// --------------------------------------------------------
+template<typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() : middle(1), back(0), front(2) { }
+
+	// Producer only
+	T& GetBack() { return buffers[back]; }
+	void Publish()
+	{
+		unsigned int old = middle.exchange(back | FreshBit, std::memory_order_acq_rel);
+		back = old & IndexMask;
+	}
+
+	// Consumer only - returns false if nothing new has been published,
+	// in which case the front stays as it was
+	bool Consume()
+	{
+		if ((middle.load(std::memory_order_relaxed) & FreshBit) == 0)
+			return false;
+
+		unsigned int old = middle.exchange(front, std::memory_order_acq_rel);
+		front = old & IndexMask;
+		return true;
+	}
+	T& GetFront() { return buffers[front]; }
+
+private:
+	static const unsigned int IndexMask = 3;
+	static const unsigned int FreshBit = 4;
+
+	T buffers[3];
+	std::atomic<unsigned int> middle; // Index, plus FreshBit when it's unread
+	unsigned int back;
+	unsigned int front;
+};
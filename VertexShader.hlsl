@@ -5,6 +5,7 @@ cbuffer ExternalData : register(b0)
 {
 	float4 colorTint;
 	matrix world;
+	matrix worldInverseTranspose;
 	matrix view;
 	matrix projection;
 }
@@ -38,10 +39,9 @@ VertexToPixel main( VertexShaderInput input )
 	output.worldPos = mul(world, float4(input.position, 1.0f)).xyz;
 
 	// Pass the normal through
-	// - This line is only valid if we're applying a uniform scale to the object.
-	// - To properly transform a normal using a non-uniform scale, you'll need to 
-	//   use the inverse transpose of the world matrix.
-	output.normal = mul((float3x3)world, input.normal);
+	// - Uses the inverse transpose of the world matrix, so
+	//   normals stay correct under non-uniform scale
+	output.normal = mul((float3x3)worldInverseTranspose, input.normal);
 	output.normal = normalize(output.normal);
 
 	// Pass the color through 
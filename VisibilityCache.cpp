@@ -0,0 +1,156 @@
+#include "VisibilityCache.h"
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+
+using namespace DirectX;
+
+// More than this in one frame is a cut rather than movement
+//  - Turn is the change in a unit normal, so 0.5 is about 29
+//    degrees; travel is in world units
+static const float CutTurn = 0.5f;
+static const float CutTravel = 10.0f;
+
+// The totals start again (as a cut) past this, before they
+// get big enough to lose precision
+static const float RebaseLimit = 1024.0f;
+
+// Margins closer than this to the drift are tested anyway,
+// for rounding in the tests themselves
+static const float Tolerance = 0.001f;
+
+static float Distance(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+	float x = a.x - b.x;
+	float y = a.y - b.y;
+	float z = a.z - b.z;
+	return sqrtf(x * x + y * y + z * z);
+}
+
+VisibilityCache::VisibilityCache()
+{
+	enabled = true;
+	epoch = 0;
+	turn = 0.0f;
+	travel = 0.0f;
+	cameraPosition = XMFLOAT3(0, 0, 0);
+	for (int p = 0; p < 6; p++)
+	{
+		previousPlanes[p] = XMFLOAT4(0, 0, 0, 0);
+		previousOffsets[p] = 0.0f;
+	}
+	ResetStats();
+}
+
+// --------------------------------------------------------
+// Works out how much any plane could have moved a point's
+// distance from it since the last frame
+//  - A plane's distance for a point p is n.(p - eye) + offset,
+//    so from one frame to the next it changes by at most
+//    |n' - n| * |p - eye'| + |eye' - eye| + |offset' - offset|;
+//    the first part is turn, scaled by the entity's distance
+//    in Check(), and the rest is travel
+// --------------------------------------------------------
+void VisibilityCache::BeginFrame(const Frustum& frustum, const XMFLOAT3& cameraPosition)
+{
+	frames++;
+
+	// Measured from the camera, so turning on the spot
+	// leaves them alone
+	float offsets[6];
+	for (int p = 0; p < 6; p++)
+	{
+		const XMFLOAT4& plane = frustum.planes[p];
+		offsets[p] = plane.w + plane.x * cameraPosition.x + plane.y * cameraPosition.y + plane.z * cameraPosition.z;
+	}
+
+	bool cut = epoch == 0;
+	if (!cut)
+	{
+		float frameTurn = 0.0f;
+		float frameShift = 0.0f;
+		for (int p = 0; p < 6; p++)
+		{
+			const XMFLOAT4& plane = frustum.planes[p];
+			const XMFLOAT4& previous = previousPlanes[p];
+			frameTurn = std::max(frameTurn, Distance(XMFLOAT3(plane.x, plane.y, plane.z), XMFLOAT3(previous.x, previous.y, previous.z)));
+			frameShift = std::max(frameShift, fabsf(offsets[p] - previousOffsets[p]));
+		}
+		float frameTravel = Distance(cameraPosition, this->cameraPosition) + frameShift;
+
+		turn += frameTurn;
+		travel += frameTravel;
+		cut = frameTurn > CutTurn || frameTravel > CutTravel || turn > RebaseLimit || travel > RebaseLimit;
+	}
+
+	if (cut)
+	{
+		epoch++;
+		turn = 0.0f;
+		travel = 0.0f;
+		cuts++;
+	}
+
+	for (int p = 0; p < 6; p++)
+	{
+		previousPlanes[p] = frustum.planes[p];
+		previousOffsets[p] = offsets[p];
+	}
+	this->cameraPosition = cameraPosition;
+}
+
+bool VisibilityCache::Check(const CullHistory& history, const XMFLOAT3& center, float radius, bool& visible)
+{
+	if (!enabled || history.epoch != epoch)
+	{
+		tested++;
+		return false;
+	}
+
+	float turned = turn - history.turn;
+	float travelled = travel - history.travel;
+	float moved = Distance(center, history.center) + fabsf(radius - history.radius);
+	float drift = turned * (history.reach + travelled) + travelled + moved;
+	if (drift + Tolerance >= fabsf(history.margin))
+	{
+		tested++;
+		return false;
+	}
+
+	visible = history.margin >= 0.0f;
+	reused++;
+	return true;
+}
+
+void VisibilityCache::Record(CullHistory& history, const XMFLOAT3& center, float radius, float margin)
+{
+	history.center = center;
+	history.radius = radius;
+	history.margin = margin;
+	history.reach = Distance(center, cameraPosition);
+	history.turn = turn;
+	history.travel = travel;
+	history.epoch = epoch;
+}
+
+void VisibilityCache::PrintStats()
+{
+	printf("---- Visibility cache: %s, %llu frames ----\n", enabled ? "on" : "off", frames);
+	if (frames == 0)
+		return;
+
+	unsigned long long checked = reused + tested;
+	printf("Per frame: %.1f tests skipped, %.1f tested (%.1f%% skipped)\n",
+		(double)reused / frames,
+		(double)tested / frames,
+		checked > 0 ? reused * 100.0 / checked : 0.0);
+	printf("Full culls (cuts and first frames): %llu\n", cuts);
+}
+
+void VisibilityCache::ResetStats()
+{
+	frames = 0;
+	cuts = 0;
+	reused = 0;
+	tested = 0;
+}
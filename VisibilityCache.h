@@ -0,0 +1,82 @@
+#pragma once
+#include <DirectXMath.h>
+#include "Collision.h"
+
+// What an entity's bounds were when the frustum last tested
+// them, and what came of it, for VisibilityCache
+//  - Kept on the entity as a component; epoch 0 means it's
+//    never been tested
+struct CullHistory
+{
+	DirectX::XMFLOAT3 center;
+	float radius;
+	float margin;		// Smallest distance + radius over the planes; visible when >= 0
+	float reach;		// Distance from the camera to the center
+	float turn;			// The cache's running totals at the time
+	float travel;
+	unsigned int epoch;
+};
+
+// --------------------------------------------------------
+// Lets frustum culling reuse last frame's answers for things
+// that can't have crossed a plane since
+//  - A sphere's answer only changes when its margin (how far it
+//    is inside the nearest plane, or outside the furthest) goes
+//    through zero, so it's kept, along with how far the camera
+//    had turned and travelled by then
+//  - Each frame, the planes are compared with the last frame's:
+//    the most any normal turned, and the most any plane moved
+//    relative to the camera, plus how far the camera went, are
+//    added to running totals
+//  - From those, and how far the entity was from the camera,
+//    Check() bounds how much its margin could have changed; if
+//    that, plus how far its own bounds moved, is less than the
+//    margin, the old answer still holds and the test is skipped
+//  - So things well inside or outside the frustum are skipped
+//    for as long as the camera keeps near where it was, and only
+//    those near an edge are tested every frame
+//  - A camera cut (a big jump or turn in one frame, or a new
+//    projection) starts a new epoch, which tests everything again
+// --------------------------------------------------------
+class VisibilityCache
+{
+public:
+	VisibilityCache();
+
+	// Once a frame, before any Check()
+	void BeginFrame(const Frustum& frustum, const DirectX::XMFLOAT3& cameraPosition);
+
+	// Whether the last test of the entity still holds for where
+	// its bounds are now, setting visible to that result if so
+	//  - Those that return false need testing, then Record()
+	bool Check(const CullHistory& history, const DirectX::XMFLOAT3& center, float radius, bool& visible);
+
+	// Keeps a fresh test's margin (see FrustumCuller::Cull())
+	void Record(CullHistory& history, const DirectX::XMFLOAT3& center, float radius, float margin);
+
+	// Turned off, every Check() fails, for comparing against it
+	void SetEnabled(bool enabled) { this->enabled = enabled; }
+	bool IsEnabled() { return enabled; }
+
+	void PrintStats();
+	void ResetStats();
+
+private:
+	bool enabled;
+	unsigned int epoch;
+
+	// Since the epoch began
+	float turn;		// Sum of each frame's largest change in a plane's normal
+	float travel;	// Sum of each frame's camera movement, and largest change in a plane's offset from it
+
+	// The frame before, to compare with
+	DirectX::XMFLOAT4 previousPlanes[6];
+	float previousOffsets[6];
+	DirectX::XMFLOAT3 cameraPosition;
+
+	// Stats
+	unsigned long long frames;
+	unsigned long long cuts;
+	unsigned long long reused;
+	unsigned long long tested;
+};
@@ -0,0 +1,263 @@
+#include "World.h"
+#include <mutex>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Chunks start on a cache line
+static const std::align_val_t ChunkAlignment = std::align_val_t(64);
+
+// The registered component types
+//  - A fixed array, so lookups never race with a new type
+//    being registered on another thread
+static ComponentInfo componentInfos[MaxComponentTypes];
+static unsigned int componentTypeCount = 0;
+static std::mutex componentTypeMutex;
+
+ComponentId RegisterComponentType(unsigned int size, unsigned int alignment)
+{
+	std::lock_guard<std::mutex> lock(componentTypeMutex);
+	if (componentTypeCount == MaxComponentTypes)
+	{
+		printf("Too many component types (the limit is %u)\n", MaxComponentTypes);
+		abort();
+	}
+
+	componentInfos[componentTypeCount].size = size;
+	componentInfos[componentTypeCount].alignment = alignment;
+	return componentTypeCount++;
+}
+
+const ComponentInfo& GetComponentInfo(ComponentId component)
+{
+	return componentInfos[component];
+}
+
+// --------------------------------------------------------
+// Lays out a chunk for the given components
+//  - The entity ids come first, then one array per component,
+//    each aligned for its type
+//  - Fits as many rows as the chunk has room for
+// --------------------------------------------------------
+Archetype::Archetype(ComponentMask mask)
+{
+	this->mask = mask;
+	entityCount = 0;
+	memset(columnOffsets, 0, sizeof(columnOffsets));
+	memset(neighbours, 0, sizeof(neighbours));
+
+	unsigned int rowSize = sizeof(EntityId);
+	for (ComponentId id = 0; id < MaxComponentTypes; id++)
+	{
+		if (mask & ((ComponentMask)1 << id))
+		{
+			components.push_back(id);
+			rowSize += GetComponentInfo(id).size;
+		}
+	}
+
+	// Start from the unpadded estimate and back off until the
+	// alignment padding fits too
+	for (capacity = ChunkSize / rowSize; capacity > 1; capacity--)
+	{
+		unsigned int offset = capacity * sizeof(EntityId);
+		for (ComponentId id : components)
+		{
+			const ComponentInfo& info = GetComponentInfo(id);
+			offset = (offset + info.alignment - 1) / info.alignment * info.alignment;
+			offset += info.size * capacity;
+		}
+		if (offset <= ChunkSize)
+			break;
+	}
+
+	unsigned int offset = capacity * sizeof(EntityId);
+	for (ComponentId id : components)
+	{
+		const ComponentInfo& info = GetComponentInfo(id);
+		offset = (offset + info.alignment - 1) / info.alignment * info.alignment;
+		columnOffsets[id] = offset;
+		offset += info.size * capacity;
+	}
+}
+
+Archetype::~Archetype()
+{
+	for (unsigned char* chunk : chunks)
+		operator delete(chunk, ChunkAlignment);
+}
+
+unsigned int Archetype::GetCount(unsigned int chunk)
+{
+	// Only the last chunk can be partly full
+	return chunk + 1 < chunks.size() ? capacity : entityCount - chunk * capacity;
+}
+
+unsigned int Archetype::AddRow(EntityId entity)
+{
+	unsigned int row = entityCount;
+	if (row == chunks.size() * capacity)
+		chunks.push_back((unsigned char*)operator new(ChunkSize, ChunkAlignment));
+
+	GetEntities(row / capacity)[row % capacity] = entity;
+	entityCount++;
+	return row;
+}
+
+EntityId Archetype::RemoveRow(unsigned int row)
+{
+	unsigned int last = entityCount - 1;
+	EntityId moved = InvalidEntity;
+
+	// Fill the hole with the last row
+	if (row != last)
+	{
+		for (ComponentId id : components)
+			memcpy(GetComponent(row, id), GetComponent(last, id), GetComponentInfo(id).size);
+
+		moved = GetEntities(last / capacity)[last % capacity];
+		GetEntities(row / capacity)[row % capacity] = moved;
+	}
+
+	// Let go of the last chunk once it's empty
+	entityCount--;
+	if (entityCount == (chunks.size() - 1) * capacity)
+	{
+		operator delete(chunks.back(), ChunkAlignment);
+		chunks.pop_back();
+	}
+
+	return moved;
+}
+
+unsigned char* Archetype::GetComponent(unsigned int row, ComponentId component)
+{
+	return chunks[row / capacity] + columnOffsets[component] + (row % capacity) * GetComponentInfo(component).size;
+}
+
+
+World::World()
+{
+	entityCount = 0;
+}
+
+World::~World()
+{
+	for (Archetype* archetype : archetypes)
+		delete archetype;
+}
+
+void World::Destroy(EntityId entity)
+{
+	if (!IsAlive(entity))
+		return;
+
+	EntityRecord& record = records[entity.index];
+	EntityId moved = record.archetype->RemoveRow(record.row);
+	if (moved != InvalidEntity)
+		records[moved.index].row = record.row;
+
+	// Old handles stop matching from here on
+	record.archetype = 0;
+	record.generation++;
+	freeIds.push_back(entity.index);
+	entityCount--;
+}
+
+bool World::IsAlive(EntityId entity)
+{
+	return
+		entity.index < records.size() &&
+		records[entity.index].generation == entity.generation &&
+		records[entity.index].archetype != 0;
+}
+
+Archetype* World::GetArchetype(ComponentMask mask)
+{
+	auto found = archetypeLookup.find(mask);
+	if (found != archetypeLookup.end())
+		return found->second;
+
+	Archetype* archetype = new Archetype(mask);
+	archetypes.push_back(archetype);
+	archetypeLookup[mask] = archetype;
+	return archetype;
+}
+
+Archetype* World::GetNeighbour(Archetype* archetype, ComponentId component)
+{
+	if (!archetype->neighbours[component])
+		archetype->neighbours[component] = GetArchetype(archetype->mask ^ ((ComponentMask)1 << component));
+	return archetype->neighbours[component];
+}
+
+EntityId World::CreateInArchetype(Archetype* archetype)
+{
+	EntityId entity;
+	if (!freeIds.empty())
+	{
+		entity.index = freeIds.back();
+		freeIds.pop_back();
+	}
+	else
+	{
+		// Generations start at 1, so default handles never match
+		entity.index = (unsigned int)records.size();
+		records.push_back(EntityRecord{ 0, 0, 1 });
+	}
+	entity.generation = records[entity.index].generation;
+
+	records[entity.index].archetype = archetype;
+	records[entity.index].row = archetype->AddRow(entity);
+	entityCount++;
+	return entity;
+}
+
+// --------------------------------------------------------
+// Moves an entity's row to another archetype, carrying over
+// the components both have in common
+//  - Components only the new archetype has are left for
+//    the caller to fill in
+// --------------------------------------------------------
+void World::MoveEntity(EntityId entity, Archetype* to)
+{
+	EntityRecord& record = records[entity.index];
+	Archetype* from = record.archetype;
+	unsigned int newRow = to->AddRow(entity);
+
+	for (ComponentId id : to->components)
+	{
+		if (from->mask & ((ComponentMask)1 << id))
+			memcpy(to->GetComponent(newRow, id), from->GetComponent(record.row, id), GetComponentInfo(id).size);
+	}
+
+	EntityId moved = from->RemoveRow(record.row);
+	if (moved != InvalidEntity)
+		records[moved.index].row = record.row;
+
+	record.archetype = to;
+	record.row = newRow;
+}
+
+unsigned char* World::GetComponentData(EntityId entity, ComponentId component)
+{
+	if (!IsAlive(entity))
+		return 0;
+
+	EntityRecord& record = records[entity.index];
+	if ((record.archetype->mask & ((ComponentMask)1 << component)) == 0)
+		return 0;
+	return record.archetype->GetComponent(record.row, component);
+}
+
+void World::CollectChunks(ComponentMask mask, std::vector<ChunkRef>& chunks)
+{
+	for (Archetype* archetype : archetypes)
+	{
+		if ((archetype->mask & mask) != mask)
+			continue;
+
+		for (unsigned int c = 0; c < archetype->GetChunkCount(); c++)
+			chunks.push_back(ChunkRef{ archetype, c });
+	}
+}
@@ -0,0 +1,255 @@
+#pragma once
+#include <functional>
+#include <string.h>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include "JobSystem.h"
+#include "HandlePool.h"
+
+// Identifies one entity in a World
+//  - Generational, so handles to destroyed entities are caught
+typedef Handle<struct EntityTag> EntityId;
+const EntityId InvalidEntity = EntityId();
+
+// Components are plain structs, each given a small id the
+// first time it's used
+//  - An archetype is the set of components an entity has,
+//    stored as one bit per component id
+typedef unsigned int ComponentId;
+typedef unsigned long long ComponentMask;
+const unsigned int MaxComponentTypes = 64;
+
+struct ComponentInfo
+{
+	unsigned int size;
+	unsigned int alignment;
+};
+
+ComponentId RegisterComponentType(unsigned int size, unsigned int alignment);
+const ComponentInfo& GetComponentInfo(ComponentId component);
+
+template<typename T>
+ComponentId GetComponentId()
+{
+	static_assert(std::is_trivially_copyable<T>::value, "Components are moved around with memcpy");
+	static const ComponentId id = RegisterComponentType((unsigned int)sizeof(T), (unsigned int)alignof(T));
+	return id;
+}
+
+template<typename... Ts>
+ComponentMask GetComponentMask()
+{
+	return ((ComponentMask)0 | ... | ((ComponentMask)1 << GetComponentId<Ts>()));
+}
+
+// --------------------------------------------------------
+// Every entity with one particular set of components
+//  - Entities are packed into fixed-size chunks, and within a
+//    chunk each component has its own array, so a system only
+//    pulls the components it asks for into cache
+//  - Rows are kept dense: removing an entity moves the very
+//    last one into its spot, so every chunk but the last is full
+// --------------------------------------------------------
+class Archetype
+{
+public:
+	static const unsigned int ChunkSize = 16 * 1024;
+
+	Archetype(ComponentMask mask);
+	~Archetype();
+
+	ComponentMask GetMask() { return mask; }
+	unsigned int GetEntityCount() { return entityCount; }
+	unsigned int GetChunkCount() { return (unsigned int)chunks.size(); }
+	unsigned int GetChunkCapacity() { return capacity; }
+
+	// Per chunk - how many entities it holds, and the start of
+	// their ids and of one component's array
+	unsigned int GetCount(unsigned int chunk);
+	EntityId* GetEntities(unsigned int chunk) { return (EntityId*)chunks[chunk]; }
+	void* GetColumn(unsigned int chunk, ComponentId component) { return chunks[chunk] + columnOffsets[component]; }
+
+private:
+	friend class World;
+
+	ComponentMask mask;
+	std::vector<ComponentId> components;
+	unsigned int columnOffsets[MaxComponentTypes];
+	unsigned int capacity;
+	unsigned int entityCount;
+	std::vector<unsigned char*> chunks;
+
+	// The archetype with one component added or taken away,
+	// filled in as they're first needed
+	Archetype* neighbours[MaxComponentTypes];
+
+	// Rows count across chunks: row / capacity is the chunk
+	unsigned int AddRow(EntityId entity);
+	EntityId RemoveRow(unsigned int row); // Returns the entity moved into row, if any
+	unsigned char* GetComponent(unsigned int row, ComponentId component);
+};
+
+// --------------------------------------------------------
+// Holds all the entities, grouped by archetype
+//  - Adding or removing a component moves the entity's data
+//    to the matching archetype
+//  - Component pointers from Get() and the queries are only
+//    good until the next Create/Destroy/Add/Remove
+//  - Queries call back once per chunk with the entity count
+//    and a pointer to each requested component's array:
+//      world->ForEachChunk<Bounds, Velocity>(
+//        [](unsigned int count, EntityId* ids, Bounds* b, Velocity* v) { ... });
+//  - Handles to destroyed entities are safe to pass in:
+//    they have no components, and changes to them are ignored
+//  - Not thread safe for structural changes, though the
+//    callbacks of ParallelForEachChunk can write to the
+//    components of the chunk they're given
+// --------------------------------------------------------
+class World
+{
+public:
+	World();
+	~World();
+
+	template<typename... Ts> EntityId Create(const Ts&... components);
+	void Destroy(EntityId entity);
+	bool IsAlive(EntityId entity);
+	unsigned int GetEntityCount() { return entityCount; }
+	unsigned int GetArchetypeCount() { return (unsigned int)archetypes.size(); }
+
+	template<typename T> bool Has(EntityId entity);
+	template<typename T> T* Get(EntityId entity); // Null if the entity doesn't have one
+	template<typename T> void Add(EntityId entity, const T& component); // Overwrites an existing one
+	template<typename T> void Remove(EntityId entity);
+
+	// Every chunk whose archetype has all of Ts
+	//  - func(unsigned int count, EntityId* entities, Ts*... components)
+	template<typename... Ts, typename Func> void ForEachChunk(Func func);
+
+	// Same, with the chunks spread across the job system's threads
+	template<typename... Ts, typename Func> void ParallelForEachChunk(JobSystem* jobSystem, Func func);
+
+	// Every entity with all of Ts, one at a time
+	//  - func(EntityId entity, Ts&... components)
+	template<typename... Ts, typename Func> void ForEach(Func func);
+
+private:
+	struct EntityRecord
+	{
+		Archetype* archetype; // Null while the slot is free
+		unsigned int row;
+		unsigned int generation;
+	};
+
+	struct ChunkRef
+	{
+		Archetype* archetype;
+		unsigned int chunk;
+	};
+
+	std::vector<EntityRecord> records;
+	std::vector<unsigned int> freeIds;
+	std::vector<Archetype*> archetypes;
+	std::unordered_map<ComponentMask, Archetype*> archetypeLookup;
+	unsigned int entityCount;
+
+	Archetype* GetArchetype(ComponentMask mask);
+	Archetype* GetNeighbour(Archetype* archetype, ComponentId component);
+	EntityId CreateInArchetype(Archetype* archetype);
+	void MoveEntity(EntityId entity, Archetype* to);
+	unsigned char* GetComponentData(EntityId entity, ComponentId component);
+	void CollectChunks(ComponentMask mask, std::vector<ChunkRef>& chunks);
+};
+
+template<typename... Ts>
+EntityId World::Create(const Ts&... components)
+{
+	EntityId entity = CreateInArchetype(GetArchetype(GetComponentMask<Ts...>()));
+	(memcpy(GetComponentData(entity, GetComponentId<Ts>()), &components, sizeof(Ts)), ...);
+	return entity;
+}
+
+template<typename T>
+bool World::Has(EntityId entity)
+{
+	return IsAlive(entity) && (records[entity.index].archetype->mask & GetComponentMask<T>()) != 0;
+}
+
+template<typename T>
+T* World::Get(EntityId entity)
+{
+	return (T*)GetComponentData(entity, GetComponentId<T>());
+}
+
+template<typename T>
+void World::Add(EntityId entity, const T& component)
+{
+	if (!IsAlive(entity))
+		return;
+
+	ComponentId id = GetComponentId<T>();
+	Archetype* archetype = records[entity.index].archetype;
+	if ((archetype->mask & ((ComponentMask)1 << id)) == 0)
+		MoveEntity(entity, GetNeighbour(archetype, id));
+	memcpy(GetComponentData(entity, id), &component, sizeof(T));
+}
+
+template<typename T>
+void World::Remove(EntityId entity)
+{
+	if (!IsAlive(entity))
+		return;
+
+	ComponentId id = GetComponentId<T>();
+	Archetype* archetype = records[entity.index].archetype;
+	if ((archetype->mask & ((ComponentMask)1 << id)) != 0)
+		MoveEntity(entity, GetNeighbour(archetype, id));
+}
+
+template<typename... Ts, typename Func>
+void World::ForEachChunk(Func func)
+{
+	ComponentMask mask = GetComponentMask<Ts...>();
+	for (Archetype* archetype : archetypes)
+	{
+		if ((archetype->mask & mask) != mask)
+			continue;
+
+		for (unsigned int c = 0; c < archetype->GetChunkCount(); c++)
+			func(archetype->GetCount(c), archetype->GetEntities(c), (Ts*)archetype->GetColumn(c, GetComponentId<Ts>())...);
+	}
+}
+
+template<typename... Ts, typename Func>
+void World::ParallelForEachChunk(JobSystem* jobSystem, Func func)
+{
+	std::vector<ChunkRef> chunks;
+	CollectChunks(GetComponentMask<Ts...>(), chunks);
+
+	auto body = [&](unsigned int first, unsigned int last)
+	{
+		for (unsigned int i = first; i < last; i++)
+		{
+			Archetype* archetype = chunks[i].archetype;
+			unsigned int c = chunks[i].chunk;
+			func(archetype->GetCount(c), archetype->GetEntities(c), (Ts*)archetype->GetColumn(c, GetComponentId<Ts>())...);
+		}
+	};
+
+	// A chunk is already a good-sized piece of work
+	if (jobSystem)
+		jobSystem->ParallelFor((unsigned int)chunks.size(), 1, body);
+	else
+		body(0, (unsigned int)chunks.size());
+}
+
+template<typename... Ts, typename Func>
+void World::ForEach(Func func)
+{
+	ForEachChunk<Ts...>([&](unsigned int count, EntityId* entities, Ts*... components)
+	{
+		for (unsigned int i = 0; i < count; i++)
+			func(entities[i], components[i]...);
+	});
+}